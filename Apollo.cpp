@@ -2,13 +2,15 @@
 #include "Apollo.h"
 
 #include "DDSTextureLoader12.h"
+#include "DdsMipFile.h"
 #include "QuadSphereGenerator.h"
 #include "ReadData.h"
+#include "TileFile.h"
 
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx12.h"
 
-extern void ExitGame() noexcept;
+extern void ExitGame(int exitCode = 0) noexcept;
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -28,6 +30,8 @@ Apollo::Apollo() noexcept :
 
 Apollo::~Apollo()
 {
+    StopSimulation();
+
     // Ensure that the GPU is no longer referencing resources that are about to be destroyed.
     WaitForGpu();
 
@@ -39,6 +43,11 @@ Apollo::~Apollo()
 // Initialize the Direct3D resources required to run.
 void Apollo::InitializeD3DResources(HWND window, int width, int height, UINT subDivideCount, UINT shadowMapSize, BOOL fullScreenMode)
 {
+    PROFILE_THREAD_NAME("Main");
+    PROFILE_SCOPE("Initialize");
+
+    m_startTime = std::chrono::steady_clock::now();
+
     m_window = window;
     m_outputWidth = std::max(width, 1);
     m_outputHeight = std::max(height, 1);
@@ -47,16 +56,110 @@ void Apollo::InitializeD3DResources(HWND window, int width, int height, UINT sub
 
     // Initialize values.
     m_isFlightMode = true;
+    std::fill(std::begin(m_keyTracker), std::end(m_keyTracker), false);
 
     m_subDivideCount = subDivideCount;
     m_shadowMapSize = shadowMapSize;
 
+    m_totalIndexData = nullptr;
     m_totalIBSize = 0;
     m_totalIndexCount = 0;
     m_staticVBSize = 0;
     m_staticVertexCount = 0;
+    m_drawArgumentUploadSize = 0;
+    m_drawArgumentUploadTotal = 0;
+    m_sphereLoadTime = 0.0f;
+    m_reportSphere = false;
+    std::fill(std::begin(m_sphereReports), std::end(m_sphereReports), SphereReport{});
+    m_sphereReportCount = 0;
+    m_meshCacheHit = false;
 
     m_culledQuadCount = 0;
+    m_horizonCulledQuadCount = 0;
+    m_shadowCulledQuadCount = 0;
+    m_drawCount = 0;
+    m_shadowDrawCount = 0;
+    m_cullingTime = 0.0f;
+    m_simdCulling = true;
+    m_horizonCulling = true;
+
+    m_temporalCulling = true;
+    m_cullFrameCount = 0;
+    m_cullSkippedFrameCount = 0;
+    m_cullBatchCount = 0;
+    m_planeHintHitCount = 0;
+    m_fullCullingTime = 0.0f;
+    m_cullingSavedTime = 0.0f;
+
+    // Simulation thread dispatches culling, one core is left for render thread.
+    m_workerPool = std::make_unique<WorkerPool>(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    m_cullThreadCount = static_cast<int>(m_workerPool->GetThreadCount());
+    m_measureCullingScaling = false;
+    m_sceneCuller = std::make_unique<SceneCuller>(m_faceTrees, *m_workerPool);
+
+    m_tessEstimate = false;
+    m_tessEstimated = false;
+    std::fill(std::begin(m_tessTriangleCount), std::end(m_tessTriangleCount), 0);
+    m_tessEstimateTime = 0.0f;
+    m_checkTess = false;
+    m_tessCheck = {};
+    m_tessCheckCameraCount = 0;
+    m_tessCheckTime = 0.0f;
+
+    m_expandTess = false;
+    m_checkTessMesh = false;
+    m_tessMeshTriangleCount = 0;
+    m_tessMeshVertexCount = 0;
+    m_tessMeshTime = 0.0f;
+    m_tessMeshExported = false;
+    m_tessMeshCheck = {};
+    m_tessMeshCheckPatchCount = 0;
+    m_tessMeshCheckTime = 0.0f;
+
+    m_patternGeometry = false;
+    m_patternSupported = false;
+    m_patternBuildTime = 0.0f;
+    m_patternUploadSize = 0;
+
+    m_terrainLoadTime = 0.0f;
+    m_groundClamp = true;
+    m_cameraAltitude = 0.0f;
+    m_benchmarkTerrain = false;
+    m_terrainBenchmark = {};
+
+    m_tileHeapSlotStart = 0;
+    m_streamUploadMappedData = nullptr;
+    m_streamUploadFrameSize = 0;
+    m_tileFrame = 0;
+    m_tileStreamingState = nullptr;
+    m_timeToFirstFrame = 0.0f;
+    m_timeToFullDetail = 0.0f;
+
+    m_simulatedFrameCount = 0;
+    m_renderedFrameCount = 0;
+    m_simulationExit = false;
+    m_requests = {};
+    m_handledRequests = {};
+    m_requestedReplayFileName[0] = L'\0';
+    m_requestedExitAfterReplay = false;
+    m_hasFramePacket = false;
+
+    m_inputLatency = 0.0f;
+    m_inputLatencyTotal = 0.0;
+    m_inputLatencyCount = 0;
+
+    m_updateAllocations = {};
+    m_renderAllocations = {};
+    m_frameAllocations = {};
+    m_frameStartAllocations = {};
+
+    m_replayFrameStats = {};
+    m_replayFrame = 0;
+    m_replayFrameUpdated = false;
+    m_recording = false;
+    m_replaying = false;
+    m_exitAfterReplay = false;
+    m_replayExitCode = -1;
 
 	m_renderShadow = true;
     m_lightRotation = true;
@@ -83,8 +186,6 @@ void Apollo::InitializeD3DResources(HWND window, int width, int height, UINT sub
     m_lightDirection = XMVector3TransformCoord(m_lightDirection, XMMatrixRotationY(3.0f));
 
     m_shadowTransform = IDENTITY_MATRIX;
-    m_lightNearZ = 0.0f;
-    m_lightFarZ = 0.0f;
     m_lightPosition = XMFLOAT3(0.0f, 0.0f, 0.0f);
     m_lightView = IDENTITY_MATRIX;
     m_lightProj = IDENTITY_MATRIX;
@@ -98,17 +199,150 @@ void Apollo::InitializeD3DResources(HWND window, int width, int height, UINT sub
     CreateDeviceDependentResources();
     CreateWindowSizeDependentResources();
     CreateCommandListDependentResources();
+
+    StartSimulation();
 }
 
 // Executes the basic game loop.
+// Input is handed to simulation thread, and the latest frame packet it published is drawn.
+// Without a new packet the last one is drawn again, so UI stays responsive.
 void Apollo::Tick()
 {
-    m_timer.Tick([&]()
+    const AllocationCount renderStart = AllocationCounter::GetThreadCount();
+
+    SampleInput();
+
+    const bool newPacket = m_framePackets.Acquire();
+    if (newPacket)
     {
-        Update(m_timer);
-    });
+        {
+            std::lock_guard<std::mutex> lock(m_simulationMutex);
+            m_renderedFrameCount++;
+        }
+        m_simulationCondition.notify_one();
+
+        m_hasFramePacket = true;
+    }
+
+    // Don't try to render anything before the first simulated frame.
+    if (!m_hasFramePacket)
+        return;
+
+    const FramePacket& packet = m_framePackets.GetReadBuffer();
+    Render(packet, newPacket);
+
+    m_renderAllocations = AllocationCounter::GetThreadCount() - renderStart;
+
+    // Replay runner is done.
+    if (newPacket && packet.stats.replayExitCode >= 0)
+        ExitGame(packet.stats.replayExitCode);
+}
+
+void Apollo::StartSimulation()
+{
+    // Slots are sized once, so publishing a packet never allocates.
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        for (auto& drawSlots : m_framePackets.GetBuffer(i).drawSlots)
+            drawSlots.assign(m_drawSlotCount, {});
+    }
+
+    m_simulatedFrameCount = 0;
+    m_renderedFrameCount = 0;
+    m_simulationExit = false;
+    m_hasFramePacket = false;
+
+    // First frame is simulated with current input.
+    SampleInput();
+
+    m_simulationThread = std::thread(&Apollo::SimulationMain, this);
+}
+
+void Apollo::StopSimulation()
+{
+    if (!m_simulationThread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_simulationMutex);
+        m_simulationExit = true;
+    }
+    m_simulationCondition.notify_one();
+
+    m_simulationThread.join();
+}
+
+void Apollo::SimulationMain()
+{
+    PROFILE_THREAD_NAME("Simulation");
+
+    for (;;)
+    {
+        // Wait until render thread took the last packet.
+        {
+            std::unique_lock<std::mutex> lock(m_simulationMutex);
+            m_simulationCondition.wait(lock, [&]()
+            {
+                return m_simulationExit || m_renderedFrameCount >= m_simulatedFrameCount;
+            });
+            if (m_simulationExit)
+                return;
+        }
+
+        // Allocations of the whole process from last simulated frame start to this one.
+        const AllocationCount frameStart = AllocationCounter::GetCount();
+        m_frameAllocations = frameStart - m_frameStartAllocations;
+        m_frameStartAllocations = frameStart;
+
+        // Keep the last input if render thread didn't sample a new one.
+        m_simulationInputs.Acquire();
+        const SimulationInput& input = m_simulationInputs.GetReadBuffer();
+
+        const AllocationCount updateStart = AllocationCounter::GetThreadCount();
+
+        m_timer.Tick([&]()
+        {
+            Update(m_timer, input);
+        });
+
+        m_updateAllocations = AllocationCounter::GetThreadCount() - updateStart;
+
+        WriteFramePacket(input, m_framePackets.GetWriteBuffer());
+        m_framePackets.Publish();
 
-    Render();
+        std::lock_guard<std::mutex> lock(m_simulationMutex);
+        m_simulatedFrameCount++;
+    }
+}
+
+void Apollo::SampleInput()
+{
+    SimulationInput& input = m_simulationInputs.GetWriteBuffer();
+
+    input.sampleTime = std::chrono::steady_clock::now();
+    input.aspectRatio = m_aspectRatio;
+    input.outputHeight = m_outputHeight;
+    input.camYaw = m_camYaw;
+    input.camPitch = m_camPitch;
+    input.camMoveSpeed = m_camMoveSpeed;
+    input.forwardMove = m_keyTracker['W'] ? 1.0f : m_keyTracker['S'] ? -1.0f : 0.0f;
+    input.rightMove = m_keyTracker['A'] ? -1.0f : m_keyTracker['D'] ? 1.0f : 0.0f;
+    input.lightRotation = m_lightRotation;
+    input.renderShadow = m_renderShadow;
+    input.simdCulling = m_simdCulling;
+    input.horizonCulling = m_horizonCulling;
+    input.temporalCulling = m_temporalCulling;
+    input.tessEstimate = m_tessEstimate;
+    input.patternGeometry = m_patternGeometry && m_patternSupported;
+    input.groundClamp = m_groundClamp;
+    input.cullThreadCount = m_cullThreadCount;
+    input.tessMin = m_tessMin;
+    input.tessMax = m_tessMax;
+    input.requests = m_requests;
+    input.exitAfterReplay = m_requestedExitAfterReplay;
+    memcpy(input.replayFileName, m_requestedReplayFileName, sizeof(input.replayFileName));
+
+    m_simulationInputs.Publish();
 }
 
 void Apollo::OnKeyDown(UINT8 key)
@@ -126,12 +360,12 @@ void Apollo::OnKeyDown(UINT8 key)
         return;
     }
 
-    m_keyTracker.insert_or_assign(key, true);
+    m_keyTracker[key] = true;
 }
 
 void Apollo::OnKeyUp(UINT8 key)
 {
-    m_keyTracker.insert_or_assign(key, false);
+    m_keyTracker[key] = false;
 }
 
 void Apollo::OnMouseWheel(float delta)
@@ -156,128 +390,479 @@ void Apollo::OnMouseMove(int x, int y)
     SetCursorPos(pt.x, pt.y);
 }
 
-// Updates the world.
-void Apollo::Update(DX::StepTimer const& timer)
+// Updates the world. Runs on simulation thread.
+void Apollo::Update(DX::StepTimer const& timer, const SimulationInput& input)
 {
+    PROFILE_SCOPE("Update");
+
 	const auto elapsedTime = static_cast<float>(timer.GetElapsedSeconds());
+    const auto updateStart = std::chrono::high_resolution_clock::now();
+
+    // Last replayed frame is done, its render overlapped this frame start.
+    if (m_replaying && m_replayFrameUpdated)
+        EndReplayFrame();
+
+    HandleRequests(input);
+
+    // Replayed frame overrides input and timer driven state.
+    float camYaw = input.camYaw;
+    float camPitch = input.camPitch;
+    if (m_replaying)
+    {
+        const CameraFrame& frame = m_cameraPath.GetFrame(m_replayFrame);
+        ApplyCameraFrame(frame);
+        camYaw = frame.yaw;
+        camPitch = frame.pitch;
+    }
+
+    // Move camera based on its orientation.
+    {
+        PROFILE_SCOPE("Camera");
+
+        m_camRotationMatrix = XMMatrixRotationRollPitchYaw(camPitch, camYaw, 0.0f);
+        m_camLookTarget = XMVector3TransformCoord(DEFAULT_FORWARD_VECTOR, m_camRotationMatrix);
+        m_camLookTarget = XMVector3Normalize(m_camLookTarget);
+
+        m_camRight = XMVector3TransformCoord(DEFAULT_RIGHT_VECTOR, m_camRotationMatrix);
+        m_camUp = XMVector3TransformCoord(DEFAULT_UP_VECTOR, m_camRotationMatrix);
+        m_camForward = XMVector3TransformCoord(DEFAULT_FORWARD_VECTOR, m_camRotationMatrix);
+
+        // Flight mode.
+        if (!m_replaying)
+        {
+            const float verticalMove = input.forwardMove * elapsedTime * input.camMoveSpeed;
+            const float horizontalMove = input.rightMove * elapsedTime * input.camMoveSpeed;
 
-    // Set view matrix based on camera position and orientation.
-    m_camRotationMatrix = XMMatrixRotationRollPitchYaw(m_camPitch, m_camYaw, 0.0f);
-    m_camLookTarget = XMVector3TransformCoord(DEFAULT_FORWARD_VECTOR, m_camRotationMatrix);
-    m_camLookTarget = XMVector3Normalize(m_camLookTarget);
+            m_camPosition += horizontalMove * m_camRight;
+            m_camPosition += verticalMove * m_camForward;
+        }
 
-    m_camRight = XMVector3TransformCoord(DEFAULT_RIGHT_VECTOR, m_camRotationMatrix);
-    m_camUp = XMVector3TransformCoord(DEFAULT_UP_VECTOR, m_camRotationMatrix);
-    m_camForward = XMVector3TransformCoord(DEFAULT_FORWARD_VECTOR, m_camRotationMatrix);
+        ClampCameraToGround(input);
 
-    // Flight mode.
-    const float verticalMove = (m_keyTracker['W'] ? 1.0f : m_keyTracker['S'] ? -1.0f : 0.0f) * elapsedTime * m_camMoveSpeed;
-    const float horizontalMove = (m_keyTracker['A'] ? -1.0f : m_keyTracker['D'] ? 1.0f : 0.0f) * elapsedTime * m_camMoveSpeed;
+        m_camLookTarget = m_camPosition + m_camLookTarget;
+    }
 
-    m_camPosition += horizontalMove * m_camRight;
-    m_camPosition += verticalMove * m_camForward;
+    // Light rotation update.
+    if (input.lightRotation && !m_replaying)
+        m_lightDirection = XMVector3TransformCoord(m_lightDirection, XMMatrixRotationY(elapsedTime / 24.0f));
 
-    m_camLookTarget = m_camPosition + m_camLookTarget;
-    m_viewMatrix = XMMatrixLookAtLH(m_camPosition, m_camLookTarget, m_camUp);
+    // Camera and light transforms of this frame, derived the same way headless replay does.
+    SceneView sceneView;
+    {
+        PROFILE_SCOPE("Scene view");
+
+        CameraFrame frame = {};
+        XMStoreFloat3(&frame.position, m_camPosition);
+        frame.yaw = camYaw;
+        frame.pitch = camPitch;
+        XMStoreFloat3(&frame.lightDirection, m_lightDirection);
+        sceneView = SceneView::Create(frame, input.aspectRatio, m_sceneBounds);
+
+        m_viewMatrix = XMLoadFloat4x4(&sceneView.view);
+        m_projectionMatrix = XMLoadFloat4x4(&sceneView.projection);
+        m_lightView = sceneView.lightView;
+        m_lightProj = sceneView.lightProjection;
+        m_lightPosition = sceneView.lightPosition;
+        XMStoreFloat4x4(&m_shadowTransform, sceneView.GetShadowTransform());
+    }
 
     // Do frustum culling.
     {
-        // Update projection matrix.
-        m_projectionMatrix = XMMatrixPerspectiveFovLH(
-            XM_PIDIV4, 
-            m_aspectRatio, 
-            0.01f, 
-            XMVector3Length(m_camPosition).m128_f32[0]);
+        PROFILE_SCOPE("Culling");
 
-        // Update frustum.
-        BoundingFrustum bf;
-        auto det = XMMatrixDeterminant(m_viewMatrix);
-        BoundingFrustum(m_projectionMatrix).Transform(bf, XMMatrixInverse(&det, m_viewMatrix));
+        SceneCullOptions options = {};
+        options.simd = input.simdCulling;
+        options.horizonCulling = input.horizonCulling;
+        options.temporalCulling = input.temporalCulling;
+        options.shadow = input.renderShadow;
+        options.threadCount = static_cast<uint32_t>(input.cullThreadCount);
+
+        if (m_measureCullingScaling)
+        {
+            m_sceneCuller->MeasureScaling(sceneView, options, c_cullingScalingIterationCount, m_cullingScaling);
+            m_measureCullingScaling = false;
+        }
 
         // Update index data each face tree.
-        m_culledQuadCount = 0;
-        for (int i = 0; i < 6; i++)
+        const auto cullingStart = std::chrono::high_resolution_clock::now();
+
+        const SceneCullResult result = m_sceneCuller->Cull(sceneView, options);
+        m_culledQuadCount = result.stats[CULL_VIEW_CAMERA].culledQuadCount;
+        m_horizonCulledQuadCount = result.stats[CULL_VIEW_CAMERA].horizonCulledQuadCount;
+        m_shadowCulledQuadCount = input.renderShadow ? result.stats[CULL_VIEW_LIGHT].culledQuadCount : 0;
+        for (const CullStats& stats : result.stats)
+        {
+            m_cullBatchCount += stats.batchCount;
+            m_planeHintHitCount += stats.planeHintHitCount;
+        }
+        const bool cullingSkipped = result.skipped;
+
+        m_cullingTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - cullingStart).count();
+
+        // Saved time of skipped frame is estimated with last full culling time.
+        m_cullFrameCount++;
+        if (cullingSkipped)
+        {
+            m_cullSkippedFrameCount++;
+            m_cullingSavedTime += std::max(m_fullCullingTime - m_cullingTime, 0.0f);
+        }
+        else
         {
-	        const uint32_t culledQuadCount = m_faceTrees[i]->UpdateIndexData(bf, m_totalIndexData);
-            m_culledQuadCount += culledQuadCount;
+            m_fullCullingTime = m_cullingTime;
         }
+
+        m_drawCount = m_sceneCuller->GetDrawCount(CULL_VIEW_CAMERA);
+        m_shadowDrawCount = input.renderShadow ? m_sceneCuller->GetDrawCount(CULL_VIEW_LIGHT) : 0;
     }
 
-    // Light rotation update.
-    if (m_lightRotation)
-        m_lightDirection = XMVector3TransformCoord(m_lightDirection, XMMatrixRotationY(elapsedTime / 24.0f));
+    // Tess factors of visible patches, with the same parameters as this frame's CBs.
+    m_tessEstimated = input.tessEstimate;
+    if (input.tessEstimate)
+    {
+        PROFILE_SCOPE("Tess estimate");
+        EstimateTessellation(input);
+    }
+
+    // Pattern instances of visible patches, with the same parameters as this frame's CBs.
+    if (input.patternGeometry)
+    {
+        PROFILE_SCOPE("Pattern instances");
+        BuildPatternInstances(input);
+    }
+
+    if (m_checkTess)
+    {
+        PROFILE_SCOPE("Tess crack check");
+        CheckTessCracks(input);
+        m_checkTess = false;
+    }
+
+    if (m_expandTess)
+    {
+        PROFILE_SCOPE("Tess expand");
+        ExpandTessellation(input);
+        m_expandTess = false;
+    }
+
+    if (m_checkTessMesh)
+    {
+        PROFILE_SCOPE("Tess mesh check");
+        CheckTessellatedMesh(input);
+        m_checkTessMesh = false;
+    }
+
+    if (m_reportSphere)
+    {
+        PROFILE_SCOPE("Sphere generation report");
+        ReportSphereGeneration();
+        m_reportSphere = false;
+    }
+
+    if (m_benchmarkTerrain)
+    {
+        PROFILE_SCOPE("Terrain sampler benchmark");
+        m_terrainBenchmark = m_terrainSampler->RunBenchmark(c_terrainBenchmarkQueryCount, 0);
+        m_benchmarkTerrain = false;
+    }
+
+    if (m_recording)
+        RecordCameraFrame(camYaw, camPitch);
+
+    if (m_replaying)
+    {
+        ReplayFrameStats& stats = m_replayFrameStats;
+        stats = {};
+        stats.updateTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - updateStart).count();
+        stats.cullingTime = m_cullingTime;
+        stats.culledQuadCount = m_culledQuadCount;
+        stats.shadowCulledQuadCount = m_shadowCulledQuadCount;
+        stats.drawCount = m_drawCount;
+        stats.indexCount = m_sceneCuller->GetIndexCount(CULL_VIEW_CAMERA);
+        stats.shadowIndexCount = input.renderShadow ? m_sceneCuller->GetIndexCount(CULL_VIEW_LIGHT) : 0;
+        m_replayFrameUpdated = true;
+    }
+}
+
+void Apollo::HandleRequests(const SimulationInput& input)
+{
+    const SimulationRequests& requests = input.requests;
+
+    if (requests.resetTimer != m_handledRequests.resetTimer)
+        m_timer.ResetElapsedTime();
 
-	// Update Shadow Transform.
+    if (requests.resetCamera != m_handledRequests.resetCamera)
     {
-        XMVECTOR lightDir = m_lightDirection;
-        XMVECTOR lightPos = -2.0f * m_sceneBounds.Radius * lightDir;
-        XMVECTOR targetPos = XMLoadFloat3(&m_sceneBounds.Center);
-        XMVECTOR lightUp = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-        XMMATRIX lightView = XMMatrixLookAtLH(lightPos, targetPos, lightUp);
+        m_camPosition = XMVectorSet(0.0f, 0.0f, -500.0f, 0.0f);
+        m_camLookTarget = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    if (requests.resetStats != m_handledRequests.resetStats)
+    {
+        m_cullFrameCount = 0;
+        m_cullSkippedFrameCount = 0;
+        m_cullBatchCount = 0;
+        m_planeHintHitCount = 0;
+        m_cullingSavedTime = 0.0f;
+    }
 
-        XMStoreFloat3(&m_lightPosition, lightPos);
+    if (requests.measureScaling != m_handledRequests.measureScaling)
+        m_measureCullingScaling = true;
 
-        // Transform bounding sphere to light space.
-        XMFLOAT3 sphereCenterLS;
-        XMStoreFloat3(&sphereCenterLS, XMVector3TransformCoord(targetPos, lightView));
+    if (requests.checkTess != m_handledRequests.checkTess)
+        m_checkTess = true;
 
-        // Ortho frustum in light space encloses scene.
-        float l = sphereCenterLS.x - m_sceneBounds.Radius;
-        float b = sphereCenterLS.y - m_sceneBounds.Radius;
-        float n = sphereCenterLS.z - m_sceneBounds.Radius;
-        float r = sphereCenterLS.x + m_sceneBounds.Radius;
-        float t = sphereCenterLS.y + m_sceneBounds.Radius;
-        float f = sphereCenterLS.z + m_sceneBounds.Radius;
+    if (requests.expandTess != m_handledRequests.expandTess)
+        m_expandTess = true;
 
-        m_lightNearZ = n;
-        m_lightFarZ = f;
+    if (requests.checkTessMesh != m_handledRequests.checkTessMesh)
+        m_checkTessMesh = true;
 
-        XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(l, r, b, t, n, f);
+    if (requests.reportSphere != m_handledRequests.reportSphere)
+        m_reportSphere = true;
 
-        // Transform NDC space [-1,+1]^2 to texture space [0,1]^2
-        XMMATRIX T(
-            0.5f, 0.0f, 0.0f, 0.0f,
-            0.0f, -0.5f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f,
-            0.5f, 0.5f, 0.0f, 1.0f);
+    if (requests.benchmarkTerrain != m_handledRequests.benchmarkTerrain && m_terrainSampler->IsLoaded())
+        m_benchmarkTerrain = true;
 
-        XMMATRIX S = lightView * lightProj * T;
-        XMStoreFloat4x4(&m_lightView, lightView);
-        XMStoreFloat4x4(&m_lightProj, lightProj);
-        XMStoreFloat4x4(&m_shadowTransform, S);
+    // Recorded path is saved on stop.
+    if (requests.record != m_handledRequests.record && !m_replaying)
+    {
+        if (m_recording)
+            m_cameraPath.Save(c_cameraPathFileName);
+        else
+            m_cameraPath.Clear();
+        m_recording = !m_recording;
     }
+
+    if (requests.replay != m_handledRequests.replay && !m_replaying)
+        BeginReplay(input.replayFileName, input.exitAfterReplay);
+
+    m_handledRequests = requests;
 }
 
-// Draws the scene.
-void Apollo::Render()
+void Apollo::WriteFramePacket(const SimulationInput& input, FramePacket& packet)
 {
-    // Don't try to render anything before the first Update.
-    if (m_timer.GetFrameCount() == 0)
+    PROFILE_SCOPE("Write frame packet");
+
+    packet.frameIndex = m_simulatedFrameCount;
+    packet.inputSampleTime = input.sampleTime;
+    packet.renderShadow = input.renderShadow;
+    packet.patternGeometry = input.patternGeometry;
+
+    // ShadowCB data.
     {
-        return;
+        ShadowCB& cbShadow = packet.shadowCB;
+
+        const XMMATRIX lightWorld = XMLoadFloat4x4(&IDENTITY_MATRIX);
+        const XMMATRIX lightView = XMLoadFloat4x4(&m_lightView);
+        const XMMATRIX lightProj = XMLoadFloat4x4(&m_lightProj);
+
+        cbShadow.lightWorldMatrix = XMMatrixTranspose(lightWorld);
+        cbShadow.lightViewProjMatrix = XMMatrixTranspose(lightView * lightProj);
+        cbShadow.cameraPosition = m_camPosition;
+        cbShadow.parameters = GetTessParameters(CULL_VIEW_LIGHT, input).parameters;
+    }
+
+    // OpaqueCB data.
+    {
+        OpaqueCB& cbOpaque = packet.opaqueCB;
+
+        cbOpaque.worldMatrix = XMMatrixTranspose(m_worldMatrix);
+        cbOpaque.viewProjMatrix = XMMatrixTranspose(m_viewMatrix * m_projectionMatrix);
+        XMStoreFloat4(&cbOpaque.cameraPosition, m_camPosition);
+        XMStoreFloat4(&cbOpaque.lightDirection, m_lightDirection);
+        cbOpaque.lightColor = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+
+        cbOpaque.shadowTransform = XMMatrixTranspose(XMLoadFloat4x4(&m_shadowTransform));
+        cbOpaque.parameters = GetTessParameters(CULL_VIEW_CAMERA, input).parameters;
+    }
+
+    // Visible ranges of each pass, as indirect draw slots.
+    for (uint32_t v = 0; v < CULL_VIEW_COUNT && !input.patternGeometry; v++)
+    {
+        const auto view = static_cast<CullView>(v);
+        if (view == CULL_VIEW_LIGHT && !input.renderShadow)
+            continue;
+
+        std::vector<D3D12_DRAW_INDEXED_ARGUMENTS>& drawSlots = packet.drawSlots[v];
+        std::fill(drawSlots.begin(), drawSlots.end(), D3D12_DRAW_INDEXED_ARGUMENTS{});
+        m_sceneCuller->WriteDrawSlots(view, drawSlots.data());
     }
 
-    // Upload index data to GPU.
+    // Visible leaves, for tiles of streamed textures.
+    BuildTileRequests(input, packet);
+
+    SimulationStats& stats = packet.stats;
+
+    // Or instances of each pass grouped by pattern, with one indirect draw per used pattern.
+    std::fill(std::begin(stats.patternInstanceCount), std::end(stats.patternInstanceCount), 0);
+    std::fill(std::begin(stats.patternDrawCount), std::end(stats.patternDrawCount), 0);
+    for (uint32_t v = 0; v < CULL_VIEW_COUNT && input.patternGeometry; v++)
     {
-        DX::ThrowIfFailed(m_commandAllocators[m_backBufferIndex]->Reset());
-        DX::ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].Get(), nullptr));
+        if (v == CULL_VIEW_LIGHT && !input.renderShadow)
+            continue;
 
-        // Update dynamic index buffer and upload to static index buffer.
+        std::vector<uint32_t>& instances = packet.patternInstances[v];
+        std::vector<D3D12_DRAW_INDEXED_ARGUMENTS>& draws = packet.patternDraws[v];
+        instances.clear();
+        draws.clear();
+        for (uint32_t p = 0; p < PatternCache::c_patternCount; p++)
         {
-            for (FaceTree* faceTree : m_faceTrees)
-                faceTree->Upload(m_commandList.Get());
+            const auto first = static_cast<UINT>(instances.size());
+            for (const auto& taskInstances : m_patternInstances)
+            {
+                const std::vector<uint32_t>& bucket = taskInstances[v].buckets[p];
+                instances.insert(instances.end(), bucket.begin(), bucket.end());
+            }
+
+            const UINT count = static_cast<UINT>(instances.size()) - first;
+            if (count == 0)
+                continue;
+
+            const PatternRange& pattern = m_patternCache->GetPattern(p);
+            draws.push_back({ pattern.indexCount, count, pattern.startIndex, 0, first });
         }
 
-        DX::ThrowIfFailed(m_commandList->Close());
-        m_commandQueue->ExecuteCommandLists(1, CommandListCast(m_commandList.GetAddressOf()));
+        stats.patternInstanceCount[v] = instances.size();
+        stats.patternDrawCount[v] = static_cast<uint32_t>(draws.size());
+    }
+    stats.patternBuildTime = m_patternBuildTime;
+    stats.cameraAltitude = m_cameraAltitude;
+    stats.terrainBenchmark = m_terrainBenchmark;
+    std::copy(std::begin(m_sphereReports), std::end(m_sphereReports), stats.sphereReports);
+    stats.sphereReportCount = m_sphereReportCount;
+
+    stats.culledQuadCount = m_culledQuadCount;
+    stats.horizonCulledQuadCount = m_horizonCulledQuadCount;
+    stats.shadowCulledQuadCount = m_shadowCulledQuadCount;
+    stats.drawCount = m_drawCount;
+    stats.shadowDrawCount = m_shadowDrawCount;
+    stats.cullingTime = m_cullingTime;
+    stats.cullFrameCount = m_cullFrameCount;
+    stats.cullSkippedFrameCount = m_cullSkippedFrameCount;
+    stats.cullBatchCount = m_cullBatchCount;
+    stats.planeHintHitCount = m_planeHintHitCount;
+    stats.cullingSavedTime = m_cullingSavedTime;
+    std::copy(std::begin(m_tessTriangleCount), std::end(m_tessTriangleCount), stats.tessTriangleCount);
+    stats.tessEstimateTime = m_tessEstimateTime;
+    stats.tessEstimated = m_tessEstimated;
+    stats.tessCheck = m_tessCheck;
+    stats.tessCheckCameraCount = m_tessCheckCameraCount;
+    stats.tessCheckTime = m_tessCheckTime;
+    stats.tessMeshTriangleCount = m_tessMeshTriangleCount;
+    stats.tessMeshVertexCount = m_tessMeshVertexCount;
+    stats.tessMeshTime = m_tessMeshTime;
+    stats.tessMeshExported = m_tessMeshExported;
+    stats.tessMeshCheck = m_tessMeshCheck;
+    stats.tessMeshCheckPatchCount = m_tessMeshCheckPatchCount;
+    stats.tessMeshCheckTime = m_tessMeshCheckTime;
+    stats.updateAllocations = m_updateAllocations;
+    stats.frameAllocations = m_frameAllocations;
+
+    stats.cullingScalingCount = static_cast<uint32_t>(std::min<size_t>(m_cullingScaling.size(), c_maxScalingThreadCount));
+    std::copy_n(m_cullingScaling.begin(), stats.cullingScalingCount, stats.cullingScaling);
+
+    stats.cameraPathFrameCount = m_cameraPath.GetFrameCount();
+    stats.replayFrame = m_replayFrame;
+    stats.recording = m_recording;
+    stats.replaying = m_replaying;
+
+    // Exit code is passed once.
+    stats.replayExitCode = m_replayExitCode;
+    m_replayExitCode = -1;
+}
+
+void Apollo::StartReplay(const wchar_t* fileName, bool exitWhenDone)
+{
+    wcsncpy_s(m_requestedReplayFileName, fileName, _TRUNCATE);
+    m_requestedExitAfterReplay = exitWhenDone;
+    m_requests.replay++;
+}
+
+void Apollo::BeginReplay(const wchar_t* fileName, bool exitWhenDone)
+{
+    m_recording = false;
+
+    if (!m_cameraPath.Load(fileName) || m_cameraPath.GetFrameCount() == 0)
+    {
+        if (exitWhenDone)
+            m_replayExitCode = 1;
+        return;
     }
 
-    WaitForGpu();
+    m_replayFileName = fileName;
+    m_replayFrame = 0;
+    m_replayFrameUpdated = false;
+    m_replayReport.Clear();
+    m_replayReport.Reserve(m_cameraPath.GetFrameCount());
+    m_replaying = true;
+    m_exitAfterReplay = exitWhenDone;
+
+    // Start from the same culling state as recording did.
+    for (FaceTree* faceTree : m_faceTrees)
+        faceTree->InvalidateCache();
+}
+
+void Apollo::RecordCameraFrame(float yaw, float pitch)
+{
+    CameraFrame frame = {};
+    XMStoreFloat3(&frame.position, m_camPosition);
+    frame.yaw = yaw;
+    frame.pitch = pitch;
+    XMStoreFloat3(&frame.lightDirection, m_lightDirection);
+
+    m_cameraPath.Add(frame);
+}
+
+void Apollo::ApplyCameraFrame(const CameraFrame& frame)
+{
+    m_camPosition = XMVectorSet(frame.position.x, frame.position.y, frame.position.z, 0.0f);
+    m_lightDirection = XMVectorSet(frame.lightDirection.x, frame.lightDirection.y, frame.lightDirection.z, 1.0f);
+}
+
+void Apollo::EndReplayFrame()
+{
+    // Whole process, so render thread's allocations are counted too.
+    m_replayFrameStats.allocationCount = m_frameAllocations.count;
+    m_replayFrameStats.allocationBytes = m_frameAllocations.bytes;
+    m_replayReport.Add(m_replayFrameStats);
+    m_replayFrameUpdated = false;
+
+    if (++m_replayFrame == m_cameraPath.GetFrameCount())
+        FinishReplay();
+}
+
+void Apollo::FinishReplay()
+{
+    m_replaying = false;
+    m_replayReport.Save((m_replayFileName + L".json").c_str());
+
+    // Runner fails if frame loop still allocates after warm-up. Render thread exits with it.
+    if (m_exitAfterReplay)
+        m_replayExitCode = m_replayReport.GetSteadyStateAllocationCount() > 0 ? 1 : 0;
+}
+
+// Draws the scene of a frame packet.
+void Apollo::Render(const FramePacket& packet, bool newPacket)
+{
+    PROFILE_SCOPE("Render");
+
+    const SimulationStats& stats = packet.stats;
 
     // ----------> Prepare command list.
     DX::ThrowIfFailed(m_commandAllocators[m_backBufferIndex]->Reset());
     DX::ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].Get(), nullptr));
 
+    // Reuse ring space of frames GPU is done with.
+    m_uploadRing->BeginFrame(m_fence->GetCompletedValue());
+    m_drawArgumentUploadSize = 0;
+    if (m_patternRing)
+        m_patternRing->BeginFrame(m_fence->GetCompletedValue());
+    m_patternUploadSize = 0;
+
+    // Tiles or mip rows read since last frame are copied ahead of both passes.
+    UpdateStreamedTextures(packet);
+    UpdateProgressiveTextures();
+
     // Set descriptor heaps.
     m_commandList->SetDescriptorHeaps(1, m_srvDescriptorHeap.GetAddressOf());
 
@@ -285,23 +870,18 @@ void Apollo::Render()
     m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
     m_commandList->SetGraphicsRootDescriptorTable(0, m_srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 
+    // Static VB/IB, read by pattern vertex shaders.
+    m_commandList->SetGraphicsRootShaderResourceView(3, m_staticVB->GetGPUVirtualAddress());
+    m_commandList->SetGraphicsRootShaderResourceView(4, m_staticIB->GetGPUVirtualAddress());
+
     // PASS 1 - Shadow Map
-    if (m_renderShadow)
+    if (packet.renderShadow)
     {
+        PROFILE_SCOPE("Shadow pass");
+
         // Update ShadowCB Data
         {
-            ShadowCB cbShadow;
-
-            const XMMATRIX lightWorld = XMLoadFloat4x4(&IDENTITY_MATRIX);
-            const XMMATRIX lightView = XMLoadFloat4x4(&m_lightView);
-            const XMMATRIX lightProj = XMLoadFloat4x4(&m_lightProj);
-
-            cbShadow.lightWorldMatrix = XMMatrixTranspose(lightWorld);
-            cbShadow.lightViewProjMatrix = XMMatrixTranspose(lightView * lightProj);
-            cbShadow.cameraPosition = m_camPosition;
-            cbShadow.parameters = XMFLOAT4(m_quadWidth, m_unitCount, m_tessMin, m_tessMax - 2);
-
-            memcpy(&m_cbShadowMappedData[m_backBufferIndex], &cbShadow, sizeof(ShadowCB));
+            memcpy(&m_cbShadowMappedData[m_backBufferIndex], &packet.shadowCB, sizeof(ShadowCB));
 
             // Bind the constants to the shader.
             const auto baseGpuAddress = m_cbShadowGpuAddress + m_backBufferIndex * sizeof(ShadowCB);
@@ -313,7 +893,7 @@ void Apollo::Render()
         m_commandList->OMSetRenderTargets(0, nullptr, false, &dsv);
 
         // Set PSO.
-        m_commandList->SetPipelineState(m_shadowPSO.Get());
+        m_commandList->SetPipelineState(packet.patternGeometry ? m_patternShadowPSO.Get() : m_shadowPSO.Get());
 
         // Set the viewport and scissor rect.
         const auto viewport = m_shadowMap->Viewport();
@@ -333,14 +913,19 @@ void Apollo::Render()
             m_commandList->ClearDepthStencilView(
                 m_shadowMap->Dsv(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-            // Set Topology and VB.
-            m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
-            m_commandList->IASetVertexBuffers(0, 1, &m_staticVBV);
-
-            // Set index buffer & draw all face trees.
-            for (const FaceTree* faceTree : m_faceTrees)
+            // Draw ranges visible from light.
+            if (packet.patternGeometry)
+            {
+                DrawPatterns(CULL_VIEW_LIGHT, packet);
+            }
+            else
             {
-                faceTree->Draw(m_commandList.Get());
+                // Set Topology, VB and IB.
+                m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
+                m_commandList->IASetVertexBuffers(0, 1, &m_staticVBV);
+                m_commandList->IASetIndexBuffer(&m_staticIBV);
+
+                DrawFaceTrees(CULL_VIEW_LIGHT, packet);
             }
         }
         // <--- GENERIC_READ
@@ -354,20 +939,11 @@ void Apollo::Render()
 
     // PASS 2 - Opaque.
     {
+        PROFILE_SCOPE("Opaque pass");
+
         // Update OpaqueCB data.
         {
-            OpaqueCB cbOpaque;
-
-            cbOpaque.worldMatrix = XMMatrixTranspose(m_worldMatrix);
-            cbOpaque.viewProjMatrix = XMMatrixTranspose(m_viewMatrix * m_projectionMatrix);
-            XMStoreFloat4(&cbOpaque.cameraPosition, m_camPosition);
-            XMStoreFloat4(&cbOpaque.lightDirection, m_lightDirection);
-            cbOpaque.lightColor = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-
-            cbOpaque.shadowTransform = XMMatrixTranspose(XMLoadFloat4x4(&m_shadowTransform));
-            cbOpaque.parameters = XMFLOAT4(m_quadWidth, m_unitCount, m_tessMin, m_tessMax);
-
-            memcpy(&m_cbOpaqueMappedData[m_backBufferIndex], &cbOpaque, sizeof(OpaqueCB));
+            memcpy(&m_cbOpaqueMappedData[m_backBufferIndex], &packet.opaqueCB, sizeof(OpaqueCB));
 
             // Bind OpaqueCB data to the shader.
             const auto baseGPUAddress = m_cbOpaqueGpuAddress + m_backBufferIndex * sizeof(OpaqueCB);
@@ -384,8 +960,16 @@ void Apollo::Render()
         m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
 
         // Set PSO.
-        m_commandList->SetPipelineState(
-            m_wireframe ? m_wireframePSO.Get() : m_renderShadow ? m_opaquePSO.Get() : m_noShadowPSO.Get());
+        if (packet.patternGeometry)
+        {
+            m_commandList->SetPipelineState(
+                m_wireframe ? m_patternWireframePSO.Get() : packet.renderShadow ? m_patternPSO.Get() : m_patternNoShadowPSO.Get());
+        }
+        else
+        {
+            m_commandList->SetPipelineState(
+                m_wireframe ? m_wireframePSO.Get() : packet.renderShadow ? m_opaquePSO.Get() : m_noShadowPSO.Get());
+        }
 
         // Set the viewport and scissor rect.
         m_commandList->RSSetViewports(1, &m_viewport);
@@ -403,24 +987,31 @@ void Apollo::Render()
             m_commandList->ClearRenderTargetView(rtvHandle, Colors::Black, 0, nullptr);
             m_commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-            // Set Topology and VB.
-            m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
-            m_commandList->IASetVertexBuffers(0, 1, &m_staticVBV);
-
-            // Set index buffer & draw all face trees.
-            for (const FaceTree* faceTree : m_faceTrees)
+            // Draw visible ranges of all face trees.
+            if (packet.patternGeometry)
+            {
+                DrawPatterns(CULL_VIEW_CAMERA, packet);
+            }
+            else
             {
-                faceTree->Draw(m_commandList.Get());
+                // Set Topology, VB and IB.
+                m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
+                m_commandList->IASetVertexBuffers(0, 1, &m_staticVBV);
+                m_commandList->IASetIndexBuffer(&m_staticIBV);
+
+                DrawFaceTrees(CULL_VIEW_CAMERA, packet);
             }
 
             // Draw imgui.
             {
+                PROFILE_SCOPE("ImGui");
+
                 ImGui_ImplDX12_NewFrame();
                 ImGui_ImplWin32_NewFrame();
                 ImGui::NewFrame();
 
                 {
-                    const auto io = ImGui::GetIO();
+                    const auto& io = ImGui::GetIO();
                     ImGui::Begin("apollo");
                     ImGui::SetWindowSize(ImVec2(450, 550), ImGuiCond_Always);
 
@@ -437,16 +1028,132 @@ void Apollo::Render()
 
                     ImGui::BulletText("QuadSphere initial quad count: %d", m_totalIndexCount / 4);
                     ImGui::BulletText("QuadSphere initial triangle count: %d (converted)", m_totalIndexCount * 2 / 4);
+                    ImGui::BulletText("QuadSphere vertex count: %d (%.2f MB)", m_staticVertexCount, m_staticVBSize / (1024.0f * 1024.0f));
+                    ImGui::BulletText("QuadSphere load time: %.2f ms (%s)", m_sphereLoadTime, m_meshCacheHit ? "cached" : "generated");
+                    if (ImGui::Button("Report Sphere Generation"))
+                        m_requests.reportSphere++;
+                    for (uint32_t i = 0; i < stats.sphereReportCount; i++)
+                    {
+                        const SphereReport& report = stats.sphereReports[i];
+                        ImGui::BulletText("Subdivide %u: welded %u (%.2f MB, %.1f ms), unwelded %u (%.2f MB, %.1f ms)",
+                            report.subdivideCount,
+                            report.vertexCount[0], sizeof(VertexTess) * report.vertexCount[0] / (1024.0f * 1024.0f), report.generationTime[0],
+                            report.vertexCount[1], sizeof(VertexTess) * report.vertexCount[1] / (1024.0f * 1024.0f), report.generationTime[1]);
+                    }
 
                     ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
-                    ImGui::BulletText("Render quad count: %d", (m_totalIndexCount - m_culledQuadCount) / 4);
-                    ImGui::BulletText("Render triangle count: %d (converted)", (m_totalIndexCount - m_culledQuadCount) * 2 / 4);
+                    ImGui::BulletText("Render quad count: %d", (m_totalIndexCount - stats.culledQuadCount) / 4);
+                    ImGui::BulletText("Render triangle count: %d (converted)", (m_totalIndexCount - stats.culledQuadCount) * 2 / 4);
+
+                    // Triangles after tessellation, from CPU port of hull shader.
+                    ImGui::Checkbox("Estimate Tessellation", &m_tessEstimate);
+                    if (stats.tessEstimated)
+                    {
+                        ImGui::BulletText("Tessellated triangles: camera %llu, shadow %llu (%.1f us)",
+                            static_cast<unsigned long long>(stats.tessTriangleCount[CULL_VIEW_CAMERA]),
+                            static_cast<unsigned long long>(stats.tessTriangleCount[CULL_VIEW_LIGHT]), stats.tessEstimateTime);
+                    }
+                    if (ImGui::Button("Check Tess Cracks"))
+                        m_requests.checkTess++;
+                    if (stats.tessCheckCameraCount > 0)
+                    {
+                        ImGui::BulletText("Shared edges: %u, mismatched %u, unmatched %u (%u cameras, %.1f ms)",
+                            stats.tessCheck.sharedEdgeCount, stats.tessCheck.mismatchCount, stats.tessCheck.unmatchedCount,
+                            stats.tessCheckCameraCount, stats.tessCheckTime);
+                    }
+
+                    // Mesh of CPU tessellator, visible patches are written to OBJ.
+                    if (ImGui::Button("Expand Tessellation"))
+                        m_requests.expandTess++;
+                    ImGui::SameLine();
+                    if (ImGui::Button("Check Tessellated Mesh"))
+                        m_requests.checkTessMesh++;
+                    if (stats.tessMeshTriangleCount > 0)
+                    {
+                        ImGui::BulletText("Expanded: %llu triangles, %llu vertices (%.1f ms, %s)",
+                            static_cast<unsigned long long>(stats.tessMeshTriangleCount),
+                            static_cast<unsigned long long>(stats.tessMeshVertexCount), stats.tessMeshTime,
+                            stats.tessMeshExported ? "exported" : "export failed");
+                    }
+                    if (stats.tessMeshCheckPatchCount > 0)
+                    {
+                        ImGui::BulletText("Whole sphere: %u edges, open %u, non-manifold %u (%.1f ms)",
+                            stats.tessMeshCheck.edgeCount, stats.tessMeshCheck.openEdgeCount,
+                            stats.tessMeshCheck.nonManifoldEdgeCount, stats.tessMeshCheckTime);
+                    }
+
+                    // Pre-tessellated patterns instead of HS/DS, same triangles as CPU tessellator.
+                    if (m_patternSupported)
+                        ImGui::Checkbox("Pre-tessellated Patterns", &m_patternGeometry);
+                    else
+                        ImGui::BulletText("Pre-tessellated patterns: too many patches");
+                    if (packet.patternGeometry)
+                    {
+                        ImGui::BulletText("Pattern instances: camera %llu (%u draws), shadow %llu (%u draws), %.1f us",
+                            static_cast<unsigned long long>(stats.patternInstanceCount[CULL_VIEW_CAMERA]), stats.patternDrawCount[CULL_VIEW_CAMERA],
+                            static_cast<unsigned long long>(stats.patternInstanceCount[CULL_VIEW_LIGHT]), stats.patternDrawCount[CULL_VIEW_LIGHT],
+                            stats.patternBuildTime);
+                        ImGui::BulletText("Pattern upload: %.1f KB", m_patternUploadSize / 1024.0f);
+                    }
+                    {
+                        const PatternCacheStats& cacheStats = m_patternCache->GetStats();
+                        ImGui::BulletText("Pattern cache: %u patterns, %u points, %u triangles (%.1f KB)",
+                            cacheStats.patternCount - cacheStats.emptyPatternCount, cacheStats.pointCount, cacheStats.triangleCount,
+                            (cacheStats.pointBytes + cacheStats.indexBytes) / 1024.0f);
+                    }
 
                     ImGui::Dummy(ImVec2(0.0f, 10.0f));
 
                     ImGui::BulletText("Culled quad count: %d (%.3f %%)",
-                        m_culledQuadCount, static_cast<float>(m_culledQuadCount) * 100 / (m_totalIndexCount / 4));
+                        stats.culledQuadCount, static_cast<float>(stats.culledQuadCount) * 100 / (m_totalIndexCount / 4));
+                    ImGui::BulletText("Horizon culled quad count: %d (%.3f %%)",
+                        stats.horizonCulledQuadCount, static_cast<float>(stats.horizonCulledQuadCount) * 100 / (m_totalIndexCount / 4));
+                    ImGui::BulletText("Culling time: %.1f us", stats.cullingTime);
+                    ImGui::BulletText("Draw call count: %d", stats.drawCount);
+                    if (packet.renderShadow)
+                    {
+                        // Quads submitted by each pass, to compare light culling against camera culling.
+                        ImGui::BulletText("Submitted quads: camera %d, shadow %d",
+                            m_totalIndexCount / 4 - stats.culledQuadCount, m_totalIndexCount / 4 - stats.shadowCulledQuadCount);
+                        ImGui::BulletText("Shadow draw call count: %d", stats.shadowDrawCount);
+                    }
+                    ImGui::Checkbox("SIMD Culling", &m_simdCulling);
+                    ImGui::Checkbox("Horizon Culling", &m_horizonCulling);
+                    ImGui::Checkbox("Temporal Culling", &m_temporalCulling);
+
+                    ImGui::BulletText("Skipped culling: %u / %u frames (%.1f %%), %.2f ms saved",
+                        stats.cullSkippedFrameCount, stats.cullFrameCount,
+                        stats.cullFrameCount > 0 ? static_cast<float>(stats.cullSkippedFrameCount) * 100 / stats.cullFrameCount : 0.0f,
+                        stats.cullingSavedTime / 1000.0f);
+                    ImGui::BulletText("Heap allocations: update %llu (%llu bytes), render %llu (%llu bytes)",
+                        static_cast<unsigned long long>(stats.updateAllocations.count), static_cast<unsigned long long>(stats.updateAllocations.bytes),
+                        static_cast<unsigned long long>(m_renderAllocations.count), static_cast<unsigned long long>(m_renderAllocations.bytes));
+                    ImGui::BulletText("Heap allocations: whole frame %llu (%llu bytes)",
+                        static_cast<unsigned long long>(stats.frameAllocations.count), static_cast<unsigned long long>(stats.frameAllocations.bytes));
+                    ImGui::BulletText("Draw argument upload: %llu bytes (%.1f KB since reset)",
+                        static_cast<unsigned long long>(m_drawArgumentUploadSize), m_drawArgumentUploadTotal / 1024.0f);
+                    ImGui::BulletText("Plane cache hit: %.1f %% of batches",
+                        stats.cullBatchCount > 0 ? static_cast<float>(stats.planeHintHitCount) * 100 / stats.cullBatchCount : 0.0f);
+                    ImGui::BulletText("Input to submit latency: %.2f ms (%.2f ms average)",
+                        m_inputLatency, m_inputLatencyCount > 0 ? m_inputLatencyTotal / m_inputLatencyCount : 0.0);
+                    if (ImGui::Button("Reset Culling Stats"))
+                    {
+                        m_requests.resetStats++;
+                        m_drawArgumentUploadTotal = 0;
+                        m_inputLatencyTotal = 0.0;
+                        m_inputLatencyCount = 0;
+                    }
+
+                    ImGui::SliderInt("Culling Threads", &m_cullThreadCount, 1, static_cast<int>(m_workerPool->GetThreadCount()));
+
+                    if (ImGui::Button("Measure Culling Scaling"))
+                        m_requests.measureScaling++;
+                    for (uint32_t i = 0; i < stats.cullingScalingCount; i++)
+                    {
+                        ImGui::BulletText("%u threads: %.1f us (x%.2f)",
+                            i + 1, stats.cullingScaling[i], stats.cullingScaling[0] / stats.cullingScaling[i]);
+                    }
 
                     ImGui::Dummy(ImVec2(0.0f, 20.0f));
 
@@ -454,6 +1161,62 @@ void Apollo::Render()
                     ImGui::SliderFloat("Rotate speed", &m_camRotateSpeed, 0.0f, 1.0f);
                     ImGui::Text("Move speed: %.3f (Scroll to Adjust)", m_camMoveSpeed);
 
+                    // Heights of displacement map on CPU, same as DS samples.
+                    if (m_terrainSampler->IsLoaded())
+                    {
+                        ImGui::Checkbox("Clamp Camera to Ground", &m_groundClamp);
+                        ImGui::BulletText("Camera altitude: %.3f above terrain", stats.cameraAltitude);
+                        ImGui::BulletText("Terrain sampler: %u levels, %.1f MB (%.1f ms to load)",
+                            m_terrainSampler->GetLevelCount(), m_terrainSampler->GetMemorySize() / (1024.0f * 1024.0f), m_terrainLoadTime);
+                        if (ImGui::Button("Benchmark Terrain Sampler"))
+                            m_requests.benchmarkTerrain++;
+                        const TerrainSamplerBenchmark& benchmark = stats.terrainBenchmark;
+                        if (benchmark.queryCount > 0)
+                        {
+                            ImGui::BulletText("%u queries: scalar %.1f M/s (%.1f ms), batch %.1f M/s (%.1f ms), max difference %.2g",
+                                benchmark.queryCount, benchmark.scalarRate, benchmark.scalarTime, benchmark.batchRate, benchmark.batchTime,
+                                benchmark.maxError);
+                        }
+                    }
+                    else
+                    {
+                        ImGui::BulletText("Terrain sampler: displacement map can't be decoded");
+                    }
+
+                    // Tiles of color and displacement maps resident in cache, against tiles visible leaves want.
+                    if (m_tileCache)
+                    {
+                        const TileCacheStats tileStats = m_tileCache->GetStats();
+                        ImGui::BulletText("Tile cache: %u / %u slots, %u wanted, %u loading, %u uploads",
+                            tileStats.residentTileCount, tileStats.slotCount, tileStats.wantedTileCount,
+                            tileStats.loadingTileCount, tileStats.uploadCount);
+                        ImGui::BulletText("Tiles: %llu loaded (%.2f ms per read), %llu evicted, %llu failed, %llu dropped",
+                            static_cast<unsigned long long>(tileStats.loadedTileCount), tileStats.readTime,
+                            static_cast<unsigned long long>(tileStats.evictedTileCount),
+                            static_cast<unsigned long long>(tileStats.failedTileCount),
+                            static_cast<unsigned long long>(tileStats.overflowCount));
+                    }
+                    else
+                    {
+                        ImGui::BulletText("Tile streaming: off, %s", m_tileStreamingState);
+                    }
+
+                    // Whole maps loading finer mips in background, resident mip of each of them.
+                    if (m_mipLoader)
+                    {
+                        const MipLoaderStats mipStats = m_mipLoader->GetStats();
+                        ImGui::BulletText("Mip loading: %.1f / %.1f MB, resident mips %u %u %u %u, %u chunks loading, %u uploads",
+                            mipStats.loadedSize / (1024.0f * 1024.0f), mipStats.totalSize / (1024.0f * 1024.0f),
+                            m_mipLoader->GetResidentMip(0), m_mipLoader->GetResidentMip(1),
+                            m_mipLoader->GetResidentMip(2), m_mipLoader->GetResidentMip(3),
+                            mipStats.loadingChunkCount, mipStats.uploadCount);
+                        ImGui::BulletText("Mip reads: %.2f ms per chunk, %u maps failed", mipStats.readTime, mipStats.failedTextureCount);
+                    }
+                    if (m_timeToFullDetail > 0.0f)
+                        ImGui::BulletText("Startup: first frame %.1f ms, full detail %.1f ms", m_timeToFirstFrame, m_timeToFullDetail);
+                    else
+                        ImGui::BulletText("Startup: first frame %.1f ms, full detail %s", m_timeToFirstFrame, m_tileCache ? "follows view" : "pending");
+
                     ImGui::Dummy(ImVec2(0.0f, 20.0f));
 
                     ImGui::Checkbox("Rotate Light", &m_lightRotation);
@@ -466,12 +1229,36 @@ void Apollo::Render()
                     {
                         m_camYaw = 0.0f;
                         m_camPitch = 0.0f;
-                        m_camPosition = XMVectorSet(0.0f, 0.0f, -500.0f, 0.0f);
-                        m_camLookTarget = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
+                        m_requests.resetCamera++;
+                    }
+
+                    // Recorded path is saved on stop, replay stats are written next to it.
+                    if (stats.replaying)
+                    {
+                        ImGui::Text("Replaying camera path: %u / %u frames", stats.replayFrame, stats.cameraPathFrameCount);
                     }
+                    else if (ImGui::Button(stats.recording ? "Stop Recording" : "Record Camera Path"))
+                    {
+                        m_requests.record++;
+                    }
+                    if (!stats.replaying && !stats.recording)
+                    {
+                        ImGui::SameLine();
+                        if (ImGui::Button("Replay Camera Path"))
+                            StartReplay(c_cameraPathFileName, false);
+                    }
+                    if (stats.recording)
+                        ImGui::Text("Recording: %u frames", stats.cameraPathFrameCount);
 
                     ImGui::Dummy(ImVec2(0.0f, 20.0f));
 
+#if PROFILER_ENABLED
+                    if (ImGui::Button("Save Profiler Trace"))
+                        Profiler::WriteChromeTrace(L"apollo_trace.json");
+
+                    ImGui::Dummy(ImVec2(0.0f, 20.0f));
+#endif
+
                     ImGui::Text("Press X to Switch mouse mode");
                     ImGui::Text("(GUI Mode <-> Flight Mode)");
 
@@ -495,18 +1282,43 @@ void Apollo::Render()
     DX::ThrowIfFailed(m_commandList->Close());
     m_commandQueue->ExecuteCommandLists(1, CommandListCast(m_commandList.GetAddressOf()));
 
+    // Latency of a packet is counted once, on its first submit.
+    if (newPacket)
+    {
+        m_inputLatency = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - packet.inputSampleTime).count();
+        m_inputLatencyTotal += m_inputLatency;
+        m_inputLatencyCount++;
+    }
+
+    // Ring data of this frame is in use until MoveToNextFrame's signal is passed.
+    m_uploadRing->EndFrame(m_fenceValues[m_backBufferIndex]);
+    if (m_patternRing)
+        m_patternRing->EndFrame(m_fenceValues[m_backBufferIndex]);
+
     // Present back buffer.
-    const HRESULT hr = m_swapChain->Present(0, m_fullScreenMode ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+    bool presented;
+    {
+        PROFILE_SCOPE("Present");
+        presented = m_backend->Present(!m_fullScreenMode);
+    }
 
     // If the device was reset we must completely reinitialize the renderer.
-    if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
+    if (!presented)
     {
         OnDeviceLost();
+        return;
     }
-    else
-    {
-        DX::ThrowIfFailed(hr);
-        MoveToNextFrame();
+
+    MoveToNextFrame();
+
+    // Streamed maps sharpen where camera looks, so only whole ones reach full detail.
+    if (m_timeToFirstFrame == 0.0f || m_timeToFullDetail == 0.0f)
+    {
+        const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+        if (m_timeToFirstFrame == 0.0f)
+            m_timeToFirstFrame = elapsed;
+        if (m_timeToFullDetail == 0.0f && !m_tileCache && (!m_mipLoader || m_mipLoader->IsComplete()))
+            m_timeToFullDetail = elapsed;
     }
 }
 
@@ -528,7 +1340,7 @@ void Apollo::OnSuspending()
 
 void Apollo::OnResuming()
 {
-    m_timer.ResetElapsedTime();
+    m_requests.resetTimer++;
 
     // TODO: Game is being power-resumed (or returning from minimize).
 }
@@ -702,7 +1514,7 @@ void Apollo::CreateDeviceDependentResources()
 
         // Create SRV descriptor heap.
         D3D12_DESCRIPTOR_HEAP_DESC srvDescriptorHeapDesc = {};
-        srvDescriptorHeapDesc.NumDescriptors = 6;   // color map (2), displacement map (2), shadow map (1), imgui (1).
+        srvDescriptorHeapDesc.NumDescriptors = 10;  // color map (2), displacement map (2), shadow map (1), imgui (1), min mip map (4).
         srvDescriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
         srvDescriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -717,13 +1529,16 @@ void Apollo::CreateDeviceDependentResources()
     // ================================================================================================================
     {
         // Define root parameters.
-        CD3DX12_DESCRIPTOR_RANGE srvTable;
-        srvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 6, 0);
+        CD3DX12_DESCRIPTOR_RANGE srvTable[2];
+        srvTable[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 6, 0);
+        srvTable[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, 8, 0, 6);   // min mip maps after imgui
 
-        CD3DX12_ROOT_PARAMETER rootParameters[3] = {};
-        rootParameters[0].InitAsDescriptorTable(1, &srvTable);  // register (t0)
+        CD3DX12_ROOT_PARAMETER rootParameters[5] = {};
+        rootParameters[0].InitAsDescriptorTable(2, srvTable);   // register (t0), (t8)
         rootParameters[1].InitAsConstantBufferView(0);          // register (c0)
         rootParameters[2].InitAsConstantBufferView(1);          // register (c1)
+        rootParameters[3].InitAsShaderResourceView(6, 0, D3D12_SHADER_VISIBILITY_VERTEX);  // register (t6), static VB
+        rootParameters[4].InitAsShaderResourceView(7, 0, D3D12_SHADER_VISIBILITY_VERTEX);  // register (t7), static IB
 
         // Define samplers.
         const CD3DX12_STATIC_SAMPLER_DESC anisotropicClamp(
@@ -879,6 +1694,51 @@ void Apollo::CreateDeviceDependentResources()
             m_d3dDevice->CreateGraphicsPipelineState(
                 &shadowPSODesc,
                 IID_PPV_ARGS(m_shadowPSO.ReleaseAndGetAddressOf())));
+
+        // Pattern PSOs draw triangle lists of pattern cache, one instance word per patch piece.
+        static constexpr D3D12_INPUT_ELEMENT_DESC c_patternElementDesc[] =
+        {
+            { "DOMAIN",     0,  DXGI_FORMAT_R32G32_FLOAT,       0,  0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
+            { "PATCH",      0,  DXGI_FORMAT_R32_UINT,           1,  0,  D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        };
+
+        auto patternVSBlob = DX::ReadData(L"PatternVS.cso");
+        auto shadowPatternVSBlob = DX::ReadData(L"ShadowPatternVS.cso");
+
+        const auto toPatternDesc = [&](const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, const std::vector<uint8_t>& vs)
+        {
+            auto patternDesc = D3D12_GRAPHICS_PIPELINE_STATE_DESC(desc);
+            patternDesc.InputLayout = { c_patternElementDesc, _countof(c_patternElementDesc) };
+            patternDesc.VS = { vs.data(), vs.size() };
+            patternDesc.HS = {};
+            patternDesc.DS = {};
+            patternDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+            return patternDesc;
+        };
+
+        const auto patternPSODesc = toPatternDesc(psoDesc, patternVSBlob);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateGraphicsPipelineState(
+                &patternPSODesc,
+                IID_PPV_ARGS(m_patternPSO.ReleaseAndGetAddressOf())));
+
+        const auto patternNoShadowPSODesc = toPatternDesc(noShadowPSODesc, patternVSBlob);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateGraphicsPipelineState(
+                &patternNoShadowPSODesc,
+                IID_PPV_ARGS(m_patternNoShadowPSO.ReleaseAndGetAddressOf())));
+
+        const auto patternWireframePSODesc = toPatternDesc(wireframePSODesc, patternVSBlob);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateGraphicsPipelineState(
+                &patternWireframePSODesc,
+                IID_PPV_ARGS(m_patternWireframePSO.ReleaseAndGetAddressOf())));
+
+        const auto patternShadowPSODesc = toPatternDesc(shadowPSODesc, shadowPatternVSBlob);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateGraphicsPipelineState(
+                &patternShadowPSODesc,
+                IID_PPV_ARGS(m_patternShadowPSO.ReleaseAndGetAddressOf())));
     }
 
     // ================================================================================================================
@@ -938,6 +1798,7 @@ void Apollo::CreateDeviceDependentResources()
     // ================================================================================================================
     {
         IMGUI_CHECKVERSION();
+        ImGui::SetAllocatorFunctions(AllocationCounter::ImGuiAllocate, AllocationCounter::ImGuiFree);
         ImGui::CreateContext();
         auto io = ImGui::GetIO();
         io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
@@ -1128,57 +1989,101 @@ void Apollo::CreateCommandListDependentResources()
     // Because they must be alive until GPU work (upload) is done.
     ComPtr<ID3D12Resource> textureUploadHeaps[4];
 	ComPtr<ID3D12Resource> vertexUploadHeap;
+	ComPtr<ID3D12Resource> indexUploadHeap;
+    ComPtr<ID3D12Resource> patternVertexUploadHeap;
+    ComPtr<ID3D12Resource> patternIndexUploadHeap;
 
     // ================================================================================================================
     // #01. Create texture resources & views.
     // ================================================================================================================
+    // Color and displacement maps are streamed by tiles if tiled resources allow it, or loaded whole.
+    // Whole maps start from coarse mips and load finer ones in background, or all at once if their format doesn't allow it.
     {
-        CreateTextureResource(
-	        L"Textures\\colormap_l.dds", 
-	        m_colorLTexResource.ReleaseAndGetAddressOf(), 
-	        textureUploadHeaps[0].ReleaseAndGetAddressOf(), 
-	        0);
-        CreateTextureResource(
-	        L"Textures\\colormap_r.dds", 
-	        m_colorRTexResource.ReleaseAndGetAddressOf(), 
-	        textureUploadHeaps[1].ReleaseAndGetAddressOf(), 
-	        1);
-        CreateTextureResource(
-            L"Textures\\displacement_l.dds", 
-            m_heightLTexResource.ReleaseAndGetAddressOf(), 
-            textureUploadHeaps[2].ReleaseAndGetAddressOf(), 
-            2);
-        CreateTextureResource(
-            L"Textures\\displacement_r.dds", 
-            m_heightRTexResource.ReleaseAndGetAddressOf(), 
-            textureUploadHeaps[3].ReleaseAndGetAddressOf(), 
-            3);
+        PROFILE_SCOPE("Load textures");
+
+        if (!CreateStreamedTextures(textureUploadHeaps) && !CreateProgressiveTextures(textureUploadHeaps))
+        {
+            CreateTextureResource(
+                L"Textures\\colormap_l.dds",
+                m_colorLTexResource.ReleaseAndGetAddressOf(),
+                textureUploadHeaps[0].ReleaseAndGetAddressOf(),
+                0);
+            CreateTextureResource(
+                L"Textures\\colormap_r.dds",
+                m_colorRTexResource.ReleaseAndGetAddressOf(),
+                textureUploadHeaps[1].ReleaseAndGetAddressOf(),
+                1);
+            CreateTextureResource(
+                L"Textures\\displacement_l.dds",
+                m_heightLTexResource.ReleaseAndGetAddressOf(),
+                textureUploadHeaps[2].ReleaseAndGetAddressOf(),
+                2);
+            CreateTextureResource(
+                L"Textures\\displacement_r.dds",
+                m_heightRTexResource.ReleaseAndGetAddressOf(),
+                textureUploadHeaps[3].ReleaseAndGetAddressOf(),
+                3);
+        }
+
+        CreateMinMipMaps();
     }
 
     // ================================================================================================================
     // #02. Compute sphere vertices and indices.
     // ================================================================================================================
-    // Generate quad sphere.
-	const auto geoInfo = QuadSphereGenerator::CreateQuadSphere(300.0f, 300.0f, 300.0f, m_subDivideCount);
+    // Load quad sphere from mesh cache. It stays mapped across device lost.
+    if (!m_meshCache)
+    {
+        PROFILE_SCOPE("Load quad sphere");
 
-    m_faceTrees = geoInfo->faceTrees;
-    for (FaceTree* faceTree : m_faceTrees)
+        const auto loadStart = std::chrono::high_resolution_clock::now();
+
+        wchar_t cacheFileName[64] = {};
+        swprintf_s(cacheFileName, L"Cache\\quadsphere_%u.bin", m_subDivideCount);
+
+        // Generate quad sphere and store it, if cache is missing or stale.
+        CreateDirectoryW(L"Cache", nullptr);
+        m_meshCache = std::make_unique<MeshCache>();
+        m_meshCacheHit = m_meshCache->LoadOrGenerate(
+            cacheFileName, 300.0f, m_subDivideCount, L"Textures\\displacement_l.dds", L"Textures\\displacement_r.dds");
+
+        m_sphereLoadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+    }
+
+    // Heights of displacement map on CPU. It also stays across device lost.
+    if (!m_terrainSampler)
     {
-        // Index buffer & view is initialized inside Init function.
-        faceTree->Init(m_d3dDevice.Get());
+        PROFILE_SCOPE("Load terrain sampler");
+
+        const auto loadStart = std::chrono::high_resolution_clock::now();
+
+        m_terrainSampler = std::make_unique<TerrainSampler>();
+        m_terrainSampler->Load(L"Textures\\displacement_l.dds", L"Textures\\displacement_r.dds");
+
+        m_terrainLoadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
     }
 
-    // Copy vertex data.
-    const auto staticVertexData = std::vector<VertexTess>(geoInfo->vertices);
-    m_totalIndexData = std::vector<uint32_t>(geoInfo->indices);
-    m_totalIndexCount = m_totalIndexData.size();
+    m_faceTrees = m_meshCache->CreateFaceTrees();
 
-    delete geoInfo;
+    // Index data is used in place.
+    m_totalIndexData = m_meshCache->GetIndices();
+    m_totalIndexCount = m_meshCache->GetIndexCount();
 
-    m_staticVertexCount = staticVertexData.size();
+    m_staticVertexCount = m_meshCache->GetVertexCount();
     m_staticVBSize = sizeof(VertexTess) * m_staticVertexCount;
     m_totalIBSize = sizeof(uint32_t) * m_totalIndexCount;
 
+    // Leaf bounds for tile requests. Mesh stays across device lost, so they do too.
+    if (m_tileCache && m_leafCones.empty())
+        BuildLeafCones();
+
+#ifdef _DEBUG
+    char report[128] = {};
+    sprintf_s(report, "QuadSphere (subdivide %u): %u vertices, %zu bytes VB, %.2f ms (%s)\n",
+        m_subDivideCount, m_staticVertexCount, m_staticVBSize, m_sphereLoadTime, m_meshCacheHit ? "cached" : "generated");
+    OutputDebugStringA(report);
+#endif
+
     // ================================================================================================================
     // #03. Create vertex buffer & view.
     // ================================================================================================================
@@ -1214,20 +2119,171 @@ void Apollo::CreateCommandListDependentResources()
 
         // Define sub-resource data.
         D3D12_SUBRESOURCE_DATA subResourceData = {};
-        subResourceData.pData = staticVertexData.data();
+        subResourceData.pData = m_meshCache->GetVertices();
         subResourceData.RowPitch = m_staticVBSize;
     	subResourceData.SlicePitch = m_staticVBSize;
 
         // Copy the vertex data to the default heap.
         UpdateSubresources(m_commandList.Get(), m_staticVB.Get(), vertexUploadHeap.Get(), 0, 0, 1, &subResourceData);
 
-        // Translate vertex buffer state.
+        // Translate vertex buffer state. Pattern vertex shaders read it as SRV.
         const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
             m_staticVB.Get(),
-            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
         m_commandList->ResourceBarrier(1, &barrier);
     }
 
+    // ================================================================================================================
+    // #04. Create index buffer & view.
+    // ================================================================================================================
+    // Whole index buffer is uploaded once, and culling only selects ranges of it.
+    {
+        // Create default heap.
+        CD3DX12_HEAP_PROPERTIES defaultHeapProp(D3D12_HEAP_TYPE_DEFAULT);
+        auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(m_totalIBSize);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateCommittedResource(
+                &defaultHeapProp,
+                D3D12_HEAP_FLAG_NONE,
+                &resDesc,
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(m_staticIB.ReleaseAndGetAddressOf())));
+
+        // Initialize index buffer view.
+        m_staticIBV.BufferLocation = m_staticIB->GetGPUVirtualAddress();
+        m_staticIBV.Format = DXGI_FORMAT_R32_UINT;
+        m_staticIBV.SizeInBytes = static_cast<UINT>(m_totalIBSize);
+
+        // Create upload heap.
+        CD3DX12_HEAP_PROPERTIES uploadHeapProp(D3D12_HEAP_TYPE_UPLOAD);
+        auto uploadHeapDesc = CD3DX12_RESOURCE_DESC::Buffer(m_totalIBSize);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateCommittedResource(
+                &uploadHeapProp,
+                D3D12_HEAP_FLAG_NONE,
+                &uploadHeapDesc,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nullptr,
+                IID_PPV_ARGS(indexUploadHeap.ReleaseAndGetAddressOf())));
+
+        // Define sub-resource data.
+        D3D12_SUBRESOURCE_DATA subResourceData = {};
+        subResourceData.pData = m_totalIndexData;
+        subResourceData.RowPitch = m_totalIBSize;
+        subResourceData.SlicePitch = m_totalIBSize;
+
+        // Copy the index data to the default heap.
+        UpdateSubresources(m_commandList.Get(), m_staticIB.Get(), indexUploadHeap.Get(), 0, 0, 1, &subResourceData);
+
+        // Translate index buffer state. Pattern vertex shaders read it as SRV.
+        const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+            m_staticIB.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            D3D12_RESOURCE_STATE_INDEX_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        m_commandList->ResourceBarrier(1, &barrier);
+    }
+
+    // ================================================================================================================
+    // #05. Create pattern cache buffers & views.
+    // ================================================================================================================
+    // Patterns are built on CPU once, and kept across device lost like mesh cache.
+    {
+        if (!m_patternCache)
+        {
+            PROFILE_SCOPE("Build pattern cache");
+            m_patternCache = std::make_unique<PatternCache>();
+        }
+
+        // Instance word holds patch index in PATTERN_PATCH_BITS.
+        m_patternSupported = m_totalIndexCount / 4 <= PATTERN_MAX_PATCH_COUNT;
+
+        const std::vector<XMFLOAT2>& points = m_patternCache->GetPoints();
+        const std::vector<uint16_t>& indices = m_patternCache->GetIndices();
+        const auto vbSize = static_cast<UINT>(sizeof(XMFLOAT2) * points.size());
+        const auto ibSize = static_cast<UINT>(sizeof(uint16_t) * indices.size());
+
+        const auto createBuffer = [&](UINT size, const void* data, D3D12_RESOURCE_STATES state,
+            ID3D12Resource** buffer, ID3D12Resource** uploadHeap)
+        {
+            CD3DX12_HEAP_PROPERTIES defaultHeapProp(D3D12_HEAP_TYPE_DEFAULT);
+            auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+            DX::ThrowIfFailed(
+                m_d3dDevice->CreateCommittedResource(
+                    &defaultHeapProp,
+                    D3D12_HEAP_FLAG_NONE,
+                    &resDesc,
+                    D3D12_RESOURCE_STATE_COPY_DEST,
+                    nullptr,
+                    IID_PPV_ARGS(buffer)));
+
+            CD3DX12_HEAP_PROPERTIES uploadHeapProp(D3D12_HEAP_TYPE_UPLOAD);
+            DX::ThrowIfFailed(
+                m_d3dDevice->CreateCommittedResource(
+                    &uploadHeapProp,
+                    D3D12_HEAP_FLAG_NONE,
+                    &resDesc,
+                    D3D12_RESOURCE_STATE_GENERIC_READ,
+                    nullptr,
+                    IID_PPV_ARGS(uploadHeap)));
+
+            D3D12_SUBRESOURCE_DATA subResourceData = {};
+            subResourceData.pData = data;
+            subResourceData.RowPitch = size;
+            subResourceData.SlicePitch = size;
+            UpdateSubresources(m_commandList.Get(), *buffer, *uploadHeap, 0, 0, 1, &subResourceData);
+
+            const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+                *buffer, D3D12_RESOURCE_STATE_COPY_DEST, state);
+            m_commandList->ResourceBarrier(1, &barrier);
+        };
+
+        createBuffer(vbSize, points.data(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+            m_patternVB.ReleaseAndGetAddressOf(), patternVertexUploadHeap.ReleaseAndGetAddressOf());
+        createBuffer(ibSize, indices.data(), D3D12_RESOURCE_STATE_INDEX_BUFFER,
+            m_patternIB.ReleaseAndGetAddressOf(), patternIndexUploadHeap.ReleaseAndGetAddressOf());
+
+        m_patternVBV.BufferLocation = m_patternVB->GetGPUVirtualAddress();
+        m_patternVBV.StrideInBytes = sizeof(XMFLOAT2);
+        m_patternVBV.SizeInBytes = vbSize;
+
+        m_patternIBV.BufferLocation = m_patternIB->GetGPUVirtualAddress();
+        m_patternIBV.Format = DXGI_FORMAT_R16_UINT;
+        m_patternIBV.SizeInBytes = ibSize;
+    }
+
+    // ================================================================================================================
+    // #06. Create render backend, draw argument buffers & upload ring.
+    // ================================================================================================================
+    // Visible ranges are drawn with one ExecuteIndirect per pass, with one argument slot per leaf.
+    // Only changed slots are uploaded, through upload ring. Both only talk to render backend.
+    {
+        m_backend = std::make_unique<D3D12Backend>(m_d3dDevice.Get(), m_commandList.Get(), m_swapChain.Get());
+
+        const uint32_t slotCount = m_totalIndexCount / m_faceTrees[0]->GetLeafIndexCount();
+        m_drawSlotCount = slotCount;
+        for (auto& drawArguments : m_drawArguments)
+            drawArguments = std::make_unique<DrawArgumentBuffer>(*m_backend, slotCount);
+
+        // Worst case is every slot of every pass in every frame in flight, with alignment padding and one skipped ring end.
+        const uint64_t passSize = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * slotCount + c_drawArgumentAlignment;
+        const uint64_t ringSize = passSize * CULL_VIEW_COUNT * (c_swapBufferCount + 1);
+        m_uploadRing = std::make_unique<UploadRing>(
+            *m_backend, (ringSize + c_drawArgumentAlignment - 1) / c_drawArgumentAlignment * c_drawArgumentAlignment);
+
+        // Pattern instances and draws have their own ring, sized for every patch visible in every pass.
+        if (m_patternSupported)
+        {
+            const uint64_t maxInstanceCount = PatternCache::CalcMaxInstanceCount(m_totalIndexCount / 4, m_unitCount);
+            const uint64_t patternPassSize = sizeof(uint32_t) * maxInstanceCount +
+                sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * PatternCache::c_patternCount + 2 * c_drawArgumentAlignment;
+            const uint64_t patternRingSize = patternPassSize * CULL_VIEW_COUNT * (c_swapBufferCount + 1);
+            m_patternRing = std::make_unique<UploadRing>(
+                *m_backend, (patternRingSize + c_drawArgumentAlignment - 1) / c_drawArgumentAlignment * c_drawArgumentAlignment);
+        }
+    }
+
     // <---------- Close command list.
     DX::ThrowIfFailed(m_commandList->Close());
     m_commandQueue->ExecuteCommandLists(1, CommandListCast(m_commandList.GetAddressOf()));
@@ -1240,6 +2296,9 @@ void Apollo::CreateCommandListDependentResources()
         textureUploadHeaps[i].Reset();
     }
     vertexUploadHeap.Reset();
+    indexUploadHeap.Reset();
+    patternVertexUploadHeap.Reset();
+    patternIndexUploadHeap.Reset();
 }
 
 void Apollo::WaitForGpu() noexcept
@@ -1327,8 +2386,878 @@ void Apollo::GetAdapter(IDXGIAdapter1** ppAdapter) const
     *ppAdapter = adapter.Detach();
 }
 
+void Apollo::DrawFaceTrees(CullView view, const FramePacket& packet)
+{
+    uint64_t uploadSize;
+    {
+        PROFILE_SCOPE("Upload draw arguments");
+        uploadSize = m_drawArguments[view]->Update(*m_uploadRing, packet.drawSlots[view].data());
+    }
+    m_drawArgumentUploadSize += uploadSize;
+    m_drawArgumentUploadTotal += uploadSize;
+
+    m_drawArguments[view]->Draw();
+}
+
+TessParameters Apollo::GetTessParameters(CullView view, const SimulationInput& input) const
+{
+    // Shadow pass tessellates 4 times less along each edge.
+    TessParameters params = {};
+    XMStoreFloat3(&params.cameraPosition, m_camPosition);
+    params.parameters = XMFLOAT4(
+        m_quadWidth, m_unitCount, input.tessMin, view == CULL_VIEW_LIGHT ? input.tessMax - 2 : input.tessMax);
+
+    return params;
+}
+
+void Apollo::EstimateTessellation(const SimulationInput& input)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t viewCount = input.renderShadow ? CULL_VIEW_COUNT : 1;
+    const TessParameters params[CULL_VIEW_COUNT] =
+    {
+        GetTessParameters(CULL_VIEW_CAMERA, input), GetTessParameters(CULL_VIEW_LIGHT, input),
+    };
+    const VertexTess* vertices = m_meshCache->GetVertices();
+
+    // Same split as culling, each task reads ranges its subtree wrote.
+    m_workerPool->Dispatch(c_cullTaskCount, [&](uint32_t task)
+    {
+        const uint32_t face = task / FACE_TREE_SUBTREE_COUNT;
+        const uint32_t subtree = task % FACE_TREE_SUBTREE_COUNT;
+
+        for (uint32_t v = 0; v < viewCount; v++)
+        {
+            const std::vector<IndexRange>& ranges = m_faceTrees[face]->GetRenderRanges(static_cast<CullView>(v), subtree);
+            m_tessSlots[task].triangleCount[v] = TessFactor::EstimateTriangleCount(
+                params[v], vertices, m_totalIndexData, ranges.data(), static_cast<uint32_t>(ranges.size()));
+        }
+    });
+
+    std::fill(std::begin(m_tessTriangleCount), std::end(m_tessTriangleCount), 0);
+    for (uint32_t v = 0; v < viewCount; v++)
+    {
+        for (const TessSlot& slot : m_tessSlots)
+            m_tessTriangleCount[v] += slot.triangleCount[v];
+    }
+
+    m_tessEstimateTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Apollo::CheckTessCracks(const SimulationInput& input)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // Current camera, then cameras spread over sphere (golden angle spiral) close to surface,
+    // where factors change fastest.
+    TessParameters params[c_tessCheckCameraCount];
+    for (uint32_t c = 0; c < c_tessCheckCameraCount; c++)
+    {
+        params[c] = GetTessParameters(CULL_VIEW_CAMERA, input);
+        if (c == 0)
+            continue;
+
+        const float y = 1.0f - 2.0f * (c - 0.5f) / (c_tessCheckCameraCount - 1);
+        const float ring = sqrtf(1.0f - y * y);
+        const float angle = c * XM_PI * (3.0f - sqrtf(5.0f));
+        const float distance = SPHERE_RADIUS + 1.0f + 4.0f * c;
+        params[c].cameraPosition = XMFLOAT3(cosf(angle) * ring * distance, y * distance, sinf(angle) * ring * distance);
+    }
+
+    // One camera per task, each task hashes its own open edges.
+    TessEdgeCheck checks[c_tessCheckCameraCount];
+    const VertexTess* vertices = m_meshCache->GetVertices();
+    m_workerPool->Dispatch(c_tessCheckCameraCount, [&](uint32_t c)
+    {
+        checks[c] = TessFactor::CheckSharedEdges(params[c], vertices, m_totalIndexData, m_totalIndexCount);
+    });
+
+    m_tessCheck = {};
+    for (const TessEdgeCheck& check : checks)
+    {
+        m_tessCheck.sharedEdgeCount += check.sharedEdgeCount;
+        m_tessCheck.mismatchCount += check.mismatchCount;
+        m_tessCheck.unmatchedCount += check.unmatchedCount;
+    }
+    m_tessCheckCameraCount = c_tessCheckCameraCount;
+
+    m_tessCheckTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Apollo::ExpandTessellation(const SimulationInput& input)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const TessParameters params = GetTessParameters(CULL_VIEW_CAMERA, input);
+    const VertexTess* vertices = m_meshCache->GetVertices();
+    const HeightQuery heights = GetHeightQuery();
+
+    // Same split as culling, each task expands ranges its subtree wrote.
+    std::vector<TessMesh> meshes(c_cullTaskCount);
+    m_workerPool->Dispatch(c_cullTaskCount, [&](uint32_t task)
+    {
+        const uint32_t face = task / FACE_TREE_SUBTREE_COUNT;
+        const uint32_t subtree = task % FACE_TREE_SUBTREE_COUNT;
+
+        const std::vector<IndexRange>& ranges = m_faceTrees[face]->GetRenderRanges(CULL_VIEW_CAMERA, subtree);
+        Tessellator::Expand(
+            params, vertices, m_totalIndexData, ranges.data(), static_cast<uint32_t>(ranges.size()), &heights, meshes[task]);
+    });
+
+    m_tessMeshTriangleCount = 0;
+    m_tessMeshVertexCount = 0;
+    for (const TessMesh& mesh : meshes)
+    {
+        m_tessMeshTriangleCount += mesh.indices.size() / 3;
+        m_tessMeshVertexCount += mesh.positions.size();
+    }
+
+    m_tessMeshTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    m_tessMeshExported = Tessellator::WriteObj(c_tessMeshFileName, meshes.data(), static_cast<uint32_t>(meshes.size()));
+}
+
+void Apollo::CheckTessellatedMesh(const SimulationInput& input)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // Shadow pass factors keep the whole sphere at a few million triangles even near surface.
+    const TessParameters params = GetTessParameters(CULL_VIEW_LIGHT, input);
+    const VertexTess* vertices = m_meshCache->GetVertices();
+    const HeightQuery heights = GetHeightQuery();
+
+    // Whole index buffer in equal parts of whole patches. A closed sphere has no open edge.
+    const uint32_t patchCount = m_totalIndexCount / 4;
+    std::vector<TessMesh> meshes(c_cullTaskCount);
+    m_workerPool->Dispatch(c_cullTaskCount, [&](uint32_t task)
+    {
+        const uint32_t first = patchCount * task / c_cullTaskCount;
+        const uint32_t last = patchCount * (task + 1) / c_cullTaskCount;
+        const IndexRange range = { first * 4, (last - first) * 4 };
+
+        Tessellator::Expand(params, vertices, m_totalIndexData, &range, 1, &heights, meshes[task]);
+    });
+
+    m_tessMeshCheck = Tessellator::CheckMesh(meshes.data(), static_cast<uint32_t>(meshes.size()));
+    m_tessMeshCheckPatchCount = patchCount;
+
+    m_tessMeshCheckTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Apollo::ReportSphereGeneration()
+{
+    // No height map, so only generator itself is timed.
+    for (uint32_t i = 0; i < c_sphereReportCount; i++)
+    {
+        SphereReport& report = m_sphereReports[i];
+        report.subdivideCount = c_sphereReportFirstCount + i;
+
+        for (uint32_t welded = 0; welded < 2; welded++)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            const auto geoInfo = QuadSphereGenerator::CreateQuadSphere(
+                300.0f, 300.0f, 300.0f, report.subdivideCount, nullptr, welded == 0);
+            report.generationTime[welded] = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            report.vertexCount[welded] = static_cast<uint32_t>(geoInfo->vertices.size());
+
+            for (const auto faceTree : geoInfo->faceTrees)
+                delete faceTree;
+            delete geoInfo;
+        }
+
+        char line[160] = {};
+        sprintf_s(line, "QuadSphere (subdivide %u): welded %u vertices, %zu bytes VB, %.2f ms; unwelded %u vertices, %zu bytes VB, %.2f ms\n",
+            report.subdivideCount,
+            report.vertexCount[0], sizeof(VertexTess) * report.vertexCount[0], report.generationTime[0],
+            report.vertexCount[1], sizeof(VertexTess) * report.vertexCount[1], report.generationTime[1]);
+        OutputDebugStringA(line);
+    }
+
+    m_sphereReportCount = c_sphereReportCount;
+}
+
+void Apollo::ClampCameraToGround(const SimulationInput& input)
+{
+    if (!m_terrainSampler->IsLoaded())
+        return;
+
+    // Close to camera factors are highest, so DS samples level 0 there.
+    XMFLOAT3 position;
+    XMStoreFloat3(&position, m_camPosition);
+    const float distance = XMVectorGetX(XMVector3Length(m_camPosition));
+    const float surfaceRadius = m_terrainSampler->GetSurfaceRadius(position);
+
+    // Replayed path is kept as recorded.
+    const float minDistance = surfaceRadius + c_groundClearance;
+    if (input.groundClamp && !m_replaying && distance < minDistance && distance > 0.0f)
+    {
+        m_camPosition = XMVectorScale(m_camPosition, minDistance / distance);
+        m_cameraAltitude = c_groundClearance;
+        return;
+    }
+
+    m_cameraAltitude = distance - surfaceRadius;
+}
+
+HeightQuery Apollo::GetHeightQuery() const
+{
+    // Empty query puts points on undisplaced sphere.
+    if (!m_terrainSampler->IsLoaded())
+        return nullptr;
+
+    const TerrainSampler* sampler = m_terrainSampler.get();
+    return [sampler](const XMFLOAT3* directions, const uint32_t* levels, uint32_t count, float* heights)
+    {
+        sampler->SampleHeights(directions, levels, count, heights);
+    };
+}
+
+bool Apollo::CreateStreamedTextures(ComPtr<ID3D12Resource>* uploadHeaps)
+{
+    PROFILE_SCOPE("Create streamed textures");
+
+    // Unmapped tiles must read as zero, and Sample needs LOD clamp.
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if (FAILED(m_d3dDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) ||
+        options.TiledResourcesTier < D3D12_TILED_RESOURCES_TIER_2)
+    {
+        m_tileStreamingState = "tiled resources tier 2 is not supported";
+        return false;
+    }
+
+    static const wchar_t* const fileNames[4] =
+    {
+        L"Textures\\colormap_l.tiles", L"Textures\\colormap_r.tiles", L"Textures\\displacement_l.tiles", L"Textures\\displacement_r.tiles",
+    };
+    ComPtr<ID3D12Resource>* const textures[4] =
+    {
+        std::addressof(m_colorLTexResource), std::addressof(m_colorRTexResource),
+        std::addressof(m_heightLTexResource), std::addressof(m_heightRTexResource),
+    };
+
+    auto tileCache = std::make_unique<TileCache>(c_tileCacheSlotCount);
+    std::vector<uint8_t> tails[4];
+    D3D12_PACKED_MIP_INFO packedMips[4] = {};
+    uint32_t tailTileCount = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        auto file = std::make_unique<TileFile>();
+        if (!file->Open(fileNames[i]) || !file->ReadTail(tails[i]))
+        {
+            m_tileStreamingState = "tile files are missing (run with --tile-textures)";
+            return false;
+        }
+
+        const TileLayout& layout = file->GetLayout();
+        const CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+            static_cast<DXGI_FORMAT>(layout.format), layout.width, layout.height, 1, static_cast<UINT16>(layout.mipCount),
+            1, 0, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateReservedResource(
+                &textureDesc,
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(textures[i]->ReleaseAndGetAddressOf())));
+
+        // Tiles are cut offline, so device must lay them out the same way.
+        D3D12_TILE_SHAPE tileShape = {};
+        UINT subresourceCount = 1;
+        D3D12_SUBRESOURCE_TILING mipTiling = {};
+        m_d3dDevice->GetResourceTiling(textures[i]->Get(), nullptr, &packedMips[i], &tileShape, &subresourceCount, 0, &mipTiling);
+        if (packedMips[i].NumStandardMips != layout.packedMipStart ||
+            tileShape.WidthInTexels != layout.tileWidth || tileShape.HeightInTexels != layout.tileHeight)
+        {
+            m_tileStreamingState = "tile layout of device differs from tile files";
+            return false;
+        }
+
+        tailTileCount += packedMips[i].NumTilesForPackedMips;
+        tileCache->AddTexture(std::move(file), i % 2);
+    }
+
+    // Mip tails first, then slots of cache.
+    const CD3DX12_HEAP_DESC heapDesc(
+        static_cast<UINT64>(tailTileCount + c_tileCacheSlotCount) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES,
+        D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+    DX::ThrowIfFailed(m_d3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(m_tileHeap.ReleaseAndGetAddressOf())));
+    m_tileHeapSlotStart = tailTileCount;
+
+    UINT heapOffset = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        ID3D12Resource* texture = textures[i]->Get();
+        const TileLayout& layout = tileCache->GetLayout(i);
+        const D3D12_PACKED_MIP_INFO& packedMip = packedMips[i];
+
+        // Map tail, and upload its rows.
+        if (packedMip.NumPackedMips > 0)
+        {
+            D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+            coordinate.Subresource = packedMip.NumStandardMips;
+            D3D12_TILE_REGION_SIZE regionSize = {};
+            regionSize.NumTiles = packedMip.NumTilesForPackedMips;
+            const D3D12_TILE_RANGE_FLAGS rangeFlags = D3D12_TILE_RANGE_FLAG_NONE;
+            m_commandQueue->UpdateTileMappings(
+                texture, 1, &coordinate, &regionSize, m_tileHeap.Get(),
+                1, &rangeFlags, &heapOffset, &packedMip.NumTilesForPackedMips, D3D12_TILE_MAPPING_FLAG_NONE);
+            heapOffset += packedMip.NumTilesForPackedMips;
+
+            const D3D12_RESOURCE_DESC textureDesc = texture->GetDesc();
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[TILE_LAYOUT_MAX_MIPS] = {};
+            UINT64 uploadBufferSize = 0;
+            m_d3dDevice->GetCopyableFootprints(
+                &textureDesc, packedMip.NumStandardMips, packedMip.NumPackedMips, 0, footprints, nullptr, nullptr, &uploadBufferSize);
+
+            CD3DX12_HEAP_PROPERTIES uploadHeapProp(D3D12_HEAP_TYPE_UPLOAD);
+            auto uploadHeapDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+            DX::ThrowIfFailed(
+                m_d3dDevice->CreateCommittedResource(
+                    &uploadHeapProp,
+                    D3D12_HEAP_FLAG_NONE,
+                    &uploadHeapDesc,
+                    D3D12_RESOURCE_STATE_GENERIC_READ,
+                    nullptr,
+                    IID_PPV_ARGS(uploadHeaps[i].ReleaseAndGetAddressOf())));
+
+            uint8_t* uploadData = nullptr;
+            DX::ThrowIfFailed(uploadHeaps[i]->Map(0, nullptr, reinterpret_cast<void**>(&uploadData)));
+
+            const uint8_t* tailData = tails[i].data();
+            for (UINT m = 0; m < packedMip.NumPackedMips; m++)
+            {
+                const uint32_t mip = packedMip.NumStandardMips + m;
+                for (uint32_t row = 0; row < layout.GetRowCount(mip); row++)
+                {
+                    memcpy(uploadData + footprints[m].Offset + row * footprints[m].Footprint.RowPitch, tailData, layout.GetRowPitch(mip));
+                    tailData += layout.GetRowPitch(mip);
+                }
+
+                const CD3DX12_TEXTURE_COPY_LOCATION dst(texture, mip);
+                const CD3DX12_TEXTURE_COPY_LOCATION src(uploadHeaps[i].Get(), footprints[m]);
+                m_commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+            }
+
+            uploadHeaps[i]->Unmap(0, nullptr);
+        }
+
+        // Translate state.
+        const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+            texture,
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_commandList->ResourceBarrier(1, &barrier);
+
+        // Create SRV.
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Format = static_cast<DXGI_FORMAT>(layout.format);
+        srvDesc.Texture2D.MipLevels = layout.mipCount;
+
+        const CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(
+            m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), i, m_cbvSrvDescriptorSize);
+        m_d3dDevice->CreateShaderResourceView(texture, &srvDesc, srvHandle);
+    }
+
+    m_tileCache = std::move(tileCache);
+    m_tileCache->Start();
+    m_tileFrame = 0;
+    m_tileStreamingState = nullptr;
+
+    return true;
+}
+
+void Apollo::CreateMinMipMaps()
+{
+    // One texel per tile of mip 0 of streamed maps. Whole maps read a single texel, their resident mip.
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        const UINT width = m_tileCache ? m_tileCache->GetLayout(i).GetTilesX(0) : 1;
+        const UINT height = m_tileCache ? m_tileCache->GetLayout(i).GetTilesY(0) : 1;
+
+        CD3DX12_HEAP_PROPERTIES defaultHeapProp(D3D12_HEAP_TYPE_DEFAULT);
+        const CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_FLOAT, width, height, 1, 1);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateCommittedResource(
+                &defaultHeapProp,
+                D3D12_HEAP_FLAG_NONE,
+                &textureDesc,
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+                nullptr,
+                IID_PPV_ARGS(m_minMipResources[i].ReleaseAndGetAddressOf())));
+
+        const CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(
+            m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), 6 + i, m_cbvSrvDescriptorSize);
+        m_d3dDevice->CreateShaderResourceView(m_minMipResources[i].Get(), nullptr, srvHandle);
+    }
+
+    if (!m_tileCache && !m_mipLoader)
+        return;
+
+    // Upload part of each back buffer holds tiles or mip rows of a frame, then every min mip map.
+    uint64_t frameSize = m_tileCache ?
+        static_cast<uint64_t>(c_maxTileUploads) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES :
+        static_cast<uint64_t>(c_maxMipUploads) * GetMipChunkStride();
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        const D3D12_RESOURCE_DESC textureDesc = m_minMipResources[i]->GetDesc();
+        UINT64 footprintSize = 0;
+        m_d3dDevice->GetCopyableFootprints(&textureDesc, 0, 1, frameSize, &m_minMipFootprints[i], nullptr, nullptr, &footprintSize);
+        frameSize = (m_minMipFootprints[i].Offset + footprintSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) /
+            D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT * D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+    }
+    m_streamUploadFrameSize = (frameSize + D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES - 1) /
+        D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+    CD3DX12_HEAP_PROPERTIES uploadHeapProp(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(c_swapBufferCount * m_streamUploadFrameSize);
+    DX::ThrowIfFailed(
+        m_d3dDevice->CreateCommittedResource(
+            &uploadHeapProp,
+            D3D12_HEAP_FLAG_NONE,
+            &resDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(m_streamUploadHeap.ReleaseAndGetAddressOf())));
+
+    // Mapping.
+    DX::ThrowIfFailed(m_streamUploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&m_streamUploadMappedData)));
+}
+
+void Apollo::BuildLeafCones()
+{
+    PROFILE_SCOPE("Build leaf cones");
+
+    const uint32_t leafIndexCount = m_faceTrees[0]->GetLeafIndexCount();
+    const VertexTess* vertices = m_meshCache->GetVertices();
+
+    m_leafCones.resize(m_totalIndexCount / leafIndexCount);
+    m_workerPool->Dispatch(c_cullTaskCount, [&](uint32_t task)
+    {
+        const auto leafCount = static_cast<uint32_t>(m_leafCones.size());
+        for (uint32_t leaf = leafCount * task / c_cullTaskCount; leaf < leafCount * (task + 1) / c_cullTaskCount; leaf++)
+        {
+            const uint32_t* indices = m_totalIndexData + static_cast<size_t>(leaf) * leafIndexCount;
+
+            XMVECTOR center = XMVectorZero();
+            for (uint32_t i = 0; i < leafIndexCount; i++)
+                center = XMVectorAdd(center, XMVector3Normalize(XMLoadFloat3(&vertices[indices[i]].position)));
+            center = XMVector3Normalize(center);
+
+            float minCos = 1.0f;
+            for (uint32_t i = 0; i < leafIndexCount; i++)
+            {
+                const XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&vertices[indices[i]].position));
+                minCos = std::min(minCos, XMVectorGetX(XMVector3Dot(center, direction)));
+            }
+
+            XMStoreFloat4(&m_leafCones[leaf], XMVectorSetW(center, acosf(std::max(minCos, -1.0f))));
+        }
+    });
+}
+
+void Apollo::BuildTileRequests(const SimulationInput& input, FramePacket& packet) const
+{
+    packet.tileRequests.clear();
+    if (m_leafCones.empty())
+        return;
+
+    // Arc of sphere one pixel covers, per unit of distance.
+    const float pixelAngle = XM_PIDIV4 / static_cast<float>(std::max(input.outputHeight, 1)) / 150.0f;
+    const uint32_t leafIndexCount = m_faceTrees[0]->GetLeafIndexCount();
+
+    for (const FaceTree* faceTree : m_faceTrees)
+    {
+        for (uint32_t subtree = 0; subtree < FACE_TREE_SUBTREE_COUNT; subtree++)
+        {
+            for (const IndexRange& range : faceTree->GetRenderRanges(CULL_VIEW_CAMERA, subtree))
+            {
+                for (uint32_t leaf = range.start / leafIndexCount; leaf < (range.start + range.count) / leafIndexCount; leaf++)
+                {
+                    const XMFLOAT4& cone = m_leafCones[leaf];
+                    const float sinRadius = sinf(cone.w);
+
+                    // Nearest point of leaf sets texel size it wants.
+                    const XMVECTOR center = XMVectorScale(XMVectorSet(cone.x, cone.y, cone.z, 0.0f), 150.0f);
+                    const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(m_camPosition, center))) - 150.0f * sinRadius;
+
+                    // Same mapping as Displace.
+                    float theta = atan2f(cone.z, cone.x);
+                    theta = theta < 0.0f ? theta + XM_2PI : theta;
+                    const float phi = acosf(std::min(std::max(cone.y, -1.0f), 1.0f));
+
+                    TileRequest request = {};
+                    request.texelAngle = std::max(distance, 1.0f) * pixelAngle;
+                    request.y0 = std::max((phi - cone.w) / XM_PI, 0.0f);
+                    request.y1 = std::min((phi + cone.w) / XM_PI, 1.0f);
+
+                    // Longitudes of cone widen towards poles, and cover all of them around one.
+                    const float sinPhi = sinf(phi);
+                    if (sinPhi <= sinRadius)
+                    {
+                        request.x0 = 0.0f;
+                        request.x1 = 1.0f;
+                    }
+                    else
+                    {
+                        const float halfWidth = asinf(sinRadius / sinPhi) / XM_2PI;
+                        request.x0 = theta / XM_2PI - halfWidth;
+                        request.x0 = request.x0 < 0.0f ? request.x0 + 1.0f : request.x0 >= 1.0f ? request.x0 - 1.0f : request.x0;
+                        request.x1 = request.x0 + 2.0f * halfWidth;
+                    }
+
+                    packet.tileRequests.push_back(request);
+                }
+            }
+        }
+    }
+}
+
+void Apollo::UpdateStreamedTextures(const FramePacket& packet)
+{
+    if (!m_tileCache)
+        return;
+
+    PROFILE_SCOPE("Update streamed textures");
+
+    const uint32_t dirtyMask = m_tileCache->Update(
+        m_tileFrame++, packet.tileRequests.data(), static_cast<uint32_t>(packet.tileRequests.size()), c_maxTileUploads, m_tileUpdates);
+
+    ID3D12Resource* const textures[4] =
+    {
+        m_colorLTexResource.Get(), m_colorRTexResource.Get(), m_heightLTexResource.Get(), m_heightRTexResource.Get(),
+    };
+
+    // Queue applies mappings after every command list already submitted and before this one.
+    uint32_t copyMask = 0;
+    for (const TileUpdate& update : m_tileUpdates)
+    {
+        const D3D12_TILED_RESOURCE_COORDINATE coordinate = { update.x, update.y, 0, update.mip };
+        D3D12_TILE_REGION_SIZE regionSize = {};
+        regionSize.NumTiles = 1;
+        const bool mapped = update.slot != TILE_CACHE_NO_SLOT;
+        const D3D12_TILE_RANGE_FLAGS rangeFlags = mapped ? D3D12_TILE_RANGE_FLAG_NONE : D3D12_TILE_RANGE_FLAG_NULL;
+        const UINT heapOffset = mapped ? m_tileHeapSlotStart + update.slot : 0;
+        const UINT tileCount = 1;
+        m_commandQueue->UpdateTileMappings(
+            textures[update.texture], 1, &coordinate, &regionSize, m_tileHeap.Get(),
+            1, &rangeFlags, &heapOffset, &tileCount, D3D12_TILE_MAPPING_FLAG_NONE);
+
+        copyMask |= mapped ? 1u << update.texture : 0;
+    }
+
+    if ((copyMask | dirtyMask) == 0)
+        return;
+
+    D3D12_RESOURCE_BARRIER barriers[8];
+    UINT barrierCount = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (copyMask & (1u << i))
+        {
+            barriers[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(textures[i],
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+        if (dirtyMask & (1u << i))
+        {
+            barriers[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(m_minMipResources[i].Get(),
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+    }
+    m_commandList->ResourceBarrier(barrierCount, barriers);
+
+    // Upload part of this back buffer is free, as GPU is done with its last frame.
+    const uint64_t uploadOffset = m_backBufferIndex * m_streamUploadFrameSize;
+    uint8_t* uploadData = m_streamUploadMappedData + uploadOffset;
+
+    uint32_t copyCount = 0;
+    for (const TileUpdate& update : m_tileUpdates)
+    {
+        if (update.slot == TILE_CACHE_NO_SLOT)
+            continue;
+
+        const uint64_t tileOffset = static_cast<uint64_t>(copyCount++) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+        memcpy(uploadData + tileOffset, update.data, D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES);
+
+        const D3D12_TILED_RESOURCE_COORDINATE coordinate = { update.x, update.y, 0, update.mip };
+        D3D12_TILE_REGION_SIZE regionSize = {};
+        regionSize.NumTiles = 1;
+        m_commandList->CopyTiles(
+            textures[update.texture], &coordinate, &regionSize, m_streamUploadHeap.Get(), uploadOffset + tileOffset,
+            D3D12_TILE_COPY_FLAG_LINEAR_BUFFER_TO_SWIZZLED_TILED_RESOURCE);
+    }
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (dirtyMask & (1u << i))
+            CopyMinMipMap(i, m_tileCache->GetMinMipMap(i).data(), uploadOffset);
+    }
+
+    for (UINT b = 0; b < barrierCount; b++)
+        std::swap(barriers[b].Transition.StateBefore, barriers[b].Transition.StateAfter);
+    m_commandList->ResourceBarrier(barrierCount, barriers);
+}
+
+void Apollo::CopyMinMipMap(uint32_t texture, const float* minMips, uint64_t uploadOffset)
+{
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = m_minMipFootprints[texture];
+    uint8_t* uploadData = m_streamUploadMappedData + uploadOffset;
+    const UINT width = footprint.Footprint.Width;
+    for (UINT row = 0; row < footprint.Footprint.Height; row++)
+        memcpy(uploadData + footprint.Offset + row * footprint.Footprint.RowPitch, &minMips[row * width], sizeof(float) * width);
+
+    footprint.Offset += uploadOffset;
+    const CD3DX12_TEXTURE_COPY_LOCATION dst(m_minMipResources[texture].Get(), 0);
+    const CD3DX12_TEXTURE_COPY_LOCATION src(m_streamUploadHeap.Get(), footprint);
+    m_commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+}
+
+bool Apollo::CreateProgressiveTextures(ComPtr<ID3D12Resource>* uploadHeaps)
+{
+    PROFILE_SCOPE("Create progressive textures");
+
+    static const wchar_t* const fileNames[4] =
+    {
+        L"Textures\\colormap_l.dds", L"Textures\\colormap_r.dds", L"Textures\\displacement_l.dds", L"Textures\\displacement_r.dds",
+    };
+    ComPtr<ID3D12Resource>* const textures[4] =
+    {
+        std::addressof(m_colorLTexResource), std::addressof(m_colorRTexResource),
+        std::addressof(m_heightLTexResource), std::addressof(m_heightRTexResource),
+    };
+
+    // Every initial mip is read before any resource is made, so a failure leaves nothing behind for whole loading.
+    auto mipLoader = std::make_unique<MipLoader>(c_mipChunkSize, c_mipChunkCount);
+    std::vector<uint8_t> initialMips[4];
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        auto file = std::make_unique<DdsMipFile>();
+        if (!file->Open(fileNames[i]))
+            return false;
+
+        mipLoader->AddTexture(std::move(file), c_mipInitialSize);
+        if (!mipLoader->ReadInitialMips(i, initialMips[i]))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        const TileLayout& layout = mipLoader->GetLayout(i);
+        const CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+            static_cast<DXGI_FORMAT>(layout.format), layout.width, layout.height, 1, static_cast<UINT16>(layout.mipCount));
+        CD3DX12_HEAP_PROPERTIES defaultHeapProp(D3D12_HEAP_TYPE_DEFAULT);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateCommittedResource(
+                &defaultHeapProp,
+                D3D12_HEAP_FLAG_NONE,
+                &textureDesc,
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(textures[i]->ReleaseAndGetAddressOf())));
+        ID3D12Resource* texture = textures[i]->Get();
+
+        // Upload initial mips, finer ones stay undefined until loaded.
+        const UINT firstMip = mipLoader->GetInitialMip(i);
+        const UINT mipCount = layout.mipCount - firstMip;
+        D3D12_SUBRESOURCE_DATA subresources[TILE_LAYOUT_MAX_MIPS] = {};
+        const uint8_t* mipData = initialMips[i].data();
+        for (UINT m = 0; m < mipCount; m++)
+        {
+            subresources[m].pData = mipData;
+            subresources[m].RowPitch = layout.GetRowPitch(firstMip + m);
+            subresources[m].SlicePitch = static_cast<LONG_PTR>(MipLoader::GetMipSize(layout, firstMip + m));
+            mipData += subresources[m].SlicePitch;
+        }
+
+        const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture, firstMip, mipCount);
+        CD3DX12_HEAP_PROPERTIES uploadHeapProp(D3D12_HEAP_TYPE_UPLOAD);
+        auto uploadHeapDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateCommittedResource(
+                &uploadHeapProp,
+                D3D12_HEAP_FLAG_NONE,
+                &uploadHeapDesc,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nullptr,
+                IID_PPV_ARGS(uploadHeaps[i].ReleaseAndGetAddressOf())));
+
+        UpdateSubresources(m_commandList.Get(), texture, uploadHeaps[i].Get(), 0, firstMip, mipCount, subresources);
+
+        // Translate state.
+        const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+            texture,
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_commandList->ResourceBarrier(1, &barrier);
+
+        // Create SRV of every mip, min mip map keeps sampling off those not loaded yet.
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Format = static_cast<DXGI_FORMAT>(layout.format);
+        srvDesc.Texture2D.MipLevels = layout.mipCount;
+
+        const CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(
+            m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), i, m_cbvSrvDescriptorSize);
+        m_d3dDevice->CreateShaderResourceView(texture, &srvDesc, srvHandle);
+    }
+
+    m_mipLoader = std::move(mipLoader);
+    m_mipLoader->Start();
+    m_mipUploads.reserve(c_maxMipUploads);
+
+    return true;
+}
+
+uint64_t Apollo::GetMipChunkStride() const
+{
+    return (m_mipLoader->GetMaxChunkSize() + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) /
+        D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT * D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+}
+
+void Apollo::UpdateProgressiveTextures()
+{
+    if (!m_mipLoader)
+        return;
+
+    PROFILE_SCOPE("Update progressive textures");
+
+    const uint32_t dirtyMask = m_mipLoader->Update(c_maxMipUploads, m_mipUploads);
+
+    uint32_t copyMask = 0;
+    for (const MipUpload& upload : m_mipUploads)
+        copyMask |= 1u << upload.texture;
+
+    if ((copyMask | dirtyMask) == 0)
+        return;
+
+    ID3D12Resource* const textures[4] =
+    {
+        m_colorLTexResource.Get(), m_colorRTexResource.Get(), m_heightLTexResource.Get(), m_heightRTexResource.Get(),
+    };
+
+    D3D12_RESOURCE_BARRIER barriers[8];
+    UINT barrierCount = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (copyMask & (1u << i))
+        {
+            barriers[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(textures[i],
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+        if (dirtyMask & (1u << i))
+        {
+            barriers[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(m_minMipResources[i].Get(),
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+    }
+    m_commandList->ResourceBarrier(barrierCount, barriers);
+
+    // Upload part of this back buffer is free, as GPU is done with its last frame.
+    const uint64_t uploadOffset = m_backBufferIndex * m_streamUploadFrameSize;
+    const uint64_t chunkStride = GetMipChunkStride();
+
+    for (size_t u = 0; u < m_mipUploads.size(); u++)
+    {
+        const MipUpload& upload = m_mipUploads[u];
+        const TileLayout& layout = m_mipLoader->GetLayout(upload.texture);
+
+        // Rows of chunk are placed as the whole mip would be, then cut down to the chunk.
+        const D3D12_RESOURCE_DESC textureDesc = textures[upload.texture]->GetDesc();
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        m_d3dDevice->GetCopyableFootprints(&textureDesc, upload.mip, 1, uploadOffset + u * chunkStride, &footprint, nullptr, nullptr, nullptr);
+
+        uint8_t* uploadData = m_streamUploadMappedData + footprint.Offset;
+        const uint32_t rowPitch = layout.GetRowPitch(upload.mip);
+        for (uint32_t row = 0; row < upload.rowCount; row++)
+            memcpy(uploadData + row * footprint.Footprint.RowPitch, upload.data + row * rowPitch, rowPitch);
+
+        const UINT y = upload.firstRow * layout.blockSize;
+        footprint.Footprint.Height = std::min(upload.rowCount * layout.blockSize, footprint.Footprint.Height - y);
+
+        const CD3DX12_TEXTURE_COPY_LOCATION dst(textures[upload.texture], upload.mip);
+        const CD3DX12_TEXTURE_COPY_LOCATION src(m_streamUploadHeap.Get(), footprint);
+        m_commandList->CopyTextureRegion(&dst, 0, y, 0, &src, nullptr);
+    }
+
+    // Texture is copied before clamp drops to its new mip, in the same command list.
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (dirtyMask & (1u << i))
+        {
+            const float minMip = static_cast<float>(m_mipLoader->GetResidentMip(i));
+            CopyMinMipMap(i, &minMip, uploadOffset);
+        }
+    }
+
+    for (UINT b = 0; b < barrierCount; b++)
+        std::swap(barriers[b].Transition.StateBefore, barriers[b].Transition.StateAfter);
+    m_commandList->ResourceBarrier(barrierCount, barriers);
+}
+
+void Apollo::BuildPatternInstances(const SimulationInput& input)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t viewCount = input.renderShadow ? CULL_VIEW_COUNT : 1;
+    const TessParameters params[CULL_VIEW_COUNT] =
+    {
+        GetTessParameters(CULL_VIEW_CAMERA, input), GetTessParameters(CULL_VIEW_LIGHT, input),
+    };
+    const VertexTess* vertices = m_meshCache->GetVertices();
+
+    // Same split as culling, each task buckets patches of ranges its subtree wrote.
+    m_workerPool->Dispatch(c_cullTaskCount, [&](uint32_t task)
+    {
+        const uint32_t face = task / FACE_TREE_SUBTREE_COUNT;
+        const uint32_t subtree = task % FACE_TREE_SUBTREE_COUNT;
+
+        for (uint32_t v = 0; v < viewCount; v++)
+        {
+            const std::vector<IndexRange>& ranges = m_faceTrees[face]->GetRenderRanges(static_cast<CullView>(v), subtree);
+
+            PatternInstances& instances = m_patternInstances[task][v];
+            instances.Clear();
+            PatternCache::BuildInstances(
+                params[v], vertices, m_totalIndexData, ranges.data(), static_cast<uint32_t>(ranges.size()), instances);
+        }
+    });
+
+    m_patternBuildTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Apollo::DrawPatterns(CullView view, const FramePacket& packet)
+{
+    PROFILE_SCOPE("Draw patterns");
+
+    const std::vector<uint32_t>& instances = packet.patternInstances[view];
+    const std::vector<D3D12_DRAW_INDEXED_ARGUMENTS>& draws = packet.patternDraws[view];
+    if (draws.empty())
+        return;
+
+    m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_commandList->IASetVertexBuffers(0, 1, &m_patternVBV);
+    m_commandList->IASetIndexBuffer(&m_patternIBV);
+
+    // Instance words and draw arguments change every frame, so both are written to ring as a whole.
+    const uint64_t instanceSize = sizeof(uint32_t) * instances.size();
+    const UploadRing::Allocation instanceData = m_patternRing->Allocate(instanceSize, sizeof(uint32_t));
+    memcpy(instanceData.cpuAddress, instances.data(), instanceSize);
+
+    const uint64_t drawSize = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * draws.size();
+    const UploadRing::Allocation drawData = m_patternRing->Allocate(drawSize, sizeof(uint32_t));
+    memcpy(drawData.cpuAddress, draws.data(), drawSize);
+
+    m_patternUploadSize += instanceSize + drawSize;
+
+    m_backend->SetInstanceBuffer(instanceData.buffer, instanceData.offset, static_cast<uint32_t>(instanceSize), sizeof(uint32_t));
+    m_backend->DrawIndexedIndirect(drawData.buffer, drawData.offset, static_cast<uint32_t>(draws.size()));
+}
+
 void Apollo::OnDeviceLost()
 {
+    // Simulation thread uses face trees.
+    StopSimulation();
+
     // imgui
     ImGui_ImplDX12_Shutdown();
     ImGui_ImplWin32_Shutdown();
@@ -1343,7 +3272,33 @@ void Apollo::OnDeviceLost()
 
     // Static VB/IB
     m_staticVB.Reset();
-    m_totalIndexData.clear();
+    m_staticIB.Reset();
+    m_totalIndexData = nullptr;
+
+    // Draw arguments
+    for (auto& drawArguments : m_drawArguments)
+        drawArguments.reset();
+    m_uploadRing.reset();
+    m_patternRing.reset();
+    m_backend.reset();
+
+    // Pattern VB/IB
+    m_patternVB.Reset();
+    m_patternIB.Reset();
+
+    // Streamed textures, loader thread is stopped first
+    m_tileCache.reset();
+    m_tileHeap.Reset();
+    m_streamUploadHeap.Reset();
+    m_streamUploadMappedData = nullptr;
+    for (auto& minMipResource : m_minMipResources)
+        minMipResource.Reset();
+
+    // Progressive textures, loader thread is stopped first. Startup metrics measure recovery.
+    m_mipLoader.reset();
+    m_startTime = std::chrono::steady_clock::now();
+    m_timeToFirstFrame = 0.0f;
+    m_timeToFullDetail = 0.0f;
 
     // Textures
     m_colorLTexResource.Reset();
@@ -1388,11 +3343,15 @@ void Apollo::OnDeviceLost()
     CreateDeviceDependentResources();
     CreateWindowSizeDependentResources();
     CreateCommandListDependentResources();
+
+    StartSimulation();
 }
 
 void Apollo::CreateTextureResource(
     const wchar_t* fileName, ID3D12Resource** texture, ID3D12Resource** uploadHeap, UINT index) const
 {
+    PROFILE_SCOPE("Load texture");
+
     std::unique_ptr<uint8_t[]> ddsData;
     std::vector<D3D12_SUBRESOURCE_DATA> subResourceDataVec;
 
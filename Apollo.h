@@ -1,8 +1,25 @@
 #pragma once
 
+#include "AllocationCounter.h"
+#include "CameraPath.h"
+#include "D3D12Backend.h"
+#include "DrawArgumentBuffer.h"
 #include "FaceTree.h"
+#include "MeshCache.h"
+#include "MipLoader.h"
+#include "PatternCache.h"
+#include "Profiler.h"
+#include "ReplayReport.h"
+#include "SceneCuller.h"
 #include "ShadowMap.h"
 #include "StepTimer.h"
+#include "TerrainSampler.h"
+#include "TessFactor.h"
+#include "Tessellator.h"
+#include "TileCache.h"
+#include "TripleBuffer.h"
+#include "UploadRing.h"
+#include "WorkerPool.h"
 
 class Apollo
 {
@@ -20,9 +37,13 @@ public:
     // Initialization
     void InitializeD3DResources(HWND window, int width, int height, UINT subDivideCount, UINT shadowMapSize, BOOL fullScreenMode);
 
-    // Basic game loop
+    // Basic game loop (render thread, simulation runs on its own thread)
     void Tick();
 
+    // Replay recorded camera path and write stats next to it (fileName + ".json").
+    // Request is passed to simulation thread with next input.
+    void StartReplay(const wchar_t* fileName, bool exitWhenDone);
+
     // Input handle
     void OnKeyDown(UINT8 key);
     void OnKeyUp(UINT8 key);
@@ -58,8 +79,139 @@ private:
         uint8_t             padding[88];
     };
 
-    void Update(DX::StepTimer const& timer);
-    void Render();
+    // Tessellated triangles of one estimate task, padded to own cache line.
+    struct TessSlot
+    {
+        uint64_t            triangleCount[CULL_VIEW_COUNT];
+        uint8_t             padding[64 - sizeof(uint64_t) * CULL_VIEW_COUNT];
+    };
+
+    // One-shot requests from render thread. Counted, so none is lost when an input is skipped.
+    struct SimulationRequests
+    {
+        uint32_t            resetCamera;
+        uint32_t            resetStats;
+        uint32_t            measureScaling;
+        uint32_t            record;
+        uint32_t            replay;
+        uint32_t            resetTimer;
+        uint32_t            checkTess;
+        uint32_t            expandTess;
+        uint32_t            checkTessMesh;
+        uint32_t            benchmarkTerrain;
+        uint32_t            reportSphere;
+    };
+
+    // Input and options sampled by render thread at the start of each tick.
+    struct SimulationInput
+    {
+        std::chrono::steady_clock::time_point sampleTime;
+        float               aspectRatio;
+        int                 outputHeight;
+        float               camYaw;
+        float               camPitch;
+        float               camMoveSpeed;
+        float               forwardMove;        // -1, 0 or 1
+        float               rightMove;          // -1, 0 or 1
+        bool                lightRotation;
+        bool                renderShadow;
+        bool                simdCulling;
+        bool                horizonCulling;
+        bool                temporalCulling;
+        bool                tessEstimate;
+        bool                patternGeometry;
+        bool                groundClamp;
+        int                 cullThreadCount;
+        int                 tessMin;
+        int                 tessMax;
+        SimulationRequests  requests;
+        bool                exitAfterReplay;
+        wchar_t             replayFileName[MAX_PATH];
+    };
+
+    // Welded and unwelded quad sphere generated with one subdivide count (no height map).
+    static constexpr uint32_t c_sphereReportFirstCount = 7;
+    static constexpr uint32_t c_sphereReportCount = 3;     // Subdivide counts 7 ~ 9
+    struct SphereReport
+    {
+        uint32_t            subdivideCount;
+        uint32_t            vertexCount[2];         // Welded, unwelded
+        float               generationTime[2];      // ms
+    };
+
+    // Stats of one simulated frame, shown by render thread.
+    static constexpr uint32_t c_maxScalingThreadCount = 64;
+    struct SimulationStats
+    {
+        uint32_t            culledQuadCount;
+        uint32_t            horizonCulledQuadCount;
+        uint32_t            shadowCulledQuadCount;
+        uint32_t            drawCount;
+        uint32_t            shadowDrawCount;
+        float               cullingTime;
+        uint32_t            cullFrameCount;
+        uint32_t            cullSkippedFrameCount;
+        uint64_t            cullBatchCount;
+        uint64_t            planeHintHitCount;
+        float               cullingSavedTime;
+        uint64_t            tessTriangleCount[CULL_VIEW_COUNT];     // Valid if tessEstimated
+        float               tessEstimateTime;
+        bool                tessEstimated;
+        TessEdgeCheck       tessCheck;
+        uint32_t            tessCheckCameraCount;                   // 0 until first check
+        float               tessCheckTime;
+        uint64_t            tessMeshTriangleCount;                  // Camera pass, 0 until first expand
+        uint64_t            tessMeshVertexCount;
+        float               tessMeshTime;
+        bool                tessMeshExported;
+        TessMeshCheck       tessMeshCheck;
+        uint32_t            tessMeshCheckPatchCount;                // 0 until first check
+        float               tessMeshCheckTime;
+        uint64_t            patternInstanceCount[CULL_VIEW_COUNT];  // Valid if patternGeometry
+        uint32_t            patternDrawCount[CULL_VIEW_COUNT];
+        float               patternBuildTime;
+        float               cameraAltitude;                         // Above terrain, valid if terrain sampler is loaded
+        TerrainSamplerBenchmark terrainBenchmark;                   // queryCount is 0 until first benchmark
+        SphereReport        sphereReports[c_sphereReportCount];
+        uint32_t            sphereReportCount;                      // 0 until first report
+        AllocationCount     updateAllocations;      // Simulation thread only
+        AllocationCount     frameAllocations;       // Whole process, between simulated frames
+        float               cullingScaling[c_maxScalingThreadCount];
+        uint32_t            cullingScalingCount;
+        uint32_t            cameraPathFrameCount;
+        uint32_t            replayFrame;
+        bool                recording;
+        bool                replaying;
+        int                 replayExitCode;         // -1 until replay runner is done
+    };
+
+    // Everything render thread needs to draw one simulated frame. Not changed once published.
+    struct FramePacket
+    {
+        uint64_t            frameIndex;
+        std::chrono::steady_clock::time_point inputSampleTime;
+        OpaqueCB            opaqueCB;
+        ShadowCB            shadowCB;
+        bool                renderShadow;
+        bool                patternGeometry;
+        std::vector<D3D12_DRAW_INDEXED_ARGUMENTS> drawSlots[CULL_VIEW_COUNT];
+        std::vector<uint32_t> patternInstances[CULL_VIEW_COUNT];                    // Grouped by pattern
+        std::vector<D3D12_DRAW_INDEXED_ARGUMENTS> patternDraws[CULL_VIEW_COUNT];     // One per used pattern
+        std::vector<TileRequest> tileRequests;                                      // Visible leaves, empty if textures aren't streamed
+        SimulationStats     stats;
+    };
+
+    // Simulation thread
+    void StartSimulation();
+    void StopSimulation();
+    void SimulationMain();
+    void Update(DX::StepTimer const& timer, const SimulationInput& input);
+    void HandleRequests(const SimulationInput& input);
+    void WriteFramePacket(const SimulationInput& input, FramePacket& packet);
+
+    // Render thread
+    void SampleInput();
+    void Render(const FramePacket& packet, bool newPacket);
 
     void CreateDeviceResources();
     void CreateDeviceDependentResources();
@@ -72,6 +224,49 @@ private:
 
     void OnDeviceLost();
 
+    // Camera path
+    void BeginReplay(const wchar_t* fileName, bool exitWhenDone);
+    void RecordCameraFrame(float yaw, float pitch);
+    void ApplyCameraFrame(const CameraFrame& frame);
+    void EndReplayFrame();
+    void FinishReplay();
+
+    // Culling
+    void DrawFaceTrees(CullView view, const FramePacket& packet);
+
+    // Tessellation (CPU port of ConstantHS)
+    TessParameters GetTessParameters(CullView view, const SimulationInput& input) const;
+    void EstimateTessellation(const SimulationInput& input);
+    void CheckTessCracks(const SimulationInput& input);
+
+    // Software tessellation (CPU port of fixed function tessellator and DS)
+    void ExpandTessellation(const SimulationInput& input);
+    void CheckTessellatedMesh(const SimulationInput& input);
+
+    // Pre-tessellated patterns (instead of HS/DS)
+    void BuildPatternInstances(const SimulationInput& input);
+    void DrawPatterns(CullView view, const FramePacket& packet);
+
+    // Quad sphere generation
+    void ReportSphereGeneration();
+
+    // Terrain heights on CPU
+    void ClampCameraToGround(const SimulationInput& input);
+    HeightQuery GetHeightQuery() const;
+
+    // Tiled streaming of color and displacement maps
+    bool CreateStreamedTextures(Microsoft::WRL::ComPtr<ID3D12Resource>* uploadHeaps);
+    void CreateMinMipMaps();
+    void BuildLeafCones();
+    void BuildTileRequests(const SimulationInput& input, FramePacket& packet) const;
+    void UpdateStreamedTextures(const FramePacket& packet);
+    void CopyMinMipMap(uint32_t texture, const float* minMips, uint64_t uploadOffset);
+
+    // Progressive loading of whole color and displacement maps
+    bool CreateProgressiveTextures(Microsoft::WRL::ComPtr<ID3D12Resource>* uploadHeaps);
+    void UpdateProgressiveTextures();
+    uint64_t GetMipChunkStride() const;
+
     // Helper functions
     void CreateTextureResource(const wchar_t* fileName, ID3D12Resource** texture, ID3D12Resource** uploadHeap, UINT index) const;
 
@@ -85,7 +280,7 @@ private:
 																					0.f, 0.f, 0.f, 1.f };
 
     // Input
-    std::unordered_map<UINT8, bool>                     m_keyTracker;
+    bool                                                m_keyTracker[256];
     bool												m_isFlightMode;
 
 	// Application state
@@ -135,6 +330,10 @@ private:
     Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_noShadowPSO;
     Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_wireframePSO;
     Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_shadowPSO;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_patternPSO;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_patternNoShadowPSO;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_patternWireframePSO;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>         m_patternShadowPSO;
 
     // CB
     Microsoft::WRL::ComPtr<ID3D12Resource>              m_cbOpaqueUploadHeap;
@@ -159,20 +358,144 @@ private:
     Microsoft::WRL::ComPtr<ID3D12Resource>              m_heightLTexResource;
     Microsoft::WRL::ComPtr<ID3D12Resource>              m_heightRTexResource;
 
+    // Mesh cache (mapped vertex, index and node data)
+    std::unique_ptr<MeshCache>                          m_meshCache;
+    bool                                                m_meshCacheHit;
+    float                                               m_sphereLoadTime;
+
     // Static IB Data
-    std::vector<uint32_t>							    m_totalIndexData;
+    const uint32_t*							            m_totalIndexData;
     size_t											    m_totalIBSize;
     uint32_t										    m_totalIndexCount;
 
+    // Static IB (whole quad sphere, drawn by visible ranges)
+    Microsoft::WRL::ComPtr<ID3D12Resource>              m_staticIB;
+    D3D12_INDEX_BUFFER_VIEW                             m_staticIBV;
+
+    // Indirect draw arguments, only changed slots are uploaded every frame
+    static constexpr uint64_t                           c_drawArgumentAlignment = 256;
+    std::unique_ptr<RenderBackend>                      m_backend;
+    std::unique_ptr<UploadRing>                         m_uploadRing;
+    std::unique_ptr<DrawArgumentBuffer>                 m_drawArguments[CULL_VIEW_COUNT];
+    uint32_t                                            m_drawSlotCount;
+    uint64_t                                            m_drawArgumentUploadSize;
+    uint64_t                                            m_drawArgumentUploadTotal;
+
     // Static VB
     Microsoft::WRL::ComPtr<ID3D12Resource>              m_staticVB;
     D3D12_VERTEX_BUFFER_VIEW                            m_staticVBV;
     size_t											    m_staticVBSize;
     uint32_t										    m_staticVertexCount;
+    bool                                                m_reportSphere;
+    SphereReport                                        m_sphereReports[c_sphereReportCount];
+    uint32_t                                            m_sphereReportCount;
 
     // QuadBox
     UINT        			                            m_subDivideCount;
     uint32_t										    m_culledQuadCount;
+    uint32_t                                            m_horizonCulledQuadCount;
+    uint32_t                                            m_shadowCulledQuadCount;
+    uint32_t                                            m_drawCount;
+    uint32_t                                            m_shadowDrawCount;
+    float                                               m_cullingTime;
+    bool                                                m_simdCulling;
+    bool                                                m_horizonCulling;
+
+    // Temporal culling stats (reset from stats window)
+    bool                                                m_temporalCulling;
+    uint32_t                                            m_cullFrameCount;
+    uint32_t                                            m_cullSkippedFrameCount;
+    uint64_t                                            m_cullBatchCount;
+    uint64_t                                            m_planeHintHitCount;
+    float                                               m_fullCullingTime;
+    float                                               m_cullingSavedTime;
+
+    // Culling worker pool (one task per level 1 subtree of each face)
+    static constexpr uint32_t                           c_cullTaskCount = SceneCuller::c_taskCount;
+    static constexpr uint32_t                           c_cullingScalingIterationCount = 200;
+    std::unique_ptr<WorkerPool>                         m_workerPool;
+    std::unique_ptr<SceneCuller>                        m_sceneCuller;
+    int                                                 m_cullThreadCount;
+    bool                                                m_measureCullingScaling;
+    std::vector<float>                                  m_cullingScaling;
+
+    // Tessellated triangle estimate of visible patches, and crack check of every patch
+    static constexpr uint32_t                           c_tessCheckCameraCount = 8;
+    TessSlot                                            m_tessSlots[c_cullTaskCount];
+    bool                                                m_tessEstimate;
+    bool                                                m_tessEstimated;
+    uint64_t                                            m_tessTriangleCount[CULL_VIEW_COUNT];
+    float                                               m_tessEstimateTime;
+    bool                                                m_checkTess;
+    TessEdgeCheck                                       m_tessCheck;
+    uint32_t                                            m_tessCheckCameraCount;
+    float                                               m_tessCheckTime;
+
+    // Tessellated mesh of visible patches (exported), and open edge check of whole sphere
+    static constexpr const wchar_t*                     c_tessMeshFileName = L"tessellated_mesh.obj";
+    bool                                                m_expandTess;
+    bool                                                m_checkTessMesh;
+    uint64_t                                            m_tessMeshTriangleCount;
+    uint64_t                                            m_tessMeshVertexCount;
+    float                                               m_tessMeshTime;
+    bool                                                m_tessMeshExported;
+    TessMeshCheck                                       m_tessMeshCheck;
+    uint32_t                                            m_tessMeshCheckPatchCount;
+    float                                               m_tessMeshCheckTime;
+
+    // Pre-tessellated pattern path, patches are drawn as instances of cached patterns and displaced in VS
+    std::unique_ptr<PatternCache>                       m_patternCache;
+    Microsoft::WRL::ComPtr<ID3D12Resource>              m_patternVB;
+    Microsoft::WRL::ComPtr<ID3D12Resource>              m_patternIB;
+    D3D12_VERTEX_BUFFER_VIEW                            m_patternVBV;
+    D3D12_INDEX_BUFFER_VIEW                             m_patternIBV;
+    std::unique_ptr<UploadRing>                         m_patternRing;
+    PatternInstances                                    m_patternInstances[c_cullTaskCount][CULL_VIEW_COUNT];
+    bool                                                m_patternGeometry;
+    bool                                                m_patternSupported;     // Patch index fits instance word
+    float                                               m_patternBuildTime;
+    uint64_t                                            m_patternUploadSize;
+
+    // CPU terrain sampler (ground clamping, heights of CPU tessellator), kept across device lost
+    static constexpr float                              c_groundClearance = 0.05f;
+    static constexpr uint32_t                           c_terrainBenchmarkQueryCount = 1u << 20;
+    std::unique_ptr<TerrainSampler>                     m_terrainSampler;
+    float                                               m_terrainLoadTime;
+    bool                                                m_groundClamp;
+    float                                               m_cameraAltitude;
+    bool                                                m_benchmarkTerrain;
+    TerrainSamplerBenchmark                             m_terrainBenchmark;
+
+    // Tiled streaming of color and displacement maps, as reserved resources whose tiles TileCache maps into one heap.
+    // Mip tails of every map sit at the start of heap, slots of cache follow. Whole textures are loaded if it can't run.
+    static constexpr uint32_t                           c_tileCacheSlotCount = 1024;    // 64 MB
+    static constexpr uint32_t                           c_maxTileUploads = 16;          // Per frame
+    std::unique_ptr<TileCache>                          m_tileCache;
+    Microsoft::WRL::ComPtr<ID3D12Heap>                  m_tileHeap;
+    uint32_t                                            m_tileHeapSlotStart;
+    Microsoft::WRL::ComPtr<ID3D12Resource>              m_streamUploadHeap;             // Tiles or mip rows, then min mip maps, one part per back buffer
+    uint8_t*                                            m_streamUploadMappedData;
+    uint64_t                                            m_streamUploadFrameSize;
+    Microsoft::WRL::ComPtr<ID3D12Resource>              m_minMipResources[4];           // 1 x 1 resident mip if maps are whole
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT                  m_minMipFootprints[4];          // In upload part of a back buffer
+    std::vector<TileUpdate>                             m_tileUpdates;
+    uint64_t                                            m_tileFrame;
+    const char*                                         m_tileStreamingState;           // Why maps are whole
+    std::vector<DirectX::XMFLOAT4>                      m_leafCones;                    // Center direction and angular radius of each leaf
+
+    // Progressive loading of whole maps, if they aren't streamed by tiles. Mips up to c_mipInitialSize are uploaded
+    // before first frame, MipLoader reads finer ones in background and min mip maps clamp sampling to resident mips.
+    static constexpr uint32_t                           c_mipInitialSize = 256;         // Texels, as maxsize of DDSTextureLoader
+    static constexpr uint32_t                           c_mipChunkSize = 1u << 20;
+    static constexpr uint32_t                           c_mipChunkCount = 16;
+    static constexpr uint32_t                           c_maxMipUploads = 4;            // Chunks per frame
+    std::unique_ptr<MipLoader>                          m_mipLoader;
+    std::vector<MipUpload>                              m_mipUploads;
+
+    // From initialization (or device lost) to present of first frame, and of first frame with every mip of whole maps.
+    std::chrono::steady_clock::time_point               m_startTime;
+    float                                               m_timeToFirstFrame;             // ms, 0 until reached
+    float                                               m_timeToFullDetail;
 
     // QuadTree instances
     std::vector<FaceTree*>                              m_faceTrees;
@@ -182,9 +505,48 @@ private:
     UINT												m_shadowMapSize;
     DirectX::BoundingSphere                             m_sceneBounds;
 
-    // Game state
+    // Game state (simulation thread)
     DX::StepTimer                                       m_timer;
 
+    // Simulation thread, at most one frame ahead of render thread
+    std::thread                                         m_simulationThread;
+    std::mutex                                          m_simulationMutex;
+    std::condition_variable                             m_simulationCondition;
+    uint64_t                                            m_simulatedFrameCount;
+    uint64_t                                            m_renderedFrameCount;
+    bool                                                m_simulationExit;
+    TripleBuffer<SimulationInput>                       m_simulationInputs;
+    TripleBuffer<FramePacket>                           m_framePackets;
+    SimulationRequests                                  m_requests;
+    SimulationRequests                                  m_handledRequests;
+    wchar_t                                             m_requestedReplayFileName[MAX_PATH];
+    bool                                                m_requestedExitAfterReplay;
+    bool                                                m_hasFramePacket;
+
+    // Input sample to submit latency of new frame packets (ms)
+    float                                               m_inputLatency;
+    double                                              m_inputLatencyTotal;
+    uint32_t                                            m_inputLatencyCount;
+
+    // Heap allocations of last frame
+    AllocationCount                                     m_updateAllocations;
+    AllocationCount                                     m_renderAllocations;
+    AllocationCount                                     m_frameAllocations;
+    AllocationCount                                     m_frameStartAllocations;
+
+    // Camera path record / replay
+    static constexpr const wchar_t*                     c_cameraPathFileName = L"camera_path.bin";
+    CameraPath                                          m_cameraPath;
+    ReplayReport                                        m_replayReport;
+    std::wstring                                        m_replayFileName;
+    ReplayFrameStats                                    m_replayFrameStats;
+    uint32_t                                            m_replayFrame;
+    bool                                                m_replayFrameUpdated;
+    bool                                                m_recording;
+    bool                                                m_replaying;
+    bool                                                m_exitAfterReplay;
+    int                                                 m_replayExitCode;
+
     // Rendering options
     bool												m_renderShadow;
     bool												m_lightRotation;
@@ -213,8 +575,6 @@ private:
 
     // Shadow Map states
     DirectX::XMFLOAT4X4                                 m_shadowTransform;
-    float                                               m_lightNearZ;
-    float                                               m_lightFarZ;
     DirectX::XMFLOAT3                                   m_lightPosition;
     DirectX::XMFLOAT4X4                                 m_lightView;
     DirectX::XMFLOAT4X4                                 m_lightProj;
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> g_allocationCount = 0;
+	std::atomic<uint64_t> g_allocationBytes = 0;
+
+	thread_local uint64_t t_allocationCount = 0;
+	thread_local uint64_t t_allocationBytes = 0;
+
+	void* AllocateCounted(size_t size)
+	{
+		AllocationCounter::Add(size);
+		return malloc(size == 0 ? 1 : size);
+	}
+
+	void* AllocateCountedAligned(size_t size, std::align_val_t alignment)
+	{
+		AllocationCounter::Add(size);
+		return _aligned_malloc(size == 0 ? 1 : size, static_cast<size_t>(alignment));
+	}
+}
+
+AllocationCount AllocationCounter::GetCount()
+{
+	return { g_allocationCount.load(std::memory_order_relaxed), g_allocationBytes.load(std::memory_order_relaxed) };
+}
+
+AllocationCount AllocationCounter::GetThreadCount()
+{
+	return { t_allocationCount, t_allocationBytes };
+}
+
+void AllocationCounter::Add(size_t size)
+{
+	t_allocationCount++;
+	t_allocationBytes += size;
+	g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	g_allocationBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void* AllocationCounter::ImGuiAllocate(size_t size, void*)
+{
+	Add(size);
+	return malloc(size);
+}
+
+void AllocationCounter::ImGuiFree(void* pointer, void*)
+{
+	free(pointer);
+}
+
+// Replaced global allocation functions. Every other form forwards to these.
+void* operator new(size_t size)
+{
+	void* pointer = AllocateCounted(size);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateCounted(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateCounted(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* pointer = AllocateCountedAligned(size, alignment);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+	_aligned_free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+	_aligned_free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(pointer);
+}
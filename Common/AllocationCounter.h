@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct AllocationCount
+{
+	uint64_t	count;
+	uint64_t	bytes;
+
+	AllocationCount operator-(const AllocationCount& rhs) const { return { count - rhs.count, bytes - rhs.bytes }; }
+};
+
+// Counts heap allocations of global operator new (replaced in AllocationCounter.cpp), and of ImGui
+// once its allocator is hooked. Counters only grow, so allocations of a section are the difference
+// of counts taken around it. GetCount is process wide, GetThreadCount only the calling thread.
+class AllocationCounter
+{
+public:
+	static AllocationCount GetCount();
+	static AllocationCount GetThreadCount();
+
+	static void Add(size_t size);
+
+	// For ImGui::SetAllocatorFunctions.
+	static void* ImGuiAllocate(size_t size, void* userData);
+	static void ImGuiFree(void* pointer, void* userData);
+};
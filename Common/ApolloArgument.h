@@ -10,6 +10,12 @@ struct ApolloArgument
     BOOL FullScreenMode;
     UINT Width;
     UINT Height;
+    std::wstring ReplayFileName;    // Camera path replayed on launch, app exits when done
+    BOOL BakeFaces = FALSE;         // --bake-faces [faceSize]: bake cube face textures and exit, no window
+    UINT BakeFaceSize = 0u;         // 0 picks size from source width
+    BOOL TileTextures = FALSE;      // --tile-textures: cut color and displacement maps into tile files and exit, no window
+    std::wstring HeadlessReplayFileName;    // --replay-headless <path> [subDivideCount]: replay culling only and exit, no window
+    std::wstring CullBenchmarkFileName;     // --benchmark-cull <path> [subDivideCount]: time culling modes on fixed path and exit, no window
 
     explicit ApolloArgument(
         UINT subDivideCount = 8u,
@@ -29,6 +35,44 @@ ApolloArgument CollectApolloArgument()
     if (szArgList == nullptr)
         return arguments;
 
+    if (nArgs >= 2 && wcscmp(szArgList[1], L"--bake-faces") == 0)
+    {
+        arguments.BakeFaces = TRUE;
+        if (nArgs >= 3)
+            arguments.BakeFaceSize = static_cast<UINT>(std::stoi(szArgList[2]));
+
+        LocalFree(szArgList);
+        return arguments;
+    }
+
+    if (nArgs >= 2 && wcscmp(szArgList[1], L"--tile-textures") == 0)
+    {
+        arguments.TileTextures = TRUE;
+
+        LocalFree(szArgList);
+        return arguments;
+    }
+
+    if (nArgs >= 3 && wcscmp(szArgList[1], L"--replay-headless") == 0)
+    {
+        arguments.HeadlessReplayFileName = szArgList[2];
+        if (nArgs >= 4)
+            arguments.SubDivideCount = std::min(MAX_SUB_DIVIDE_COUNT, std::max(MIN_SUB_DIVIDE_COUNT, static_cast<UINT>(std::stoi(szArgList[3]))));
+
+        LocalFree(szArgList);
+        return arguments;
+    }
+
+    if (nArgs >= 3 && wcscmp(szArgList[1], L"--benchmark-cull") == 0)
+    {
+        arguments.CullBenchmarkFileName = szArgList[2];
+        if (nArgs >= 4)
+            arguments.SubDivideCount = std::min(MAX_SUB_DIVIDE_COUNT, std::max(MIN_SUB_DIVIDE_COUNT, static_cast<UINT>(std::stoi(szArgList[3]))));
+
+        LocalFree(szArgList);
+        return arguments;
+    }
+
     if (nArgs >= 2)
     {
         arguments.SubDivideCount = std::min(MAX_SUB_DIVIDE_COUNT, std::max(MIN_SUB_DIVIDE_COUNT, static_cast<UINT>(std::stoi(szArgList[1]))));
@@ -46,6 +90,10 @@ ApolloArgument CollectApolloArgument()
         arguments.Width = std::max(1280u, static_cast<UINT>(std::stoi(szArgList[4])));
         arguments.Height = std::max(720u, static_cast<UINT>(std::stoi(szArgList[5])));
     }
+    if (nArgs >= 7)
+    {
+        arguments.ReplayFileName = szArgList[6];
+    }
 
     if (szArgList != nullptr)
         LocalFree(szArgList);
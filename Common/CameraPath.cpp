@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "CameraPath.h"
+
+bool CameraPath::Load(const wchar_t* fileName)
+{
+	m_frames.clear();
+
+	const HANDLE file = CreateFileW(
+		fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	Header header = {};
+	DWORD read = 0;
+	bool result = ReadFile(file, &header, sizeof(Header), &read, nullptr) && read == sizeof(Header) &&
+		header.magic == c_magic && header.version == c_version && header.frameStride == sizeof(CameraFrame);
+
+	if (result)
+	{
+		m_frames.resize(header.frameCount);
+
+		const DWORD frameSize = static_cast<DWORD>(sizeof(CameraFrame) * header.frameCount);
+		result = ReadFile(file, m_frames.data(), frameSize, &read, nullptr) && read == frameSize;
+	}
+
+	CloseHandle(file);
+
+	if (!result)
+		m_frames.clear();
+
+	return result;
+}
+
+bool CameraPath::Save(const wchar_t* fileName) const
+{
+	const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	Header header = {};
+	header.magic = c_magic;
+	header.version = c_version;
+	header.frameStride = sizeof(CameraFrame);
+	header.frameCount = GetFrameCount();
+
+	const DWORD frameSize = static_cast<DWORD>(sizeof(CameraFrame) * m_frames.size());
+	DWORD written = 0;
+	bool result = WriteFile(file, &header, sizeof(Header), &written, nullptr) && written == sizeof(Header);
+	result = result && WriteFile(file, m_frames.data(), frameSize, &written, nullptr) && written == frameSize;
+	CloseHandle(file);
+
+	if (!result)
+		DeleteFileW(fileName);
+
+	return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Camera and light state of one frame, which is all Update reads from input and timer.
+struct CameraFrame
+{
+	DirectX::XMFLOAT3	position;
+	float				yaw;
+	float				pitch;
+	DirectX::XMFLOAT3	lightDirection;
+};
+
+// Recorded flight, replayed frame by frame with fixed timestep.
+// File layout is Header | CameraFrame[frameCount].
+class CameraPath
+{
+public:
+	void Clear() { m_frames.clear(); }
+	void Add(const CameraFrame& frame) { m_frames.push_back(frame); }
+
+	// Returns false if file is missing, of other version or truncated.
+	bool Load(const wchar_t* fileName);
+	bool Save(const wchar_t* fileName) const;
+
+	const CameraFrame&	GetFrame(uint32_t index) const { return m_frames[index]; }
+	uint32_t			GetFrameCount() const { return static_cast<uint32_t>(m_frames.size()); }
+
+private:
+	static constexpr uint32_t c_magic = 0x50435041;	// 'APCP'
+	static constexpr uint32_t c_version = 1;
+
+	struct Header
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	frameStride;
+		uint32_t	frameCount;
+	};
+
+	std::vector<CameraFrame>	m_frames;
+};
@@ -0,0 +1,802 @@
+#include "pch.h"
+#include "CubeFaceBaker.h"
+
+#include "DdsFormat.h"
+#include "QuadSphereGenerator.h"
+#include "TextureDecoder.h"
+#include "WorkerPool.h"
+
+#include <cfloat>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace
+{
+	enum class OutputFormat
+	{
+		BC1, BC4, R8, R16, RGBA8,
+	};
+
+	inline uint16_t ToUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	inline uint8_t ToUnorm8(float value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	inline float SrgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline float LinearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	OutputFormat SelectOutputFormat(TextureDecoder::Format source)
+	{
+		switch (source)
+		{
+		case TextureDecoder::Format::BC1:	return OutputFormat::BC1;
+		case TextureDecoder::Format::BC4:	return OutputFormat::BC4;
+		case TextureDecoder::Format::R8:	return OutputFormat::R8;
+		case TextureDecoder::Format::RGBA8:
+		case TextureDecoder::Format::BGRA8:	return OutputFormat::RGBA8;
+		default:							return OutputFormat::R16;
+		}
+	}
+
+	uint32_t GetDxgiFormat(OutputFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case OutputFormat::BC1:		return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case OutputFormat::BC4:		return DXGI_FORMAT_BC4_UNORM;
+		case OutputFormat::R8:		return DXGI_FORMAT_R8_UNORM;
+		case OutputFormat::R16:		return DXGI_FORMAT_R16_UNORM;
+		default:					return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	inline uint32_t GetChannelCount(OutputFormat format)
+	{
+		return format == OutputFormat::BC1 || format == OutputFormat::RGBA8 ? 4 : 1;
+	}
+
+	inline bool IsBlockCompressed(OutputFormat format)
+	{
+		return format == OutputFormat::BC1 || format == OutputFormat::BC4;
+	}
+
+	// Bytes of one 4x4 block, or of one texel.
+	uint32_t GetElementSize(OutputFormat format)
+	{
+		switch (format)
+		{
+		case OutputFormat::R8:		return 1;
+		case OutputFormat::R16:		return 2;
+		case OutputFormat::RGBA8:	return 4;
+		default:					return 8;
+		}
+	}
+
+	// Elements per row of a mip, blocks of 4x4 for BC formats.
+	inline uint32_t GetElementCount(OutputFormat format, uint32_t width)
+	{
+		return IsBlockCompressed(format) ? std::max((width + 3) / 4, 1u) : width;
+	}
+
+	// Equirectangular coordinates of Displace and PS of unit direction, x = theta / 2pi in [0, 1), y = phi / pi.
+	inline void ToEquirect(float x, float y, float z, OUT float& gx, OUT float& gy)
+	{
+		float theta = atan2f(z, x);
+		theta = theta < 0.0f ? XM_2PI + theta : theta;
+		gx = theta / XM_2PI;
+		gy = acosf(std::min(std::max(y, -1.0f), 1.0f)) / XM_PI;
+	}
+
+	// Cube position of face-local coordinates is origin + s * right + t * up.
+	struct FaceAxes
+	{
+		XMFLOAT3				origin;
+		XMFLOAT3				right;
+		XMFLOAT3				up;
+	};
+
+	FaceAxes GetFaceAxes(uint32_t face)
+	{
+		const XMFLOAT3 c0 = QuadSphereGenerator::GetFaceCorner(face, 0);
+		const XMFLOAT3 c1 = QuadSphereGenerator::GetFaceCorner(face, 1);
+		const XMFLOAT3 c2 = QuadSphereGenerator::GetFaceCorner(face, 2);
+
+		return { c0, { c2.x - c0.x, c2.y - c0.y, c2.z - c0.z }, { c1.x - c0.x, c1.y - c0.y, c1.z - c0.z } };
+	}
+
+	inline void GetAxesDirection(const FaceAxes& axes, float s, float t, OUT float direction[3])
+	{
+		direction[0] = axes.origin.x + s * axes.right.x + t * axes.up.x;
+		direction[1] = axes.origin.y + s * axes.right.y + t * axes.up.y;
+		direction[2] = axes.origin.z + s * axes.right.z + t * axes.up.z;
+
+		const float invLength = 1.0f / sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		direction[0] *= invLength;
+		direction[1] *= invLength;
+		direction[2] *= invLength;
+	}
+
+	// Both halves of a map in linear space, channels interleaved, as 16-bit unorm.
+	// Mips are box filtered from level 0 down to 1x1, the ones of files aren't used as they may be filtered in sRGB.
+	class EquirectSource
+	{
+	public:
+		bool Load(const TextureDecoder (&decoders)[2], uint32_t channelCount, bool srgb, WorkerPool& pool);
+
+		uint32_t GetWidth() const { return m_levels[0].width; }
+		uint32_t GetHeight() const { return m_levels[0].height; }
+		uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+		uint32_t GetChannelCount() const { return m_channelCount; }
+
+		// Mip whose texels cover texel footprint of face, given by equirectangular coordinates of
+		// center and of a step along s and t.
+		uint32_t CalcLevel(float gx, float gy, float gxS, float gyS, float gxT, float gyT) const;
+
+		// SampleLevel at equirectangular coordinates, left or right half as PS picks it, added to sum.
+		void Sample(float gx, float gy, uint32_t level, IN OUT float* sum) const;
+
+	private:
+		struct Level
+		{
+			uint32_t				width;
+			uint32_t				height;
+			std::vector<uint16_t>	texels[2];		// Left and right halves
+		};
+
+		std::vector<Level>			m_levels;
+		uint32_t					m_channelCount = 1;
+	};
+
+	bool EquirectSource::Load(const TextureDecoder (&decoders)[2], uint32_t channelCount, bool srgb, WorkerPool& pool)
+	{
+		m_levels.clear();
+		m_channelCount = channelCount;
+
+		const uint32_t width = decoders[0].GetWidth();
+		const uint32_t height = decoders[0].GetHeight();
+		if (width == 0 || height == 0 || decoders[1].GetWidth() != width || decoders[1].GetHeight() != height)
+			return false;
+
+		m_levels.push_back({ width, height });
+		const size_t rowSize = static_cast<size_t>(width) * channelCount;
+		for (uint32_t half = 0; half < 2; half++)
+		{
+			const TextureDecoder& decoder = decoders[half];
+			std::vector<uint16_t>& texels = m_levels[0].texels[half];
+			texels.resize(rowSize * height);
+
+			pool.Dispatch(decoder.GetStripCount(), [&](uint32_t strip)
+			{
+				std::vector<float> rows(static_cast<size_t>(width) * 4 * TextureDecoder::c_stripHeight);
+				if (channelCount == 4)
+					decoder.DecodeStripRGBA(strip, rows.data());
+				else
+					decoder.DecodeStrip(strip, rows.data());
+
+				const uint32_t y0 = strip * TextureDecoder::c_stripHeight;
+				const size_t count = std::min(TextureDecoder::c_stripHeight, height - y0) * rowSize;
+				uint16_t* dest = &texels[y0 * rowSize];
+				for (size_t i = 0; i < count; i++)
+				{
+					// Alpha is linear.
+					const bool color = srgb && i % 4 != 3;
+					dest[i] = ToUnorm16(color ? SrgbToLinear(rows[i]) : rows[i]);
+				}
+			});
+		}
+
+		// 2x2 box of finer level, edge texels repeated for odd sizes.
+		while (m_levels.back().width > 1 || m_levels.back().height > 1)
+		{
+			const Level& fine = m_levels.back();
+			Level coarse = { std::max(fine.width / 2, 1u), std::max(fine.height / 2, 1u) };
+
+			for (uint32_t half = 0; half < 2; half++)
+			{
+				const uint16_t* src = fine.texels[half].data();
+				std::vector<uint16_t>& dst = coarse.texels[half];
+				dst.resize(static_cast<size_t>(coarse.width) * coarse.height * channelCount);
+
+				pool.Dispatch(coarse.height, [&](uint32_t y)
+				{
+					const size_t row0 = static_cast<size_t>(std::min(2 * y, fine.height - 1)) * fine.width;
+					const size_t row1 = static_cast<size_t>(std::min(2 * y + 1, fine.height - 1)) * fine.width;
+					for (uint32_t x = 0; x < coarse.width; x++)
+					{
+						const uint32_t x0 = std::min(2 * x, fine.width - 1);
+						const uint32_t x1 = std::min(2 * x + 1, fine.width - 1);
+						for (uint32_t c = 0; c < channelCount; c++)
+						{
+							const uint32_t sum =
+								src[(row0 + x0) * channelCount + c] + src[(row0 + x1) * channelCount + c] +
+								src[(row1 + x0) * channelCount + c] + src[(row1 + x1) * channelCount + c];
+							dst[(static_cast<size_t>(y) * coarse.width + x) * channelCount + c] = static_cast<uint16_t>((sum + 2) / 4);
+						}
+					}
+				});
+			}
+
+			m_levels.push_back(std::move(coarse));
+		}
+
+		return true;
+	}
+
+	uint32_t EquirectSource::CalcLevel(float gx, float gy, float gxS, float gyS, float gxT, float gyT) const
+	{
+		// Texels of both halves along x, theta wraps at 0 and 1.
+		const float scaleX = 2.0f * GetWidth();
+		const float scaleY = static_cast<float>(GetHeight());
+		const float dxS = (gxS - gx - roundf(gxS - gx)) * scaleX;
+		const float dyS = (gyS - gy) * scaleY;
+		const float dxT = (gxT - gx - roundf(gxT - gx)) * scaleX;
+		const float dyT = (gyT - gy) * scaleY;
+
+		// Area of footprint rather than its longest side, which near poles would blur along theta only.
+		const float area = fabsf(dxS * dyT - dyS * dxT);
+		if (area <= 1.0f)
+			return 0;
+
+		return std::min(static_cast<uint32_t>(0.5f * log2f(area)), GetLevelCount() - 1);
+	}
+
+	void EquirectSource::Sample(float gx, float gy, uint32_t level, float* sum) const
+	{
+		// round() of HLSL is to nearest even, so theta of exactly pi is on left half.
+		const uint32_t half = gx > 0.5f ? 1 : 0;
+		const float u = std::min(std::max(half == 0 ? gx * 2.0f : (gx - 0.5f) * 2.0f, 0.0f), 1.0f);
+
+		const Level& source = m_levels[level];
+		const uint16_t* texels = source.texels[half].data();
+
+		// Texel centers are at half texels, clamp addressing repeats edge texels.
+		const float x = u * source.width - 0.5f;
+		const float y = gy * source.height - 0.5f;
+		const float floorX = floorf(x);
+		const float floorY = floorf(y);
+		const float ax = x - floorX;
+		const float ay = y - floorY;
+
+		const int maxX = static_cast<int>(source.width) - 1;
+		const int maxY = static_cast<int>(source.height) - 1;
+		const size_t x0 = std::min(std::max(static_cast<int>(floorX), 0), maxX);
+		const size_t x1 = std::min(std::max(static_cast<int>(floorX) + 1, 0), maxX);
+		const size_t row0 = static_cast<size_t>(std::min(std::max(static_cast<int>(floorY), 0), maxY)) * source.width;
+		const size_t row1 = static_cast<size_t>(std::min(std::max(static_cast<int>(floorY) + 1, 0), maxY)) * source.width;
+
+		const float w00 = (1.0f - ax) * (1.0f - ay) / 65535.0f;
+		const float w01 = ax * (1.0f - ay) / 65535.0f;
+		const float w10 = (1.0f - ax) * ay / 65535.0f;
+		const float w11 = ax * ay / 65535.0f;
+		for (uint32_t c = 0; c < m_channelCount; c++)
+		{
+			sum[c] +=
+				w00 * texels[(row0 + x0) * m_channelCount + c] + w01 * texels[(row0 + x1) * m_channelCount + c] +
+				w10 * texels[(row1 + x0) * m_channelCount + c] + w11 * texels[(row1 + x1) * m_channelCount + c];
+		}
+	}
+
+	// First mip of a face, faceSize rows baked on pool.
+	void BakeFirstLevel(const EquirectSource& source, uint32_t face, uint32_t faceSize, WorkerPool& pool, OUT std::vector<float>& texels)
+	{
+		const FaceAxes axes = GetFaceAxes(face);
+		const uint32_t channelCount = source.GetChannelCount();
+		texels.resize(static_cast<size_t>(faceSize) * faceSize * channelCount);
+
+		const uint32_t sampleCount = CUBE_FACE_SUPERSAMPLE;
+		const float step = 1.0f / (faceSize * sampleCount);
+		const float weight = 1.0f / (sampleCount * sampleCount);
+
+		pool.Dispatch(faceSize, [&](uint32_t y)
+		{
+			float direction[3];
+			for (uint32_t x = 0; x < faceSize; x++)
+			{
+				// Footprint of one sample, at texel center.
+				const float s = (x + 0.5f) / faceSize;
+				const float t = (y + 0.5f) / faceSize;
+				float gx, gy, gxS, gyS, gxT, gyT;
+				GetAxesDirection(axes, s, t, direction);
+				ToEquirect(direction[0], direction[1], direction[2], gx, gy);
+				GetAxesDirection(axes, s + step, t, direction);
+				ToEquirect(direction[0], direction[1], direction[2], gxS, gyS);
+				GetAxesDirection(axes, s, t + step, direction);
+				ToEquirect(direction[0], direction[1], direction[2], gxT, gyT);
+				const uint32_t level = source.CalcLevel(gx, gy, gxS, gyS, gxT, gyT);
+
+				float sum[4] = {};
+				for (uint32_t sy = 0; sy < sampleCount; sy++)
+				{
+					for (uint32_t sx = 0; sx < sampleCount; sx++)
+					{
+						GetAxesDirection(axes, (x * sampleCount + sx + 0.5f) * step, (y * sampleCount + sy + 0.5f) * step, direction);
+						ToEquirect(direction[0], direction[1], direction[2], gx, gy);
+						source.Sample(gx, gy, level, sum);
+					}
+				}
+
+				float* dest = &texels[(static_cast<size_t>(y) * faceSize + x) * channelCount];
+				for (uint32_t c = 0; c < channelCount; c++)
+					dest[c] = sum[c] * weight;
+			}
+		});
+	}
+
+	// 2x2 box of a level of width x width texels, width even.
+	void Downsample(const std::vector<float>& fine, uint32_t width, uint32_t channelCount, OUT std::vector<float>& coarse)
+	{
+		const uint32_t coarseWidth = width / 2;
+		coarse.resize(static_cast<size_t>(coarseWidth) * coarseWidth * channelCount);
+
+		for (uint32_t y = 0; y < coarseWidth; y++)
+		{
+			const float* row0 = &fine[static_cast<size_t>(2 * y) * width * channelCount];
+			const float* row1 = row0 + static_cast<size_t>(width) * channelCount;
+			for (uint32_t x = 0; x < coarseWidth; x++)
+			{
+				for (uint32_t c = 0; c < channelCount; c++)
+				{
+					const size_t i0 = static_cast<size_t>(2 * x) * channelCount + c;
+					const size_t i1 = i0 + channelCount;
+					coarse[(static_cast<size_t>(y) * coarseWidth + x) * channelCount + c] = 0.25f * (row0[i0] + row0[i1] + row1[i0] + row1[i1]);
+				}
+			}
+		}
+	}
+
+	uint16_t Pack565(const float rgb[3])
+	{
+		const auto r = static_cast<uint16_t>(std::min(std::max(rgb[0], 0.0f), 1.0f) * 31.0f + 0.5f);
+		const auto g = static_cast<uint16_t>(std::min(std::max(rgb[1], 0.0f), 1.0f) * 63.0f + 0.5f);
+		const auto b = static_cast<uint16_t>(std::min(std::max(rgb[2], 0.0f), 1.0f) * 31.0f + 0.5f);
+
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint16_t color, float rgb[3])
+	{
+		rgb[0] = static_cast<float>((color >> 11) & 0x1F) / 31.0f;
+		rgb[1] = static_cast<float>((color >> 5) & 0x3F) / 63.0f;
+		rgb[2] = static_cast<float>(color & 0x1F) / 31.0f;
+	}
+
+	// Four color mode with endpoints at extreme projections of block colors on their principal axis.
+	void EncodeBC1Block(const float colors[16][3], OUT uint8_t* block)
+	{
+		float mean[3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+				mean[c] += colors[i][c] / 16.0f;
+		}
+
+		// Covariance, rr rg rb gg gb bb.
+		float cov[6] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			const float d[3] = { colors[i][0] - mean[0], colors[i][1] - mean[1], colors[i][2] - mean[2] };
+			cov[0] += d[0] * d[0];
+			cov[1] += d[0] * d[1];
+			cov[2] += d[0] * d[2];
+			cov[3] += d[1] * d[1];
+			cov[4] += d[1] * d[2];
+			cov[5] += d[2] * d[2];
+		}
+
+		// Power iteration from row of channel with largest variance.
+		float axis[3];
+		if (cov[0] >= cov[3] && cov[0] >= cov[5])
+			axis[0] = cov[0], axis[1] = cov[1], axis[2] = cov[2];
+		else if (cov[3] >= cov[5])
+			axis[0] = cov[1], axis[1] = cov[3], axis[2] = cov[4];
+		else
+			axis[0] = cov[2], axis[1] = cov[4], axis[2] = cov[5];
+
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			const float next[3] =
+			{
+				cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+				cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+				cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+			};
+			const float scale = std::max(std::max(fabsf(next[0]), fabsf(next[1])), fabsf(next[2]));
+			if (scale < FLT_EPSILON)
+				break;
+
+			for (int c = 0; c < 3; c++)
+				axis[c] = next[c] / scale;
+		}
+
+		// Uniform block leaves axis at zero, both endpoints at mean.
+		const float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		const float invLength = lengthSq > FLT_EPSILON ? 1.0f / sqrtf(lengthSq) : 0.0f;
+		float minT = 0.0f, maxT = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 3; c++)
+				t += (colors[i][c] - mean[c]) * axis[c] * invLength;
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+
+		float end0[3], end1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			end0[c] = mean[c] + axis[c] * invLength * maxT;
+			end1[c] = mean[c] + axis[c] * invLength * minT;
+		}
+
+		uint16_t color0 = Pack565(end0);
+		uint16_t color1 = Pack565(end1);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		// Equal endpoints are three color mode, where index 0 is still color0.
+		uint32_t bits = 0;
+		if (color0 != color1)
+		{
+			float palette[4][3];
+			Unpack565(color0, palette[0]);
+			Unpack565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				float bestDistance = FLT_MAX;
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					float distance = 0.0f;
+					for (int c = 0; c < 3; c++)
+						distance += (colors[i][c] - palette[p][c]) * (colors[i][c] - palette[p][c]);
+					if (distance < bestDistance)
+					{
+						best = p;
+						bestDistance = distance;
+					}
+				}
+				bits |= best << (2 * i);
+			}
+		}
+
+		memcpy(block, &color0, sizeof(uint16_t));
+		memcpy(block + 2, &color1, sizeof(uint16_t));
+		memcpy(block + 4, &bits, sizeof(uint32_t));
+	}
+
+	// Eight value mode between block min and max.
+	void EncodeBC4Block(const float values[16], OUT uint8_t* block)
+	{
+		float minValue = values[0], maxValue = values[0];
+		for (int i = 1; i < 16; i++)
+		{
+			minValue = std::min(minValue, values[i]);
+			maxValue = std::max(maxValue, values[i]);
+		}
+
+		block[0] = ToUnorm8(maxValue);
+		block[1] = ToUnorm8(minValue);
+
+		uint64_t bits = 0;
+		if (block[0] > block[1])
+		{
+			const float r0 = block[0] / 255.0f;
+			const float r1 = block[1] / 255.0f;
+			float palette[8] = { r0, r1 };
+			for (int i = 1; i < 7; i++)
+				palette[i + 1] = ((7 - i) * r0 + i * r1) / 7.0f;
+
+			for (int i = 0; i < 16; i++)
+			{
+				uint64_t best = 0;
+				float bestDistance = FLT_MAX;
+				for (uint32_t p = 0; p < 8; p++)
+				{
+					const float distance = fabsf(values[i] - palette[p]);
+					if (distance < bestDistance)
+					{
+						best = p;
+						bestDistance = distance;
+					}
+				}
+				bits |= best << (3 * i);
+			}
+		}
+
+		for (int i = 0; i < 6; i++)
+			block[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+
+	// Linear texels of a level to output format, block rows (or rows) encoded on pool.
+	void EncodeLevel(
+		const std::vector<float>& texels, uint32_t width, uint32_t channelCount, OutputFormat format, bool srgb,
+		WorkerPool& pool, OUT std::vector<uint8_t>& out)
+	{
+		const uint32_t elementSize = GetElementSize(format);
+		const uint32_t elementCount = GetElementCount(format, width);
+		const size_t rowPitch = static_cast<size_t>(elementCount) * elementSize;
+		out.resize(rowPitch * elementCount);
+
+		const auto encodeTexel = [&](size_t texel, uint32_t c)
+		{
+			const float value = texels[texel * channelCount + c];
+			return srgb && c != 3 ? LinearToSrgb(value) : value;
+		};
+
+		pool.Dispatch(elementCount, [&](uint32_t row)
+		{
+			uint8_t* dest = &out[row * rowPitch];
+			if (!IsBlockCompressed(format))
+			{
+				const size_t first = static_cast<size_t>(row) * width;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					if (format == OutputFormat::R16)
+					{
+						const uint16_t value = ToUnorm16(texels[first + x]);
+						memcpy(dest + 2 * x, &value, sizeof(uint16_t));
+					}
+					else
+					{
+						for (uint32_t c = 0; c < channelCount; c++)
+							dest[x * channelCount + c] = ToUnorm8(encodeTexel(first + x, c));
+					}
+				}
+				return;
+			}
+
+			// Mips under 4x4 repeat edge texels over the block.
+			for (uint32_t blockX = 0; blockX < elementCount; blockX++)
+			{
+				float colors[16][3];
+				float values[16];
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					const uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+					const uint32_t y = std::min(row * 4 + i / 4, width - 1);
+					const size_t texel = static_cast<size_t>(y) * width + x;
+					if (format == OutputFormat::BC1)
+					{
+						for (uint32_t c = 0; c < 3; c++)
+							colors[i][c] = encodeTexel(texel, c);
+					}
+					else
+					{
+						values[i] = texels[texel];
+					}
+				}
+
+				if (format == OutputFormat::BC1)
+					EncodeBC1Block(colors, dest + blockX * elementSize);
+				else
+					EncodeBC4Block(values, dest + blockX * elementSize);
+			}
+		});
+	}
+
+	bool WriteData(HANDLE file, const void* data, size_t size)
+	{
+		DWORD written = 0;
+		return WriteFile(file, data, static_cast<DWORD>(size), &written, nullptr) && written == size;
+	}
+}
+
+XMFLOAT3 CubeFaceBaker::GetDirection(uint32_t face, float s, float t)
+{
+	float direction[3];
+	GetAxesDirection(GetFaceAxes(face), s, t, direction);
+
+	return XMFLOAT3(direction[0], direction[1], direction[2]);
+}
+
+void CubeFaceBaker::FindFace(const XMFLOAT3& direction, uint32_t& face, float& s, float& t)
+{
+	// Face normal is center of its cube face, the one of largest projection is hit first.
+	float bestDot = -FLT_MAX;
+	FaceAxes axes = {};
+	face = 0;
+	for (uint32_t f = 0; f < CUBE_FACE_COUNT; f++)
+	{
+		const FaceAxes candidate = GetFaceAxes(f);
+		const float normal[3] =
+		{
+			candidate.origin.x + 0.5f * (candidate.right.x + candidate.up.x),
+			candidate.origin.y + 0.5f * (candidate.right.y + candidate.up.y),
+			candidate.origin.z + 0.5f * (candidate.right.z + candidate.up.z),
+		};
+		const float dot = direction.x * normal[0] + direction.y * normal[1] + direction.z * normal[2];
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			axes = candidate;
+			face = f;
+		}
+	}
+
+	// Point of direction on face plane, at unit distance along normal.
+	const float scale = bestDot > FLT_MIN ? 1.0f / bestDot : 0.0f;
+	const float p[3] =
+	{
+		direction.x * scale - axes.origin.x, direction.y * scale - axes.origin.y, direction.z * scale - axes.origin.z,
+	};
+	const float rightLengthSq = axes.right.x * axes.right.x + axes.right.y * axes.right.y + axes.right.z * axes.right.z;
+	const float upLengthSq = axes.up.x * axes.up.x + axes.up.y * axes.up.y + axes.up.z * axes.up.z;
+
+	s = std::min(std::max((p[0] * axes.right.x + p[1] * axes.right.y + p[2] * axes.right.z) / rightLengthSq, 0.0f), 1.0f);
+	t = std::min(std::max((p[0] * axes.up.x + p[1] * axes.up.y + p[2] * axes.up.z) / upLengthSq, 0.0f), 1.0f);
+}
+
+uint32_t CubeFaceBaker::CalcFaceSize(uint32_t sourceWidth)
+{
+	uint32_t size = 4;
+	while (size * 2 <= sourceWidth / 2)
+		size *= 2;
+
+	return size;
+}
+
+bool CubeFaceBaker::Bake(
+	const wchar_t* leftFileName, const wchar_t* rightFileName, const wchar_t* outFileName,
+	uint32_t faceSize, WorkerPool& pool, CubeFaceBakeStats& stats)
+{
+	stats = {};
+	const auto decodeStart = std::chrono::high_resolution_clock::now();
+
+	OutputFormat format;
+	bool srgb;
+	EquirectSource source;
+	{
+		TextureDecoder decoders[2];
+		if (!decoders[0].Load(leftFileName) || !decoders[1].Load(rightFileName) ||
+			decoders[0].GetSourceFormat() != decoders[1].GetSourceFormat())
+			return false;
+
+		format = SelectOutputFormat(decoders[0].GetSourceFormat());
+		srgb = decoders[0].IsSrgb() && GetChannelCount(format) == 4;
+		if (!source.Load(decoders, GetChannelCount(format), srgb, pool))
+			return false;
+	}
+
+	const auto bakeStart = std::chrono::high_resolution_clock::now();
+
+	if (faceSize == 0)
+		faceSize = CalcFaceSize(source.GetWidth());
+	uint32_t mipCount = 1;
+	while ((2u << (mipCount - 1)) <= faceSize)
+		mipCount++;
+	faceSize = 1u << (mipCount - 1);
+
+	const HANDLE file = CreateFileW(outFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Texture array of faces, not a cube map: face orientations follow face tree, not D3D cube faces.
+	const uint32_t elementCount = GetElementCount(format, faceSize);
+	Dds::Header header = {};
+	header.size = sizeof(Dds::Header);
+	header.flags = Dds::c_headerCaps | Dds::c_headerHeight | Dds::c_headerWidth | Dds::c_headerPixelFormat | Dds::c_headerMipMapCount |
+		(IsBlockCompressed(format) ? Dds::c_headerLinearSize : Dds::c_headerPitch);
+	header.height = faceSize;
+	header.width = faceSize;
+	header.pitchOrLinearSize = elementCount * GetElementSize(format) * (IsBlockCompressed(format) ? elementCount : 1);
+	header.depth = 1;
+	header.mipMapCount = mipCount;
+	header.ddspf.size = sizeof(Dds::PixelFormat);
+	header.ddspf.flags = Dds::c_pixelFourCC;
+	header.ddspf.fourCC = Dds::MakeFourCC('D', 'X', '1', '0');
+	header.caps = Dds::c_capsTexture | (mipCount > 1 ? Dds::c_capsComplex | Dds::c_capsMipMap : 0);
+
+	Dds::HeaderDXT10 header10 = {};
+	header10.dxgiFormat = GetDxgiFormat(format, srgb);
+	header10.resourceDimension = Dds::c_dimensionTexture2D;
+	header10.arraySize = CUBE_FACE_COUNT;
+
+	bool written = WriteData(file, &Dds::c_magic, sizeof(Dds::c_magic)) &&
+		WriteData(file, &header, sizeof(header)) && WriteData(file, &header10, sizeof(header10));
+	stats.outputBytes = sizeof(Dds::c_magic) + sizeof(header) + sizeof(header10);
+
+	// Mips of a slice are contiguous, slices one after another.
+	const uint32_t channelCount = source.GetChannelCount();
+	std::vector<float> level, coarse;
+	std::vector<uint8_t> encoded;
+	for (uint32_t face = 0; face < CUBE_FACE_COUNT && written; face++)
+	{
+		BakeFirstLevel(source, face, faceSize, pool, level);
+
+		uint32_t width = faceSize;
+		for (uint32_t mip = 0; mip < mipCount && written; mip++)
+		{
+			EncodeLevel(level, width, channelCount, format, srgb, pool, encoded);
+			written = WriteData(file, encoded.data(), encoded.size());
+			stats.outputBytes += encoded.size();
+
+			if (mip + 1 < mipCount)
+			{
+				Downsample(level, width, channelCount, coarse);
+				level.swap(coarse);
+				width /= 2;
+			}
+		}
+	}
+
+	CloseHandle(file);
+	if (!written)
+	{
+		DeleteFileW(outFileName);
+		return false;
+	}
+
+	const auto bakeEnd = std::chrono::high_resolution_clock::now();
+
+	stats.faceSize = faceSize;
+	stats.mipCount = mipCount;
+	stats.format = header10.dxgiFormat;
+	stats.sourceTexelCount = 2ull * source.GetWidth() * source.GetHeight();
+	stats.faceTexelCount = static_cast<uint64_t>(CUBE_FACE_COUNT) * faceSize * faceSize;
+	stats.decodeTime = std::chrono::duration<float, std::milli>(bakeStart - decodeStart).count();
+	stats.bakeTime = std::chrono::duration<float, std::milli>(bakeEnd - bakeStart).count();
+
+	return true;
+}
+
+bool CubeFaceBaker::BakeTextures(uint32_t faceSize)
+{
+	struct BakeJob
+	{
+		const wchar_t*		left;
+		const wchar_t*		right;
+		const wchar_t*		out;
+		const char*			name;
+	};
+
+	static const BakeJob jobs[] =
+	{
+		{ L"Textures\\colormap_l.dds", L"Textures\\colormap_r.dds", L"Textures\\colormap_faces.dds", "colormap" },
+		{ L"Textures\\displacement_l.dds", L"Textures\\displacement_r.dds", L"Textures\\displacement_faces.dds", "displacement" },
+	};
+
+	WorkerPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+
+	bool succeeded = true;
+	for (const BakeJob& job : jobs)
+	{
+		CubeFaceBakeStats stats;
+		const bool baked = Bake(job.left, job.right, job.out, faceSize, pool, stats);
+		succeeded = succeeded && baked;
+
+		char line[256];
+		if (baked)
+		{
+			snprintf(line, sizeof(line),
+				"CubeFaceBaker: %s, %u^2 x %u faces, %u mips, format %u, %.1f MB from %.1f Mtexels, decode %.0f ms, bake %.0f ms\n",
+				job.name, stats.faceSize, CUBE_FACE_COUNT, stats.mipCount, stats.format, stats.outputBytes / (1024.0 * 1024.0),
+				stats.sourceTexelCount / 1e6, stats.decodeTime, stats.bakeTime);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "CubeFaceBaker: %s failed\n", job.name);
+		}
+		OutputDebugStringA(line);
+	}
+
+	return succeeded;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+class WorkerPool;
+
+#define CUBE_FACE_COUNT 6u
+#define CUBE_FACE_SUPERSAMPLE 4u		// Source samples per side of one texel of first mip
+
+struct CubeFaceBakeStats
+{
+	uint32_t				faceSize;
+	uint32_t				mipCount;
+	uint32_t				format;				// DXGI_FORMAT of output
+	uint64_t				sourceTexelCount;	// Both halves, first mip
+	uint64_t				faceTexelCount;		// Six faces, first mip
+	uint64_t				outputBytes;		// Headers, every face and mip
+	float					decodeTime;			// Milliseconds
+	float					bakeTime;
+};
+
+// Offline reprojection of equirectangular maps (left and right halves, mapped as DS and PS sample them)
+// onto the six faces of quad sphere, so a face is read at face-local coordinates with no trigonometry.
+//
+// Face-local (s, t) in [0, 1]^2 is cube position corner 0 + s * (corner 2 - corner 0) + t * (corner 1 - corner 0)
+// of QuadSphereGenerator::GetFaceCorner, the same axes as face grid. Texel (x, y) of a face of size N covers
+// [x, x + 1] / N in s and [y, y + 1] / N in t.
+// A face of a quarter of equator texels keeps equator detail in 3/4 of the texels of both halves,
+// and spends them evenly instead of at the poles.
+//
+// First mip averages CUBE_FACE_SUPERSAMPLE^2 bilinear samples per texel, from source mip of texel footprint.
+// Filtering is done in linear space for sRGB sources. Finer mips are box filtered, each face on its own.
+// Output is one DDS with a 2D texture array of six slices in face tree order and full mip chains,
+// in the format family of source: BC1, BC4, R8, R16 (also for R32F) or R8G8B8A8.
+namespace CubeFaceBaker
+{
+	// Unit direction of face-local coordinates.
+	DirectX::XMFLOAT3 GetDirection(uint32_t face, float s, float t);
+
+	// Face whose plane direction crosses first, and face-local coordinates there.
+	void FindFace(IN const DirectX::XMFLOAT3& direction, OUT uint32_t& face, OUT float& s, OUT float& t);
+
+	// Largest power of two not above a quarter of equator texels, 2 * sourceWidth / 4.
+	uint32_t CalcFaceSize(uint32_t sourceWidth);
+
+	// Bake one pair of halves. faceSize 0 uses CalcFaceSize, others are rounded down to a power of two.
+	// Rows of every face are baked and encoded on pool. Returns false if sources can't be decoded or output written.
+	bool Bake(
+		const wchar_t* leftFileName, const wchar_t* rightFileName, const wchar_t* outFileName,
+		uint32_t faceSize, WorkerPool& pool, OUT CubeFaceBakeStats& stats);
+
+	// Color and displacement maps of Textures directory, to colormap_faces.dds and displacement_faces.dds.
+	// Summary of each is written to debug output.
+	bool BakeTextures(uint32_t faceSize);
+}
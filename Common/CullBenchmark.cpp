@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "CullBenchmark.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+CullBenchmark::CullBenchmark(IN const std::vector<FaceTree*>& faceTrees, WorkerPool& workerPool, IN const BoundingSphere& sceneBounds)
+	: m_workerPool(workerPool),
+	m_backend(false),
+	m_replay(faceTrees, workerPool, m_backend, 16.0f / 9.0f, sceneBounds),
+	m_path(CreatePath(c_frameCount, sceneBounds.Radius))
+{
+	m_times.reserve(c_frameCount);
+}
+
+void CullBenchmark::Run(const char* name, IN const SceneCullOptions& options)
+{
+	m_replay.Reset();
+	m_times.clear();
+
+	double indexCount = 0.0;
+	double shadowIndexCount = 0.0;
+	for (uint32_t frame = 0; frame < m_path.GetFrameCount(); frame++)
+	{
+		const ReplayFrameStats stats = m_replay.RunFrame(m_path.GetFrame(frame), options);
+		if (frame < ReplayReport::c_warmUpFrameCount)
+			continue;
+
+		m_times.push_back(stats.cullingTime);
+		indexCount += static_cast<double>(stats.indexCount);
+		shadowIndexCount += static_cast<double>(stats.shadowIndexCount);
+	}
+
+	std::sort(m_times.begin(), m_times.end());
+
+	Result result = {};
+	result.name = name;
+	result.p50 = ReplayReport::Percentile(m_times, 50.0f);
+	result.p95 = ReplayReport::Percentile(m_times, 95.0f);
+	result.max = m_times.empty() ? 0.0f : m_times.back();
+	result.indexCount = m_times.empty() ? 0.0 : indexCount / m_times.size();
+	result.shadowIndexCount = m_times.empty() ? 0.0 : shadowIndexCount / m_times.size();
+	m_results.push_back(result);
+}
+
+void CullBenchmark::RunAll()
+{
+	// DirectXCollision tests on one thread, camera view alone and with light view.
+	Run("scalar camera", { false, false, false, false, 1 });
+	Run("scalar camera+light", { false, false, false, true, 1 });
+
+	// Four siblings per plane test, same views and thread.
+	Run("simd camera", { true, false, false, false, 1 });
+	Run("simd camera+light", { true, false, false, true, 1 });
+
+	// Subtree tasks spread over 2, 4, ... and every worker thread.
+	for (uint32_t threadCount = 2; threadCount / 2 < m_workerPool.GetThreadCount(); threadCount *= 2)
+	{
+		const uint32_t activeThreadCount = std::min(threadCount, m_workerPool.GetThreadCount());
+
+		char name[64];
+		sprintf_s(name, "simd camera+light x%u", activeThreadCount);
+		Run(name, { true, false, false, true, activeThreadCount });
+	}
+
+	// Patches behind sphere from camera and light rejected before plane test, on one thread.
+	Run("simd camera horizon", { true, true, false, false, 1 });
+	Run("simd camera+light horizon", { true, true, false, true, 1 });
+}
+
+std::string CullBenchmark::ToText() const
+{
+	std::string out;
+	char line[256];
+	sprintf_s(line, "%u frames (%u warm-up not counted), %u worker threads\n",
+		m_path.GetFrameCount(), ReplayReport::c_warmUpFrameCount, m_workerPool.GetThreadCount());
+	out += line;
+	sprintf_s(line, "%-24s %10s %10s %10s %14s %14s\n", "mode", "p50 us", "p95 us", "max us", "indices", "shadow indices");
+	out += line;
+
+	for (const Result& result : m_results)
+	{
+		sprintf_s(line, "%-24s %10.1f %10.1f %10.1f %14.0f %14.0f\n",
+			result.name.c_str(), result.p50, result.p95, result.max, result.indexCount, result.shadowIndexCount);
+		out += line;
+	}
+
+	return out;
+}
+
+bool CullBenchmark::Save(const wchar_t* fileName) const
+{
+	const std::string text = ToText();
+
+	const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	const BOOL result = WriteFile(file, text.data(), static_cast<DWORD>(text.size()), &written, nullptr);
+	CloseHandle(file);
+
+	return result && written == text.size();
+}
+
+CameraPath CullBenchmark::CreatePath(uint32_t frameCount, float sceneRadius)
+{
+	CameraPath path;
+	for (uint32_t f = 0; f < frameCount; f++)
+	{
+		const float t = static_cast<float>(f) / static_cast<float>(frameCount);
+		const float angle = XM_2PI * t;
+		const float distance = sceneRadius * (3.0f - 1.95f * t);
+
+		// Looking at sphere center from far away, and more and more toward horizon on the way down.
+		CameraFrame frame = {};
+		frame.position = XMFLOAT3(-distance * sinf(angle), 0.3f * distance, -distance * cosf(angle));
+		frame.yaw = angle;
+		frame.pitch = 0.3f * (1.0f - t);
+		frame.lightDirection = XMFLOAT3(cosf(3.0f + angle), 0.0f, -sinf(3.0f + angle));
+		path.Add(frame);
+	}
+
+	return path;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "HeadlessReplay.h"
+#include "RecordingBackend.h"
+
+// Cull time per frame of culling modes over one fixed camera path, so modes and builds are compared on
+// the same frames. Each mode replays whole path through HeadlessReplay, and warm-up frames are not counted.
+class CullBenchmark
+{
+public:
+	static constexpr uint32_t c_frameCount = 600;
+
+	CullBenchmark(IN const std::vector<FaceTree*>& faceTrees, WorkerPool& workerPool, IN const DirectX::BoundingSphere& sceneBounds);
+
+	CullBenchmark(const CullBenchmark&) = delete;
+	CullBenchmark& operator=(const CullBenchmark&) = delete;
+
+	// Replay path with options, and keep cull time of its frames under name.
+	void Run(const char* name, IN const SceneCullOptions& options);
+
+	// Every mode culling has.
+	void RunAll();
+
+	// One line per mode: p50/p95/max cull time in microseconds, and mean camera and shadow index count.
+	std::string ToText() const;
+	bool Save(const wchar_t* fileName) const;
+
+	// Camera circling sphere while coming down from far away to just above surface, under a turning light.
+	static CameraPath CreatePath(uint32_t frameCount, float sceneRadius);
+
+private:
+	struct Result
+	{
+		std::string					name;
+		float						p50;
+		float						p95;
+		float						max;
+		double						indexCount;
+		double						shadowIndexCount;
+	};
+
+	WorkerPool&						m_workerPool;
+	RecordingBackend				m_backend;
+	HeadlessReplay					m_replay;
+	CameraPath						m_path;
+
+	std::vector<float>				m_times;
+	std::vector<Result>				m_results;
+};
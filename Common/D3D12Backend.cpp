@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "D3D12Backend.h"
+
+namespace
+{
+	D3D12_RESOURCE_STATES ToResourceState(BufferState state)
+	{
+		switch (state)
+		{
+		case BufferState::COPY_DEST:			return D3D12_RESOURCE_STATE_COPY_DEST;
+		case BufferState::INDIRECT_ARGUMENT:	return D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+		default:								return D3D12_RESOURCE_STATE_COMMON;
+		}
+	}
+}
+
+D3D12Backend::D3D12Backend(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, IDXGISwapChain3* swapChain)
+{
+	m_device = device;
+	m_commandList = commandList;
+	m_swapChain = swapChain;
+
+	// One indexed draw per argument.
+	D3D12_INDIRECT_ARGUMENT_DESC argumentDesc = {};
+	argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+	signatureDesc.NumArgumentDescs = 1;
+	signatureDesc.pArgumentDescs = &argumentDesc;
+
+	DX::ThrowIfFailed(
+		m_device->CreateCommandSignature(
+			&signatureDesc, nullptr, IID_PPV_ARGS(m_drawSignature.ReleaseAndGetAddressOf())));
+}
+
+BufferHandle D3D12Backend::CreateBuffer(uint64_t size, BufferHeap heap)
+{
+	Buffer buffer = {};
+
+	// Committed resources are zeroed.
+	const bool upload = heap == BufferHeap::UPLOAD;
+	const CD3DX12_HEAP_PROPERTIES heapProp(upload ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT);
+	const auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	if (FAILED(
+		m_device->CreateCommittedResource(
+			&heapProp,
+			D3D12_HEAP_FLAG_NONE,
+			&resDesc,
+			upload ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(buffer.resource.ReleaseAndGetAddressOf()))))
+	{
+		return INVALID_BUFFER_HANDLE;
+	}
+
+	// Upload heap can stay mapped for its lifetime.
+	if (upload)
+	{
+		const CD3DX12_RANGE readRange(0, 0);
+		DX::ThrowIfFailed(buffer.resource->Map(0, &readRange, reinterpret_cast<void**>(&buffer.mappedData)));
+	}
+
+	if (!m_freeHandles.empty())
+	{
+		const BufferHandle handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+		m_buffers[handle] = std::move(buffer);
+		return handle;
+	}
+
+	m_buffers.push_back(std::move(buffer));
+	return static_cast<BufferHandle>(m_buffers.size() - 1);
+}
+
+void D3D12Backend::DestroyBuffer(BufferHandle buffer)
+{
+	Buffer& target = m_buffers[buffer];
+	if (target.mappedData != nullptr)
+		target.resource->Unmap(0, nullptr);
+
+	target = {};
+	m_freeHandles.push_back(buffer);
+}
+
+uint8_t* D3D12Backend::GetMappedData(BufferHandle buffer)
+{
+	return m_buffers[buffer].mappedData;
+}
+
+void D3D12Backend::Barrier(BufferHandle buffer, BufferState before, BufferState after)
+{
+	const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+		m_buffers[buffer].resource.Get(), ToResourceState(before), ToResourceState(after));
+	m_commandList->ResourceBarrier(1, &barrier);
+}
+
+void D3D12Backend::CopyBuffer(
+	BufferHandle dest, uint64_t destOffset, BufferHandle source, uint64_t sourceOffset, uint64_t size)
+{
+	m_commandList->CopyBufferRegion(
+		m_buffers[dest].resource.Get(), destOffset, m_buffers[source].resource.Get(), sourceOffset, size);
+}
+
+void D3D12Backend::SetInstanceBuffer(BufferHandle buffer, uint64_t offset, uint32_t size, uint32_t stride)
+{
+	D3D12_VERTEX_BUFFER_VIEW view;
+	view.BufferLocation = m_buffers[buffer].resource->GetGPUVirtualAddress() + offset;
+	view.SizeInBytes = size;
+	view.StrideInBytes = stride;
+	m_commandList->IASetVertexBuffers(1, 1, &view);
+}
+
+void D3D12Backend::DrawIndexedIndirect(BufferHandle arguments, uint64_t offset, uint32_t drawCount)
+{
+	m_commandList->ExecuteIndirect(
+		m_drawSignature.Get(), drawCount, m_buffers[arguments].resource.Get(), offset, nullptr, 0);
+}
+
+bool D3D12Backend::Present(bool allowTearing)
+{
+	const HRESULT hr = m_swapChain->Present(0, allowTearing ? DXGI_PRESENT_ALLOW_TEARING : 0);
+	if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
+		return false;
+
+	DX::ThrowIfFailed(hr);
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "RenderBackend.h"
+
+// RenderBackend over a D3D12 device, recording into the renderer's command list.
+class D3D12Backend : public RenderBackend
+{
+public:
+	D3D12Backend(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, IDXGISwapChain3* swapChain);
+
+	D3D12Backend(const D3D12Backend&) = delete;
+	D3D12Backend& operator=(const D3D12Backend&) = delete;
+
+	BufferHandle CreateBuffer(uint64_t size, BufferHeap heap) override;
+	void DestroyBuffer(BufferHandle buffer) override;
+	uint8_t* GetMappedData(BufferHandle buffer) override;
+
+	void Barrier(BufferHandle buffer, BufferState before, BufferState after) override;
+	void CopyBuffer(
+		BufferHandle dest, uint64_t destOffset, BufferHandle source, uint64_t sourceOffset, uint64_t size) override;
+	void SetInstanceBuffer(BufferHandle buffer, uint64_t offset, uint32_t size, uint32_t stride) override;
+	void DrawIndexedIndirect(BufferHandle arguments, uint64_t offset, uint32_t drawCount) override;
+
+	bool Present(bool allowTearing) override;
+
+private:
+	struct Buffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource>		resource;
+		uint8_t*									mappedData;
+	};
+
+	ID3D12Device*									m_device;
+	ID3D12GraphicsCommandList*						m_commandList;
+	IDXGISwapChain3*								m_swapChain;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature>	m_drawSignature;
+
+	// Destroyed slots are reused.
+	std::vector<Buffer>								m_buffers;
+	std::vector<BufferHandle>						m_freeHandles;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+// File layout of DDS, same as DDS_PIXELFORMAT, DDS_HEADER and DDS_HEADER_DXT10 of DDSTextureLoader.
+namespace Dds
+{
+	constexpr uint32_t c_magic = 0x20534444;	// "DDS "
+
+	// Header flags.
+	constexpr uint32_t c_headerCaps = 0x1;
+	constexpr uint32_t c_headerHeight = 0x2;
+	constexpr uint32_t c_headerWidth = 0x4;
+	constexpr uint32_t c_headerPitch = 0x8;
+	constexpr uint32_t c_headerPixelFormat = 0x1000;
+	constexpr uint32_t c_headerMipMapCount = 0x20000;
+	constexpr uint32_t c_headerLinearSize = 0x80000;
+
+	// Pixel format flags.
+	constexpr uint32_t c_pixelFourCC = 0x4;
+	constexpr uint32_t c_pixelRGB = 0x40;
+	constexpr uint32_t c_pixelLuminance = 0x20000;
+
+	// Caps.
+	constexpr uint32_t c_capsComplex = 0x8;
+	constexpr uint32_t c_capsTexture = 0x1000;
+	constexpr uint32_t c_capsMipMap = 0x400000;
+
+	constexpr uint32_t c_dimensionTexture2D = 3;	// D3D10_RESOURCE_DIMENSION_TEXTURE2D
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+			(static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	struct PixelFormat
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	fourCC;
+		uint32_t	rgbBitCount;
+		uint32_t	rBitMask;
+		uint32_t	gBitMask;
+		uint32_t	bBitMask;
+		uint32_t	aBitMask;
+	};
+
+	struct Header
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	height;
+		uint32_t	width;
+		uint32_t	pitchOrLinearSize;
+		uint32_t	depth;
+		uint32_t	mipMapCount;
+		uint32_t	reserved1[11];
+		PixelFormat	ddspf;
+		uint32_t	caps;
+		uint32_t	caps2;
+		uint32_t	caps3;
+		uint32_t	caps4;
+		uint32_t	reserved2;
+	};
+
+	struct HeaderDXT10
+	{
+		uint32_t	dxgiFormat;
+		uint32_t	resourceDimension;
+		uint32_t	miscFlag;
+		uint32_t	arraySize;
+		uint32_t	miscFlags2;
+	};
+
+	static_assert(sizeof(Header) == 124, "DDS header size mismatch");
+}
@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "DdsMipFile.h"
+
+#include "TextureDecoder.h"
+
+DdsMipFile::~DdsMipFile()
+{
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+}
+
+bool DdsMipFile::Open(const wchar_t* fileName)
+{
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_layout = {};
+
+	m_file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Headers may be shorter than the largest one, if file is tiny.
+	uint8_t header[TextureDecoder::c_maxHeaderSize];
+	LARGE_INTEGER fileSize = {};
+	DWORD read = 0;
+	uint32_t format, width, height, mipCount;
+	size_t offset = 0;
+	bool valid = GetFileSizeEx(m_file, &fileSize) &&
+		ReadFile(m_file, header, sizeof(header), &read, nullptr) &&
+		TextureDecoder::ParseHeader(header, read, format, width, height, mipCount, offset) &&
+		m_layout.Create(format, width, height, mipCount);
+
+	// Mips of first array slice are stored one after another.
+	for (uint32_t mip = 0; mip < m_layout.mipCount && valid; mip++)
+	{
+		m_mipOffsets[mip] = offset;
+		offset += MipLoader::GetMipSize(m_layout, mip);
+	}
+	valid = valid && static_cast<uint64_t>(fileSize.QuadPart) >= offset;
+
+	if (!valid)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		m_layout = {};
+		return false;
+	}
+
+	return true;
+}
+
+bool DdsMipFile::ReadRows(uint32_t mip, uint32_t firstRow, uint32_t rowCount, uint8_t* data)
+{
+	if (m_file == INVALID_HANDLE_VALUE || mip >= m_layout.mipCount || firstRow + rowCount > m_layout.GetRowCount(mip))
+		return false;
+
+	const uint32_t rowPitch = m_layout.GetRowPitch(mip);
+
+	LARGE_INTEGER position = {};
+	position.QuadPart = static_cast<LONGLONG>(m_mipOffsets[mip] + static_cast<uint64_t>(firstRow) * rowPitch);
+
+	const DWORD size = rowCount * rowPitch;
+	DWORD read = 0;
+	return SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) &&
+		ReadFile(m_file, data, size, &read, nullptr) && read == size;
+}
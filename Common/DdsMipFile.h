@@ -0,0 +1,26 @@
+#pragma once
+
+#include "MipLoader.h"
+
+// Mips of first array slice of a DDS file, read row ranges at a time so coarse mips don't wait for the whole file.
+// Formats are those TextureDecoder reads.
+class DdsMipFile : public MipSource
+{
+public:
+	DdsMipFile() = default;
+	~DdsMipFile() override;
+
+	DdsMipFile(const DdsMipFile&) = delete;
+	DdsMipFile& operator=(const DdsMipFile&) = delete;
+
+	// Read headers only. Returns false if file is missing, its format is not supported or it is shorter than its mips.
+	bool Open(const wchar_t* fileName);
+
+	const TileLayout& GetLayout() const override { return m_layout; }
+	bool ReadRows(uint32_t mip, uint32_t firstRow, uint32_t rowCount, OUT uint8_t* data) override;
+
+private:
+	HANDLE						m_file = INVALID_HANDLE_VALUE;
+	TileLayout					m_layout = {};
+	uint64_t					m_mipOffsets[TILE_LAYOUT_MAX_MIPS] = {};
+};
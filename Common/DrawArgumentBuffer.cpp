@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "DrawArgumentBuffer.h"
+
+namespace
+{
+	inline bool SlotEqual(const D3D12_DRAW_INDEXED_ARGUMENTS& a, const D3D12_DRAW_INDEXED_ARGUMENTS& b)
+	{
+		return memcmp(&a, &b, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)) == 0;
+	}
+}
+
+DrawArgumentBuffer::DrawArgumentBuffer(RenderBackend& backend, uint32_t slotCount) : m_backend(backend)
+{
+	m_slots.assign(slotCount, {});
+
+	// Dirty runs are at least two slots apart, so this is their worst case.
+	m_dirtyRuns.reserve(slotCount / 2 + 1);
+
+	// New buffers are zeroed, which is the same as m_slots.
+	m_buffer = m_backend.CreateBuffer(sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * slotCount, BufferHeap::DEFAULT);
+	if (m_buffer == INVALID_BUFFER_HANDLE)
+		throw std::exception();
+}
+
+DrawArgumentBuffer::~DrawArgumentBuffer()
+{
+	m_backend.DestroyBuffer(m_buffer);
+}
+
+uint64_t DrawArgumentBuffer::Update(UploadRing& uploadRing, IN const D3D12_DRAW_INDEXED_ARGUMENTS* slots)
+{
+	FindDirtyRuns(m_slots.data(), slots, GetSlotCount(), c_mergeGap, m_dirtyRuns);
+	if (m_dirtyRuns.empty())
+		return 0;
+
+	uint64_t uploadSize = 0;
+	for (const SlotRun& run : m_dirtyRuns)
+		uploadSize += sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * run.count;
+
+	const auto allocation = uploadRing.Allocate(uploadSize, c_uploadAlignment);
+
+	// Buffer decays to COMMON after every frame, as every buffer does.
+	m_backend.Barrier(m_buffer, BufferState::COMMON, BufferState::COPY_DEST);
+
+	// Dirty runs are packed one after another in upload ring.
+	uint64_t offset = 0;
+	for (const SlotRun& run : m_dirtyRuns)
+	{
+		const uint64_t size = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * run.count;
+		memcpy(static_cast<uint8_t*>(allocation.cpuAddress) + offset, slots + run.first, size);
+		memcpy(m_slots.data() + run.first, slots + run.first, size);
+
+		m_backend.CopyBuffer(
+			m_buffer, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * run.first,
+			allocation.buffer, allocation.offset + offset, size);
+
+		offset += size;
+	}
+
+	m_backend.Barrier(m_buffer, BufferState::COPY_DEST, BufferState::INDIRECT_ARGUMENT);
+
+	return uploadSize;
+}
+
+void DrawArgumentBuffer::Draw() const
+{
+	// Without copies this frame, buffer is promoted from COMMON on use.
+	m_backend.DrawIndexedIndirect(m_buffer, 0, GetSlotCount());
+}
+
+void DrawArgumentBuffer::FindDirtyRuns(
+	IN const D3D12_DRAW_INDEXED_ARGUMENTS* previous, IN const D3D12_DRAW_INDEXED_ARGUMENTS* next,
+	uint32_t slotCount, uint32_t mergeGap, OUT std::vector<SlotRun>& runs)
+{
+	runs.clear();
+
+	for (uint32_t s = 0; s < slotCount; s++)
+	{
+		if (SlotEqual(previous[s], next[s]))
+			continue;
+
+		// Extend last run over short clean gap.
+		if (!runs.empty() && s - (runs.back().first + runs.back().count) <= mergeGap)
+		{
+			runs.back().count = s + 1 - runs.back().first;
+			continue;
+		}
+
+		runs.push_back({ s, 1 });
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "UploadRing.h"
+
+// Run of consecutive slots [first, first + count).
+struct SlotRun
+{
+	uint32_t			first;
+	uint32_t			count;
+};
+
+// Indirect draw arguments kept in a default heap buffer across frames.
+// Every slot belongs to one leaf of static index buffer, and holds the visible range starting there
+// (zero index count otherwise). So a slot only changes when visibility around its leaf changes,
+// and only changed slots are copied through the upload ring.
+class DrawArgumentBuffer
+{
+public:
+	DrawArgumentBuffer(RenderBackend& backend, uint32_t slotCount);
+	~DrawArgumentBuffer();
+
+	DrawArgumentBuffer(const DrawArgumentBuffer&) = delete;
+	DrawArgumentBuffer& operator=(const DrawArgumentBuffer&) = delete;
+
+	// Upload slots which differ from last update and record copies into buffer.
+	// Returns uploaded bytes.
+	uint64_t Update(UploadRing& uploadRing, IN const D3D12_DRAW_INDEXED_ARGUMENTS* slots);
+
+	// Record draw of every slot, empty ones draw nothing.
+	void Draw() const;
+
+	uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+
+	// Runs of slots where next differs from previous.
+	// Runs at most mergeGap clean slots apart are merged, as one bigger copy is cheaper than two.
+	static void FindDirtyRuns(
+		IN const D3D12_DRAW_INDEXED_ARGUMENTS* previous, IN const D3D12_DRAW_INDEXED_ARGUMENTS* next,
+		uint32_t slotCount, uint32_t mergeGap, OUT std::vector<SlotRun>& runs);
+
+private:
+	static constexpr uint32_t					c_mergeGap = 4;
+	static constexpr uint64_t					c_uploadAlignment = 256;
+
+	RenderBackend&								m_backend;
+	BufferHandle								m_buffer;
+
+	// Slots as last uploaded. Buffer starts zeroed, and so does this.
+	std::vector<D3D12_DRAW_INDEXED_ARGUMENTS>	m_slots;
+	std::vector<SlotRun>						m_dirtyRuns;
+};
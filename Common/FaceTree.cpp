@@ -1,88 +1,140 @@
 #include "pch.h"
 #include "FaceTree.h"
 
-FaceTree::FaceTree(QuadNode* rootNode, UINT32 faceIndexCount)
+FaceTree::FaceTree(QuadTree&& quadTree, UINT32 faceIndexCount)
 {
-	m_rootNode = rootNode;
+	m_quadTree = std::move(quadTree);
 	m_faceIndexCount = faceIndexCount;
-	m_renderIndexData = std::vector<uint32_t>(m_faceIndexCount);
+
+	// Worst case is every other leaf visible.
+	const uint32_t leafCount = 1u << (2 * (m_quadTree.GetLevelCount() - 1));
+	for (auto& viewRanges : m_renderRanges)
+	{
+		for (auto& renderRanges : viewRanges)
+			renderRanges.reserve(leafCount / 2 + 1);
+	}
 }
 
-FaceTree::~FaceTree()
+uint32_t FaceTree::UpdateIndexData(IN DirectX::BoundingFrustum& frustum, CullView view)
 {
-	m_staticIB.Reset();
-	m_uploadIB.Reset();
-	delete m_rootNode;
+	InvalidateCache();
+
+	for (auto& renderRanges : m_renderRanges[view])
+		renderRanges.clear();
+
+	// Frustum path writes whole face to first subtree.
+	uint32_t culledQuadCount = 0;
+	m_quadTree.Render(frustum, m_renderRanges[view][0], culledQuadCount);
+
+	return culledQuadCount;
 }
 
-void FaceTree::Init(ID3D12Device* device)
+uint32_t FaceTree::UpdateIndexData(IN DirectX::BoundingOrientedBox& volume, CullView view)
 {
-	m_staticIndexCount = m_rootNode->GetIndexCount();
-	m_staticIBSize = sizeof(uint32_t) * m_staticIndexCount;
-
-    // Create default heap.
-    CD3DX12_HEAP_PROPERTIES defaultHeapProp(D3D12_HEAP_TYPE_DEFAULT);
-    auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(m_staticIBSize);
-    DX::ThrowIfFailed(
-        device->CreateCommittedResource(
-            &defaultHeapProp,
-            D3D12_HEAP_FLAG_NONE,
-            &resDesc,
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            nullptr,
-            IID_PPV_ARGS(m_staticIB.ReleaseAndGetAddressOf())));
-
-    // Initialize the index buffer view.
-    m_ibv.BufferLocation = m_staticIB->GetGPUVirtualAddress();
-    m_ibv.Format = DXGI_FORMAT_R32_UINT;
-    m_ibv.SizeInBytes = m_staticIBSize;
-
-    // Create upload heap.
-    CD3DX12_HEAP_PROPERTIES uploadHeapProp(D3D12_HEAP_TYPE_UPLOAD);
-    auto uploadHeapDesc = CD3DX12_RESOURCE_DESC::Buffer(m_staticIBSize);
-    DX::ThrowIfFailed(
-        device->CreateCommittedResource(
-            &uploadHeapProp,
-            D3D12_HEAP_FLAG_NONE,
-            &uploadHeapDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(m_uploadIB.ReleaseAndGetAddressOf())));
+	InvalidateCache();
+
+	for (auto& renderRanges : m_renderRanges[view])
+		renderRanges.clear();
+
+	uint32_t culledQuadCount = 0;
+	m_quadTree.Render(volume, m_renderRanges[view][0], culledQuadCount);
+
+	return culledQuadCount;
 }
 
-uint32_t FaceTree::UpdateIndexData(IN DirectX::BoundingFrustum& frustum, IN const std::vector<uint32_t>& indices)
+CullStats FaceTree::UpdateIndexData(
+	IN const CullPlanes& planes, IN const CullHorizon& horizon, uint32_t subtree, CullView view)
 {
-	m_renderIndexData.clear();
+	SubtreeCache& cache = m_caches[view][subtree];
 
-	uint32_t culledQuadCount = 0;
-	m_rootNode->Render(frustum, indices, m_renderIndexData, culledQuadCount);
+	// View didn't move, so ranges of last time are still valid.
+	// Key is not updated on hit, so slow movement can't drift away from it.
+	if (cache.valid && cache.planes.NearEqual(planes, c_cacheEpsilon) && cache.horizon.NearEqual(horizon, c_cacheEpsilon))
+	{
+		CullStats stats = {};
+		stats.culledQuadCount = cache.stats.culledQuadCount;
+		stats.horizonCulledQuadCount = cache.stats.horizonCulledQuadCount;
+		stats.cachedSubtreeCount = 1;
+		return stats;
+	}
 
-	m_renderIndexCount = m_renderIndexData.size();
-	m_renderIBSize = sizeof(uint32_t) * m_renderIndexCount;
+	m_renderRanges[view][subtree].clear();
 
-	return culledQuadCount;
+	CullStats stats = {};
+	m_quadTree.CullSubtree(subtree, view, planes, horizon, m_renderRanges[view][subtree], stats);
+
+	cache.planes = planes;
+	cache.horizon = horizon;
+	cache.stats = stats;
+	cache.valid = true;
+
+	return stats;
+}
+
+void FaceTree::InvalidateCache()
+{
+	for (auto& viewCaches : m_caches)
+	{
+		for (auto& cache : viewCaches)
+			cache.valid = false;
+	}
 }
 
-void FaceTree::Upload(ID3D12GraphicsCommandList* commandList)
+void FaceTree::WriteDrawSlots(CullView view, OUT D3D12_DRAW_INDEXED_ARGUMENTS* slots) const
 {
-    // Define sub-resource data.
-    D3D12_SUBRESOURCE_DATA subResourceData = {};
-    subResourceData.pData = m_renderIndexData.data();
-    subResourceData.RowPitch = m_renderIBSize;
-    subResourceData.SlicePitch = m_renderIBSize;
-
-    // Copy the index data to the default heap.
-    UpdateSubresources(commandList, m_staticIB.Get(), m_uploadIB.Get(), 0, 0, 1, &subResourceData);
-
-    // Translate vertex buffer state.
-    const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_staticIB.Get(),
-        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER);
-	commandList->ResourceBarrier(1, &barrier);
+	const uint32_t leafIndexCount = GetLeafIndexCount();
+	const auto write = [&](const IndexRange& range)
+	{
+		slots[range.start / leafIndexCount] = { range.count, 1, range.start, 0, 0 };
+	};
+
+	// Subtrees are adjacent in index buffer too, so ranges are merged across them.
+	IndexRange pending = {};
+	for (const auto& renderRanges : m_renderRanges[view])
+	{
+		for (const IndexRange& range : renderRanges)
+		{
+			if (pending.count > 0 && pending.start + pending.count == range.start)
+			{
+				pending.count += range.count;
+				continue;
+			}
+
+			if (pending.count > 0)
+				write(pending);
+			pending = range;
+		}
+	}
+
+	if (pending.count > 0)
+		write(pending);
 }
 
-void FaceTree::Draw(ID3D12GraphicsCommandList* commandList) const
+uint32_t FaceTree::GetDrawCount(CullView view) const
 {
-	commandList->IASetIndexBuffer(&m_ibv);
-	commandList->DrawIndexedInstanced(m_renderIndexCount, 1, 0, 0, 0);
-}
\ No newline at end of file
+	uint32_t drawCount = 0;
+	uint32_t end = UINT32_MAX;
+	for (const auto& renderRanges : m_renderRanges[view])
+	{
+		for (const IndexRange& range : renderRanges)
+		{
+			if (range.start != end)
+				drawCount++;
+			end = range.start + range.count;
+		}
+	}
+
+	return drawCount;
+}
+
+uint32_t FaceTree::GetIndexCount(CullView view) const
+{
+	uint32_t indexCount = 0;
+	for (const auto& renderRanges : m_renderRanges[view])
+	{
+		for (const IndexRange& range : renderRanges)
+			indexCount += range.count;
+	}
+
+	return indexCount;
+}
@@ -1,33 +1,52 @@
 #pragma once
 
-#include "QuadNode.h"
+#include "QuadTree.h"
+
+#define FACE_TREE_SUBTREE_COUNT 4u
 
 class FaceTree
 {
 public:
-	FaceTree(QuadNode* rootNode, UINT32 faceIndexCount);
-	~FaceTree();
+	FaceTree(QuadTree&& quadTree, UINT32 faceIndexCount);
+	~FaceTree() = default;
 
-	QuadNode*								GetRootNode() const { return m_rootNode; }
+	const QuadTree&							GetQuadTree() const { return m_quadTree; }
 
-	void Init(ID3D12Device* device);
-	uint32_t UpdateIndexData(IN DirectX::BoundingFrustum& frustum, IN const std::vector<uint32_t>& indices);
-	void Upload(ID3D12GraphicsCommandList* commandList);
-	void Draw(ID3D12GraphicsCommandList* commandList) const;
+	uint32_t UpdateIndexData(IN DirectX::BoundingFrustum& frustum, CullView view);
+	uint32_t UpdateIndexData(IN DirectX::BoundingOrientedBox& volume, CullView view);
 
-private:
-	QuadNode*								m_rootNode;
-	uint32_t								m_faceIndexCount;
+	// Cull one level 1 subtree for view. Different subtrees can be updated from different threads.
+	// Last result is reused if planes and horizon are same as last time within epsilon.
+	CullStats UpdateIndexData(IN const CullPlanes& planes, IN const CullHorizon& horizon, uint32_t subtree, CullView view);
+	void InvalidateCache();
+
+	// Write one indexed draw per merged visible range of view into slots, which are indexed by
+	// first leaf of range in static index buffer (see DrawArgumentBuffer). Other slots are not touched.
+	void WriteDrawSlots(CullView view, OUT D3D12_DRAW_INDEXED_ARGUMENTS* slots) const;
+
+	// Visible ranges of view found by one subtree task, in index buffer order.
+	const std::vector<IndexRange>&	GetRenderRanges(CullView view, uint32_t subtree) const { return m_renderRanges[view][subtree]; }
 
-	std::vector<uint32_t>					m_renderIndexData;
+	uint32_t GetDrawCount(CullView view) const;
+	uint32_t GetIndexCount(CullView view) const;
 
-	uint32_t								m_staticIndexCount = 0;
-	uint32_t								m_staticIBSize = 0;
+	// Index count of one leaf node, same for every face tree.
+	uint32_t GetLeafIndexCount() const { return m_faceIndexCount >> (2 * (m_quadTree.GetLevelCount() - 1)); }
 
-	uint32_t								m_renderIndexCount = 0;
-	uint32_t								m_renderIBSize = 0;
+private:
+	static constexpr float					c_cacheEpsilon = 1e-5f;
+
+	struct SubtreeCache
+	{
+		CullPlanes							planes;
+		CullHorizon							horizon;
+		CullStats							stats;
+		bool								valid;
+	};
+
+	QuadTree								m_quadTree;
+	uint32_t								m_faceIndexCount;
 
-	D3D12_INDEX_BUFFER_VIEW					m_ibv;
-	Microsoft::WRL::ComPtr<ID3D12Resource>  m_staticIB;
-	Microsoft::WRL::ComPtr<ID3D12Resource>  m_uploadIB;
-};
\ No newline at end of file
+	std::vector<IndexRange>					m_renderRanges[CULL_VIEW_COUNT][FACE_TREE_SUBTREE_COUNT];
+	SubtreeCache							m_caches[CULL_VIEW_COUNT][FACE_TREE_SUBTREE_COUNT] = {};
+};
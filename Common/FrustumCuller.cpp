@@ -0,0 +1,214 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Gather sign bit of each lane into 4-bit mask.
+	inline uint32_t MoveMask(FXMVECTOR v)
+	{
+#if defined(_XM_SSE_INTRINSICS_)
+		return static_cast<uint32_t>(_mm_movemask_ps(v));
+#else
+		XMUINT4 u;
+		XMStoreUInt4(&u, v);
+		return (u.x >> 31) | ((u.y >> 31) << 1) | ((u.z >> 31) << 2) | ((u.w >> 31) << 3);
+#endif
+	}
+
+	inline uint32_t BitCount(uint32_t mask)
+	{
+		static constexpr uint32_t counts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+		return counts[mask & 0xF];
+	}
+
+	inline XMVECTOR LoadBatch(const float* data, uint32_t first)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(data + first));
+	}
+}
+
+CullPlanes CullPlanes::FromViewProjection(FXMMATRIX viewProj)
+{
+	// Row vector convention, so clip planes are combinations of matrix columns.
+	const XMMATRIX m = XMMatrixTranspose(viewProj);
+
+	CullPlanes result = {};
+	XMStoreFloat4(&result.planes[0], XMPlaneNormalize(m.r[3] + m.r[0]));
+	XMStoreFloat4(&result.planes[1], XMPlaneNormalize(m.r[3] - m.r[0]));
+	XMStoreFloat4(&result.planes[2], XMPlaneNormalize(m.r[3] + m.r[1]));
+	XMStoreFloat4(&result.planes[3], XMPlaneNormalize(m.r[3] - m.r[1]));
+	XMStoreFloat4(&result.planes[4], XMPlaneNormalize(m.r[2]));
+	XMStoreFloat4(&result.planes[5], XMPlaneNormalize(m.r[3] - m.r[2]));
+
+	return result;
+}
+
+CullHorizon CullHorizon::FromCameraPosition(FXMVECTOR cameraPosition)
+{
+	const float distance = XMVectorGetX(XMVector3Length(cameraPosition));
+
+	CullHorizon result = {};
+	result.enabled = distance > SPHERE_RADIUS;
+	if (!result.enabled)
+		return result;
+
+	XMStoreFloat3(&result.cameraDirection, cameraPosition / distance);
+	result.cosHorizon = SPHERE_RADIUS / distance;
+	result.sinHorizon = sqrtf(1.0f - result.cosHorizon * result.cosHorizon);
+
+	return result;
+}
+
+CullHorizon CullHorizon::FromDirection(FXMVECTOR direction)
+{
+	// Horizon angle acos(R / d) is pi / 2 at infinity.
+	CullHorizon result = {};
+	result.enabled = true;
+	XMStoreFloat3(&result.cameraDirection, XMVector3Normalize(direction));
+	result.cosHorizon = 0.0f;
+	result.sinHorizon = 1.0f;
+
+	return result;
+}
+
+bool CullPlanes::NearEqual(const CullPlanes& other, float epsilon) const
+{
+	const XMVECTOR e = XMVectorReplicate(epsilon);
+	for (uint32_t p = 0; p < CULL_PLANE_COUNT; p++)
+	{
+		if (!XMVector4NearEqual(XMLoadFloat4(&planes[p]), XMLoadFloat4(&other.planes[p]), e))
+			return false;
+	}
+
+	return true;
+}
+
+bool CullHorizon::NearEqual(const CullHorizon& other, float epsilon) const
+{
+	if (enabled != other.enabled)
+		return false;
+	if (!enabled)
+		return true;
+
+	const XMVECTOR e = XMVectorReplicate(epsilon);
+	return
+		XMVector3NearEqual(XMLoadFloat3(&cameraDirection), XMLoadFloat3(&other.cameraDirection), e) &&
+		fabsf(cosHorizon - other.cosHorizon) <= epsilon;
+}
+
+void FrustumCuller::CullBatch(
+	IN const CullPlanes& planes, IN const CullBoxes& boxes, uint32_t first, uint32_t planeMask,
+	uint8_t* planeHint, OUT CullBatchResult& result)
+{
+	const XMVECTOR cx = LoadBatch(boxes.centerX, first);
+	const XMVECTOR cy = LoadBatch(boxes.centerY, first);
+	const XMVECTOR cz = LoadBatch(boxes.centerZ, first);
+
+	XMVECTOR ax[3], ay[3], az[3];
+	for (int a = 0; a < 3; a++)
+	{
+		ax[a] = LoadBatch(boxes.axisX[a], first);
+		ay[a] = LoadBatch(boxes.axisY[a], first);
+		az[a] = LoadBatch(boxes.axisZ[a], first);
+	}
+
+	uint32_t outsideMask = 0;
+	for (uint32_t& mask : result.planeMasks)
+		mask = 0;
+	result.planeHintHit = false;
+
+	// Test hinted plane first, it rejected most boxes of this batch last time.
+	const uint32_t hint = planeHint != nullptr ? *planeHint : CULL_PLANE_COUNT;
+	const bool hintValid = hint < CULL_PLANE_COUNT && (planeMask & (1u << hint)) != 0;
+
+	uint32_t order[CULL_PLANE_COUNT];
+	uint32_t orderCount = 0;
+	if (hintValid)
+		order[orderCount++] = hint;
+	for (uint32_t p = 0; p < CULL_PLANE_COUNT; p++)
+	{
+		if ((planeMask & (1u << p)) != 0 && p != hint)
+			order[orderCount++] = p;
+	}
+
+	uint32_t bestPlane = CULL_PLANE_COUNT;
+	uint32_t bestCount = 0;
+
+	for (uint32_t i = 0; i < orderCount; i++)
+	{
+		const uint32_t p = order[i];
+
+		const XMFLOAT4& plane = planes.planes[p];
+		const XMVECTOR px = XMVectorReplicate(plane.x);
+		const XMVECTOR py = XMVectorReplicate(plane.y);
+		const XMVECTOR pz = XMVectorReplicate(plane.z);
+		const XMVECTOR pw = XMVectorReplicate(plane.w);
+
+		// Signed distance of box centers.
+		const XMVECTOR dist = XMVectorMultiplyAdd(cz, pz, XMVectorMultiplyAdd(cy, py, XMVectorMultiplyAdd(cx, px, pw)));
+
+		// Projected radius of boxes onto plane normal.
+		XMVECTOR radius = XMVectorZero();
+		for (int a = 0; a < 3; a++)
+		{
+			const XMVECTOR d = XMVectorMultiplyAdd(az[a], pz, XMVectorMultiplyAdd(ay[a], py, ax[a] * px));
+			radius += XMVectorAbs(d);
+		}
+
+		const uint32_t planeOutsideMask = MoveMask(XMVectorLess(dist, XMVectorNegate(radius)));
+		outsideMask |= planeOutsideMask;
+
+		if (BitCount(planeOutsideMask) > bestCount)
+		{
+			bestPlane = p;
+			bestCount = BitCount(planeOutsideMask);
+		}
+
+		const uint32_t intersectMask = MoveMask(XMVectorLessOrEqual(dist, radius));
+		for (uint32_t lane = 0; lane < CULL_BATCH_SIZE; lane++)
+		{
+			if (intersectMask & (1u << lane))
+				result.planeMasks[lane] |= 1u << p;
+		}
+
+		// Every box is already outside.
+		if (outsideMask == (1u << CULL_BATCH_SIZE) - 1)
+		{
+			result.planeHintHit = hintValid && i == 0;
+			break;
+		}
+	}
+
+	if (planeHint != nullptr && bestCount > 0)
+		*planeHint = static_cast<uint8_t>(bestPlane);
+
+	result.outsideMask = outsideMask;
+	result.hiddenMask = 0;
+}
+
+uint32_t FrustumCuller::HorizonBatch(IN const CullHorizon& horizon, IN const CullCones& cones, uint32_t first)
+{
+	if (!horizon.enabled)
+		return 0;
+
+	const XMVECTOR ax = LoadBatch(cones.axisX, first);
+	const XMVECTOR ay = LoadBatch(cones.axisY, first);
+	const XMVECTOR az = LoadBatch(cones.axisZ, first);
+	const XMVECTOR cosAngle = LoadBatch(cones.cosAngle, first);
+	const XMVECTOR sinAngle = LoadBatch(cones.sinAngle, first);
+
+	// Cosine of angle between camera direction and cone axes.
+	const XMVECTOR cosTheta = XMVectorMultiplyAdd(
+		az, XMVectorReplicate(horizon.cameraDirection.z), XMVectorMultiplyAdd(
+		ay, XMVectorReplicate(horizon.cameraDirection.y),
+		ax * XMVectorReplicate(horizon.cameraDirection.x)));
+
+	// cos(horizon + cone angle), both angles are in [0, pi / 2].
+	const XMVECTOR cosLimit = XMVectorNegativeMultiplySubtract(
+		XMVectorReplicate(horizon.sinHorizon), sinAngle,
+		XMVectorReplicate(horizon.cosHorizon) * cosAngle);
+
+	return MoveMask(XMVectorLess(cosTheta, cosLimit));
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#define CULL_PLANE_COUNT 6u
+#define CULL_PLANE_MASK_ALL 0x3Fu
+#define CULL_BATCH_SIZE 4u
+
+// Views culled every frame. Each keeps its own ranges and plane hints.
+enum CullView : uint32_t
+{
+	CULL_VIEW_CAMERA,
+	CULL_VIEW_LIGHT,
+	CULL_VIEW_COUNT,
+};
+
+#define SPHERE_RADIUS 150.0f
+#define SPHERE_MAX_DISPLACEMENT 0.6f	// Same as height scale of DS
+
+// Inward facing, normalized clip planes (left, right, bottom, top, near, far).
+struct CullPlanes
+{
+	DirectX::XMFLOAT4	planes[CULL_PLANE_COUNT];
+
+	static CullPlanes FromViewProjection(DirectX::FXMMATRIX viewProj);
+
+	bool NearEqual(const CullPlanes& other, float epsilon) const;
+};
+
+// Camera seen from sphere center, for horizon culling.
+// A point at radius r is hidden behind sphere if its angle from camera direction is over acos(R / d) + acos(R / r).
+struct CullHorizon
+{
+	DirectX::XMFLOAT3	cameraDirection;
+	float				cosHorizon;		// cos(acos(R / d)) = R / d
+	float				sinHorizon;
+	bool				enabled;		// false when camera is under sphere surface
+
+	static CullHorizon FromCameraPosition(DirectX::FXMVECTOR cameraPosition);
+
+	// Viewer at infinity, such as directional light. direction points toward viewer.
+	static CullHorizon FromDirection(DirectX::FXMVECTOR direction);
+
+	bool NearEqual(const CullHorizon& other, float epsilon) const;
+};
+
+// Structure-of-arrays view of node OBBs.
+// axisX[a][n], axisY[a][n], axisZ[a][n] is a-th OBB axis of node n, already scaled by its extent.
+struct CullBoxes
+{
+	const float*		centerX;
+	const float*		centerY;
+	const float*		centerZ;
+	const float*		axisX[3];
+	const float*		axisY[3];
+	const float*		axisZ[3];
+};
+
+// Structure-of-arrays view of node cones.
+// Cone of node contains every direction of its patch, widened by acos(R / Rmax) for displacement.
+struct CullCones
+{
+	const float*		axisX;
+	const float*		axisY;
+	const float*		axisZ;
+	const float*		cosAngle;
+	const float*		sinAngle;
+};
+
+// Result of one batch.
+// Lane i of batch is outside if bit i of outsideMask is set.
+// Otherwise planeMasks[i] holds the planes which still intersect the box (0 means fully inside).
+// hiddenMask is filled by caller with HorizonBatch, and hidden lanes are not in outsideMask.
+// planeHintHit is true if hinted plane alone rejected every box.
+struct CullBatchResult
+{
+	uint32_t			outsideMask;
+	uint32_t			hiddenMask;
+	uint32_t			planeMasks[CULL_BATCH_SIZE];
+	bool				planeHintHit;
+};
+
+namespace FrustumCuller
+{
+	// Test CULL_BATCH_SIZE consecutive boxes starting at first against planes in planeMask.
+	// If planeHint is given, that plane is tested first and then replaced with the plane rejecting most boxes.
+	// Uses SSE through DirectXMath, or scalar code when _XM_NO_INTRINSICS_ is defined.
+	void CullBatch(
+		IN const CullPlanes& planes, IN const CullBoxes& boxes, uint32_t first, uint32_t planeMask,
+		uint8_t* planeHint, OUT CullBatchResult& result);
+
+	// Test CULL_BATCH_SIZE consecutive cones starting at first against horizon.
+	// Returns mask of lanes fully hidden behind sphere.
+	uint32_t HorizonBatch(IN const CullHorizon& horizon, IN const CullCones& cones, uint32_t first);
+}
@@ -0,0 +1,84 @@
+#include "pch.h"
+#include "HeadlessReplay.h"
+
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+
+HeadlessReplay::HeadlessReplay(
+	IN const std::vector<FaceTree*>& faceTrees, WorkerPool& workerPool, RenderBackend& backend,
+	float aspectRatio, IN const DirectX::BoundingSphere& sceneBounds)
+	: m_culler(faceTrees, workerPool), m_backend(backend), m_aspectRatio(aspectRatio), m_sceneBounds(sceneBounds)
+{
+	const uint32_t slotCount = m_culler.GetSlotCount();
+	m_drawSlots.resize(slotCount);
+	for (auto& drawArguments : m_drawArguments)
+		drawArguments = std::make_unique<DrawArgumentBuffer>(m_backend, slotCount);
+
+	// Sized as Apollo sizes its ring: every slot of every pass in every frame in flight.
+	const uint64_t passSize = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * slotCount + c_drawArgumentAlignment;
+	const uint64_t ringSize = passSize * CULL_VIEW_COUNT * (c_framesInFlight + 1);
+	m_uploadRing = std::make_unique<UploadRing>(
+		m_backend, (ringSize + c_drawArgumentAlignment - 1) / c_drawArgumentAlignment * c_drawArgumentAlignment);
+}
+
+HeadlessReplay::~HeadlessReplay()
+{
+	// Buffers go back to backend before it does.
+	for (auto& drawArguments : m_drawArguments)
+		drawArguments.reset();
+	m_uploadRing.reset();
+}
+
+ReplayFrameStats HeadlessReplay::RunFrame(IN const CameraFrame& frame, IN const SceneCullOptions& options)
+{
+	const AllocationCount allocationStart = AllocationCounter::GetCount();
+	const auto updateStart = std::chrono::high_resolution_clock::now();
+
+	const SceneView view = SceneView::Create(frame, m_aspectRatio, m_sceneBounds);
+
+	const auto cullingStart = std::chrono::high_resolution_clock::now();
+	const SceneCullResult result = m_culler.Cull(view, options);
+	const auto cullingEnd = std::chrono::high_resolution_clock::now();
+
+	// Same slots and uploads as Apollo's frame packet and DrawFaceTrees.
+	const uint32_t viewCount = options.shadow ? CULL_VIEW_COUNT : 1;
+	m_uploadRing->BeginFrame(m_fenceValue >= c_framesInFlight ? m_fenceValue - c_framesInFlight : 0);
+	for (uint32_t v = 0; v < viewCount; v++)
+	{
+		const auto cullView = static_cast<CullView>(v);
+		std::fill(m_drawSlots.begin(), m_drawSlots.end(), D3D12_DRAW_INDEXED_ARGUMENTS{});
+		m_culler.WriteDrawSlots(cullView, m_drawSlots.data());
+
+		m_uploadedBytes += m_drawArguments[v]->Update(*m_uploadRing, m_drawSlots.data());
+		m_drawArguments[v]->Draw();
+	}
+	m_uploadRing->EndFrame(++m_fenceValue);
+	m_backend.Present(false);
+
+	ReplayFrameStats stats = {};
+	stats.updateTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - updateStart).count();
+	stats.cullingTime = std::chrono::duration<float, std::micro>(cullingEnd - cullingStart).count();
+	stats.culledQuadCount = result.stats[CULL_VIEW_CAMERA].culledQuadCount;
+	stats.shadowCulledQuadCount = options.shadow ? result.stats[CULL_VIEW_LIGHT].culledQuadCount : 0;
+	stats.indexCount = m_culler.GetIndexCount(CULL_VIEW_CAMERA);
+	stats.shadowIndexCount = options.shadow ? m_culler.GetIndexCount(CULL_VIEW_LIGHT) : 0;
+	stats.drawCount = m_culler.GetDrawCount(CULL_VIEW_CAMERA);
+
+	const AllocationCount allocations = AllocationCounter::GetCount() - allocationStart;
+	stats.allocationCount = static_cast<uint32_t>(allocations.count);
+	stats.allocationBytes = allocations.bytes;
+
+	return stats;
+}
+
+void HeadlessReplay::Run(IN const CameraPath& path, IN const SceneCullOptions& options, OUT ReplayReport& report)
+{
+	Reset();
+
+	report.Clear();
+	report.Reserve(path.GetFrameCount());
+	for (uint32_t frame = 0; frame < path.GetFrameCount(); frame++)
+		report.Add(RunFrame(path.GetFrame(frame), options));
+}
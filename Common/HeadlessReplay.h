@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "CameraPath.h"
+#include "DrawArgumentBuffer.h"
+#include "ReplayReport.h"
+#include "SceneCuller.h"
+
+// Camera path replay without window or device. Each frame runs what Apollo's Update and the draw
+// argument part of Render run: SceneView of the frame, SceneCuller, draw slots through UploadRing into
+// DrawArgumentBuffer, their indirect draws and present, all recorded into the given backend.
+// GPU is taken to finish frames c_framesInFlight behind, as swap chain lets it.
+class HeadlessReplay
+{
+public:
+	static constexpr uint32_t c_framesInFlight = 3;
+
+	HeadlessReplay(
+		IN const std::vector<FaceTree*>& faceTrees, WorkerPool& workerPool, RenderBackend& backend,
+		float aspectRatio, IN const DirectX::BoundingSphere& sceneBounds);
+	~HeadlessReplay();
+
+	HeadlessReplay(const HeadlessReplay&) = delete;
+	HeadlessReplay& operator=(const HeadlessReplay&) = delete;
+
+	// Start from the same culling state as recording did.
+	void Reset() { m_culler.InvalidateCache(); }
+
+	// Replay one frame. Index counts are those of culled ranges, which backend must have drawn.
+	// Allocations are of whole process during frame.
+	ReplayFrameStats RunFrame(IN const CameraFrame& frame, IN const SceneCullOptions& options);
+
+	// Reset and replay every frame of path into report.
+	void Run(IN const CameraPath& path, IN const SceneCullOptions& options, OUT ReplayReport& report);
+
+	SceneCuller&	GetCuller() { return m_culler; }
+	uint64_t		GetUploadedBytes() const { return m_uploadedBytes; }
+
+private:
+	static constexpr uint64_t							c_drawArgumentAlignment = 256;
+
+	SceneCuller											m_culler;
+	RenderBackend&										m_backend;
+	float												m_aspectRatio;
+	DirectX::BoundingSphere								m_sceneBounds;
+
+	std::unique_ptr<UploadRing>							m_uploadRing;
+	std::unique_ptr<DrawArgumentBuffer>					m_drawArguments[CULL_VIEW_COUNT];
+	std::vector<D3D12_DRAW_INDEXED_ARGUMENTS>			m_drawSlots;
+
+	uint64_t											m_fenceValue = 0;
+	uint64_t											m_uploadedBytes = 0;
+};
@@ -0,0 +1,185 @@
+#include "pch.h"
+#include "HeightMap.h"
+
+#include "TextureDecoder.h"
+
+#include <cfloat>
+
+using namespace DirectX;
+
+bool HeightMap::Load(const wchar_t* leftFileName, const wchar_t* rightFileName)
+{
+	m_levels.clear();
+
+	TextureDecoder left, right;
+	if (!left.Load(leftFileName) || !right.Load(rightFileName))
+		return false;
+
+	if (left.GetWidth() != right.GetWidth() || left.GetHeight() != right.GetHeight())
+		return false;
+
+	m_texelWidth = left.GetWidth() * 2;
+	m_texelHeight = left.GetHeight();
+
+	// Finest level, every cell holds range of its texels.
+	Level finest = {};
+	finest.width = (m_texelWidth + HEIGHT_MAP_CELL_SIZE - 1) / HEIGHT_MAP_CELL_SIZE;
+	finest.height = (m_texelHeight + HEIGHT_MAP_CELL_SIZE - 1) / HEIGHT_MAP_CELL_SIZE;
+	finest.minHeights.assign(static_cast<size_t>(finest.width) * finest.height, FLT_MAX);
+	finest.maxHeights.assign(static_cast<size_t>(finest.width) * finest.height, -FLT_MAX);
+	m_levels.push_back(std::move(finest));
+
+	DecodeHalf(left, 0);
+	DecodeHalf(right, left.GetWidth());
+
+	// Coarser levels, every cell holds range of 2x2 cells below.
+	while (m_levels.back().width > 1 || m_levels.back().height > 1)
+	{
+		const Level& fine = m_levels.back();
+
+		Level coarse = {};
+		coarse.width = (fine.width + 1) / 2;
+		coarse.height = (fine.height + 1) / 2;
+		coarse.minHeights.assign(static_cast<size_t>(coarse.width) * coarse.height, FLT_MAX);
+		coarse.maxHeights.assign(static_cast<size_t>(coarse.width) * coarse.height, -FLT_MAX);
+
+		for (uint32_t y = 0; y < fine.height; y++)
+		{
+			for (uint32_t x = 0; x < fine.width; x++)
+			{
+				const size_t src = static_cast<size_t>(y) * fine.width + x;
+				const size_t dst = static_cast<size_t>(y / 2) * coarse.width + x / 2;
+				coarse.minHeights[dst] = std::min(coarse.minHeights[dst], fine.minHeights[src]);
+				coarse.maxHeights[dst] = std::max(coarse.maxHeights[dst], fine.maxHeights[src]);
+			}
+		}
+
+		m_levels.push_back(std::move(coarse));
+	}
+
+	return true;
+}
+
+void HeightMap::DecodeHalf(const TextureDecoder& decoder, uint32_t texelOffsetX)
+{
+	Level& finest = m_levels.front();
+
+	const uint32_t width = decoder.GetWidth();
+	std::vector<float> strip(static_cast<size_t>(width) * TextureDecoder::c_stripHeight);
+
+	for (uint32_t s = 0; s < decoder.GetStripCount(); s++)
+	{
+		decoder.DecodeStrip(s, strip.data());
+
+		const uint32_t y0 = s * TextureDecoder::c_stripHeight;
+		const uint32_t rowCount = std::min(TextureDecoder::c_stripHeight, decoder.GetHeight() - y0);
+
+		for (uint32_t y = 0; y < rowCount; y++)
+		{
+			const size_t cellRow = static_cast<size_t>((y0 + y) / HEIGHT_MAP_CELL_SIZE) * finest.width;
+			const float* row = strip.data() + static_cast<size_t>(y) * width;
+
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const size_t cell = cellRow + (texelOffsetX + x) / HEIGHT_MAP_CELL_SIZE;
+				finest.minHeights[cell] = std::min(finest.minHeights[cell], row[x]);
+				finest.maxHeights[cell] = std::max(finest.maxHeights[cell], row[x]);
+			}
+		}
+	}
+}
+
+uint64_t HeightMap::CalcSourceKey(const wchar_t* leftFileName, const wchar_t* rightFileName)
+{
+	// FNV-1a over size and write time of both files. Missing file counts as zero.
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (const wchar_t* fileName : { leftFileName, rightFileName })
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data = {};
+		GetFileAttributesExW(fileName, GetFileExInfoStandard, &data);
+
+		const uint32_t words[4] =
+		{
+			data.nFileSizeLow, data.nFileSizeHigh,
+			data.ftLastWriteTime.dwLowDateTime, data.ftLastWriteTime.dwHighDateTime,
+		};
+		for (uint32_t word : words)
+			hash = (hash ^ word) * 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+void HeightMap::GetRange(
+	float thetaMin, float thetaMax, float phiMin, float phiMax,
+	OUT float& minHeight, OUT float& maxHeight) const
+{
+	// Texel rectangle which can be sampled, widened by filter footprint.
+	const auto margin = static_cast<int64_t>(HEIGHT_MAP_SAMPLE_MARGIN);
+	int64_t x0 = static_cast<int64_t>(floor(thetaMin / XM_2PI * m_texelWidth)) - margin;
+	int64_t x1 = static_cast<int64_t>(ceil(thetaMax / XM_2PI * m_texelWidth)) + margin;
+	const int64_t y0 = static_cast<int64_t>(floor(phiMin / XM_PI * m_texelHeight)) - margin;
+	const int64_t y1 = static_cast<int64_t>(ceil(phiMax / XM_PI * m_texelHeight)) + margin;
+
+	const auto cellY0 = static_cast<uint32_t>(std::max<int64_t>(y0, 0) / HEIGHT_MAP_CELL_SIZE);
+	const auto cellY1 = static_cast<uint32_t>(std::min<int64_t>(y1, m_texelHeight - 1) / HEIGHT_MAP_CELL_SIZE);
+
+	const auto width = static_cast<int64_t>(m_texelWidth);
+	if (x1 - x0 + 1 >= width)
+	{
+		x0 = 0;
+		x1 = width - 1;
+	}
+
+	// Split rectangle where it wraps around theta = 0.
+	x0 = (x0 % width + width) % width;
+	x1 = (x1 % width + width) % width;
+
+	float low, high;
+	if (x0 <= x1)
+	{
+		GetCellRange(
+			static_cast<uint32_t>(x0 / HEIGHT_MAP_CELL_SIZE), static_cast<uint32_t>(x1 / HEIGHT_MAP_CELL_SIZE),
+			cellY0, cellY1, minHeight, maxHeight);
+		return;
+	}
+
+	GetCellRange(
+		static_cast<uint32_t>(x0 / HEIGHT_MAP_CELL_SIZE), m_levels.front().width - 1,
+		cellY0, cellY1, minHeight, maxHeight);
+	GetCellRange(
+		0, static_cast<uint32_t>(x1 / HEIGHT_MAP_CELL_SIZE),
+		cellY0, cellY1, low, high);
+
+	minHeight = std::min(minHeight, low);
+	maxHeight = std::max(maxHeight, high);
+}
+
+void HeightMap::GetCellRange(
+	uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1,
+	OUT float& minHeight, OUT float& maxHeight) const
+{
+	// Coarser cells cover finer ones, so range stays conservative.
+	uint32_t level = 0;
+	while (level + 1 < m_levels.size() &&
+		(((x1 >> level) - (x0 >> level) + 1) > c_maxQueryCells ||
+		((y1 >> level) - (y0 >> level) + 1) > c_maxQueryCells))
+	{
+		level++;
+	}
+
+	const Level& source = m_levels[level];
+
+	minHeight = FLT_MAX;
+	maxHeight = -FLT_MAX;
+	for (uint32_t y = y0 >> level; y <= y1 >> level; y++)
+	{
+		for (uint32_t x = x0 >> level; x <= x1 >> level; x++)
+		{
+			const size_t cell = static_cast<size_t>(y) * source.width + x;
+			minHeight = std::min(minHeight, source.minHeights[cell]);
+			maxHeight = std::max(maxHeight, source.maxHeights[cell]);
+		}
+	}
+}
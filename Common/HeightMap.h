@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class TextureDecoder;
+
+#define HEIGHT_MAP_CELL_SIZE 16u		// Texels per side of finest pyramid cell
+#define HEIGHT_MAP_SAMPLE_MARGIN 65u	// Texels DS can reach around a point, bilinear (1) + coarsest mip level (2^6)
+
+// Min / max pyramid of displacement map, on CPU.
+// Left and right textures are one equirectangular image, the same way DS samples them,
+// so texel x of whole image is theta / 2pi * (2 * width) and texel y is phi / pi * height.
+class HeightMap
+{
+public:
+	// Decode both halves and build pyramid. Returns false if a file can't be decoded or sizes differ.
+	bool Load(const wchar_t* leftFileName, const wchar_t* rightFileName);
+
+	// Cheap key of source files (size and write time), for caches built from height map.
+	static uint64_t CalcSourceKey(const wchar_t* leftFileName, const wchar_t* rightFileName);
+
+	// Range of heights, in [0, 1] of texture, DS can sample for directions in
+	// longitude [thetaMin, thetaMax] and colatitude [phiMin, phiMax]. theta wraps around 2pi.
+	void GetRange(
+		float thetaMin, float thetaMax, float phiMin, float phiMax,
+		OUT float& minHeight, OUT float& maxHeight) const;
+
+	bool IsLoaded() const { return !m_levels.empty(); }
+
+private:
+	struct Level
+	{
+		uint32_t			width;
+		uint32_t			height;
+		std::vector<float>	minHeights;
+		std::vector<float>	maxHeights;
+	};
+
+	void DecodeHalf(const TextureDecoder& decoder, uint32_t texelOffsetX);
+
+	// Range of finest cells [x0, x1] x [y0, y1], read from coarsest level where it spans a few cells.
+	void GetCellRange(
+		uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1,
+		OUT float& minHeight, OUT float& maxHeight) const;
+
+	static constexpr uint32_t	c_maxQueryCells = 4;	// Per side
+
+	std::vector<Level>			m_levels;
+	uint32_t					m_texelWidth = 0;
+	uint32_t					m_texelHeight = 0;
+};
@@ -0,0 +1,221 @@
+#include "pch.h"
+#include "MeshCache.h"
+
+#include "HeightMap.h"
+#include "Profiler.h"
+#include "QuadSphereGenerator.h"
+
+MeshCache::~MeshCache()
+{
+	Release();
+}
+
+bool MeshCache::Load(const wchar_t* fileName, float width, uint32_t subdivideCount, uint64_t heightMapKey)
+{
+	Release();
+
+	// Open and map cache file.
+	m_file = CreateFileW(
+		fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(Header)))
+	{
+		Release();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		Release();
+		return false;
+	}
+
+	// Reject cache built with other parameters or by other version of generator.
+	const Header expected = CreateHeader(width, subdivideCount, heightMapKey);
+	const Header& header = GetHeader();
+	if (header.magic != expected.magic ||
+		header.version != expected.version ||
+		header.width != expected.width ||
+		header.subdivideCount != expected.subdivideCount ||
+		header.maxLevel != expected.maxLevel ||
+		header.vertexStride != expected.vertexStride ||
+		header.nodeStride != expected.nodeStride ||
+		header.heightMapKey != expected.heightMapKey)
+	{
+		Release();
+		return false;
+	}
+
+	// Reject cache whose node count doesn't match face tree depth.
+	const auto levelCount = static_cast<char>(std::min(header.subdivideCount, header.maxLevel) + 1);
+	if (header.nodeCount != 6 * QuadTree::CalcNodeCount(levelCount))
+	{
+		Release();
+		return false;
+	}
+
+	// Reject truncated or modified cache.
+	const uint64_t payloadSize =
+		static_cast<uint64_t>(sizeof(VertexTess)) * header.vertexCount +
+		static_cast<uint64_t>(sizeof(uint32_t)) * header.indexCount +
+		static_cast<uint64_t>(sizeof(QuadNodeRecord)) * header.nodeCount;
+
+	if (static_cast<uint64_t>(fileSize.QuadPart) != sizeof(Header) + payloadSize ||
+		CalcChecksum(m_data + sizeof(Header), payloadSize) != header.checksum)
+	{
+		Release();
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshCache::LoadOrGenerate(
+	const wchar_t* fileName, float width, uint32_t subdivideCount, const wchar_t* heightMapLeft, const wchar_t* heightMapRight)
+{
+	// Node bounds depend on displacement map, so cache is keyed on it too.
+	const uint64_t heightMapKey = HeightMap::CalcSourceKey(heightMapLeft, heightMapRight);
+	if (Load(fileName, width, subdivideCount, heightMapKey))
+		return true;
+
+	PROFILE_SCOPE("Generate quad sphere");
+
+	// Without height map, bounds fall back to full displacement range.
+	HeightMap heightMap;
+	heightMap.Load(heightMapLeft, heightMapRight);
+
+	const auto geoInfo = QuadSphereGenerator::CreateQuadSphere(width, width, width, subdivideCount, &heightMap);
+	Create(fileName, width, subdivideCount, heightMapKey, geoInfo->vertices, geoInfo->indices, geoInfo->faceTrees);
+
+	for (const auto faceTree : geoInfo->faceTrees)
+		delete faceTree;
+	delete geoInfo;
+
+	return false;
+}
+
+void MeshCache::Create(
+	const wchar_t* fileName, float width, uint32_t subdivideCount, uint64_t heightMapKey,
+	const std::vector<VertexTess>& vertices,
+	const std::vector<uint32_t>& indices,
+	const std::vector<FaceTree*>& faceTrees)
+{
+	Release();
+
+	// Face tree nodes are already breadth-first, so they are copied as they are.
+	std::vector<QuadNodeRecord> nodes;
+	for (const FaceTree* faceTree : faceTrees)
+		faceTree->GetQuadTree().GetRecords(nodes);
+
+	Header header = CreateHeader(width, subdivideCount, heightMapKey);
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+
+	const size_t vertexSize = sizeof(VertexTess) * vertices.size();
+	const size_t indexSize = sizeof(uint32_t) * indices.size();
+	const size_t nodeSize = sizeof(QuadNodeRecord) * nodes.size();
+
+	// Serialize.
+	m_ownedData.resize(sizeof(Header) + vertexSize + indexSize + nodeSize);
+
+	uint8_t* payload = m_ownedData.data() + sizeof(Header);
+	memcpy(payload, vertices.data(), vertexSize);
+	memcpy(payload + vertexSize, indices.data(), indexSize);
+	memcpy(payload + vertexSize + indexSize, nodes.data(), nodeSize);
+
+	header.checksum = CalcChecksum(payload, vertexSize + indexSize + nodeSize);
+	memcpy(m_ownedData.data(), &header, sizeof(Header));
+
+	m_data = m_ownedData.data();
+
+	// Write cache file. If it fails, geometry is just generated again on next launch.
+	const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	DWORD written = 0;
+	const BOOL result = WriteFile(file, m_ownedData.data(), static_cast<DWORD>(m_ownedData.size()), &written, nullptr);
+	CloseHandle(file);
+
+	if (!result || written != m_ownedData.size())
+		DeleteFileW(fileName);
+}
+
+std::vector<FaceTree*> MeshCache::CreateFaceTrees() const
+{
+	const Header& header = GetHeader();
+	const auto levelCount = static_cast<char>(std::min(header.subdivideCount, header.maxLevel) + 1);
+	const uint32_t nodeCount = QuadTree::CalcNodeCount(levelCount);
+	const uint32_t faceIndexCount = header.indexCount / 6;
+
+	// Nodes of each face are stored breadth-first, one face after another.
+	std::vector<FaceTree*> faceTrees;
+	for (int f = 0; f < 6; f++)
+	{
+		faceTrees.push_back(new FaceTree(QuadTree(GetNodes() + f * nodeCount, levelCount), faceIndexCount));
+	}
+
+	return faceTrees;
+}
+
+MeshCache::Header MeshCache::CreateHeader(float width, uint32_t subdivideCount, uint64_t heightMapKey)
+{
+	Header header = {};
+	header.magic = c_magic;
+	header.version = c_version;
+	header.width = width;
+	header.subdivideCount = subdivideCount;
+	header.maxLevel = QUAD_NODE_MAX_LEVEL;
+	header.vertexStride = sizeof(VertexTess);
+	header.nodeStride = sizeof(QuadNodeRecord);
+	header.heightMapKey = heightMapKey;
+
+	return header;
+}
+
+uint64_t MeshCache::CalcChecksum(const uint8_t* data, size_t size)
+{
+	// FNV-1a on 64-bit words.
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + offset, sizeof(uint64_t));
+		hash = (hash ^ word) * 0x100000001b3ull;
+	}
+	for (; offset < size; offset++)
+	{
+		hash = (hash ^ data[offset]) * 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+void MeshCache::Release()
+{
+	if (m_data != nullptr && m_data != m_ownedData.data())
+		UnmapViewOfFile(m_data);
+	m_data = nullptr;
+
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	m_mapping = nullptr;
+
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+
+	m_ownedData.clear();
+	m_ownedData.shrink_to_fit();
+}
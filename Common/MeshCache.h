@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FaceTree.h"
+
+// Binary cache of quad sphere geometry and flattened face tree nodes.
+// File layout is Header | VertexTess[vertexCount] | uint32_t[indexCount] | QuadNodeRecord[nodeCount],
+// and the cache is read through a file mapping, so vertex and index data are used in place.
+class MeshCache
+{
+public:
+	MeshCache() = default;
+	~MeshCache();
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// Map cache file. Returns false if file is missing, built with other parameters or corrupted.
+	// heightMapKey identifies height map node bounds are fit to (see HeightMap::CalcSourceKey).
+	bool Load(const wchar_t* fileName, float width, uint32_t subdivideCount, uint64_t heightMapKey);
+
+	// Load cache file, or generate quad sphere with bounds fit to height map and store it if cache is missing or stale.
+	// Returns true on cache hit.
+	bool LoadOrGenerate(
+		const wchar_t* fileName, float width, uint32_t subdivideCount, const wchar_t* heightMapLeft, const wchar_t* heightMapRight);
+
+	// Serialize generated geometry, write it to file and use it as cache.
+	// Cache is still usable if file can't be written.
+	void Create(
+		const wchar_t* fileName, float width, uint32_t subdivideCount, uint64_t heightMapKey,
+		const std::vector<VertexTess>& vertices,
+		const std::vector<uint32_t>& indices,
+		const std::vector<FaceTree*>& faceTrees);
+
+	std::vector<FaceTree*> CreateFaceTrees() const;
+
+	const VertexTess*	GetVertices() const { return reinterpret_cast<const VertexTess*>(m_data + sizeof(Header)); }
+	const uint32_t*		GetIndices() const { return reinterpret_cast<const uint32_t*>(GetVertices() + GetHeader().vertexCount); }
+	uint32_t			GetVertexCount() const { return GetHeader().vertexCount; }
+	uint32_t			GetIndexCount() const { return GetHeader().indexCount; }
+
+private:
+	static constexpr uint32_t c_magic = 0x4D4C5041;	// 'APLM'
+	static constexpr uint32_t c_version = 5;
+
+	struct Header
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		float		width;
+		uint32_t	subdivideCount;
+		uint32_t	maxLevel;
+		uint32_t	vertexStride;
+		uint32_t	nodeStride;
+		uint32_t	vertexCount;
+		uint32_t	indexCount;
+		uint32_t	nodeCount;
+		uint64_t	heightMapKey;
+		uint64_t	checksum;
+	};
+
+	const Header&			GetHeader() const { return *reinterpret_cast<const Header*>(m_data); }
+	const QuadNodeRecord*	GetNodes() const { return reinterpret_cast<const QuadNodeRecord*>(GetIndices() + GetHeader().indexCount); }
+
+	static Header CreateHeader(float width, uint32_t subdivideCount, uint64_t heightMapKey);
+	static uint64_t CalcChecksum(const uint8_t* data, size_t size);
+
+	void Release();
+
+	HANDLE					m_file = INVALID_HANDLE_VALUE;
+	HANDLE					m_mapping = nullptr;
+	const uint8_t*			m_data = nullptr;
+	std::vector<uint8_t>	m_ownedData;
+};
@@ -0,0 +1,293 @@
+#include "pch.h"
+#include "MipLoader.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+MipLoader::MipLoader(uint32_t chunkSize, uint32_t chunkCount)
+	: m_chunkSize(chunkSize), m_chunkCount(chunkCount)
+{
+	// Lowest buffers are taken first.
+	for (uint32_t buffer = chunkCount; buffer > 0; buffer--)
+		m_freeBuffers.push_back(buffer - 1);
+
+	// Every load holds a buffer, so none of these grow past it.
+	m_uploadedBuffers.reserve(chunkCount);
+	m_readyLoads.reserve(chunkCount);
+	m_queuedLoads.reserve(chunkCount);
+	m_completedLoads.reserve(chunkCount);
+}
+
+MipLoader::~MipLoader()
+{
+	Stop();
+}
+
+uint32_t MipLoader::AddTexture(std::unique_ptr<MipSource> source, uint32_t initialSize)
+{
+	const TileLayout& layout = source->GetLayout();
+
+	// Same rule as maxsize of DDSTextureLoader, keeping at least last mip.
+	uint32_t initialMip = 0;
+	while (initialSize > 0 && initialMip + 1 < layout.mipCount &&
+		(layout.GetMipWidth(initialMip) > initialSize || layout.GetMipHeight(initialMip) > initialSize))
+		initialMip++;
+
+	Texture texture = {};
+	texture.initialMip = initialMip;
+	texture.residentMip = initialMip;
+	texture.uploadedRows.assign(layout.mipCount, 0);
+	texture.queueMip = initialMip > 0 ? initialMip - 1 : layout.mipCount;
+	texture.dirty = true;
+
+	for (uint32_t mip = 0; mip < layout.mipCount; mip++)
+	{
+		m_stats.totalSize += GetMipSize(layout, mip);
+		if (mip >= initialMip)
+		{
+			texture.uploadedRows[mip] = layout.GetRowCount(mip);
+			m_stats.loadedSize += GetMipSize(layout, mip);
+		}
+	}
+
+	const uint32_t alignedPitch = (layout.GetRowPitch(0) + MIP_LOADER_PITCH_ALIGNMENT - 1) / MIP_LOADER_PITCH_ALIGNMENT * MIP_LOADER_PITCH_ALIGNMENT;
+	m_bufferSize = std::max({ m_bufferSize, static_cast<size_t>(m_chunkSize), static_cast<size_t>(layout.GetRowPitch(0)) });
+	m_maxChunkSize = std::max({ m_maxChunkSize, static_cast<size_t>(m_chunkSize), static_cast<size_t>(alignedPitch) });
+	if (initialMip == 0)
+		m_completeCount++;
+
+	texture.source = std::move(source);
+	m_textures.push_back(std::move(texture));
+
+	return static_cast<uint32_t>(m_textures.size()) - 1;
+}
+
+bool MipLoader::ReadInitialMips(uint32_t texture, std::vector<uint8_t>& data) const
+{
+	PROFILE_SCOPE("Read initial mips");
+
+	const Texture& t = m_textures[texture];
+	const TileLayout& layout = t.source->GetLayout();
+
+	uint64_t size = 0;
+	for (uint32_t mip = t.initialMip; mip < layout.mipCount; mip++)
+		size += GetMipSize(layout, mip);
+	data.resize(static_cast<size_t>(size));
+
+	uint8_t* mipData = data.data();
+	for (uint32_t mip = t.initialMip; mip < layout.mipCount; mip++)
+	{
+		if (!t.source->ReadRows(mip, 0, layout.GetRowCount(mip), mipData))
+			return false;
+
+		mipData += GetMipSize(layout, mip);
+	}
+
+	return true;
+}
+
+void MipLoader::Start()
+{
+	if (m_thread.joinable() || m_stopped)
+		return;
+
+	m_buffers.resize(m_bufferSize * m_chunkCount);
+
+	m_stop = false;
+	m_thread = std::thread(&MipLoader::LoaderMain, this);
+}
+
+void MipLoader::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+
+		for (const Load& load : m_queuedLoads)
+			m_freeBuffers.push_back(load.buffer);
+		m_queuedLoads.clear();
+	}
+
+	m_wakeCondition.notify_all();
+	m_thread.join();
+	m_stopped = true;
+}
+
+void MipLoader::LoaderMain()
+{
+	PROFILE_THREAD_NAME("Mip loader");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wakeCondition.wait(lock, [this]() { return m_stop || !m_queuedLoads.empty(); });
+		if (m_stop)
+			return;
+
+		Load load = m_queuedLoads.front();
+		m_queuedLoads.erase(m_queuedLoads.begin());
+		lock.unlock();
+
+		{
+			PROFILE_SCOPE("Read mip rows");
+
+			const auto readStart = std::chrono::high_resolution_clock::now();
+			load.succeeded = m_textures[load.texture].source->ReadRows(
+				load.mip, load.firstRow, load.rowCount, &m_buffers[load.buffer * m_bufferSize]);
+			load.readTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - readStart).count();
+		}
+
+		lock.lock();
+		m_completedLoads.push_back(load);
+	}
+}
+
+uint32_t MipLoader::Update(uint32_t maxUploads, std::vector<MipUpload>& updates)
+{
+	PROFILE_SCOPE("Mip loader update");
+
+	updates.clear();
+
+	// Renderer copied rows handed out last time.
+	m_freeBuffers.insert(m_freeBuffers.end(), m_uploadedBuffers.begin(), m_uploadedBuffers.end());
+	m_uploadedBuffers.clear();
+
+	UploadLoads(maxUploads, updates);
+	if (!m_stopped)
+		QueueLoads();
+
+	uint32_t dirtyMask = 0;
+	for (uint32_t t = 0; t < m_textures.size(); t++)
+	{
+		if (m_textures[t].dirty || m_firstUpdate)
+			dirtyMask |= 1u << t;
+		m_textures[t].dirty = false;
+	}
+	m_firstUpdate = false;
+
+	return dirtyMask;
+}
+
+void MipLoader::UploadLoads(uint32_t maxUploads, std::vector<MipUpload>& updates)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_readyLoads.insert(m_readyLoads.end(), m_completedLoads.begin(), m_completedLoads.end());
+		m_completedLoads.clear();
+	}
+
+	m_stats.uploadCount = 0;
+	uint32_t readyCount = 0;
+	for (; readyCount < m_readyLoads.size() && m_stats.uploadCount < maxUploads; readyCount++)
+	{
+		const Load& load = m_readyLoads[readyCount];
+
+		Texture& texture = m_textures[load.texture];
+		m_totalReadTime += load.readTime;
+		m_readCount++;
+		if (!load.succeeded || texture.failed)
+		{
+			// Texture is done where it is, its chunks still in flight are dropped.
+			if (!texture.failed)
+			{
+				texture.failed = true;
+				texture.queueMip = GetLayout(load.texture).mipCount;
+				m_stats.failedTextureCount++;
+				m_completeCount++;
+			}
+			m_freeBuffers.push_back(load.buffer);
+			continue;
+		}
+
+		MipUpload update = {};
+		update.texture = load.texture;
+		update.mip = load.mip;
+		update.firstRow = load.firstRow;
+		update.rowCount = load.rowCount;
+		update.data = &m_buffers[load.buffer * m_bufferSize];
+		updates.push_back(update);
+
+		texture.uploadedRows[load.mip] += load.rowCount;
+		m_stats.loadedSize += static_cast<uint64_t>(load.rowCount) * GetLayout(load.texture).GetRowPitch(load.mip);
+		UpdateResidentMip(texture);
+
+		m_uploadedBuffers.push_back(load.buffer);
+		m_stats.uploadCount++;
+		m_stats.uploadedChunkCount++;
+	}
+	m_readyLoads.erase(m_readyLoads.begin(), m_readyLoads.begin() + readyCount);
+}
+
+void MipLoader::QueueLoads()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (!m_freeBuffers.empty())
+	{
+		// Coarsest mip left of any texture, so every texture sharpens evenly.
+		uint32_t next = UINT32_MAX;
+		for (uint32_t t = 0; t < m_textures.size(); t++)
+		{
+			const Texture& texture = m_textures[t];
+			if (texture.queueMip < GetLayout(t).mipCount && (next == UINT32_MAX || texture.queueMip > m_textures[next].queueMip))
+				next = t;
+		}
+		if (next == UINT32_MAX)
+			break;
+
+		Texture& texture = m_textures[next];
+		const TileLayout& layout = GetLayout(next);
+		const uint32_t alignedPitch =
+			(layout.GetRowPitch(texture.queueMip) + MIP_LOADER_PITCH_ALIGNMENT - 1) / MIP_LOADER_PITCH_ALIGNMENT * MIP_LOADER_PITCH_ALIGNMENT;
+		const uint32_t chunkRows = std::max(m_chunkSize / alignedPitch, 1u);
+
+		Load load = {};
+		load.texture = next;
+		load.mip = texture.queueMip;
+		load.firstRow = texture.queueRow;
+		load.rowCount = std::min(chunkRows, layout.GetRowCount(texture.queueMip) - texture.queueRow);
+		load.buffer = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+		m_queuedLoads.push_back(load);
+
+		// Mip 0 is the last one queued.
+		texture.queueRow += load.rowCount;
+		if (texture.queueRow == layout.GetRowCount(texture.queueMip))
+		{
+			texture.queueMip = texture.queueMip > 0 ? texture.queueMip - 1 : layout.mipCount;
+			texture.queueRow = 0;
+		}
+	}
+
+	m_wakeCondition.notify_one();
+}
+
+void MipLoader::UpdateResidentMip(Texture& texture)
+{
+	const TileLayout& layout = texture.source->GetLayout();
+
+	const uint32_t residentMip = texture.residentMip;
+	while (texture.residentMip > 0 && texture.uploadedRows[texture.residentMip - 1] == layout.GetRowCount(texture.residentMip - 1))
+		texture.residentMip--;
+
+	if (texture.residentMip != residentMip)
+	{
+		texture.dirty = true;
+		if (texture.residentMip == 0)
+			m_completeCount++;
+	}
+}
+
+MipLoaderStats MipLoader::GetStats() const
+{
+	MipLoaderStats stats = m_stats;
+	stats.loadingChunkCount = m_chunkCount - static_cast<uint32_t>(m_freeBuffers.size() + m_uploadedBuffers.size());
+
+	stats.readTime = m_readCount > 0 ? static_cast<float>(m_totalReadTime / m_readCount) : 0.0f;
+
+	return stats;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TileStore.h"
+
+#define MIP_LOADER_PITCH_ALIGNMENT 256u		// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+
+// Source of mip rows for MipLoader. Only mip sizes and row pitches of layout are used, not its tiles.
+// ReadRows is called from loader thread, apart from initial mips.
+class MipSource
+{
+public:
+	virtual ~MipSource() = default;
+
+	virtual const TileLayout& GetLayout() const = 0;
+
+	// Write rows [firstRow, firstRow + rowCount) of mip into data, tightly packed. Rows are of blocks for BC formats.
+	// Returns false if they can't be read.
+	virtual bool ReadRows(uint32_t mip, uint32_t firstRow, uint32_t rowCount, OUT uint8_t* data) = 0;
+};
+
+// Rows of a mip read since last Update, to be copied into texture in order.
+struct MipUpload
+{
+	uint32_t				texture;
+	uint32_t				mip;
+	uint32_t				firstRow;
+	uint32_t				rowCount;
+	const uint8_t*			data;			// rowCount rows of layout row pitch, valid until next Update
+};
+
+struct MipLoaderStats
+{
+	uint64_t				loadedSize;			// Bytes of initial mips and uploaded rows
+	uint64_t				totalSize;			// Bytes of every mip
+	uint32_t				loadingChunkCount;	// Queued, being read or waiting for upload
+	uint32_t				uploadCount;		// Chunks of last Update
+	uint64_t				uploadedChunkCount;	// Since Start
+	uint32_t				failedTextureCount;
+	float					readTime;			// Average milliseconds of one chunk read
+};
+
+// CPU side of progressive texture loading, with no device object.
+// Mips no larger than initial size, the same ones maxsize of DDSTextureLoader keeps, are read up front so
+// a texture can be drawn right away. Finer mips are read by the loader thread in chunks of rows, coarsest
+// mip of every texture first, and handed out at most maxUploads chunks per Update.
+//
+// A mip becomes resident once all its rows are handed out. Renderer clamps sampling to resident mip,
+// so finer mips of texture may hold anything before then. A texture whose read fails stays at its resident mip.
+//
+// Nothing is allocated per Update.
+class MipLoader
+{
+public:
+	// Chunks are at most chunkSize bytes with rows aligned to MIP_LOADER_PITCH_ALIGNMENT, unless a single row is larger.
+	MipLoader(uint32_t chunkSize, uint32_t chunkCount);
+	~MipLoader();
+
+	MipLoader(const MipLoader&) = delete;
+	MipLoader& operator=(const MipLoader&) = delete;
+
+	// Add texture before Start. initialSize of 0 makes every mip initial. Returns texture index.
+	uint32_t AddTexture(std::unique_ptr<MipSource> source, uint32_t initialSize);
+
+	// Rows of every initial mip, finest first and tightly packed. Returns false if they can't be read.
+	bool ReadInitialMips(uint32_t texture, OUT std::vector<uint8_t>& data) const;
+
+	// Start and stop loader thread. Stop drops queued chunks and waits for current one, loading doesn't resume.
+	void Start();
+	void Stop();
+
+	// Returns mask of textures whose resident mip changed, including every texture on first call.
+	uint32_t Update(uint32_t maxUploads, OUT std::vector<MipUpload>& updates);
+
+	// Every texture is resident down to mip 0, or failed.
+	bool IsComplete() const { return m_completeCount == m_textures.size(); }
+
+	uint32_t				GetTextureCount() const { return static_cast<uint32_t>(m_textures.size()); }
+	const TileLayout&		GetLayout(uint32_t texture) const { return m_textures[texture].source->GetLayout(); }
+	uint32_t				GetInitialMip(uint32_t texture) const { return m_textures[texture].initialMip; }
+
+	// Finest mip whose rows and those of every coarser mip were handed out.
+	uint32_t				GetResidentMip(uint32_t texture) const { return m_textures[texture].residentMip; }
+
+	// Largest chunk with rows aligned to MIP_LOADER_PITCH_ALIGNMENT.
+	size_t					GetMaxChunkSize() const { return m_maxChunkSize; }
+	MipLoaderStats			GetStats() const;
+
+	static uint64_t GetMipSize(const TileLayout& layout, uint32_t mip)
+	{
+		return static_cast<uint64_t>(layout.GetRowPitch(mip)) * layout.GetRowCount(mip);
+	}
+
+private:
+	struct Texture
+	{
+		std::unique_ptr<MipSource>	source;
+		uint32_t					initialMip;
+		uint32_t					residentMip;
+		std::vector<uint32_t>		uploadedRows;	// Per mip
+		uint32_t					queueMip;		// Next chunk to queue, mip count when every one is queued
+		uint32_t					queueRow;
+		bool						failed;
+		bool						dirty;
+	};
+
+	struct Load
+	{
+		uint32_t					texture;
+		uint32_t					mip;
+		uint32_t					firstRow;
+		uint32_t					rowCount;
+		uint32_t					buffer;
+		bool						succeeded;
+		float						readTime;
+	};
+
+	void LoaderMain();
+
+	void UploadLoads(uint32_t maxUploads, OUT std::vector<MipUpload>& updates);
+	void QueueLoads();
+	void UpdateResidentMip(Texture& texture);
+
+	uint32_t						m_chunkSize;
+	uint32_t						m_chunkCount;
+	size_t							m_bufferSize = 0;	// Chunk size, or largest row
+	size_t							m_maxChunkSize = 0;
+
+	std::vector<Texture>			m_textures;
+	uint32_t						m_completeCount = 0;
+	bool							m_firstUpdate = true;
+
+	// Staging buffers of loads, chunkCount of them.
+	std::vector<uint8_t>			m_buffers;
+	std::vector<uint32_t>			m_freeBuffers;
+	std::vector<uint32_t>			m_uploadedBuffers;	// Handed out by last Update
+	std::vector<Load>				m_readyLoads;		// Read, waiting for upload budget
+
+	std::thread						m_thread;
+	mutable std::mutex				m_mutex;
+	std::condition_variable			m_wakeCondition;
+	std::vector<Load>				m_queuedLoads;
+	std::vector<Load>				m_completedLoads;
+	bool							m_stop = false;
+	bool							m_stopped = false;
+
+	MipLoaderStats					m_stats = {};
+	double							m_totalReadTime = 0.0;
+	uint64_t						m_readCount = 0;
+};
@@ -0,0 +1,191 @@
+#include "pch.h"
+#include "PatternCache.h"
+
+using namespace DirectX;
+
+void PatternInstances::Clear()
+{
+	if (buckets.size() != PatternCache::c_patternCount)
+		buckets.resize(PatternCache::c_patternCount);
+
+	for (std::vector<uint32_t>& bucket : buckets)
+		bucket.clear();
+	patchCount = 0;
+}
+
+uint64_t PatternInstances::GetInstanceCount() const
+{
+	uint64_t count = 0;
+	for (const std::vector<uint32_t>& bucket : buckets)
+		count += bucket.size();
+
+	return count;
+}
+
+PatternCache::PatternCache()
+{
+	m_stats = {};
+
+	// Every factor divides TESS_MAX_FACTOR, so points of all patterns are on one grid.
+	m_points.reserve(PATTERN_GRID_SIZE * PATTERN_GRID_SIZE);
+	for (uint32_t v = 0; v < PATTERN_GRID_SIZE; v++)
+	{
+		for (uint32_t u = 0; u < PATTERN_GRID_SIZE; u++)
+			m_points.emplace_back(static_cast<float>(u) / TESS_MAX_FACTOR, static_cast<float>(v) / TESS_MAX_FACTOR);
+	}
+
+	QuadDomain domain;
+
+	IntegerTessFactors quad = { { 1, 1, 1, 1 }, { 1, 1 } };
+	Tessellator::BuildDomain(quad, domain);
+	AddPattern(c_quadPattern, domain, 0, static_cast<uint32_t>(domain.indices.size()));
+
+	// Domain with four equal edges holds inner grid first, then strip of edges 0 to 3 (see BuildDomain).
+	for (uint32_t insideExponent = 1; insideExponent < PATTERN_EXPONENT_COUNT; insideExponent++)
+	{
+		const uint32_t inside = 1u << insideExponent;
+		const uint32_t innerCount = 6 * (inside - 2) * (inside - 2);
+
+		for (uint32_t edgeExponent = 0; edgeExponent < PATTERN_EXPONENT_COUNT; edgeExponent++)
+		{
+			const uint32_t edge = 1u << edgeExponent;
+			const IntegerTessFactors factors = { { edge, edge, edge, edge }, { inside, inside } };
+			Tessellator::BuildDomain(factors, domain);
+
+			if (edgeExponent == 0)
+				AddPattern(InnerPattern(insideExponent), domain, 0, innerCount);
+			if (edgeExponent == insideExponent)
+				AddPattern(UniformPattern(insideExponent), domain, 0, static_cast<uint32_t>(domain.indices.size()));
+
+			const uint32_t stripCount = 3 * (edge + inside - 2);
+			for (uint32_t e = 0; e < 4; e++)
+				AddPattern(StripPattern(e, edgeExponent, insideExponent), domain, innerCount + e * stripCount, stripCount);
+		}
+	}
+
+	m_stats.patternCount = c_patternCount;
+	m_stats.pointCount = static_cast<uint32_t>(m_points.size());
+	m_stats.triangleCount = static_cast<uint32_t>(m_indices.size() / 3);
+	m_stats.pointBytes = sizeof(XMFLOAT2) * m_points.size();
+	m_stats.indexBytes = sizeof(uint16_t) * m_indices.size();
+}
+
+void PatternCache::AddPattern(uint32_t pattern, const QuadDomain& domain, uint32_t startIndex, uint32_t indexCount)
+{
+	m_patterns[pattern] = { static_cast<uint32_t>(m_indices.size()), indexCount };
+	if (indexCount == 0)
+		m_stats.emptyPatternCount++;
+
+	// Domain index to grid point.
+	for (uint32_t i = startIndex; i < startIndex + indexCount; i++)
+	{
+		const XMFLOAT2& point = domain.points[domain.indices[i]];
+		const auto u = static_cast<uint32_t>(lroundf(point.x * TESS_MAX_FACTOR));
+		const auto v = static_cast<uint32_t>(lroundf(point.y * TESS_MAX_FACTOR));
+		m_indices.push_back(static_cast<uint16_t>(v * PATTERN_GRID_SIZE + u));
+	}
+}
+
+uint32_t PatternCache::FactorExponent(uint32_t factor)
+{
+	uint32_t exponent = 0;
+	while ((1u << exponent) < factor)
+		exponent++;
+
+	return exponent;
+}
+
+void PatternCache::SelectPatterns(float w, const PatchTessFactors& factors, uint32_t patch, PatchPatterns& patterns)
+{
+	const IntegerTessFactors tess = TessFactor::PartitionInteger(factors);
+
+	patterns.count = 0;
+	if (tess.IsQuad())
+	{
+		// Only corners, which always sample level 0.
+		patterns.patterns[0] = c_quadPattern;
+		patterns.instances[0] = PackInstance(patch, 0, 0);
+		patterns.count = 1;
+		return;
+	}
+
+	const uint32_t insideExponent = FactorExponent(tess.insideTess[0]);
+	const uint32_t insideLevel = TessFactor::CalcLevel(w, factors.insideTess[0]);
+
+	uint32_t edgeLevels[4];
+	bool uniform = true;
+	for (uint32_t e = 0; e < 4; e++)
+	{
+		edgeLevels[e] = TessFactor::CalcLevel(w, factors.edgeTess[e]);
+		uniform = uniform && tess.edgeTess[e] == tess.insideTess[0] && edgeLevels[e] == insideLevel;
+	}
+
+	if (uniform)
+	{
+		patterns.patterns[0] = UniformPattern(insideExponent);
+		patterns.instances[0] = PackInstance(patch, insideLevel, insideLevel);
+		patterns.count = 1;
+		return;
+	}
+
+	// Inside factor 2 has a single inner point and no inner triangles.
+	if (tess.insideTess[0] > 2)
+	{
+		patterns.patterns[patterns.count] = InnerPattern(insideExponent);
+		patterns.instances[patterns.count] = PackInstance(patch, insideLevel, insideLevel);
+		patterns.count++;
+	}
+
+	for (uint32_t e = 0; e < 4; e++)
+	{
+		patterns.patterns[patterns.count] = StripPattern(e, FactorExponent(tess.edgeTess[e]), insideExponent);
+		patterns.instances[patterns.count] = PackInstance(patch, insideLevel, edgeLevels[e]);
+		patterns.count++;
+	}
+}
+
+void PatternCache::BuildInstances(
+	const TessParameters& params, const VertexTess* vertices, const uint32_t* indices,
+	const IndexRange* ranges, uint32_t rangeCount, PatternInstances& instances)
+{
+	const float w = params.parameters.w;
+
+	// Patches of a group are contiguous in index buffer, so group is prepared once for all of them.
+	TessGroup group = {};
+	bool hasGroup = false;
+	PatchPatterns patterns;
+	for (uint32_t r = 0; r < rangeCount; r++)
+	{
+		const uint32_t end = ranges[r].start + ranges[r].count;
+		for (uint32_t index = ranges[r].start; index < end; index += 4)
+		{
+			const VertexTess* const patch[4] =
+			{
+				&vertices[indices[index]], &vertices[indices[index + 1]], &vertices[indices[index + 2]], &vertices[indices[index + 3]],
+			};
+
+			if (!hasGroup ||
+				group.quadPos.x != patch[3]->quadPos.x || group.quadPos.y != patch[3]->quadPos.y || group.quadPos.z != patch[3]->quadPos.z)
+			{
+				group = TessFactor::PrepareGroup(params, patch[3]->quadPos);
+				hasGroup = true;
+			}
+
+			SelectPatterns(w, TessFactor::EvaluatePatch(params, group, patch), index / 4, patterns);
+			for (uint32_t p = 0; p < patterns.count; p++)
+				instances.buckets[patterns.patterns[p]].push_back(patterns.instances[p]);
+			instances.patchCount++;
+		}
+	}
+}
+
+uint64_t PatternCache::CalcMaxInstanceCount(uint32_t patchCount, uint32_t unitCount)
+{
+	// Group has unitCount x unitCount patches, all but its inner (unitCount - 2)^2 touch a neighbour group.
+	unitCount = std::max(unitCount, 1u);
+	const uint64_t groupPatchCount = static_cast<uint64_t>(unitCount) * unitCount;
+	const uint64_t innerCount = unitCount > 2 ? static_cast<uint64_t>(unitCount - 2) * (unitCount - 2) : 0;
+	const uint64_t borderCount = groupPatchCount - innerCount;
+
+	return (patchCount / groupPatchCount) * (innerCount + PATTERN_MAX_PER_PATCH * borderCount);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Tessellator.h"
+
+#define PATTERN_EXPONENT_COUNT 7						// Factors 1, 2, 4, ..., TESS_MAX_FACTOR
+#define PATTERN_GRID_SIZE (TESS_MAX_FACTOR + 1)			// Every domain point is on this grid
+#define PATTERN_MAX_PER_PATCH 5							// Inner grid and four strips
+#define PATTERN_PATCH_BITS 22
+#define PATTERN_MAX_PATCH_COUNT (1u << PATTERN_PATCH_BITS)
+
+// Triangles of one pattern in index buffer of cache.
+struct PatternRange
+{
+	uint32_t				startIndex;
+	uint32_t				indexCount;
+};
+
+struct PatternCacheStats
+{
+	uint32_t				patternCount;
+	uint32_t				emptyPatternCount;		// Inner grid of inside factor 2
+	uint32_t				pointCount;
+	uint32_t				triangleCount;
+	uint64_t				pointBytes;
+	uint64_t				indexBytes;
+};
+
+// Patterns drawing one patch, with instance word of each.
+struct PatchPatterns
+{
+	uint32_t				count;
+	uint32_t				patterns[PATTERN_MAX_PER_PATCH];
+	uint32_t				instances[PATTERN_MAX_PER_PATCH];
+};
+
+// Instance words of every pattern for one view. Buckets keep their capacity, so a frame rarely allocates.
+struct PatternInstances
+{
+	std::vector<std::vector<uint32_t>>	buckets;
+	uint32_t							patchCount = 0;
+
+	void Clear();
+	uint64_t GetInstanceCount() const;
+};
+
+// Pre-tessellated patches for every power of two factor ConstantHS produces.
+// Full combinations of four edges and inside factor would be 7^5 grids, so a patch is drawn from pieces instead:
+// inner grid of its inside factor, and a transition strip for each edge (side, edge factor, inside factor).
+// Patches whose edges all match inside factor, most of a tess group, use one uniform pattern.
+// Pieces are cut from Tessellator::BuildDomain, so both paths emit the same triangles.
+//
+// Instance word is patch index (PATTERN_PATCH_BITS), inside level (3 bits) and edge level (3 bits).
+// Vertex shader reads patch corners from static IB/VB, and uses edge level for points on patch border.
+class PatternCache
+{
+public:
+	static constexpr uint32_t c_quadPattern = 0;
+	static constexpr uint32_t c_uniformPatternBase = 1;
+	static constexpr uint32_t c_innerPatternBase = c_uniformPatternBase + PATTERN_EXPONENT_COUNT - 1;
+	static constexpr uint32_t c_stripPatternBase = c_innerPatternBase + PATTERN_EXPONENT_COUNT - 1;
+	static constexpr uint32_t c_patternCount = c_stripPatternBase + 4 * PATTERN_EXPONENT_COUNT * (PATTERN_EXPONENT_COUNT - 1);
+
+	PatternCache();
+
+	PatternCache(const PatternCache&) = delete;
+	PatternCache& operator=(const PatternCache&) = delete;
+
+	// Domain points (u, v), indexed as row v * PATTERN_GRID_SIZE + u of the grid.
+	const std::vector<DirectX::XMFLOAT2>& GetPoints() const { return m_points; }
+	const std::vector<uint16_t>& GetIndices() const { return m_indices; }
+	const PatternRange& GetPattern(uint32_t pattern) const { return m_patterns[pattern]; }
+	const PatternCacheStats& GetStats() const { return m_stats; }
+
+	// Exponents are log2 of factors. Inside exponent is at least 1, as inside factor 1 is always a quad.
+	static uint32_t UniformPattern(uint32_t insideExponent) { return c_uniformPatternBase + insideExponent - 1; }
+	static uint32_t InnerPattern(uint32_t insideExponent) { return c_innerPatternBase + insideExponent - 1; }
+	static uint32_t StripPattern(uint32_t edge, uint32_t edgeExponent, uint32_t insideExponent)
+	{
+		return c_stripPatternBase + (edge * PATTERN_EXPONENT_COUNT + edgeExponent) * (PATTERN_EXPONENT_COUNT - 1) + insideExponent - 1;
+	}
+
+	static uint32_t PackInstance(uint32_t patch, uint32_t insideLevel, uint32_t edgeLevel)
+	{
+		return patch | insideLevel << PATTERN_PATCH_BITS | edgeLevel << (PATTERN_PATCH_BITS + 3);
+	}
+
+	// Exponent of a partitioned factor. ConstantHS only gives powers of two, others are rounded up.
+	static uint32_t FactorExponent(uint32_t factor);
+
+	// Patterns of one patch. w is max tess exponent of view, for levels.
+	static void SelectPatterns(float w, IN const PatchTessFactors& factors, uint32_t patch, OUT PatchPatterns& patterns);
+
+	// Select patterns of every patch of ranges and append instance words to buckets.
+	static void BuildInstances(
+		IN const TessParameters& params, IN const VertexTess* vertices, IN const uint32_t* indices,
+		IN const IndexRange* ranges, uint32_t rangeCount, OUT PatternInstances& instances);
+
+	// Most instances a view can have, when every patch of mesh is visible.
+	// Only patches on border of a tess group can be split into pieces.
+	static uint64_t CalcMaxInstanceCount(uint32_t patchCount, uint32_t unitCount);
+
+private:
+	void AddPattern(uint32_t pattern, IN const QuadDomain& domain, uint32_t startIndex, uint32_t indexCount);
+
+	std::vector<DirectX::XMFLOAT2>	m_points;
+	std::vector<uint16_t>			m_indices;
+	PatternRange					m_patterns[c_patternCount];
+	PatternCacheStats				m_stats;
+};
@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <cstdio>
+#include <string>
+
+namespace
+{
+	const auto g_epoch = std::chrono::steady_clock::now();
+}
+
+std::mutex Profiler::s_ringMutex;
+std::vector<Profiler::ThreadRing*> Profiler::s_rings;
+thread_local Profiler::ThreadRing* Profiler::t_ring = nullptr;
+
+uint64_t Profiler::Now()
+{
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count());
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadRing& ring = GetThreadRing();
+
+	// Only owner thread writes, so plain increment is enough. Release pairs with acquire in WriteChromeTrace.
+	const uint64_t index = ring.writeCount.load(std::memory_order_relaxed);
+	ring.events[index & (c_ringSize - 1)] = { name, start, end };
+	ring.writeCount.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	GetThreadRing().name = name;
+}
+
+Profiler::ThreadRing& Profiler::GetThreadRing()
+{
+	if (t_ring == nullptr)
+	{
+		auto ring = new ThreadRing();
+		ring->writeCount = 0;
+		ring->name = nullptr;
+
+		std::lock_guard<std::mutex> lock(s_ringMutex);
+		ring->threadId = static_cast<uint32_t>(s_rings.size());
+		s_rings.push_back(ring);
+		t_ring = ring;
+	}
+
+	return *t_ring;
+}
+
+bool Profiler::WriteChromeTrace(const wchar_t* fileName)
+{
+	std::string json = "{\"traceEvents\":[\n";
+	char line[256];
+	bool first = true;
+
+	const auto append = [&](int length)
+	{
+		if (length <= 0)
+			return;
+		if (!first)
+			json += ",\n";
+		json.append(line, std::min(static_cast<size_t>(length), sizeof(line) - 1));
+		first = false;
+	};
+
+	std::lock_guard<std::mutex> lock(s_ringMutex);
+	for (const ThreadRing* ringData : s_rings)
+	{
+		const ThreadRing& ring = *ringData;
+
+		if (ring.name != nullptr)
+		{
+			append(snprintf(line, sizeof(line),
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				ring.threadId, ring.name));
+		}
+
+		// Complete events, timestamps in microseconds.
+		const uint64_t writeCount = ring.writeCount.load(std::memory_order_acquire);
+		const uint64_t eventCount = std::min<uint64_t>(writeCount, c_ringSize);
+		for (uint64_t i = writeCount - eventCount; i < writeCount; i++)
+		{
+			const Event& event = ring.events[i & (c_ringSize - 1)];
+			append(snprintf(line, sizeof(line),
+				"{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, ring.threadId, event.start / 1000.0, (event.end - event.start) / 1000.0));
+		}
+	}
+	json += "\n]}\n";
+
+	const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	const BOOL result = WriteFile(file, json.data(), static_cast<DWORD>(json.size()), &written, nullptr);
+	CloseHandle(file);
+
+	return result && written == json.size();
+}
+
+#endif
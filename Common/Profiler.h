@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Scoped CPU markers recorded into per-thread rings, dumped on demand as Chrome trace JSON
+// (chrome://tracing or Perfetto). Compiled in for debug builds, or any build defining APOLLO_PROFILE.
+// Otherwise every marker compiles to nothing.
+#if !defined(NDEBUG) || defined(APOLLO_PROFILE)
+#define PROFILER_ENABLED 1
+#else
+#define PROFILER_ENABLED 0
+#endif
+
+#if PROFILER_ENABLED
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Name must be a string with static lifetime, only its pointer is recorded.
+#define PROFILE_SCOPE(name) const ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+
+class Profiler
+{
+public:
+	// Nanoseconds since first call.
+	static uint64_t Now();
+
+	static void Record(const char* name, uint64_t start, uint64_t end);
+	static void SetThreadName(const char* name);
+
+	// Write last events of every thread. Threads still recording may tear their oldest events,
+	// so call it between frames when culling workers are idle.
+	static bool WriteChromeTrace(const wchar_t* fileName);
+
+private:
+	// Per thread, power of two. Oldest events are overwritten.
+	static constexpr uint32_t c_ringSize = 1u << 15;
+
+	struct Event
+	{
+		const char*	name;
+		uint64_t	start;
+		uint64_t	end;
+	};
+
+	struct ThreadRing
+	{
+		Event					events[c_ringSize];
+		std::atomic<uint64_t>	writeCount;
+		uint32_t				threadId;
+		const char*				name;
+	};
+
+	static ThreadRing& GetThreadRing();
+
+	// Rings are never freed, so events of exited threads can still be written.
+	static std::mutex					s_ringMutex;
+	static std::vector<ThreadRing*>		s_rings;
+	static thread_local ThreadRing*		t_ring;
+};
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : m_name(name), m_start(Profiler::Now()) {}
+	~ProfileScope() { Profiler::Record(m_name, m_start, Profiler::Now()); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char*		m_name;
+	uint64_t		m_start;
+};
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif
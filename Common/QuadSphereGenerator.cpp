@@ -1,13 +1,54 @@
 #include "pch.h"
 #include "QuadSphereGenerator.h"
 
+#include <thread>
+
 using namespace DirectX;
 
-QuadSphereGenerator::QuadSphereInfo* QuadSphereGenerator::CreateQuadSphere(
-	float width, float height, float depth, std::uint32_t numSubdivisions)
+namespace
 {
-	MeshData meshData;
+	// Cube corners, front face (z = -1) then back face.
+	const XMFLOAT3 c_cubeCorners[8] =
+	{
+		XMFLOAT3(-1, -1, -1), XMFLOAT3(-1, +1, -1), XMFLOAT3(+1, +1, -1), XMFLOAT3(+1, -1, -1),
+		XMFLOAT3(+1, -1, +1), XMFLOAT3(+1, +1, +1), XMFLOAT3(-1, +1, +1), XMFLOAT3(-1, -1, +1),
+	};
+
+	// Corners of front, back, top, bottom, left and right faces, in quad index order.
+	const uint32_t c_faceCorners[24] =
+	{
+		0, 1, 3, 2,
+		6, 7, 5, 4,
+		1, 6, 2, 5,
+		7, 0, 4, 3,
+		7, 6, 0, 1,
+		3, 2, 4, 5,
+	};
+
+	// Cube edges, lower corner first. Welded seam vertices run from lower to higher corner.
+	const uint32_t c_cubeEdges[12][2] =
+	{
+		{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 0, 3 },
+		{ 4, 5 }, { 5, 6 }, { 6, 7 }, { 4, 7 },
+		{ 0, 7 }, { 1, 6 }, { 2, 5 }, { 3, 4 },
+	};
+
+	uint32_t GetCubeEdge(uint32_t corner0, uint32_t corner1)
+	{
+		const uint32_t low = std::min(corner0, corner1);
+		const uint32_t high = std::max(corner0, corner1);
+
+		uint32_t edge = 0;
+		while (c_cubeEdges[edge][0] != low || c_cubeEdges[edge][1] != high)
+			edge++;
+
+		return edge;
+	}
+}
 
+QuadSphereGenerator::QuadSphereInfo* QuadSphereGenerator::CreateQuadSphere(
+	float width, float height, float depth, std::uint32_t numSubdivisions, const HeightMap* heightMap, bool weldVertices)
+{
 	// Create the vertices.
 	VertexTess v[8];
 
@@ -15,145 +56,192 @@ QuadSphereGenerator::QuadSphereInfo* QuadSphereGenerator::CreateQuadSphere(
 	const float h2 = 0.5f * height;
 	const float d2 = 0.5f * depth;
 
-	// Fill in the front face vertex data.
-	v[0] = VertexTess(XMFLOAT3(-w2, -h2, -d2), XMFLOAT3(0, 0, 0));
-	v[1] = VertexTess(XMFLOAT3(-w2, +h2, -d2), XMFLOAT3(0, 0, 0));
-	v[2] = VertexTess(XMFLOAT3(+w2, +h2, -d2), XMFLOAT3(0, 0, 0));
-	v[3] = VertexTess(XMFLOAT3(+w2, -h2, -d2), XMFLOAT3(0, 0, 0));
-
-	// Fill in the back face vertex data.
-	v[4] = VertexTess(XMFLOAT3(+w2, -h2, +d2), XMFLOAT3(0, 0, 0));
-	v[5] = VertexTess(XMFLOAT3(+w2, +h2, +d2), XMFLOAT3(0, 0, 0));
-	v[6] = VertexTess(XMFLOAT3(-w2, +h2, +d2), XMFLOAT3(0, 0, 0));
-	v[7] = VertexTess(XMFLOAT3(-w2, -h2, +d2), XMFLOAT3(0, 0, 0));
-
-	meshData.vertices.assign(&v[0], &v[8]);
+	// Fill in the front and back face vertex data.
+	for (uint32_t c = 0; c < 8; c++)
+	{
+		const XMFLOAT3& corner = c_cubeCorners[c];
+		v[c] = VertexTess(XMFLOAT3(corner.x * w2, corner.y * h2, corner.z * d2), XMFLOAT3(0, 0, 0));
+	}
 
 	const uint32_t totalIndexCount = pow(4, numSubdivisions + 1) * 6;
 	const uint32_t faceIndexCount = totalIndexCount / 6;
+	const uint32_t gridSize = 1u << numSubdivisions;
 
-	// Create the indices.
-	uint32_t i[24];
+	// Face corner indices.
+	const uint32_t* i = c_faceCorners;
+
+	// Allocate final buffers once.
+	// Each face owns a contiguous block of faceIndexCount indices. Welded faces share corner and seam vertices,
+	// which are filled up front, and own the inner (2^n - 1)^2 vertices of their grid.
+	MeshData meshData;
+	if (weldVertices)
+	{
+		meshData.vertices.resize(static_cast<size_t>(gridSize) * gridSize * 6 + 2);
+		FillSeamVertices(meshData, v, numSubdivisions);
+	}
+	else
+	{
+		meshData.vertices.resize(static_cast<size_t>(gridSize + 1) * (gridSize + 1) * 6);
+	}
+	meshData.indices.resize(totalIndexCount);
 
-	// Fill in the front face index data
-	i[0] = 0; i[1] = 1; i[2] = 3; i[3] = 2;
+	// Fill faces and create face trees in parallel.
+	// Each worker only writes its own vertices and index block (see QuadTree::CalcBounds for quadPos).
+	std::vector<FaceTree*> faceTrees(6, nullptr);
+	std::vector<std::thread> workers;
+	for (uint32_t f = 0; f < 6; f++)
+	{
+		workers.emplace_back([&, f]()
+		{
+			const VertexTess corner[4] = { v[i[0 + f * 4]], v[i[1 + f * 4]], v[i[2 + f * 4]], v[i[3 + f * 4]] };
+			FillFaceGrid(meshData, corner, f, numSubdivisions, weldVertices);
+
+			// Corner vertices of face grid, in quad index order.
+			uint32_t index[4];
+			index[0] = GetGridVertex(f, 0, 0, numSubdivisions, weldVertices);
+			index[1] = GetGridVertex(f, 0, gridSize, numSubdivisions, weldVertices);
+			index[2] = GetGridVertex(f, gridSize, 0, numSubdivisions, weldVertices);
+			index[3] = GetGridVertex(f, gridSize, gridSize, numSubdivisions, weldVertices);
+
+			QuadTree quadTree;
+			quadTree.Build(
+				static_cast<char>(std::min(numSubdivisions, QUAD_NODE_MAX_LEVEL) + 1),
+				faceIndexCount, index, f * faceIndexCount,
+				meshData.vertices, meshData.indices, heightMap);
+
+			faceTrees[f] = new FaceTree(std::move(quadTree), faceIndexCount);
+		});
+	}
 
-	// Fill in the back face index data
-	i[4] = 6; i[5] = 7; i[6] = 5; i[7] = 4;
+	for (auto& worker : workers)
+		worker.join();
 
-	// Fill in the top face index data
-	i[8] = 1; i[9] = 6; i[10] = 2; i[11] = 5;
+	return new QuadSphereInfo(std::move(meshData.vertices), std::move(meshData.indices), std::move(faceTrees));
+}
 
-	// Fill in the bottom face index data
-	i[12] = 7; i[13] = 0; i[14] = 4; i[15] = 3;
+XMFLOAT3 QuadSphereGenerator::GetFaceCorner(std::uint32_t face, std::uint32_t corner)
+{
+	return c_cubeCorners[c_faceCorners[face * 4 + corner]];
+}
 
-	// Fill in the left face index data
-	i[16] = 7; i[17] = 6; i[18] = 0; i[19] = 1;
+void QuadSphereGenerator::FillSeamVertices(MeshData& meshData, const VertexTess cubeCorners[8], std::uint32_t numSubdivisions)
+{
+	const uint32_t gridSize = 1u << numSubdivisions;
 
-	// Fill in the right face index data
-	i[20] = 3; i[21] = 2; i[22] = 4; i[23] = 5;
+	for (uint32_t c = 0; c < 8; c++)
+		meshData.vertices[c] = cubeCorners[c];
 
-	meshData.indices.assign(&i[0], &i[24]);
+	// Same steps as face grids, so seam positions are exactly the ones of either face.
+	for (uint32_t e = 0; e < 12; e++)
+	{
+		const XMVECTOR from = XMLoadFloat3(&cubeCorners[c_cubeEdges[e][0]].position);
+		const XMVECTOR step = (XMLoadFloat3(&cubeCorners[c_cubeEdges[e][1]].position) - from) / static_cast<float>(gridSize);
 
-	// Subdivide.
-	for (char level = 0; level < numSubdivisions; ++level)
-		SubdivideQuad(meshData);
+		for (uint32_t s = 1; s < gridSize; s++)
+			XMStoreFloat3(&meshData.vertices[8 + e * (gridSize - 1) + s - 1].position, from + step * static_cast<float>(s));
+	}
+}
 
-	// Create Face Trees. 
-	std::vector<FaceTree*> faceTrees;
-	for (int f = 0; f < 6; f++)
+void QuadSphereGenerator::FillFaceGrid(
+	MeshData& meshData, const VertexTess corner[4], std::uint32_t face, std::uint32_t numSubdivisions, bool weldVertices)
+{
+	const uint32_t gridSize = 1u << numSubdivisions;
+	const uint32_t gridPitch = gridSize + 1;
+	const uint32_t faceIndexCount = 4u << (2 * numSubdivisions);
+
+	// Corners are in quad index order, which is (0, 0), (0, N), (N, 0), (N, N) on grid.
+	const XMVECTOR origin = XMLoadFloat3(&corner[0].position);
+	const XMVECTOR right = (XMLoadFloat3(&corner[2].position) - origin) / static_cast<float>(gridSize);
+	const XMVECTOR up = (XMLoadFloat3(&corner[1].position) - origin) / static_cast<float>(gridSize);
+
+	// Create the vertices, welded seams are already filled.
+	// Positions are exactly the same as the repeated midpoints (grid steps are dyadic).
+	std::vector<uint32_t> gridVertices(static_cast<size_t>(gridPitch) * gridPitch);
+	for (uint32_t y = 0; y < gridPitch; y++)
 	{
-		uint32_t index[4];
-		index[0] = i[0 + f * 4];
-		index[1] = i[1 + f * 4];
-		index[2] = i[2 + f * 4];
-		index[3] = i[3 + f * 4];
-
-		const auto root = new QuadNode(0, faceIndexCount, index, f * faceIndexCount, width);
-		root->CalcCenter(meshData.vertices, meshData.indices);
-		root->CreateChildren(
-			std::min(numSubdivisions, QUAD_NODE_MAX_LEVEL), 
-			meshData.vertices, 
-			meshData.indices);
-
-		faceTrees.push_back(new FaceTree(root, faceIndexCount));
+		for (uint32_t x = 0; x < gridPitch; x++)
+		{
+			const uint32_t vertex = GetGridVertex(face, x, y, numSubdivisions, weldVertices);
+			gridVertices[y * gridPitch + x] = vertex;
+
+			const bool seam = x == 0 || y == 0 || x == gridSize || y == gridSize;
+			if (seam && weldVertices)
+				continue;
+
+			const XMVECTOR pos = origin + right * static_cast<float>(x) + up * static_cast<float>(y);
+			XMStoreFloat3(&meshData.vertices[vertex].position, pos);
+		}
 	}
 
-	return new QuadSphereInfo(meshData.vertices, meshData.indices, faceTrees);
+	// Create the indices.
+	const GridPoint root[4] = { { 0, 0 }, { 0, gridSize }, { gridSize, 0 }, { gridSize, gridSize } };
+	FillQuadIndices(&meshData.indices[face * faceIndexCount], root, gridVertices.data(), gridPitch, numSubdivisions);
 }
 
-void QuadSphereGenerator::SubdivideQuad(MeshData& meshData)
+std::uint32_t QuadSphereGenerator::GetGridVertex(
+	std::uint32_t face, std::uint32_t x, std::uint32_t y, std::uint32_t numSubdivisions, bool weldVertices)
 {
-	// Save a copy of the input geometry.
-	const MeshData inputCopy = meshData;
+	const uint32_t gridSize = 1u << numSubdivisions;
+	if (!weldVertices)
+		return face * (gridSize + 1) * (gridSize + 1) + y * (gridSize + 1) + x;
 
-	// Reset only indices.
-	meshData.indices.resize(0);
+	// Welded vertices are cube corners, then inner points of each cube edge, then inner points of each face.
+	const bool seamX = x == 0 || x == gridSize;
+	const bool seamY = y == 0 || y == gridSize;
+	if (seamX && seamY)
+		return c_faceCorners[face * 4 + (x == 0 ? 0 : 2) + (y == 0 ? 0 : 1)];
 
-	const uint32_t numQuads = static_cast<uint32_t>(inputCopy.indices.size()) / 4;
-	for (uint32_t i = 0; i < numQuads; ++i)
+	if (seamX || seamY)
 	{
-		const int v0i = inputCopy.indices[i*4+0];
-		const int v1i = inputCopy.indices[i*4+1];
-		const int v2i = inputCopy.indices[i*4+3];
-		const int v3i = inputCopy.indices[i*4+2];
-
-		VertexTess v0 = inputCopy.vertices[v0i];
-		VertexTess v1 = inputCopy.vertices[v1i];
-		VertexTess v2 = inputCopy.vertices[v2i];
-		VertexTess v3 = inputCopy.vertices[v3i];
-
-		// Generate the midpoints.
-		VertexTess m0 = MidPoint(v0, v1);
-		VertexTess m1 = MidPoint(v1, v2);
-		VertexTess m2 = MidPoint(v2, v3);
-		VertexTess m3 = MidPoint(v3, v0);
-		VertexTess m4 = MidPoint(m0, m2);
-
-		// Add midpoints to vector.
-		const int m0i = static_cast<int>(meshData.vertices.size());
-		const int m1i = m0i + 1;
-		const int m2i = m1i + 1;
-		const int m3i = m2i + 1;
-		const int m4i = m3i + 1;
-
-		meshData.vertices.push_back(m0);
-		meshData.vertices.push_back(m1);
-		meshData.vertices.push_back(m2);
-		meshData.vertices.push_back(m3);
-		meshData.vertices.push_back(m4);
-
-		// Add indices to vector.
-		meshData.indices.push_back(v0i);
-		meshData.indices.push_back(m0i);
-		meshData.indices.push_back(m3i);
-		meshData.indices.push_back(m4i);
-
-		meshData.indices.push_back(v1i);
-		meshData.indices.push_back(m1i);
-		meshData.indices.push_back(m0i);
-		meshData.indices.push_back(m4i);
-
-		meshData.indices.push_back(v3i);
-		meshData.indices.push_back(m3i);
-		meshData.indices.push_back(m2i);
-		meshData.indices.push_back(m4i);
-
-		meshData.indices.push_back(v2i);
-		meshData.indices.push_back(m2i);
-		meshData.indices.push_back(m1i);
-		meshData.indices.push_back(m4i);
+		// Seam runs between face corners a and b (quad index order), point is t steps from a.
+		const uint32_t a = seamY ? (y == 0 ? 0 : 1) : (x == 0 ? 0 : 2);
+		const uint32_t b = seamY ? a + 2 : a + 1;
+		const uint32_t t = seamY ? x : y;
+
+		const uint32_t from = c_faceCorners[face * 4 + a];
+		const uint32_t to = c_faceCorners[face * 4 + b];
+		return 8 + GetCubeEdge(from, to) * (gridSize - 1) + (from < to ? t : gridSize - t) - 1;
 	}
+
+	const uint32_t innerSize = gridSize - 1;
+	return 8 + 12 * innerSize + face * innerSize * innerSize + (y - 1) * innerSize + x - 1;
 }
 
-VertexTess QuadSphereGenerator::MidPoint(const VertexTess& v0, const VertexTess& v1)
+void QuadSphereGenerator::FillQuadIndices(
+	std::uint32_t* indices, const GridPoint corner[4],
+	const std::uint32_t* gridVertices, std::uint32_t gridPitch, std::uint32_t remainingLevel)
 {
-	const XMVECTOR p0 = XMLoadFloat3(&v0.position);
-	const XMVECTOR p1 = XMLoadFloat3(&v1.position);
-	const XMVECTOR pos = 0.5f * (p0 + p1);
+	// Leaf quad, write corner indices.
+	if (remainingLevel == 0)
+	{
+		for (int k = 0; k < 4; k++)
+			indices[k] = gridVertices[corner[k].y * gridPitch + corner[k].x];
+		return;
+	}
 
-	VertexTess v;
-    XMStoreFloat3(&v.position, pos);
+	// Generate the midpoints.
+	const GridPoint m0 = MidPoint(corner[0], corner[1]);
+	const GridPoint m1 = MidPoint(corner[1], corner[3]);
+	const GridPoint m2 = MidPoint(corner[3], corner[2]);
+	const GridPoint m3 = MidPoint(corner[2], corner[0]);
+	const GridPoint m4 = MidPoint(corner[0], corner[3]);
 
-    return v;
+	// Children are stored in order and rotated same as QuadTree::BuildNode expects.
+	// Last corner of every child is center of parent, which hull shader uses for quad position.
+	const GridPoint children[4][4] =
+	{
+		{ corner[0], m0, m3, m4 },
+		{ corner[1], m1, m0, m4 },
+		{ corner[2], m3, m2, m4 },
+		{ corner[3], m2, m1, m4 },
+	};
+
+	const uint32_t childIndexCount = 1u << (2 * remainingLevel);
+	for (uint32_t c = 0; c < 4; c++)
+		FillQuadIndices(indices + c * childIndexCount, children[c], gridVertices, gridPitch, remainingLevel - 1);
+}
+
+QuadSphereGenerator::GridPoint QuadSphereGenerator::MidPoint(const GridPoint& p0, const GridPoint& p1)
+{
+	return { (p0.x + p1.x) / 2, (p0.y + p1.y) / 2 };
 }
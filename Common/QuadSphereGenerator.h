@@ -21,20 +21,41 @@ public:
 		std::vector<FaceTree*> faceTrees;
 
 		QuadSphereInfo(
-			const std::vector<VertexTess>& vertices,
-			const std::vector<uint32_t>& indices,
-			const std::vector<FaceTree*>& faceTrees)
+			std::vector<VertexTess>&& vertices,
+			std::vector<uint32_t>&& indices,
+			std::vector<FaceTree*>&& faceTrees)
 		{
-			this->vertices = vertices;
-			this->indices = indices;
-			this->faceTrees = faceTrees;
+			this->vertices = std::move(vertices);
+			this->indices = std::move(indices);
+			this->faceTrees = std::move(faceTrees);
 		}
 	};
 
+	// Node bounds are fit to heightMap if given (see QuadTree::Build).
+	// Welded sphere has one vertex per grid point, also on cube face seams (6 * 4^n + 2 vertices).
+	// Otherwise every face owns its (2^n + 1)^2 vertex grid.
 	static QuadSphereInfo* CreateQuadSphere(
 		float width, float height, float depth,
-		std::uint32_t numSubdivisions);
+		std::uint32_t numSubdivisions, const HeightMap* heightMap, bool weldVertices = true);
+
+	// Corner of face on cube [-1, 1]^3, in quad index order: (0, 0), (0, N), (N, 0), (N, N) of face grid.
+	// Faces are front, back, top, bottom, left and right, same order as face trees.
+	static DirectX::XMFLOAT3 GetFaceCorner(std::uint32_t face, std::uint32_t corner);
 private:
-	static void SubdivideQuad(MeshData& meshData);
-	static VertexTess MidPoint(const VertexTess& v0, const VertexTess& v1);
-};
\ No newline at end of file
+	struct GridPoint
+	{
+		std::uint32_t x;
+		std::uint32_t y;
+	};
+
+	static void FillSeamVertices(MeshData& meshData, const VertexTess cubeCorners[8], std::uint32_t numSubdivisions);
+	static void FillFaceGrid(
+		MeshData& meshData, const VertexTess corner[4],
+		std::uint32_t face, std::uint32_t numSubdivisions, bool weldVertices);
+	static std::uint32_t GetGridVertex(
+		std::uint32_t face, std::uint32_t x, std::uint32_t y, std::uint32_t numSubdivisions, bool weldVertices);
+	static void FillQuadIndices(
+		std::uint32_t* indices, const GridPoint corner[4],
+		const std::uint32_t* gridVertices, std::uint32_t gridPitch, std::uint32_t remainingLevel);
+	static GridPoint MidPoint(const GridPoint& p0, const GridPoint& p1);
+};
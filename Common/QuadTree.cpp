@@ -0,0 +1,554 @@
+#include "pch.h"
+#include "QuadTree.h"
+
+#include <cfloat>
+
+using namespace DirectX;
+
+QuadTree::QuadTree(const QuadNodeRecord* records, char levelCount)
+{
+	m_levelCount = levelCount;
+
+	const uint32_t nodeCount = CalcNodeCount(levelCount);
+	m_obbCenters.resize(nodeCount);
+	m_obbExtents.resize(nodeCount);
+	m_obbOrientations.resize(nodeCount);
+	m_baseAddresses.resize(nodeCount);
+	m_indexCounts.resize(nodeCount);
+	m_coneAxes.resize(nodeCount);
+	m_coneAngles.resize(nodeCount);
+	m_maxRadii.resize(nodeCount);
+
+	for (uint32_t n = 0; n < nodeCount; n++)
+	{
+		m_obbCenters[n] = records[n].obbCenter;
+		m_obbExtents[n] = records[n].obbExtents;
+		m_obbOrientations[n] = records[n].obbOrientation;
+		m_baseAddresses[n] = records[n].baseAddress;
+		m_indexCounts[n] = records[n].indexCount;
+		m_coneAxes[n] = records[n].coneAxis;
+		m_coneAngles[n] = records[n].coneAngle;
+		m_maxRadii[n] = records[n].maxRadius;
+	}
+
+	CreateCullData();
+}
+
+void QuadTree::Build(
+	const char levelCount, uint32_t indexCount, uint32_t index[4], uint32_t baseAddress,
+	std::vector<VertexTess>& vertices, const std::vector<uint32_t>& indices, const HeightMap* heightMap)
+{
+	m_levelCount = levelCount;
+
+	const uint32_t nodeCount = CalcNodeCount(levelCount);
+	m_obbCenters.resize(nodeCount);
+	m_obbExtents.resize(nodeCount);
+	m_obbOrientations.resize(nodeCount);
+	m_baseAddresses.resize(nodeCount);
+	m_indexCounts.resize(nodeCount);
+	m_coneAxes.resize(nodeCount);
+	m_coneAngles.resize(nodeCount);
+	m_maxRadii.resize(nodeCount);
+
+	BuildNode(0, 0, indexCount, index, baseAddress, vertices, indices, heightMap);
+	CreateCullData();
+}
+
+void QuadTree::GetRecords(std::vector<QuadNodeRecord>& records) const
+{
+	for (uint32_t n = 0; n < GetNodeCount(); n++)
+	{
+		QuadNodeRecord record = {};
+		record.obbCenter = m_obbCenters[n];
+		record.obbExtents = m_obbExtents[n];
+		record.obbOrientation = m_obbOrientations[n];
+		record.baseAddress = m_baseAddresses[n];
+		record.indexCount = m_indexCounts[n];
+		record.coneAxis = m_coneAxes[n];
+		record.coneAngle = m_coneAngles[n];
+		record.maxRadius = m_maxRadii[n];
+		records.push_back(record);
+	}
+}
+
+void QuadTree::BuildNode(
+	uint32_t node, char level, uint32_t indexCount, uint32_t index[4], uint32_t baseAddress,
+	std::vector<VertexTess>& vertices, const std::vector<uint32_t>& indices, const HeightMap* heightMap)
+{
+	CalcBounds(node, level, indexCount, index, baseAddress, vertices, indices, heightMap);
+
+	if (level + 1 >= m_levelCount)
+		return;
+
+	for (int c = 0; c < 4; c++)
+	{
+		const uint32_t qic = indexCount / 4;
+		const uint32_t qqic = qic / 4;
+
+		uint32_t childIndex[4];
+		childIndex[0] = indices[0 * qqic + c * qic + baseAddress];
+		childIndex[1] = indices[1 * qqic + c * qic + baseAddress];
+		childIndex[2] = indices[2 * qqic + c * qic + baseAddress];
+		childIndex[3] = indices[3 * qqic + c * qic + baseAddress];
+
+		BuildNode(4 * node + 1 + c, level + 1, qic, childIndex, c * qic + baseAddress, vertices, indices, heightMap);
+	}
+}
+
+void QuadTree::CalcBounds(
+	uint32_t node, char level, uint32_t indexCount, uint32_t index[4], uint32_t baseAddress,
+	std::vector<VertexTess>& vertices, const std::vector<uint32_t>& indices, const HeightMap* heightMap)
+{
+	// Calculate center position with corner position
+	auto center = XMVectorSet(0, 0, 0, 0);
+	for (int i = 0; i < 4; i++)
+	{
+		center += XMLoadFloat3(&vertices[index[i]].position);
+	}
+	center /= 4.0f;
+
+	// Store quad center position on sphere
+	XMFLOAT3 centerPosition;
+	XMStoreFloat3(&centerPosition, center);
+
+	// Hull shader reads quadPos of last corner only, which is center of parent quad. It's never on a face seam,
+	// so faces sharing welded seam vertices can be built in parallel.
+	if (level == QUAD_NODE_MAX_LEVEL)
+	{
+		if (QUAD_NODE_MAX_LEVEL == TESS_GROUP_QUAD_LEVEL)
+		{
+			for (uint32_t base = baseAddress + 3; base < baseAddress + indexCount; base += 4)
+			{
+				vertices[indices[base]].quadPos = centerPosition;
+			}
+		}
+		else
+		{
+			// Calculate sub quad center position for 5u level (virtual quad node)
+
+			XMVECTOR right = XMLoadFloat3(&vertices[index[2]].position) - XMLoadFloat3(&vertices[index[0]].position);
+			XMVECTOR up = XMLoadFloat3(&vertices[index[1]].position) - XMLoadFloat3(&vertices[index[0]].position);
+
+			for (int step = 0; step < 4; step++)
+			{
+				XMVECTOR subCenter = XMLoadFloat3(&centerPosition);
+				if (step == 0)
+				{
+					subCenter = subCenter - right * 0.25f - up * 0.25f;
+				}
+				else if (step == 1)
+				{
+					subCenter = subCenter - right * 0.25f + up * 0.25f;
+				}
+				else if (step == 2)
+				{
+					subCenter = subCenter + right * 0.25f - up * 0.25f;
+				}
+				else
+				{
+					subCenter = subCenter + right * 0.25f + up * 0.25f;
+				}
+
+				const uint32_t base = baseAddress + step * (indexCount / 4);
+				for (uint32_t i = 3; i < indexCount / 4; i += 4)
+				{
+					XMStoreFloat3(&vertices[indices[base + i]].quadPos, subCenter);
+				}
+			}
+		}
+	}
+
+	// Calculate cone of patch directions on sphere.
+	// Patch is radial projection of planar quad, so the widest direction is one of the corners.
+	const XMVECTOR coneAxis = XMVector3Normalize(center);
+	float coneAngle = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		const XMVECTOR cornerDir = XMVector3Normalize(XMLoadFloat3(&vertices[index[i]].position));
+		const float cosAngle = XMVectorGetX(XMVector3Dot(coneAxis, cornerDir));
+		coneAngle = std::max(coneAngle, acos(std::min(std::max(cosAngle, -1.0f), 1.0f)));
+	}
+
+	// Sample patch boundary on sphere, corners in order 0, 1, 3, 2.
+	// Edges of planar quad are great circle arcs after projection.
+	constexpr uint32_t edgeSampleCount = 16;
+	constexpr uint32_t boundaryCount = 4 * edgeSampleCount;
+	static constexpr int edgeCorners[4][2] = { { 0, 1 }, { 1, 3 }, { 3, 2 }, { 2, 0 } };
+
+	XMVECTOR boundary[boundaryCount];
+	for (int e = 0; e < 4; e++)
+	{
+		const XMVECTOR from = XMLoadFloat3(&vertices[index[edgeCorners[e][0]]].position);
+		const XMVECTOR to = XMLoadFloat3(&vertices[index[edgeCorners[e][1]]].position);
+
+		for (uint32_t s = 0; s < edgeSampleCount; s++)
+			boundary[e * edgeSampleCount + s] = XMVector3Normalize(XMVectorLerp(from, to, static_cast<float>(s) / edgeSampleCount));
+	}
+
+	// Every point of boundary is within half of widest sample gap from a sample.
+	float maxGap = 0.0f;
+	for (uint32_t i = 0; i < boundaryCount; i++)
+		maxGap = std::max(maxGap, XMVectorGetX(XMVector3AngleBetweenNormals(boundary[i], boundary[(i + 1) % boundaryCount])));
+	const float halfGap = 0.5f * maxGap;
+
+	float minHeight, maxHeight;
+	CalcHeightRange(boundary, boundaryCount, coneAxis, coneAngle, halfGap, heightMap, minHeight, maxHeight);
+
+	const float minRadius = SPHERE_RADIUS + SPHERE_MAX_DISPLACEMENT * minHeight;
+	const float maxRadius = SPHERE_RADIUS + SPHERE_MAX_DISPLACEMENT * maxHeight;
+
+	// Calculate TBN
+	auto n = SimpleMath::Vector3(coneAxis);
+
+	const float theta = atan2(n.z, n.x);
+	auto t = SimpleMath::Vector3(-sin(theta), 0.0f, cos(theta));
+	t.Normalize();
+
+	auto b = n.Cross(t);
+	b.Normalize();
+
+	// Fit OBB in TBN frame to patch swept from minRadius to maxRadius.
+	// t and b are 90 degrees away from patch, so their extremes are on boundary.
+	// n itself is in patch, so highest point along n is maxRadius.
+	const XMVECTOR axes[3] = { t, b, n };
+	float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float high[3] = { -FLT_MAX, -FLT_MAX, maxRadius };
+
+	for (const XMVECTOR& direction : boundary)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			const float d = XMVectorGetX(XMVector3Dot(direction, axes[a]));
+			low[a] = std::min(low[a], std::min(d * minRadius, d * maxRadius));
+			high[a] = std::max(high[a], std::max(d * minRadius, d * maxRadius));
+		}
+	}
+
+	// Along an arc, a linear function exceeds its values at nearby samples by at most 1 - cos(halfGap).
+	const float arcMargin = maxRadius * (1.0f - cos(halfGap));
+	for (int a = 0; a < 3; a++)
+	{
+		low[a] -= arcMargin;
+		if (a < 2)
+			high[a] += arcMargin;
+	}
+
+	XMFLOAT3 obbCenter;
+	XMStoreFloat3(&obbCenter,
+		t * (0.5f * (low[0] + high[0])) + b * (0.5f * (low[1] + high[1])) + n * (0.5f * (low[2] + high[2])));
+
+	// Calculate quaternion
+	const auto q = SimpleMath::Quaternion::CreateFromRotationMatrix(
+		SimpleMath::Matrix(
+			SimpleMath::Vector4(t), SimpleMath::Vector4(b),
+			SimpleMath::Vector4(n), SimpleMath::Vector4::Zero));
+
+	const auto quaternionVec = XMFLOAT4(q.x, q.y, q.z, q.w);
+
+	m_obbCenters[node] = obbCenter;
+	m_obbExtents[node] = XMFLOAT3(0.5f * (high[0] - low[0]), 0.5f * (high[1] - low[1]), 0.5f * (high[2] - low[2]));
+	m_obbOrientations[node] = quaternionVec;
+	m_baseAddresses[node] = baseAddress;
+	m_indexCounts[node] = indexCount;
+	XMStoreFloat3(&m_coneAxes[node], coneAxis);
+	m_coneAngles[node] = coneAngle;
+	m_maxRadii[node] = maxRadius;
+}
+
+void QuadTree::CalcHeightRange(
+	const XMVECTOR* directions, uint32_t directionCount, FXMVECTOR coneAxis, float coneAngle,
+	float angleMargin, const HeightMap* heightMap, OUT float& minHeight, OUT float& maxHeight)
+{
+	minHeight = 0.0f;
+	maxHeight = 1.0f;
+	if (heightMap == nullptr || !heightMap->IsLoaded())
+		return;
+
+	// Longitude / colatitude rectangle of patch, same mapping as DS.
+	// Neither has extremes inside patch unless it holds a pole, so boundary is enough.
+	XMFLOAT3 axis;
+	XMStoreFloat3(&axis, coneAxis);
+	const float thetaCenter = atan2(axis.z, axis.x);
+
+	float thetaLow = 0.0f, thetaHigh = 0.0f;
+	float phiLow = XM_PI, phiHigh = 0.0f;
+	for (uint32_t i = 0; i < directionCount; i++)
+	{
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, directions[i]);
+
+		const float phi = acos(std::min(std::max(d.y, -1.0f), 1.0f));
+		phiLow = std::min(phiLow, phi);
+		phiHigh = std::max(phiHigh, phi);
+
+		// Longitude relative to center, so patch crossing theta = 0 stays contiguous.
+		float delta = atan2(d.z, d.x) - thetaCenter;
+		if (delta > XM_PI)
+			delta -= XM_2PI;
+		else if (delta < -XM_PI)
+			delta += XM_2PI;
+
+		thetaLow = std::min(thetaLow, delta);
+		thetaHigh = std::max(thetaHigh, delta);
+	}
+
+	phiLow = std::max(phiLow - angleMargin, 0.0f);
+	phiHigh = std::min(phiHigh + angleMargin, XM_PI);
+
+	float thetaMin, thetaMax;
+	const float poleAngle = acos(std::min(fabs(axis.y), 1.0f));
+	if (poleAngle <= coneAngle + angleMargin)
+	{
+		// Patch holding a pole spans every longitude.
+		thetaMin = 0.0f;
+		thetaMax = XM_2PI;
+		if (axis.y > 0.0f)
+			phiLow = 0.0f;
+		else
+			phiHigh = XM_PI;
+	}
+	else
+	{
+		// Distance along longitude grows by 1 / sin(phi) toward poles.
+		const float minSinPhi = std::min(sin(phiLow), sin(phiHigh));
+		const float thetaMargin = angleMargin / std::max(minSinPhi, 1e-3f);
+
+		thetaMin = thetaCenter + thetaLow - thetaMargin;
+		thetaMax = thetaCenter + thetaHigh + thetaMargin;
+	}
+
+	// DS wraps theta into [0, 2pi), HeightMap wraps the same way.
+	if (thetaMin < 0.0f)
+	{
+		thetaMin += XM_2PI;
+		thetaMax += XM_2PI;
+	}
+
+	heightMap->GetRange(thetaMin, thetaMax, phiLow, phiHigh, minHeight, maxHeight);
+}
+
+void QuadTree::Render(
+	IN BoundingFrustum& frustum,
+	OUT std::vector<IndexRange>& ranges, OUT uint32_t& culledQuadCount) const
+{
+	RenderNode(0, 0, frustum, ranges, culledQuadCount);
+}
+
+void QuadTree::Render(
+	IN BoundingOrientedBox& volume,
+	OUT std::vector<IndexRange>& ranges, OUT uint32_t& culledQuadCount) const
+{
+	RenderNode(0, 0, volume, ranges, culledQuadCount);
+}
+
+template <typename TVolume>
+void QuadTree::RenderNode(
+	uint32_t node, char level,
+	IN TVolume& volume,
+	OUT std::vector<IndexRange>& ranges, OUT uint32_t& culledQuadCount) const
+{
+	const BoundingOrientedBox obb(m_obbCenters[node], m_obbExtents[node], m_obbOrientations[node]);
+	const ContainmentType result = volume.Contains(obb);
+
+	// Do not cull in level 0
+	if (result <= 0 && level >= 1)
+	{
+		culledQuadCount += m_indexCounts[node] / 4;
+		return;
+	}
+
+	// Try to render children
+	if (level + 1 < m_levelCount)
+	{
+		for (uint32_t c = 4 * node + 1; c <= 4 * node + 4; c++)
+			RenderNode(c, level + 1, volume, ranges, culledQuadCount);
+		return;
+	}
+
+	// If node is leaf, render this node
+	AppendRange(node, ranges);
+}
+
+void QuadTree::CullSubtree(
+	uint32_t subtree, CullView view, IN const CullPlanes& planes, IN const CullHorizon& horizon,
+	OUT std::vector<IndexRange>& ranges, OUT CullStats& stats) const
+{
+	// Do not cull in level 0
+	if (m_levelCount <= 1)
+	{
+		if (subtree == 0)
+			AppendRange(0, ranges);
+		return;
+	}
+
+	const CullContext context = GetCullContext(view, planes, horizon);
+
+	// Every subtree task tests the root batch, so it has no plane hint to share.
+	CullBatchResult result;
+	CullBatch(context, 1, CULL_PLANE_MASK_ALL, nullptr, result, stats);
+
+	CullChild(context, 1 + subtree, 1, subtree, result, ranges, stats);
+}
+
+void QuadTree::CullBatch(
+	const CullContext& context, uint32_t first, uint32_t planeMask, uint8_t* planeHint,
+	OUT CullBatchResult& result, OUT CullStats& stats) const
+{
+	stats.batchCount++;
+
+	// Horizon test is cheaper, so run it first and skip plane tests if every lane is hidden.
+	const uint32_t hiddenMask = FrustumCuller::HorizonBatch(*context.horizon, context.cones, first);
+	if (hiddenMask == (1u << CULL_BATCH_SIZE) - 1)
+	{
+		result = {};
+		result.hiddenMask = hiddenMask;
+		return;
+	}
+
+	FrustumCuller::CullBatch(*context.planes, context.boxes, first, planeMask, planeHint, result);
+	result.outsideMask &= ~hiddenMask;
+	result.hiddenMask = hiddenMask;
+
+	if (result.planeHintHit)
+		stats.planeHintHitCount++;
+}
+
+void QuadTree::CullChildren(
+	const CullContext& context, uint32_t node, char level, uint32_t planeMask,
+	OUT std::vector<IndexRange>& ranges, OUT CullStats& stats) const
+{
+	const uint32_t first = 4 * node + 1;
+
+	CullBatchResult result;
+	CullBatch(context, first, planeMask, &context.planeHints[node], result, stats);
+
+	for (uint32_t c = 0; c < 4; c++)
+		CullChild(context, first + c, level + 1, c, result, ranges, stats);
+}
+
+void QuadTree::CullChild(
+	const CullContext& context, uint32_t child, char level, uint32_t lane, IN const CullBatchResult& result,
+	OUT std::vector<IndexRange>& ranges, OUT CullStats& stats) const
+{
+	if (result.hiddenMask & (1u << lane))
+	{
+		stats.culledQuadCount += m_indexCounts[child] / 4;
+		stats.horizonCulledQuadCount += m_indexCounts[child] / 4;
+		return;
+	}
+
+	if (result.outsideMask & (1u << lane))
+	{
+		stats.culledQuadCount += m_indexCounts[child] / 4;
+		return;
+	}
+
+	// Render whole subtree if child is leaf or fully inside.
+	// Indices of subtree are contiguous, so it is one range.
+	if (level + 1 >= m_levelCount || result.planeMasks[lane] == 0)
+	{
+		AppendRange(child, ranges);
+		return;
+	}
+
+	// Only planes intersecting this child are tested for its children.
+	CullChildren(context, child, level, result.planeMasks[lane], ranges, stats);
+}
+
+void QuadTree::AppendRange(uint32_t node, OUT std::vector<IndexRange>& ranges) const
+{
+	// Nodes are visited in index buffer order, so only the last range can be extended.
+	const uint32_t start = m_baseAddresses[node];
+	if (!ranges.empty() && ranges.back().start + ranges.back().count == start)
+	{
+		ranges.back().count += m_indexCounts[node];
+		return;
+	}
+
+	ranges.push_back({ start, m_indexCounts[node] });
+}
+
+QuadTree::CullContext QuadTree::GetCullContext(
+	CullView view, IN const CullPlanes& planes, IN const CullHorizon& horizon) const
+{
+	CullContext context = {};
+	context.planes = &planes;
+	context.horizon = &horizon;
+	context.planeHints = m_planeHints[view].data();
+
+	context.boxes.centerX = m_cullCenterX.data();
+	context.boxes.centerY = m_cullCenterY.data();
+	context.boxes.centerZ = m_cullCenterZ.data();
+	for (int a = 0; a < 3; a++)
+	{
+		context.boxes.axisX[a] = m_cullAxisX[a].data();
+		context.boxes.axisY[a] = m_cullAxisY[a].data();
+		context.boxes.axisZ[a] = m_cullAxisZ[a].data();
+	}
+
+	context.cones.axisX = m_cullConeX.data();
+	context.cones.axisY = m_cullConeY.data();
+	context.cones.axisZ = m_cullConeZ.data();
+	context.cones.cosAngle = m_cullConeCos.data();
+	context.cones.sinAngle = m_cullConeSin.data();
+
+	return context;
+}
+
+void QuadTree::CreateCullData()
+{
+	const uint32_t nodeCount = GetNodeCount();
+
+	for (auto& planeHints : m_planeHints)
+		planeHints.assign(m_levelCount > 1 ? CalcNodeCount(m_levelCount - 1) : 0, static_cast<uint8_t>(CULL_PLANE_COUNT));
+	m_cullCenterX.resize(nodeCount);
+	m_cullCenterY.resize(nodeCount);
+	m_cullCenterZ.resize(nodeCount);
+	for (int a = 0; a < 3; a++)
+	{
+		m_cullAxisX[a].resize(nodeCount);
+		m_cullAxisY[a].resize(nodeCount);
+		m_cullAxisZ[a].resize(nodeCount);
+	}
+
+	m_cullConeX.resize(nodeCount);
+	m_cullConeY.resize(nodeCount);
+	m_cullConeZ.resize(nodeCount);
+	m_cullConeCos.resize(nodeCount);
+	m_cullConeSin.resize(nodeCount);
+
+	for (uint32_t n = 0; n < nodeCount; n++)
+	{
+		// OBB center is shifted off patch direction by the fit, so cone keeps its own axis.
+		const XMFLOAT3& coneAxis = m_coneAxes[n];
+
+		// Widen cone so that patch is hidden only if its highest point is hidden.
+		// Even face root cone is about 60 degrees, so horizon + cone angle stays below pi as HorizonBatch expects.
+		const float displacementAngle = acos(SPHERE_RADIUS / std::max(m_maxRadii[n], SPHERE_RADIUS));
+		const float coneAngle = m_coneAngles[n] + displacementAngle;
+
+		m_cullConeX[n] = coneAxis.x;
+		m_cullConeY[n] = coneAxis.y;
+		m_cullConeZ[n] = coneAxis.z;
+		m_cullConeCos[n] = cos(coneAngle);
+		m_cullConeSin[n] = sin(coneAngle);
+
+		m_cullCenterX[n] = m_obbCenters[n].x;
+		m_cullCenterY[n] = m_obbCenters[n].y;
+		m_cullCenterZ[n] = m_obbCenters[n].z;
+
+		// Rows of rotation matrix are box axes in world space.
+		const XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&m_obbOrientations[n]));
+		const float extents[3] = { m_obbExtents[n].x, m_obbExtents[n].y, m_obbExtents[n].z };
+
+		for (int a = 0; a < 3; a++)
+		{
+			XMFLOAT3 axis;
+			XMStoreFloat3(&axis, rotation.r[a] * extents[a]);
+
+			m_cullAxisX[a][n] = axis.x;
+			m_cullAxisY[a][n] = axis.y;
+			m_cullAxisZ[a][n] = axis.z;
+		}
+	}
+}
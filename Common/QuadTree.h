@@ -0,0 +1,165 @@
+#pragma once
+
+#define QUAD_NODE_MAX_LEVEL 4u
+#define TESS_GROUP_QUAD_LEVEL 5u	// DO NOT CHANGE THIS VALUE
+
+#include <DirectXCollision.h>
+#include <SimpleMath.h>
+
+#include "FrustumCuller.h"
+#include "HeightMap.h"
+
+struct VertexTess
+{
+	DirectX::XMFLOAT3	position;
+	DirectX::XMFLOAT3	quadPos;
+
+	explicit VertexTess(
+		const DirectX::XMFLOAT3 position = DirectX::XMFLOAT3(0, 0, 0),
+		const DirectX::XMFLOAT3 quadPos = DirectX::XMFLOAT3(0, 0, 0)) : position(position), quadPos(quadPos) {}
+};
+
+// Node data of QuadTree, stored breadth-first (see MeshCache).
+struct QuadNodeRecord
+{
+	DirectX::XMFLOAT3				obbCenter;
+	DirectX::XMFLOAT3				obbExtents;
+	DirectX::XMFLOAT4				obbOrientation;
+	uint32_t						baseAddress;
+	uint32_t						indexCount;
+	DirectX::XMFLOAT3				coneAxis;		// Patch direction on sphere, not OBB center direction
+	float							coneAngle;
+	float							maxRadius;		// Highest displaced point of patch
+};
+
+// Contiguous part of static index buffer.
+struct IndexRange
+{
+	uint32_t						start;
+	uint32_t						count;
+};
+
+struct CullStats
+{
+	uint32_t						culledQuadCount;		// Every culled quad, including horizon culled ones
+	uint32_t						horizonCulledQuadCount;
+	uint32_t						batchCount;				// Sibling batches tested
+	uint32_t						planeHintHitCount;		// Batches rejected by cached plane alone
+	uint32_t						cachedSubtreeCount;		// Subtrees reusing last result (see FaceTree)
+};
+
+// Linearized quadtree of one cube face.
+// Nodes are stored breadth-first, so children of node n are 4n+1 ~ 4n+4 and level l starts at (4^l - 1) / 3.
+// Every node attribute is kept in its own contiguous array, and four siblings are one FrustumCuller batch.
+class QuadTree
+{
+public:
+	QuadTree() = default;
+	QuadTree(const QuadNodeRecord* records, char levelCount);
+
+	// Bounds fit heights DS can sample from heightMap. Without it, full displacement range is assumed.
+	void Build(
+		const char levelCount, uint32_t indexCount, uint32_t index[4], uint32_t baseAddress,
+		std::vector<VertexTess>& vertices, const std::vector<uint32_t>& indices, const HeightMap* heightMap);
+
+	void GetRecords(std::vector<QuadNodeRecord>& records) const;
+
+	// Visible nodes are written as index ranges in index buffer order, and adjacent ones are merged.
+	void Render(
+		IN DirectX::BoundingFrustum& frustum,
+		OUT std::vector<IndexRange>& ranges, OUT uint32_t& culledQuadCount) const;
+
+	// Same as above for orthographic view volume.
+	void Render(
+		IN DirectX::BoundingOrientedBox& volume,
+		OUT std::vector<IndexRange>& ranges, OUT uint32_t& culledQuadCount) const;
+
+	// Same as Render for one of four level 1 subtrees, so one face can be split over threads.
+	// Tests four siblings at once and skips fully visible subtrees.
+	// Nodes hidden behind sphere are rejected before frustum test.
+	// Plane rejecting most children of each node is cached per view and tested first on next call.
+	void CullSubtree(
+		uint32_t subtree, CullView view, IN const CullPlanes& planes, IN const CullHorizon& horizon,
+		OUT std::vector<IndexRange>& ranges, OUT CullStats& stats) const;
+
+	uint32_t	GetNodeCount() const { return static_cast<uint32_t>(m_baseAddresses.size()); }
+	uint32_t	GetIndexCount() const { return m_indexCounts[0]; }
+	char		GetLevelCount() const { return m_levelCount; }
+
+	static uint32_t CalcNodeCount(char levelCount) { return ((1u << (2 * levelCount)) - 1) / 3; }
+
+private:
+	void BuildNode(
+		uint32_t node, char level, uint32_t indexCount, uint32_t index[4], uint32_t baseAddress,
+		std::vector<VertexTess>& vertices, const std::vector<uint32_t>& indices, const HeightMap* heightMap);
+
+	void CalcBounds(
+		uint32_t node, char level, uint32_t indexCount, uint32_t index[4], uint32_t baseAddress,
+		std::vector<VertexTess>& vertices, const std::vector<uint32_t>& indices, const HeightMap* heightMap);
+
+	static void CalcHeightRange(
+		const DirectX::XMVECTOR* directions, uint32_t directionCount, DirectX::FXMVECTOR coneAxis, float coneAngle,
+		float angleMargin, const HeightMap* heightMap, OUT float& minHeight, OUT float& maxHeight);
+
+	template <typename TVolume>
+	void RenderNode(
+		uint32_t node, char level,
+		IN TVolume& volume,
+		OUT std::vector<IndexRange>& ranges, OUT uint32_t& culledQuadCount) const;
+
+	struct CullContext
+	{
+		const CullPlanes*					planes;
+		const CullHorizon*					horizon;
+		uint8_t*							planeHints;
+		CullBoxes							boxes;
+		CullCones							cones;
+	};
+
+	void CullBatch(
+		const CullContext& context, uint32_t first, uint32_t planeMask, uint8_t* planeHint,
+		OUT CullBatchResult& result, OUT CullStats& stats) const;
+
+	void CullChildren(
+		const CullContext& context, uint32_t node, char level, uint32_t planeMask,
+		OUT std::vector<IndexRange>& ranges, OUT CullStats& stats) const;
+
+	void CullChild(
+		const CullContext& context, uint32_t child, char level, uint32_t lane, IN const CullBatchResult& result,
+		OUT std::vector<IndexRange>& ranges, OUT CullStats& stats) const;
+
+	void AppendRange(uint32_t node, OUT std::vector<IndexRange>& ranges) const;
+
+	CullContext GetCullContext(CullView view, IN const CullPlanes& planes, IN const CullHorizon& horizon) const;
+	void CreateCullData();
+
+	char									m_levelCount = 0;
+
+	std::vector<DirectX::XMFLOAT3>			m_obbCenters;
+	std::vector<DirectX::XMFLOAT3>			m_obbExtents;
+	std::vector<DirectX::XMFLOAT4>			m_obbOrientations;
+	std::vector<uint32_t>					m_baseAddresses;
+	std::vector<uint32_t>					m_indexCounts;
+	std::vector<DirectX::XMFLOAT3>			m_coneAxes;
+	std::vector<float>						m_coneAngles;
+	std::vector<float>						m_maxRadii;
+
+	// OBB centers and extent scaled axes split by component, for FrustumCuller.
+	std::vector<float>						m_cullCenterX;
+	std::vector<float>						m_cullCenterY;
+	std::vector<float>						m_cullCenterZ;
+	std::vector<float>						m_cullAxisX[3];
+	std::vector<float>						m_cullAxisY[3];
+	std::vector<float>						m_cullAxisZ[3];
+
+	// Cone axes and cos / sin of cone angles widened for displacement, for FrustumCuller.
+	std::vector<float>						m_cullConeX;
+	std::vector<float>						m_cullConeY;
+	std::vector<float>						m_cullConeZ;
+	std::vector<float>						m_cullConeCos;
+	std::vector<float>						m_cullConeSin;
+
+	// Last failing plane per view and internal node, for batch of its children.
+	// Each subtree task only touches nodes of its own subtree.
+	mutable std::vector<uint8_t>			m_planeHints[CULL_VIEW_COUNT];
+};
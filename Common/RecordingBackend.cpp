@@ -0,0 +1,139 @@
+#include "pch.h"
+#include "RecordingBackend.h"
+
+RecordingBackend::RecordingBackend(bool keepCommands)
+{
+	m_keepCommands = keepCommands;
+}
+
+BufferHandle RecordingBackend::CreateBuffer(uint64_t size, BufferHeap heap)
+{
+	Buffer buffer = {};
+	buffer.data.assign(static_cast<size_t>(size), 0);
+	buffer.heap = heap;
+	buffer.state = BufferState::COMMON;
+	buffer.alive = true;
+
+	m_stats.bufferBytes += size;
+
+	if (!m_freeHandles.empty())
+	{
+		const BufferHandle handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+		m_buffers[handle] = std::move(buffer);
+		return handle;
+	}
+
+	m_buffers.push_back(std::move(buffer));
+	return static_cast<BufferHandle>(m_buffers.size() - 1);
+}
+
+void RecordingBackend::DestroyBuffer(BufferHandle buffer)
+{
+	Buffer& target = m_buffers[buffer];
+	if (!target.alive)
+		throw std::exception();
+
+	m_stats.bufferBytes -= target.data.size();
+
+	target = {};
+	m_freeHandles.push_back(buffer);
+}
+
+uint8_t* RecordingBackend::GetMappedData(BufferHandle buffer)
+{
+	Buffer& target = m_buffers[buffer];
+	return target.heap == BufferHeap::UPLOAD ? target.data.data() : nullptr;
+}
+
+void RecordingBackend::Barrier(BufferHandle buffer, BufferState before, BufferState after)
+{
+	Buffer& target = m_buffers[buffer];
+	if (!target.alive || target.state != before)
+		throw std::exception();
+
+	target.state = after;
+
+	m_stats.barrierCount++;
+	Record({ RecordedCommandType::BARRIER, buffer, INVALID_BUFFER_HANDLE, 0, 0, 0, before, after });
+}
+
+void RecordingBackend::CopyBuffer(
+	BufferHandle dest, uint64_t destOffset, BufferHandle source, uint64_t sourceOffset, uint64_t size)
+{
+	Buffer& target = m_buffers[dest];
+	const Buffer& from = m_buffers[source];
+
+	// Same rules as D3D12, copy dest must be in COPY_DEST and ranges must be inside buffers.
+	if (!target.alive || !from.alive || target.heap != BufferHeap::DEFAULT || target.state != BufferState::COPY_DEST)
+		throw std::exception();
+	if (destOffset + size > target.data.size() || sourceOffset + size > from.data.size())
+		throw std::exception();
+
+	memcpy(target.data.data() + destOffset, from.data.data() + sourceOffset, static_cast<size_t>(size));
+
+	m_stats.copyCount++;
+	m_stats.copyBytes += size;
+	Record({ RecordedCommandType::COPY, dest, source, destOffset, size, 0, target.state, target.state });
+}
+
+void RecordingBackend::SetInstanceBuffer(BufferHandle buffer, uint64_t offset, uint32_t size, uint32_t stride)
+{
+	const Buffer& source = m_buffers[buffer];
+	if (!source.alive || stride == 0 || offset + size > source.data.size())
+		throw std::exception();
+
+	Record({ RecordedCommandType::SET_INSTANCE_BUFFER, buffer, INVALID_BUFFER_HANDLE, offset, size, 0, source.state, source.state });
+}
+
+void RecordingBackend::DrawIndexedIndirect(BufferHandle arguments, uint64_t offset, uint32_t drawCount)
+{
+	const Buffer& source = m_buffers[arguments];
+
+	// COMMON is promoted on use.
+	if (!source.alive || (source.state != BufferState::INDIRECT_ARGUMENT && source.state != BufferState::COMMON))
+		throw std::exception();
+	if (offset + sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * drawCount > source.data.size())
+		throw std::exception();
+
+	const auto draws = reinterpret_cast<const D3D12_DRAW_INDEXED_ARGUMENTS*>(source.data.data() + offset);
+	for (uint32_t d = 0; d < drawCount; d++)
+	{
+		const uint64_t indexCount = static_cast<uint64_t>(draws[d].IndexCountPerInstance) * draws[d].InstanceCount;
+		if (indexCount == 0)
+			continue;
+
+		m_stats.drawCount++;
+		m_stats.indexCount += indexCount;
+	}
+
+	m_stats.indirectCallCount++;
+	Record({ RecordedCommandType::DRAW_INDEXED_INDIRECT, arguments, INVALID_BUFFER_HANDLE, offset, 0, drawCount, source.state, source.state });
+}
+
+bool RecordingBackend::Present(bool)
+{
+	// Like ExecuteCommandLists, buffers decay to COMMON at end of frame.
+	for (Buffer& buffer : m_buffers)
+		buffer.state = BufferState::COMMON;
+
+	m_stats.presentCount++;
+	Record({ RecordedCommandType::PRESENT, INVALID_BUFFER_HANDLE, INVALID_BUFFER_HANDLE, 0, 0, 0, BufferState::COMMON, BufferState::COMMON });
+
+	return true;
+}
+
+void RecordingBackend::Clear()
+{
+	const uint64_t bufferBytes = m_stats.bufferBytes;
+
+	m_commands.clear();
+	m_stats = {};
+	m_stats.bufferBytes = bufferBytes;
+}
+
+void RecordingBackend::Record(const RecordedCommand& command)
+{
+	if (m_keepCommands)
+		m_commands.push_back(command);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include "RenderBackend.h"
+
+enum class RecordedCommandType : uint32_t
+{
+	BARRIER,
+	COPY,
+	SET_INSTANCE_BUFFER,
+	DRAW_INDEXED_INDIRECT,
+	PRESENT,
+};
+
+struct RecordedCommand
+{
+	RecordedCommandType		type;
+	BufferHandle			buffer;			// Barrier, copy dest, instance or argument buffer
+	BufferHandle			source;			// Copy source
+	uint64_t				offset;
+	uint64_t				size;			// Copy or instance buffer bytes
+	uint32_t				drawCount;
+	BufferState				before;
+	BufferState				after;
+};
+
+struct RecordingStats
+{
+	uint64_t				bufferBytes;		// Live buffer memory
+	uint64_t				copyBytes;
+	uint32_t				copyCount;
+	uint32_t				barrierCount;
+	uint32_t				indirectCallCount;
+	uint32_t				drawCount;			// Non-empty draws only
+	uint64_t				indexCount;
+	uint32_t				presentCount;
+};
+
+// RenderBackend without a device. Buffers live in system memory, copies and indirect draws are
+// executed on CPU right away, so uploaded data and submitted index counts can be checked.
+// Barriers are checked against tracked buffer state and throw on mismatch.
+// With keepCommands false only stats are kept, to run at full speed.
+class RecordingBackend : public RenderBackend
+{
+public:
+	explicit RecordingBackend(bool keepCommands);
+
+	RecordingBackend(const RecordingBackend&) = delete;
+	RecordingBackend& operator=(const RecordingBackend&) = delete;
+
+	BufferHandle CreateBuffer(uint64_t size, BufferHeap heap) override;
+	void DestroyBuffer(BufferHandle buffer) override;
+	uint8_t* GetMappedData(BufferHandle buffer) override;
+
+	void Barrier(BufferHandle buffer, BufferState before, BufferState after) override;
+	void CopyBuffer(
+		BufferHandle dest, uint64_t destOffset, BufferHandle source, uint64_t sourceOffset, uint64_t size) override;
+	void SetInstanceBuffer(BufferHandle buffer, uint64_t offset, uint32_t size, uint32_t stride) override;
+	void DrawIndexedIndirect(BufferHandle arguments, uint64_t offset, uint32_t drawCount) override;
+
+	bool Present(bool allowTearing) override;
+
+	const std::vector<RecordedCommand>& GetCommands() const { return m_commands; }
+	const RecordingStats& GetStats() const { return m_stats; }
+
+	// Contents of any buffer, default heap ones included.
+	const uint8_t* GetData(BufferHandle buffer) const { return m_buffers[buffer].data.data(); }
+
+	// Drop recorded commands and counters, buffers are kept.
+	void Clear();
+
+private:
+	struct Buffer
+	{
+		std::vector<uint8_t>	data;
+		BufferHeap				heap;
+		BufferState				state;
+		bool					alive;
+	};
+
+	void Record(const RecordedCommand& command);
+
+	bool							m_keepCommands;
+	std::vector<Buffer>				m_buffers;
+	std::vector<BufferHandle>		m_freeHandles;
+
+	std::vector<RecordedCommand>	m_commands;
+	RecordingStats					m_stats = {};
+};
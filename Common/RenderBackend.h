@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+typedef uint32_t BufferHandle;
+#define INVALID_BUFFER_HANDLE UINT32_MAX
+
+enum class BufferHeap : uint32_t
+{
+	UPLOAD,		// CPU writable, persistently mapped
+	DEFAULT,	// GPU only, written by copies
+};
+
+enum class BufferState : uint32_t
+{
+	COMMON,
+	COPY_DEST,
+	INDIRECT_ARGUMENT,
+};
+
+// Thin device interface under the culling submit path (upload ring, draw argument buffers, present).
+// D3D12Backend is the shipping path. RecordingBackend runs the same path without any device.
+// Commands are recorded into the backend's current command stream, in call order.
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() = default;
+
+	// New buffers are zeroed. Returns INVALID_BUFFER_HANDLE on failure.
+	virtual BufferHandle CreateBuffer(uint64_t size, BufferHeap heap) = 0;
+	virtual void DestroyBuffer(BufferHandle buffer) = 0;
+
+	// Mapped data of upload buffer, nullptr for default heap buffer.
+	virtual uint8_t* GetMappedData(BufferHandle buffer) = 0;
+
+	virtual void Barrier(BufferHandle buffer, BufferState before, BufferState after) = 0;
+	virtual void CopyBuffer(
+		BufferHandle dest, uint64_t destOffset, BufferHandle source, uint64_t sourceOffset, uint64_t size) = 0;
+
+	// Per-instance vertex data of following draws, bound to input slot 1.
+	virtual void SetInstanceBuffer(BufferHandle buffer, uint64_t offset, uint32_t size, uint32_t stride) = 0;
+
+	// Indexed draws of bound index buffer, arguments laid out as D3D12_DRAW_INDEXED_ARGUMENTS.
+	virtual void DrawIndexedIndirect(BufferHandle arguments, uint64_t offset, uint32_t drawCount) = 0;
+
+	// Returns false if device was lost.
+	virtual bool Present(bool allowTearing) = 0;
+};
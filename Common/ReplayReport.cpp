@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "ReplayReport.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace
+{
+	void AppendFormat(std::string& out, const char* format, ...)
+	{
+		char buffer[256];
+
+		va_list args;
+		va_start(args, format);
+		const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+		va_end(args);
+
+		if (length > 0)
+			out.append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+	}
+
+	template <typename TValue, typename TSelector>
+	void AppendTime(std::string& out, const char* name, const std::vector<TValue>& frames, TSelector select)
+	{
+		std::vector<float> values;
+		values.reserve(frames.size());
+		for (const TValue& frame : frames)
+			values.push_back(select(frame));
+		std::sort(values.begin(), values.end());
+
+		AppendFormat(out, "  \"%s\": { \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f, \"max\": %.2f },\n", name,
+			ReplayReport::Percentile(values, 50.0f), ReplayReport::Percentile(values, 95.0f),
+			ReplayReport::Percentile(values, 99.0f), values.empty() ? 0.0f : values.back());
+	}
+
+	template <typename TValue, typename TSelector>
+	void AppendCount(std::string& out, const char* name, const std::vector<TValue>& frames, TSelector select)
+	{
+		uint64_t low = frames.empty() ? 0 : UINT64_MAX;
+		uint64_t high = 0;
+		uint64_t sum = 0;
+		for (const TValue& frame : frames)
+		{
+			const uint64_t value = select(frame);
+			low = std::min(low, value);
+			high = std::max(high, value);
+			sum += value;
+		}
+
+		AppendFormat(out, "  \"%s\": { \"min\": %llu, \"mean\": %.1f, \"max\": %llu },\n", name,
+			static_cast<unsigned long long>(low),
+			frames.empty() ? 0.0 : static_cast<double>(sum) / frames.size(),
+			static_cast<unsigned long long>(high));
+	}
+}
+
+std::string ReplayReport::ToJson() const
+{
+	std::string out = "{\n";
+	AppendFormat(out, "  \"frameCount\": %u,\n", GetFrameCount());
+
+	AppendTime(out, "updateTimeUs", m_frames, [](const ReplayFrameStats& f) { return f.updateTime; });
+	AppendTime(out, "cullingTimeUs", m_frames, [](const ReplayFrameStats& f) { return f.cullingTime; });
+	AppendCount(out, "culledQuadCount", m_frames, [](const ReplayFrameStats& f) { return static_cast<uint64_t>(f.culledQuadCount); });
+	AppendCount(out, "shadowCulledQuadCount", m_frames, [](const ReplayFrameStats& f) { return static_cast<uint64_t>(f.shadowCulledQuadCount); });
+	AppendCount(out, "indexCount", m_frames, [](const ReplayFrameStats& f) { return f.indexCount; });
+	AppendCount(out, "shadowIndexCount", m_frames, [](const ReplayFrameStats& f) { return f.shadowIndexCount; });
+	AppendCount(out, "drawCount", m_frames, [](const ReplayFrameStats& f) { return static_cast<uint64_t>(f.drawCount); });
+	AppendCount(out, "allocationCount", m_frames, [](const ReplayFrameStats& f) { return static_cast<uint64_t>(f.allocationCount); });
+	AppendCount(out, "allocationBytes", m_frames, [](const ReplayFrameStats& f) { return f.allocationBytes; });
+	AppendFormat(out, "  \"steadyStateAllocationCount\": %llu,\n",
+		static_cast<unsigned long long>(GetSteadyStateAllocationCount()));
+
+	// One compact line per frame: update, culling, culled, shadow culled, index, shadow index, draw, allocations.
+	out += "  \"frames\": [\n";
+	for (size_t i = 0; i < m_frames.size(); i++)
+	{
+		const ReplayFrameStats& f = m_frames[i];
+		AppendFormat(out, "    [%.2f, %.2f, %u, %u, %llu, %llu, %u, %u]%s\n",
+			f.updateTime, f.cullingTime, f.culledQuadCount, f.shadowCulledQuadCount,
+			static_cast<unsigned long long>(f.indexCount), static_cast<unsigned long long>(f.shadowIndexCount),
+			f.drawCount, f.allocationCount, i + 1 < m_frames.size() ? "," : "");
+	}
+	out += "  ]\n}\n";
+
+	return out;
+}
+
+bool ReplayReport::Save(const wchar_t* fileName) const
+{
+	const std::string json = ToJson();
+
+	const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	const BOOL result = WriteFile(file, json.data(), static_cast<DWORD>(json.size()), &written, nullptr);
+	CloseHandle(file);
+
+	return result && written == json.size();
+}
+
+uint64_t ReplayReport::GetSteadyStateAllocationCount() const
+{
+	uint64_t count = 0;
+	for (size_t i = c_warmUpFrameCount; i < m_frames.size(); i++)
+		count += m_frames[i].allocationCount;
+
+	return count;
+}
+
+float ReplayReport::Percentile(const std::vector<float>& sortedValues, float percent)
+{
+	if (sortedValues.empty())
+		return 0.0f;
+
+	const auto rank = static_cast<size_t>(ceil(percent / 100.0f * sortedValues.size()));
+	return sortedValues[std::min(std::max(rank, static_cast<size_t>(1)), sortedValues.size()) - 1];
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Stats of one replayed frame. Times are in microseconds.
+struct ReplayFrameStats
+{
+	float		updateTime;
+	float		cullingTime;
+	uint32_t	culledQuadCount;
+	uint32_t	shadowCulledQuadCount;
+	uint64_t	indexCount;			// Submitted by camera pass
+	uint64_t	shadowIndexCount;	// Submitted by shadow pass
+	uint32_t	drawCount;
+	uint32_t	allocationCount;	// Heap allocations of Update and Render
+	uint64_t	allocationBytes;
+};
+
+// Stats of a camera path replay, written as JSON so runs of different builds can be compared.
+class ReplayReport
+{
+public:
+	// Frames before this are warming up caches and buffers, and may allocate.
+	static constexpr uint32_t c_warmUpFrameCount = 30;
+
+	void Clear() { m_frames.clear(); }
+	void Reserve(uint32_t frameCount) { m_frames.reserve(frameCount); }
+	void Add(const ReplayFrameStats& frame) { m_frames.push_back(frame); }
+
+	uint32_t GetFrameCount() const { return static_cast<uint32_t>(m_frames.size()); }
+
+	// Heap allocations of frames after warm-up, zero for an allocation free frame loop.
+	uint64_t GetSteadyStateAllocationCount() const;
+
+	// Time percentiles (p50/p95/p99/max), count ranges and every frame.
+	std::string ToJson() const;
+	bool Save(const wchar_t* fileName) const;
+
+	// Nearest rank percentile of sorted values.
+	static float Percentile(const std::vector<float>& sortedValues, float percent);
+
+private:
+	std::vector<ReplayFrameStats>	m_frames;
+};
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "SceneCuller.h"
+
+#include "Profiler.h"
+
+#include <chrono>
+
+using namespace DirectX;
+
+SceneCuller::SceneCuller(IN const std::vector<FaceTree*>& faceTrees, WorkerPool& workerPool)
+	: m_faceTrees(faceTrees), m_workerPool(workerPool)
+{
+}
+
+SceneCullResult SceneCuller::Cull(IN const SceneView& view, IN const SceneCullOptions& options)
+{
+	SceneCullResult result = {};
+
+	// Light view is culled in the same pass, so shadow pass draws only what light can see.
+	const uint32_t viewCount = options.shadow ? CULL_VIEW_COUNT : 1;
+
+	if (options.simd)
+	{
+		if (!options.temporalCulling)
+			InvalidateCache();
+
+		view.GetCullPlanes(m_planes);
+		view.GetCullHorizons(options.horizonCulling, m_horizons);
+		m_viewCount = viewCount;
+		m_workerPool.SetActiveThreadCount(options.threadCount);
+		CullSubtrees(result.stats);
+
+		result.skipped = true;
+		for (uint32_t v = 0; v < viewCount; v++)
+			result.skipped = result.skipped && result.stats[v].cachedSubtreeCount == c_taskCount;
+	}
+	else
+	{
+		BoundingFrustum frustum = view.GetFrustum();
+		for (FaceTree* faceTree : m_faceTrees)
+			result.stats[CULL_VIEW_CAMERA].culledQuadCount += faceTree->UpdateIndexData(frustum, CULL_VIEW_CAMERA);
+
+		if (options.shadow)
+		{
+			BoundingOrientedBox lightVolume = view.lightVolume;
+			for (FaceTree* faceTree : m_faceTrees)
+				result.stats[CULL_VIEW_LIGHT].culledQuadCount += faceTree->UpdateIndexData(lightVolume, CULL_VIEW_LIGHT);
+		}
+	}
+
+	return result;
+}
+
+void SceneCuller::MeasureScaling(
+	IN const SceneView& view, IN const SceneCullOptions& options, uint32_t iterationCount, OUT std::vector<float>& times)
+{
+	view.GetCullPlanes(m_planes);
+	view.GetCullHorizons(options.horizonCulling, m_horizons);
+	m_viewCount = options.shadow ? CULL_VIEW_COUNT : 1;
+
+	times.clear();
+	for (uint32_t threadCount = 1; threadCount <= m_workerPool.GetThreadCount(); threadCount++)
+	{
+		m_workerPool.SetActiveThreadCount(threadCount);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterationCount; i++)
+		{
+			// Same view every iteration, so cached result must not be reused.
+			InvalidateCache();
+
+			CullStats stats[CULL_VIEW_COUNT];
+			CullSubtrees(stats);
+		}
+
+		const float elapsed = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		times.push_back(elapsed / static_cast<float>(iterationCount));
+	}
+}
+
+void SceneCuller::InvalidateCache()
+{
+	for (FaceTree* faceTree : m_faceTrees)
+		faceTree->InvalidateCache();
+}
+
+void SceneCuller::WriteDrawSlots(CullView view, OUT D3D12_DRAW_INDEXED_ARGUMENTS* slots) const
+{
+	for (const FaceTree* faceTree : m_faceTrees)
+		faceTree->WriteDrawSlots(view, slots);
+}
+
+uint32_t SceneCuller::GetDrawCount(CullView view) const
+{
+	uint32_t drawCount = 0;
+	for (const FaceTree* faceTree : m_faceTrees)
+		drawCount += faceTree->GetDrawCount(view);
+
+	return drawCount;
+}
+
+uint64_t SceneCuller::GetIndexCount(CullView view) const
+{
+	uint64_t indexCount = 0;
+	for (const FaceTree* faceTree : m_faceTrees)
+		indexCount += faceTree->GetIndexCount(view);
+
+	return indexCount;
+}
+
+uint32_t SceneCuller::GetSlotCount() const
+{
+	uint32_t indexCount = 0;
+	for (const FaceTree* faceTree : m_faceTrees)
+		indexCount += faceTree->GetQuadTree().GetIndexCount();
+
+	return indexCount / m_faceTrees[0]->GetLeafIndexCount();
+}
+
+void SceneCuller::CullSubtrees(OUT CullStats stats[CULL_VIEW_COUNT])
+{
+	// Each task culls one level 1 subtree for every view, and writes only its own index data and slot.
+	// Views run back to back, so node data is still in cache for the second one.
+	m_workerPool.Dispatch(c_taskCount, [this](uint32_t task) { CullTask(task); });
+
+	for (uint32_t v = 0; v < m_viewCount; v++)
+	{
+		stats[v] = {};
+		for (const CullSlot& slot : m_slots)
+		{
+			stats[v].culledQuadCount += slot.stats[v].culledQuadCount;
+			stats[v].horizonCulledQuadCount += slot.stats[v].horizonCulledQuadCount;
+			stats[v].batchCount += slot.stats[v].batchCount;
+			stats[v].planeHintHitCount += slot.stats[v].planeHintHitCount;
+			stats[v].cachedSubtreeCount += slot.stats[v].cachedSubtreeCount;
+		}
+	}
+}
+
+void SceneCuller::CullTask(uint32_t task)
+{
+	static const char* const faceNames[6] =
+	{
+		"Cull face 0", "Cull face 1", "Cull face 2", "Cull face 3", "Cull face 4", "Cull face 5",
+	};
+
+	const uint32_t face = task / FACE_TREE_SUBTREE_COUNT;
+	const uint32_t subtree = task % FACE_TREE_SUBTREE_COUNT;
+	PROFILE_SCOPE(faceNames[face]);
+
+	for (uint32_t v = 0; v < m_viewCount; v++)
+	{
+		const auto view = static_cast<CullView>(v);
+		m_slots[task].stats[v] = m_faceTrees[face]->UpdateIndexData(m_planes[v], m_horizons[v], subtree, view);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+
+#include "FaceTree.h"
+#include "SceneView.h"
+#include "WorkerPool.h"
+
+struct SceneCullOptions
+{
+	bool			simd;				// SIMD subtree culling, otherwise scalar DirectXCollision path
+	bool			horizonCulling;
+	bool			temporalCulling;	// Reuse last result of subtrees whose view didn't change
+	bool			shadow;				// Cull light view too
+	uint32_t		threadCount;		// Worker threads of SIMD path
+};
+
+struct SceneCullResult
+{
+	CullStats		stats[CULL_VIEW_COUNT];		// Scalar path fills culledQuadCount only
+	bool			skipped;					// Every subtree of every view reused its last result
+};
+
+// Culling of every face tree for camera and light view, without any device object.
+// Apollo's Update and headless replay both cull through it.
+class SceneCuller
+{
+public:
+	// One task per level 1 subtree of each face.
+	static constexpr uint32_t c_taskCount = 6 * FACE_TREE_SUBTREE_COUNT;
+
+	SceneCuller(IN const std::vector<FaceTree*>& faceTrees, WorkerPool& workerPool);
+
+	SceneCuller(const SceneCuller&) = delete;
+	SceneCuller& operator=(const SceneCuller&) = delete;
+
+	SceneCullResult Cull(IN const SceneView& view, IN const SceneCullOptions& options);
+
+	// Time of full SIMD culling of view (cache invalidated each iteration) with 1 to every worker thread,
+	// in microseconds. Active thread count is left at the last one.
+	void MeasureScaling(
+		IN const SceneView& view, IN const SceneCullOptions& options, uint32_t iterationCount, OUT std::vector<float>& times);
+
+	void InvalidateCache();
+
+	// Draw slots of view from every face tree (see FaceTree::WriteDrawSlots), and their totals.
+	void		WriteDrawSlots(CullView view, OUT D3D12_DRAW_INDEXED_ARGUMENTS* slots) const;
+	uint32_t	GetDrawCount(CullView view) const;
+	uint64_t	GetIndexCount(CullView view) const;
+
+	// Slot of every leaf in static index buffer.
+	uint32_t	GetSlotCount() const;
+
+private:
+	// Cull stats of one culling task, padded to own cache line.
+	struct CullSlot
+	{
+		CullStats		stats[CULL_VIEW_COUNT];
+		uint8_t			padding[64 - sizeof(CullStats) * CULL_VIEW_COUNT];
+	};
+
+	// Views of current dispatch are kept in members, so task lambda only captures this and never allocates.
+	void CullSubtrees(OUT CullStats stats[CULL_VIEW_COUNT]);
+	void CullTask(uint32_t task);
+
+	const std::vector<FaceTree*>&	m_faceTrees;
+	WorkerPool&						m_workerPool;
+
+	CullPlanes						m_planes[CULL_VIEW_COUNT];
+	CullHorizon						m_horizons[CULL_VIEW_COUNT];
+	uint32_t						m_viewCount = 0;
+	CullSlot						m_slots[c_taskCount] = {};
+};
@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "SceneView.h"
+
+using namespace DirectX;
+
+SceneView SceneView::Create(IN const CameraFrame& frame, float aspectRatio, IN const BoundingSphere& sceneBounds)
+{
+	SceneView sceneView = {};
+	sceneView.cameraPosition = frame.position;
+	sceneView.lightDirection = frame.lightDirection;
+
+	// Camera looks along rotated forward axis, with rotated up axis.
+	const XMVECTOR cameraPosition = XMLoadFloat3(&frame.position);
+	const XMMATRIX rotation = XMMatrixRotationRollPitchYaw(frame.pitch, frame.yaw, 0.0f);
+	const XMVECTOR look = XMVector3Normalize(XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), rotation));
+	const XMVECTOR up = XMVector3TransformCoord(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), rotation);
+	XMStoreFloat4x4(&sceneView.view, XMMatrixLookAtLH(cameraPosition, XMVectorAdd(cameraPosition, look), up));
+
+	// Far plane at sphere center, nothing behind it is visible.
+	XMStoreFloat4x4(&sceneView.projection, XMMatrixPerspectiveFovLH(
+		XM_PIDIV4, aspectRatio, 0.01f, XMVectorGetX(XMVector3Length(cameraPosition))));
+
+	// Light sits outside scene bounds, looking at its center.
+	const XMVECTOR lightDirection = XMLoadFloat3(&frame.lightDirection);
+	const XMVECTOR lightPosition = XMVectorScale(lightDirection, -2.0f * sceneBounds.Radius);
+	const XMVECTOR targetPosition = XMLoadFloat3(&sceneBounds.Center);
+	const XMMATRIX lightView = XMMatrixLookAtLH(lightPosition, targetPosition, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMStoreFloat3(&sceneView.lightPosition, lightPosition);
+	XMStoreFloat4x4(&sceneView.lightView, lightView);
+
+	// Ortho frustum in light space encloses scene.
+	XMFLOAT3 sphereCenterLS;
+	XMStoreFloat3(&sphereCenterLS, XMVector3TransformCoord(targetPosition, lightView));
+
+	const float l = sphereCenterLS.x - sceneBounds.Radius;
+	const float b = sphereCenterLS.y - sceneBounds.Radius;
+	const float n = sphereCenterLS.z - sceneBounds.Radius;
+	const float r = sphereCenterLS.x + sceneBounds.Radius;
+	const float t = sphereCenterLS.y + sceneBounds.Radius;
+	const float f = sphereCenterLS.z + sceneBounds.Radius;
+	XMStoreFloat4x4(&sceneView.lightProjection, XMMatrixOrthographicOffCenterLH(l, r, b, t, n, f));
+
+	// Same box in world space.
+	XMVECTOR lightDet;
+	const BoundingOrientedBox lightBox(
+		sphereCenterLS, XMFLOAT3(sceneBounds.Radius, sceneBounds.Radius, sceneBounds.Radius), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	lightBox.Transform(sceneView.lightVolume, XMMatrixInverse(&lightDet, lightView));
+
+	return sceneView;
+}
+
+XMMATRIX SceneView::GetShadowTransform() const
+{
+	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
+	const XMMATRIX T(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	return XMLoadFloat4x4(&lightView) * XMLoadFloat4x4(&lightProjection) * T;
+}
+
+BoundingFrustum SceneView::GetFrustum() const
+{
+	const XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+
+	BoundingFrustum frustum;
+	XMVECTOR det;
+	BoundingFrustum(XMLoadFloat4x4(&projection)).Transform(frustum, XMMatrixInverse(&det, viewMatrix));
+	return frustum;
+}
+
+void SceneView::GetCullPlanes(OUT CullPlanes planes[CULL_VIEW_COUNT]) const
+{
+	planes[CULL_VIEW_CAMERA] = CullPlanes::FromViewProjection(XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection));
+	planes[CULL_VIEW_LIGHT] = CullPlanes::FromViewProjection(XMLoadFloat4x4(&lightView) * XMLoadFloat4x4(&lightProjection));
+}
+
+void SceneView::GetCullHorizons(bool horizonCulling, OUT CullHorizon horizons[CULL_VIEW_COUNT]) const
+{
+	// Light is directional. Patches behind sphere from light can't shadow anything lit.
+	horizons[CULL_VIEW_CAMERA] = CullHorizon::FromCameraPosition(XMLoadFloat3(&cameraPosition));
+	horizons[CULL_VIEW_LIGHT] = CullHorizon::FromDirection(XMVectorNegate(XMLoadFloat3(&lightDirection)));
+	for (uint32_t v = 0; v < CULL_VIEW_COUNT; v++)
+		horizons[v].enabled = horizons[v].enabled && horizonCulling;
+}
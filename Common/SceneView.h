@@ -0,0 +1,35 @@
+#pragma once
+
+#include <DirectXCollision.h>
+
+#include "CameraPath.h"
+#include "FrustumCuller.h"
+
+// Camera and light transforms of one frame. Everything comes from a camera frame, so Apollo's
+// Update and headless replay derive the same views from the same recorded frame.
+struct SceneView
+{
+	DirectX::XMFLOAT4X4				view;
+	DirectX::XMFLOAT4X4				projection;
+	DirectX::XMFLOAT4X4				lightView;
+	DirectX::XMFLOAT4X4				lightProjection;
+	DirectX::XMFLOAT3				cameraPosition;
+	DirectX::XMFLOAT3				lightPosition;
+	DirectX::XMFLOAT3				lightDirection;
+
+	// Orthographic light volume in world space. It encloses scene bounds.
+	DirectX::BoundingOrientedBox	lightVolume;
+
+	// Perspective camera reaching sphere center, and directional light looking at scene center from outside bounds.
+	static SceneView Create(IN const CameraFrame& frame, float aspectRatio, IN const DirectX::BoundingSphere& sceneBounds);
+
+	// Light view * projection, then NDC to texture space.
+	DirectX::XMMATRIX GetShadowTransform() const;
+
+	// Camera frustum in world space, for scalar culling path.
+	DirectX::BoundingFrustum GetFrustum() const;
+
+	// Planes of every view, and horizons which are disabled unless horizonCulling.
+	void GetCullPlanes(OUT CullPlanes planes[CULL_VIEW_COUNT]) const;
+	void GetCullHorizons(bool horizonCulling, OUT CullHorizon horizons[CULL_VIEW_COUNT]) const;
+};
@@ -0,0 +1,44 @@
+#include "pch.h"
+#include "SimulatedMipSource.h"
+
+#include <thread>
+
+SimulatedMipSource::SimulatedMipSource(const TileLayout& layout, uint32_t id, std::chrono::microseconds latency)
+	: m_layout(layout), m_id(id), m_latency(latency)
+{
+}
+
+bool SimulatedMipSource::CheckRows(
+	const TileLayout& layout, uint32_t id, uint32_t mip, uint32_t firstRow, uint32_t rowCount, const uint8_t* data)
+{
+	const uint32_t rowPitch = layout.GetRowPitch(mip);
+	for (uint32_t row = 0; row < rowCount; row++)
+	{
+		for (uint32_t i = 0; i < rowPitch; i++)
+		{
+			if (data[static_cast<size_t>(row) * rowPitch + i] != GetByte(id, mip, firstRow + row, i))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool SimulatedMipSource::ReadRows(uint32_t mip, uint32_t firstRow, uint32_t rowCount, uint8_t* data)
+{
+	m_readCount++;
+	if (m_latency.count() > 0)
+		std::this_thread::sleep_for(m_latency);
+
+	if (mip >= m_layout.mipCount || firstRow + rowCount > m_layout.GetRowCount(mip) || mip == m_failingMip)
+		return false;
+
+	const uint32_t rowPitch = m_layout.GetRowPitch(mip);
+	for (uint32_t row = 0; row < rowCount; row++)
+	{
+		for (uint32_t i = 0; i < rowPitch; i++)
+			data[static_cast<size_t>(row) * rowPitch + i] = GetByte(m_id, mip, firstRow + row, i);
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "MipLoader.h"
+
+// MipSource with no file, so MipLoader runs headless.
+// Byte i of a row is a hash of source id, mip, row and i, which CheckRows verifies. Reads take a fixed
+// latency per call, and a mip can be made to fail.
+class SimulatedMipSource : public MipSource
+{
+public:
+	SimulatedMipSource(const TileLayout& layout, uint32_t id, std::chrono::microseconds latency = std::chrono::microseconds(0));
+
+	// Make reads of mip fail, before MipLoader starts.
+	void SetFailingMip(uint32_t mip) { m_failingMip = mip; }
+
+	uint64_t GetReadCount() const { return m_readCount; }
+
+	static bool CheckRows(
+		IN const TileLayout& layout, uint32_t id, uint32_t mip, uint32_t firstRow, uint32_t rowCount, IN const uint8_t* data);
+
+	const TileLayout& GetLayout() const override { return m_layout; }
+	bool ReadRows(uint32_t mip, uint32_t firstRow, uint32_t rowCount, OUT uint8_t* data) override;
+
+private:
+	static uint8_t GetByte(uint32_t id, uint32_t mip, uint32_t row, uint32_t i)
+	{
+		return static_cast<uint8_t>(((id * 0x9E3779B1u) ^ (mip * 0x85EBCA77u) ^ (row * 0xC2B2AE3Du) ^ (i * 0x27D4EB2Fu)) >> 24);
+	}
+
+	TileLayout					m_layout;
+	uint32_t					m_id;
+	std::chrono::microseconds	m_latency;
+	uint32_t					m_failingMip = UINT32_MAX;
+	std::atomic<uint64_t>		m_readCount = 0;
+};
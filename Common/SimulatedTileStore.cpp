@@ -0,0 +1,39 @@
+#include "pch.h"
+#include "SimulatedTileStore.h"
+
+#include <thread>
+
+SimulatedTileStore::SimulatedTileStore(const TileLayout& layout, uint32_t id, std::chrono::microseconds latency)
+	: m_layout(layout), m_id(id), m_latency(latency), m_failing(layout.tileCount, false)
+{
+}
+
+bool SimulatedTileStore::CheckTile(const uint8_t* data, uint32_t id, uint32_t tile)
+{
+	const uint32_t word = (id << 24) | (tile & 0xFFFFFF);
+	for (uint32_t i = 0; i < TILE_SIZE_BYTES / sizeof(uint32_t); i++)
+	{
+		uint32_t value;
+		memcpy(&value, data + i * sizeof(uint32_t), sizeof(uint32_t));
+		if (value != word)
+			return false;
+	}
+
+	return true;
+}
+
+bool SimulatedTileStore::ReadTile(uint32_t tile, uint8_t* data)
+{
+	m_readCount++;
+	if (m_latency.count() > 0)
+		std::this_thread::sleep_for(m_latency);
+
+	if (tile >= m_layout.tileCount || m_failing[tile])
+		return false;
+
+	const uint32_t word = (m_id << 24) | (tile & 0xFFFFFF);
+	for (uint32_t i = 0; i < TILE_SIZE_BYTES / sizeof(uint32_t); i++)
+		memcpy(data + i * sizeof(uint32_t), &word, sizeof(uint32_t));
+
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "TileStore.h"
+
+// TileStore with no file, so TileCache runs headless.
+// Every 32-bit word of a tile holds store id in high 8 bits and tile index in low 24 bits, which CheckTile
+// verifies. Reads take a fixed latency, and tiles can be made to fail.
+class SimulatedTileStore : public TileStore
+{
+public:
+	SimulatedTileStore(const TileLayout& layout, uint32_t id, std::chrono::microseconds latency = std::chrono::microseconds(0));
+
+	// Make reads of tile fail, before TileCache starts.
+	void SetFailing(uint32_t tile, bool failing = true) { m_failing[tile] = failing; }
+
+	uint64_t GetReadCount() const { return m_readCount; }
+
+	static bool CheckTile(IN const uint8_t* data, uint32_t id, uint32_t tile);
+
+	const TileLayout& GetLayout() const override { return m_layout; }
+	bool ReadTile(uint32_t tile, OUT uint8_t* data) override;
+
+private:
+	TileLayout					m_layout;
+	uint32_t					m_id;
+	std::chrono::microseconds	m_latency;
+	std::vector<bool>			m_failing;
+	std::atomic<uint64_t>		m_readCount = 0;
+};
@@ -0,0 +1,386 @@
+#include "pch.h"
+#include "TerrainSampler.h"
+
+#include "FrustumCuller.h"
+#include "TextureDecoder.h"
+
+#include <cfloat>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	inline uint16_t ToUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	// Mips of a full chain, every level at least 1 texel.
+	uint32_t CalcFullLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t count = 1;
+		while (width > 1 || height > 1)
+		{
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			count++;
+		}
+
+		return count;
+	}
+}
+
+bool TerrainSampler::Load(const wchar_t* leftFileName, const wchar_t* rightFileName)
+{
+	m_levelCount = 0;
+
+	TextureDecoder decoders[2];
+	if (!decoders[0].Load(leftFileName) || !decoders[1].Load(rightFileName))
+		return false;
+
+	const uint32_t width = decoders[0].GetWidth();
+	const uint32_t height = decoders[0].GetHeight();
+	if (width != decoders[1].GetWidth() || height != decoders[1].GetHeight())
+		return false;
+
+	const uint32_t levelCount = std::min(TERRAIN_SAMPLER_LEVEL_COUNT, CalcFullLevelCount(width, height));
+	const uint32_t fileLevelCount = std::min({ levelCount, decoders[0].GetMipCount(), decoders[1].GetMipCount() });
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		m_levels[level].width = std::max(width >> level, 1u);
+		m_levels[level].height = std::max(height >> level, 1u);
+	}
+
+	// Mips of files are the ones GPU samples.
+	uint32_t decodedCount = 0;
+	for (; decodedCount < fileLevelCount; decodedCount++)
+	{
+		if (!DecodeLevel(decoders[0], 0, decodedCount) || !DecodeLevel(decoders[1], 1, decodedCount))
+			break;
+	}
+
+	if (decodedCount == 0)
+		return false;
+
+	m_levelCount = levelCount;
+	BuildMissingLevels(decodedCount);
+
+	return true;
+}
+
+bool TerrainSampler::Create(uint32_t width, uint32_t height, const float* left, const float* right)
+{
+	m_levelCount = 0;
+	if (width == 0 || height == 0)
+		return false;
+
+	const uint32_t levelCount = std::min(TERRAIN_SAMPLER_LEVEL_COUNT, CalcFullLevelCount(width, height));
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		m_levels[level].width = std::max(width >> level, 1u);
+		m_levels[level].height = std::max(height >> level, 1u);
+	}
+
+	const float* const halves[2] = { left, right };
+	const size_t texelCount = static_cast<size_t>(width) * height;
+	for (uint32_t half = 0; half < 2; half++)
+	{
+		std::vector<uint16_t>& texels = m_levels[0].texels[half];
+		texels.resize(texelCount);
+		for (size_t i = 0; i < texelCount; i++)
+			texels[i] = ToUnorm16(halves[half][i]);
+	}
+
+	m_levelCount = levelCount;
+	BuildMissingLevels(1);
+
+	return true;
+}
+
+uint64_t TerrainSampler::GetMemorySize() const
+{
+	uint64_t size = 0;
+	for (uint32_t level = 0; level < m_levelCount; level++)
+		size += sizeof(uint16_t) * (m_levels[level].texels[0].size() + m_levels[level].texels[1].size());
+
+	return size;
+}
+
+bool TerrainSampler::DecodeLevel(TextureDecoder& decoder, uint32_t half, uint32_t level)
+{
+	Level& target = m_levels[level];
+	if (!decoder.SelectMip(level) || decoder.GetWidth() != target.width || decoder.GetHeight() != target.height)
+		return false;
+
+	std::vector<uint16_t>& texels = target.texels[half];
+	texels.resize(static_cast<size_t>(target.width) * target.height);
+
+	std::vector<float> strip(static_cast<size_t>(target.width) * TextureDecoder::c_stripHeight);
+	for (uint32_t s = 0; s < decoder.GetStripCount(); s++)
+	{
+		decoder.DecodeStrip(s, strip.data());
+
+		const uint32_t y0 = s * TextureDecoder::c_stripHeight;
+		const uint32_t rowCount = std::min(TextureDecoder::c_stripHeight, target.height - y0);
+		const size_t count = static_cast<size_t>(rowCount) * target.width;
+		uint16_t* dest = &texels[static_cast<size_t>(y0) * target.width];
+		for (size_t i = 0; i < count; i++)
+			dest[i] = ToUnorm16(strip[i]);
+	}
+
+	return true;
+}
+
+void TerrainSampler::BuildMissingLevels(uint32_t firstLevel)
+{
+	// 2x2 box of finer level, edge texels repeated for odd sizes.
+	for (uint32_t level = std::max(firstLevel, 1u); level < m_levelCount; level++)
+	{
+		const Level& fine = m_levels[level - 1];
+		Level& coarse = m_levels[level];
+
+		for (uint32_t half = 0; half < 2; half++)
+		{
+			const std::vector<uint16_t>& src = fine.texels[half];
+			std::vector<uint16_t>& dst = coarse.texels[half];
+			dst.resize(static_cast<size_t>(coarse.width) * coarse.height);
+
+			for (uint32_t y = 0; y < coarse.height; y++)
+			{
+				const size_t row0 = static_cast<size_t>(std::min(2 * y, fine.height - 1)) * fine.width;
+				const size_t row1 = static_cast<size_t>(std::min(2 * y + 1, fine.height - 1)) * fine.width;
+				for (uint32_t x = 0; x < coarse.width; x++)
+				{
+					const uint32_t x0 = std::min(2 * x, fine.width - 1);
+					const uint32_t x1 = std::min(2 * x + 1, fine.width - 1);
+					const uint32_t sum = src[row0 + x0] + src[row0 + x1] + src[row1 + x0] + src[row1 + x1];
+					dst[static_cast<size_t>(y) * coarse.width + x] = static_cast<uint16_t>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+float TerrainSampler::SampleBilinear(uint32_t half, float u, float v, uint32_t level) const
+{
+	if (m_levelCount == 0)
+		return 0.0f;
+
+	const Level& source = m_levels[std::min(level, m_levelCount - 1)];
+	const uint16_t* texels = source.texels[half].data();
+
+	// Texel centers are at half texels, clamp addressing repeats edge texels.
+	const float x = u * source.width - 0.5f;
+	const float y = v * source.height - 0.5f;
+	const float floorX = floorf(x);
+	const float floorY = floorf(y);
+	const float ax = x - floorX;
+	const float ay = y - floorY;
+
+	const int maxX = static_cast<int>(source.width) - 1;
+	const int maxY = static_cast<int>(source.height) - 1;
+	const int x0 = std::min(std::max(static_cast<int>(floorX), 0), maxX);
+	const int x1 = std::min(std::max(static_cast<int>(floorX) + 1, 0), maxX);
+	const size_t row0 = static_cast<size_t>(std::min(std::max(static_cast<int>(floorY), 0), maxY)) * source.width;
+	const size_t row1 = static_cast<size_t>(std::min(std::max(static_cast<int>(floorY) + 1, 0), maxY)) * source.width;
+
+	const float top = texels[row0 + x0] + ax * (texels[row0 + x1] - static_cast<float>(texels[row0 + x0]));
+	const float bottom = texels[row1 + x0] + ax * (texels[row1 + x1] - static_cast<float>(texels[row1 + x0]));
+
+	return (top + ay * (bottom - top)) / 65535.0f;
+}
+
+float TerrainSampler::SampleHeight(const XMFLOAT3& direction, uint32_t level) const
+{
+	const float lengthSq = std::max(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z, FLT_MIN);
+	const float invLength = 1.0f / sqrtf(lengthSq);
+
+	// Cartesian to polar, theta in [0, 2pi).
+	float theta = atan2f(direction.z * invLength, direction.x * invLength);
+	theta = theta < 0.0f ? XM_2PI + theta : theta;
+	const float phi = acosf(std::min(std::max(direction.y * invLength, -1.0f), 1.0f));
+
+	// round() of HLSL is to nearest even, so theta of exactly pi is on left half.
+	const float gx = theta / XM_2PI;
+	const uint32_t half = gx > 0.5f ? 1 : 0;
+	const float u = std::min(std::max(half == 0 ? gx * 2.0f : (gx - 0.5f) * 2.0f, 0.0f), 1.0f);
+
+	return SampleBilinear(half, u, phi / XM_PI, level);
+}
+
+void TerrainSampler::SampleBatch(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, const uint32_t levels[4], XMVECTOR& heights) const
+{
+	const XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorMax(x * x + y * y + z * z, XMVectorReplicate(FLT_MIN)));
+
+	XMVECTOR theta = XMVectorATan2(z * invLength, x * invLength);
+	theta = XMVectorSelect(theta, theta + g_XMTwoPi, XMVectorLess(theta, XMVectorZero()));
+	const XMVECTOR phi = XMVectorACos(XMVectorClamp(y * invLength, g_XMNegativeOne, g_XMOne));
+
+	const XMVECTOR gx = theta * g_XMReciprocalTwoPi;
+	const XMVECTOR right = XMVectorGreater(gx, g_XMOneHalf);
+	const XMVECTOR u = XMVectorSaturate(XMVectorSelect(gx + gx, (gx - g_XMOneHalf) * g_XMTwo, right));
+	const XMVECTOR v = phi * g_XMReciprocalPi;
+
+	// Each lane can read its own level and half.
+	const Level* sources[4];
+	for (uint32_t lane = 0; lane < 4; lane++)
+		sources[lane] = &m_levels[std::min(levels[lane], m_levelCount - 1)];
+
+	XMUINT4 rightMask;
+	XMStoreUInt4(&rightMask, right);
+	const uint32_t halves[4] = { rightMask.x & 1, rightMask.y & 1, rightMask.z & 1, rightMask.w & 1 };
+
+	const XMVECTOR widths = XMVectorSet(
+		static_cast<float>(sources[0]->width), static_cast<float>(sources[1]->width),
+		static_cast<float>(sources[2]->width), static_cast<float>(sources[3]->width));
+	const XMVECTOR heightsOfLevel = XMVectorSet(
+		static_cast<float>(sources[0]->height), static_cast<float>(sources[1]->height),
+		static_cast<float>(sources[2]->height), static_cast<float>(sources[3]->height));
+
+	// Texel centers are at half texels.
+	const XMVECTOR texelX = u * widths - g_XMOneHalf;
+	const XMVECTOR texelY = v * heightsOfLevel - g_XMOneHalf;
+	const XMVECTOR floorX = XMVectorFloor(texelX);
+	const XMVECTOR floorY = XMVectorFloor(texelY);
+
+	XMFLOAT4 fx, fy;
+	XMStoreFloat4(&fx, floorX);
+	XMStoreFloat4(&fy, floorY);
+	const float floorsX[4] = { fx.x, fx.y, fx.z, fx.w };
+	const float floorsY[4] = { fy.x, fy.y, fy.z, fy.w };
+
+	// Gather four texels of every lane, there is no gather before AVX2.
+	float t00[4], t10[4], t01[4], t11[4];
+	for (uint32_t lane = 0; lane < 4; lane++)
+	{
+		const Level& source = *sources[lane];
+		const uint16_t* texels = source.texels[halves[lane]].data();
+
+		const int maxX = static_cast<int>(source.width) - 1;
+		const int maxY = static_cast<int>(source.height) - 1;
+		const int x0 = std::min(std::max(static_cast<int>(floorsX[lane]), 0), maxX);
+		const int x1 = std::min(std::max(static_cast<int>(floorsX[lane]) + 1, 0), maxX);
+		const size_t row0 = static_cast<size_t>(std::min(std::max(static_cast<int>(floorsY[lane]), 0), maxY)) * source.width;
+		const size_t row1 = static_cast<size_t>(std::min(std::max(static_cast<int>(floorsY[lane]) + 1, 0), maxY)) * source.width;
+
+		t00[lane] = texels[row0 + x0];
+		t10[lane] = texels[row0 + x1];
+		t01[lane] = texels[row1 + x0];
+		t11[lane] = texels[row1 + x1];
+	}
+
+	const XMVECTOR ax = texelX - floorX;
+	const XMVECTOR ay = texelY - floorY;
+	const XMVECTOR v00 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(t00));
+	const XMVECTOR top = XMVectorMultiplyAdd(ax, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(t10)) - v00, v00);
+	const XMVECTOR v01 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(t01));
+	const XMVECTOR bottom = XMVectorMultiplyAdd(ax, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(t11)) - v01, v01);
+
+	heights = XMVectorMultiplyAdd(ay, bottom - top, top) * XMVectorReplicate(1.0f / 65535.0f);
+}
+
+void TerrainSampler::SampleHeights(const XMFLOAT3* directions, const uint32_t* levels, uint32_t count, float* heights) const
+{
+	if (m_levelCount == 0)
+	{
+		std::fill(heights, heights + count, 0.0f);
+		return;
+	}
+
+	// Last batch repeats its last direction.
+	for (uint32_t i = 0; i < count; i += 4)
+	{
+		const XMFLOAT3* d[4];
+		uint32_t batchLevels[4];
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			const uint32_t index = std::min(i + lane, count - 1);
+			d[lane] = &directions[index];
+			batchLevels[lane] = levels[index];
+		}
+
+		XMVECTOR batch;
+		SampleBatch(
+			XMVectorSet(d[0]->x, d[1]->x, d[2]->x, d[3]->x),
+			XMVectorSet(d[0]->y, d[1]->y, d[2]->y, d[3]->y),
+			XMVectorSet(d[0]->z, d[1]->z, d[2]->z, d[3]->z),
+			batchLevels, batch);
+
+		XMFLOAT4 result;
+		XMStoreFloat4(&result, batch);
+		const float values[4] = { result.x, result.y, result.z, result.w };
+		for (uint32_t lane = 0; lane < 4 && i + lane < count; lane++)
+			heights[i + lane] = values[lane];
+	}
+}
+
+float TerrainSampler::GetSurfaceRadius(const XMFLOAT3& position, uint32_t level) const
+{
+	return SPHERE_RADIUS + SampleHeight(position, level) * SPHERE_MAX_DISPLACEMENT;
+}
+
+void TerrainSampler::GetSurfaceRadii(const XMFLOAT3* positions, uint32_t count, uint32_t level, float* radii) const
+{
+	const uint32_t levels[4] = { level, level, level, level };
+	for (uint32_t i = 0; i < count; i += 4)
+	{
+		const XMFLOAT3* p[4];
+		for (uint32_t lane = 0; lane < 4; lane++)
+			p[lane] = &positions[std::min(i + lane, count - 1)];
+
+		XMVECTOR heights = XMVectorZero();
+		if (m_levelCount > 0)
+		{
+			SampleBatch(
+				XMVectorSet(p[0]->x, p[1]->x, p[2]->x, p[3]->x),
+				XMVectorSet(p[0]->y, p[1]->y, p[2]->y, p[3]->y),
+				XMVectorSet(p[0]->z, p[1]->z, p[2]->z, p[3]->z),
+				levels, heights);
+		}
+
+		XMFLOAT4 result;
+		XMStoreFloat4(&result, XMVectorMultiplyAdd(heights, XMVectorReplicate(SPHERE_MAX_DISPLACEMENT), XMVectorReplicate(SPHERE_RADIUS)));
+		const float values[4] = { result.x, result.y, result.z, result.w };
+		for (uint32_t lane = 0; lane < 4 && i + lane < count; lane++)
+			radii[i + lane] = values[lane];
+	}
+}
+
+TerrainSamplerBenchmark TerrainSampler::RunBenchmark(uint32_t queryCount, uint32_t level) const
+{
+	TerrainSamplerBenchmark result = {};
+	result.queryCount = queryCount;
+	result.level = level;
+	if (queryCount == 0)
+		return result;
+
+	// Uniform directions on sphere, same ones every run.
+	std::mt19937 generator(1);
+	std::normal_distribution<float> distribution;
+	std::vector<XMFLOAT3> directions(queryCount);
+	for (XMFLOAT3& direction : directions)
+		direction = XMFLOAT3(distribution(generator), distribution(generator), distribution(generator));
+
+	const std::vector<uint32_t> levels(queryCount, level);
+	std::vector<float> scalarHeights(queryCount);
+	std::vector<float> batchHeights(queryCount);
+
+	const auto scalarStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < queryCount; i++)
+		scalarHeights[i] = SampleHeight(directions[i], level);
+	const auto batchStart = std::chrono::high_resolution_clock::now();
+	SampleHeights(directions.data(), levels.data(), queryCount, batchHeights.data());
+	const auto batchEnd = std::chrono::high_resolution_clock::now();
+
+	result.scalarTime = std::chrono::duration<float, std::milli>(batchStart - scalarStart).count();
+	result.batchTime = std::chrono::duration<float, std::milli>(batchEnd - batchStart).count();
+	result.scalarRate = result.scalarTime > 0.0f ? queryCount / (result.scalarTime * 1000.0f) : 0.0f;
+	result.batchRate = result.batchTime > 0.0f ? queryCount / (result.batchTime * 1000.0f) : 0.0f;
+
+	for (uint32_t i = 0; i < queryCount; i++)
+		result.maxError = std::max(result.maxError, fabsf(scalarHeights[i] - batchHeights[i]));
+
+	return result;
+}
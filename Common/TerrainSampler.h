@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class TextureDecoder;
+
+#define TERRAIN_SAMPLER_LEVEL_COUNT 7u		// Levels DS samples, CalcLevel of max tess exponent 8 is at most 6
+
+struct TerrainSamplerBenchmark
+{
+	uint32_t				queryCount;
+	uint32_t				level;
+	float					scalarTime;		// Milliseconds
+	float					batchTime;
+	float					scalarRate;		// Million queries per second
+	float					batchRate;
+	float					maxError;		// Largest difference of batch and scalar heights
+};
+
+// Displacement map on CPU, sampled the way Displace of Shader.hlsli does it:
+// unit direction to theta / phi, left or right texture by round(theta / 2pi), and bilinear filtering
+// at an explicit mip level with clamp addressing, texel centers at half texels.
+// Texels are kept as 16-bit unorm. Mips are read from files, or box filtered from level 0 if files have none.
+// Filter weights are full float, where GPU rounds them to 8 bits, so results differ by a fraction of a texel step.
+class TerrainSampler
+{
+public:
+	// Decode both halves with mips. Returns false if a file can't be decoded or sizes differ.
+	bool Load(const wchar_t* leftFileName, const wchar_t* rightFileName);
+
+	// Build from decoded halves, width x height heights in [0, 1] each, rows top to bottom. Mips are box filtered.
+	bool Create(uint32_t width, uint32_t height, IN const float* left, IN const float* right);
+
+	bool IsLoaded() const { return m_levelCount > 0; }
+	uint32_t GetLevelCount() const { return m_levelCount; }
+	uint64_t GetMemorySize() const;
+
+	// SampleLevel of one half (0 left, 1 right) at texture coordinates (u, v). Level is clamped to last one.
+	float SampleBilinear(uint32_t half, float u, float v, uint32_t level) const;
+
+	// Height in [0, 1] under direction, which doesn't need to be normalized.
+	float SampleHeight(IN const DirectX::XMFLOAT3& direction, uint32_t level) const;
+
+	// SampleHeight of count directions, four at once. Same signature as HeightQuery of Tessellator.
+	void SampleHeights(
+		IN const DirectX::XMFLOAT3* directions, IN const uint32_t* levels, uint32_t count, OUT float* heights) const;
+
+	// Distance of displaced surface from sphere center under positions, 150 + height * 0.6 as DS.
+	float GetSurfaceRadius(IN const DirectX::XMFLOAT3& position, uint32_t level = 0) const;
+	void GetSurfaceRadii(
+		IN const DirectX::XMFLOAT3* positions, uint32_t count, uint32_t level, OUT float* radii) const;
+
+	// Time scalar and batched sampling of the same random directions at level.
+	TerrainSamplerBenchmark RunBenchmark(uint32_t queryCount, uint32_t level) const;
+
+private:
+	struct Level
+	{
+		uint32_t				width;
+		uint32_t				height;
+		std::vector<uint16_t>	texels[2];		// Left and right halves
+	};
+
+	bool DecodeLevel(TextureDecoder& decoder, uint32_t half, uint32_t level);
+	void BuildMissingLevels(uint32_t firstLevel);
+
+	// Four directions, structure of arrays, each lane with its own level.
+	void SampleBatch(
+		DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z, IN const uint32_t levels[4],
+		OUT DirectX::XMVECTOR& heights) const;
+
+	Level						m_levels[TERRAIN_SAMPLER_LEVEL_COUNT];
+	uint32_t					m_levelCount = 0;
+};
@@ -0,0 +1,376 @@
+#include "pch.h"
+#include "TessFactor.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Half width of cube before projection, for face and cube edge detection.
+	constexpr float c_cubeHalfWidth = 150.0f;
+
+	// Corners of each edge, see PatchTessFactors.
+	constexpr int c_edgeCorners[4][2] = { { 0, 2 }, { 0, 1 }, { 1, 3 }, { 2, 3 } };
+
+	// HLSL sign returns int.
+	inline float Sign(float value)
+	{
+		return static_cast<float>((value > 0.0f) - (value < 0.0f));
+	}
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline bool SameQuadPos(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	// Both corners on same side of group boundary.
+	bool IsOnGroupBorder(const TessGroup& group, const XMFLOAT3& a, const XMFLOAT3& b, float halfWidth, float tolerance)
+	{
+		const XMFLOAT3 da(a.x - group.quadPos.x, a.y - group.quadPos.y, a.z - group.quadPos.z);
+		const XMFLOAT3 db(b.x - group.quadPos.x, b.y - group.quadPos.y, b.z - group.quadPos.z);
+
+		const auto onLine = [&](const XMFLOAT3& axis)
+		{
+			return fabsf(fabsf(Dot(da, axis)) - halfWidth) < tolerance && fabsf(fabsf(Dot(db, axis)) - halfWidth) < tolerance;
+		};
+
+		return onLine(group.right) || onLine(group.up);
+	}
+
+	// Corner positions of edge, in fixed order so both sides make the same key.
+	struct EdgeKey
+	{
+		uint32_t	bits[6];
+
+		bool operator==(const EdgeKey& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+	};
+
+	struct EdgeKeyHash
+	{
+		size_t operator()(const EdgeKey& key) const
+		{
+			// FNV-1a over corner bits.
+			uint64_t hash = 14695981039346656037ull;
+			for (uint32_t word : key.bits)
+			{
+				hash ^= word;
+				hash *= 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	struct OpenEdge
+	{
+		float		factor;
+		bool		inner;		// Inside group, other side was skipped with group factor
+	};
+
+	EdgeKey MakeEdgeKey(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		EdgeKey first = {};
+		EdgeKey second = {};
+		memcpy(&first.bits[0], &a, sizeof(XMFLOAT3));
+		memcpy(&first.bits[3], &b, sizeof(XMFLOAT3));
+		memcpy(&second.bits[0], &b, sizeof(XMFLOAT3));
+		memcpy(&second.bits[3], &a, sizeof(XMFLOAT3));
+
+		return memcmp(first.bits, second.bits, sizeof(first.bits)) <= 0 ? first : second;
+	}
+}
+
+XMVECTOR TessFactor::CalcTessFactorBatch(const TessParameters& params, FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+	// spherePos = normalize(planePos) * 150.
+	const XMVECTOR invLength = XMVectorReciprocalSqrt(x * x + y * y + z * z);
+	const XMVECTOR radius = XMVectorReplicate(SPHERE_RADIUS);
+	const XMVECTOR dx = x * invLength * radius - XMVectorReplicate(params.cameraPosition.x);
+	const XMVECTOR dy = y * invLength * radius - XMVectorReplicate(params.cameraPosition.y);
+	const XMVECTOR dz = z * invLength * radius - XMVectorReplicate(params.cameraPosition.z);
+
+	const XMVECTOR d = XMVectorSqrt(dx * dx + dy * dy + dz * dz);
+	const XMVECTOR s = XMVectorSaturate(
+		(d - XMVectorReplicate(TESS_NEAR_DISTANCE)) / XMVectorReplicate(TESS_FAR_DISTANCE - TESS_NEAR_DISTANCE));
+
+	// pow(s, 0.8), which is 0 for s = 0.
+	const XMVECTOR zero = XMVectorZero();
+	XMVECTOR p = XMVectorExp2(XMVectorReplicate(0.8f) * XMVectorLog2(s));
+	p = XMVectorSelect(p, zero, XMVectorEqual(s, zero));
+
+	// (int) cast truncates, and pow(2, n) of integer n is exact.
+	const XMVECTOR w = XMVectorReplicate(params.parameters.w);
+	const XMVECTOR exponent = XMVectorTruncate(-w * p + w);
+	return XMVectorRound(XMVectorExp2(exponent));
+}
+
+float TessFactor::CalcTessFactor(const TessParameters& params, const XMFLOAT3& planePos)
+{
+	// Through batch version, so scalar and batch results are same.
+	return XMVectorGetX(
+		CalcTessFactorBatch(
+			params, XMVectorReplicate(planePos.x), XMVectorReplicate(planePos.y), XMVectorReplicate(planePos.z)));
+}
+
+TessGroup TessFactor::PrepareGroup(const TessParameters& params, const XMFLOAT3& quadPos)
+{
+	TessGroup group = {};
+	group.quadPos = quadPos;
+
+	// Face detection.
+	if (fabsf(fabsf(quadPos.z) - c_cubeHalfWidth) <= 0.001f)
+	{
+		group.right = XMFLOAT3(-Sign(quadPos.z), 0.0f, 0.0f);
+		group.up = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	}
+	else if (fabsf(fabsf(quadPos.x) - c_cubeHalfWidth) <= 0.001f)
+	{
+		group.right = XMFLOAT3(0.0f, 0.0f, Sign(quadPos.x));
+		group.up = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	}
+	else
+	{
+		group.right = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		group.up = XMFLOAT3(0.0f, 0.0f, Sign(quadPos.y));
+	}
+
+	// Adjacent group below, left, above and right, one lane each.
+	const float width = params.parameters.x;
+	const XMFLOAT3& r = group.right;
+	const XMFLOAT3& u = group.up;
+	const XMVECTOR x = XMVectorSet(quadPos.x - u.x * width, quadPos.x - r.x * width, quadPos.x + u.x * width, quadPos.x + r.x * width);
+	const XMVECTOR y = XMVectorSet(quadPos.y - u.y * width, quadPos.y - r.y * width, quadPos.y + u.y * width, quadPos.y + r.y * width);
+	const XMVECTOR z = XMVectorSet(quadPos.z - u.z * width, quadPos.z - r.z * width, quadPos.z + u.z * width, quadPos.z + r.z * width);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(group.estTess), CalcTessFactorBatch(params, x, y, z));
+
+	group.tess = CalcTessFactor(params, quadPos);
+
+	return group;
+}
+
+PatchTessFactors TessFactor::EvaluatePatch(const TessParameters& params, const TessGroup& group, const VertexTess* const patch[4])
+{
+	const XMFLOAT3& p0 = patch[0]->position;
+	const XMFLOAT3& p1 = patch[1]->position;
+	const XMFLOAT3& p2 = patch[2]->position;
+	const XMFLOAT3& p3 = patch[3]->position;
+
+	const XMFLOAT3 planeCenterPos(
+		0.25f * (p0.x + p1.x + p2.x + p3.x), 0.25f * (p0.y + p1.y + p2.y + p3.y), 0.25f * (p0.z + p1.z + p2.z + p3.z));
+	const XMFLOAT3& planeQuadPos = group.quadPos;
+
+	const float tess = group.tess;
+
+	const float width = params.parameters.x;
+	const uint32_t unitCount = static_cast<uint32_t>(params.parameters.y);
+	const float unitWidth = width / static_cast<float>(unitCount);
+
+	const float planeQuadPosR = Dot(planeQuadPos, group.right);
+	const float planeQuadPosU = Dot(planeQuadPos, group.up);
+	const float planeCenterPosR = Dot(planeCenterPos, group.right);
+	const float planeCenterPosU = Dot(planeCenterPos, group.up);
+
+	PatchTessFactors output;
+
+	// Unsigned like HLSL, so it wraps around when unitCount is 1.
+	const float innerDistance = unitWidth * static_cast<float>(unitCount / 2 - 1);
+	if (fabsf(planeQuadPosR - planeCenterPosR) <= innerDistance && fabsf(planeQuadPosU - planeCenterPosU) <= innerDistance)
+	{
+		for (float& edgeTess : output.edgeTess)
+			edgeTess = tess;
+		output.insideTess[0] = tess;
+		output.insideTess[1] = tess;
+		return output;
+	}
+
+	// Rotation of patch.
+	const float x0 = Dot(p0, group.right);
+	const float y0 = Dot(p0, group.up);
+	const float x1 = Dot(p1, group.right);
+	const float y1 = Dot(p1, group.up);
+	const uint32_t rotation = (x0 == x1) ? (y0 < y1 ? 0 : 2) : (x0 < x1 ? 1 : 3);
+
+	// Bottom, left, top, right.
+	const bool border[4] =
+	{
+		planeCenterPosU - unitWidth < planeQuadPosU - width / 2,
+		planeCenterPosR - unitWidth < planeQuadPosR - width / 2,
+		planeCenterPosU + unitWidth > planeQuadPosU + width / 2,
+		planeCenterPosR + unitWidth > planeQuadPosR + width / 2,
+	};
+
+	// Group on cube edge.
+	const bool quadBorder[4] =
+	{
+		border[0] && planeQuadPosU - width < -c_cubeHalfWidth,
+		border[1] && planeQuadPosR - width < -c_cubeHalfWidth,
+		border[2] && planeQuadPosU + width > c_cubeHalfWidth,
+		border[3] && planeQuadPosR + width > c_cubeHalfWidth,
+	};
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		const uint32_t side = (i + rotation) % 4;
+		if (quadBorder[side])
+			output.edgeTess[i] = CalcTessFactor(params, p0);
+		else
+			output.edgeTess[i] = border[side] ? std::min(group.estTess[side], tess) : tess;
+	}
+	output.insideTess[0] = tess;
+	output.insideTess[1] = tess;
+
+	return output;
+}
+
+IntegerTessFactors TessFactor::PartitionInteger(const PatchTessFactors& factors)
+{
+	const auto partition = [](float factor)
+	{
+		return std::min(std::max(static_cast<uint32_t>(ceilf(factor)), 1u), TESS_MAX_FACTOR);
+	};
+
+	IntegerTessFactors result;
+	for (uint32_t i = 0; i < 4; i++)
+		result.edgeTess[i] = partition(factors.edgeTess[i]);
+	result.insideTess[0] = partition(factors.insideTess[0]);
+	result.insideTess[1] = partition(factors.insideTess[1]);
+
+	if (!result.IsQuad())
+	{
+		result.insideTess[0] = std::max(result.insideTess[0], 2u);
+		result.insideTess[1] = std::max(result.insideTess[1], 2u);
+	}
+
+	return result;
+}
+
+uint32_t TessFactor::CalcLevel(float w, float tess)
+{
+	return static_cast<uint32_t>(std::max(0.0f, (w - 2.0f) - static_cast<float>(static_cast<int>(log2f(tess)))));
+}
+
+uint32_t TessFactor::CalcTriangleCount(const PatchTessFactors& factors)
+{
+	const IntegerTessFactors tess = PartitionInteger(factors);
+	if (tess.IsQuad())
+		return 2;
+
+	const uint32_t* edges = tess.edgeTess;
+	const uint32_t insideU = tess.insideTess[0];
+	const uint32_t insideV = tess.insideTess[1];
+
+	// Inner grid, then a strip between each edge and its side of inner ring.
+	// Edges 1 and 3 run along u, edges 0 and 2 along v.
+	return 2 * (insideU - 2) * (insideV - 2)
+		+ edges[1] + edges[3] + 2 * (insideU - 2)
+		+ edges[0] + edges[2] + 2 * (insideV - 2);
+}
+
+uint64_t TessFactor::EstimateTriangleCount(
+	const TessParameters& params, const VertexTess* vertices, const uint32_t* indices,
+	const IndexRange* ranges, uint32_t rangeCount)
+{
+	uint64_t triangleCount = 0;
+
+	// Patches of a group are contiguous in index buffer, so group is prepared once for all of them.
+	TessGroup group = {};
+	bool hasGroup = false;
+	for (uint32_t r = 0; r < rangeCount; r++)
+	{
+		const uint32_t end = ranges[r].start + ranges[r].count;
+		for (uint32_t index = ranges[r].start; index < end; index += 4)
+		{
+			const VertexTess* const patch[4] =
+			{
+				&vertices[indices[index]], &vertices[indices[index + 1]], &vertices[indices[index + 2]], &vertices[indices[index + 3]],
+			};
+
+			if (!hasGroup || !SameQuadPos(group.quadPos, patch[3]->quadPos))
+			{
+				group = PrepareGroup(params, patch[3]->quadPos);
+				hasGroup = true;
+			}
+
+			triangleCount += CalcTriangleCount(EvaluatePatch(params, group, patch));
+		}
+	}
+
+	return triangleCount;
+}
+
+TessEdgeCheck TessFactor::CheckSharedEdges(
+	const TessParameters& params, const VertexTess* vertices, const uint32_t* indices, uint32_t indexCount)
+{
+	TessEdgeCheck result = {};
+
+	const float halfWidth = 0.5f * params.parameters.x;
+	const float tolerance = 0.25f * params.parameters.x / params.parameters.y;
+
+	std::unordered_map<EdgeKey, OpenEdge, EdgeKeyHash> openEdges;
+	uint64_t skippedSideCount = 0;
+
+	TessGroup group = {};
+	bool hasGroup = false;
+	for (uint32_t index = 0; index + 4 <= indexCount; index += 4)
+	{
+		const VertexTess* const patch[4] =
+		{
+			&vertices[indices[index]], &vertices[indices[index + 1]], &vertices[indices[index + 2]], &vertices[indices[index + 3]],
+		};
+
+		if (!hasGroup || !SameQuadPos(group.quadPos, patch[3]->quadPos))
+		{
+			group = PrepareGroup(params, patch[3]->quadPos);
+			hasGroup = true;
+		}
+
+		const PatchTessFactors factors = EvaluatePatch(params, group, patch);
+		for (uint32_t e = 0; e < 4; e++)
+		{
+			const XMFLOAT3& a = patch[c_edgeCorners[e][0]]->position;
+			const XMFLOAT3& b = patch[c_edgeCorners[e][1]]->position;
+			const float factor = factors.edgeTess[e];
+
+			const bool inner = !IsOnGroupBorder(group, a, b, halfWidth, tolerance);
+			if (inner && factor == group.tess)
+			{
+				skippedSideCount++;
+				continue;
+			}
+
+			const EdgeKey key = MakeEdgeKey(a, b);
+			const auto it = openEdges.find(key);
+			if (it == openEdges.end())
+			{
+				openEdges.emplace(key, OpenEdge{ factor, inner });
+				continue;
+			}
+
+			result.sharedEdgeCount++;
+			if (it->second.factor != factor)
+				result.mismatchCount++;
+			openEdges.erase(it);
+		}
+	}
+
+	// Inner edge left open got group factor from skipped side, so it is a crack.
+	uint64_t innerOpenCount = 0;
+	for (const auto& openEdge : openEdges)
+	{
+		if (openEdge.second.inner)
+		{
+			innerOpenCount++;
+			result.mismatchCount++;
+		}
+		else
+		{
+			result.unmatchedCount++;
+		}
+	}
+	result.sharedEdgeCount += static_cast<uint32_t>((skippedSideCount + innerOpenCount) / 2);
+
+	return result;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#include "QuadTree.h"
+
+#define TESS_NEAR_DISTANCE 10.0f
+#define TESS_FAR_DISTANCE 150.0f
+#define TESS_MAX_FACTOR 64u		// D3D11_TESSELLATOR_MAX_TESSELLATION_FACTOR
+
+// Tess factors of one patch, same layout as PatchTess of Shader.hlsli.
+// Edge 0 is u = 0 (corners 0, 2), 1 is v = 0 (0, 1), 2 is u = 1 (1, 3) and 3 is v = 1 (2, 3).
+struct PatchTessFactors
+{
+	float				edgeTess[4];
+	float				insideTess[2];
+};
+
+// Factors of one patch after integer partitioning, which tessellator really uses.
+struct IntegerTessFactors
+{
+	uint32_t			edgeTess[4];
+	uint32_t			insideTess[2];
+
+	// Every factor 1, patch is drawn as two triangles.
+	bool IsQuad() const
+	{
+		return edgeTess[0] == 1 && edgeTess[1] == 1 && edgeTess[2] == 1 && edgeTess[3] == 1 && insideTess[0] == 1 && insideTess[1] == 1;
+	}
+};
+
+// Constant buffer values read by ConstantHS.
+// parameters is (quad width, unit count, min tess, max tess exponent), same vector as OpaqueCB and ShadowCB.
+struct TessParameters
+{
+	DirectX::XMFLOAT3	cameraPosition;
+	DirectX::XMFLOAT4	parameters;
+};
+
+// Values shared by every patch of one tess group, which all have the same quad position.
+struct TessGroup
+{
+	DirectX::XMFLOAT3	quadPos;
+	DirectX::XMFLOAT3	right;
+	DirectX::XMFLOAT3	up;
+	float				tess;
+	float				estTess[4];		// Estimated factor of adjacent groups (bottom, left, top, right)
+};
+
+struct TessEdgeCheck
+{
+	uint32_t			sharedEdgeCount;
+	uint32_t			mismatchCount;		// Shared edges with different factors on each side
+	uint32_t			unmatchedCount;		// Edges of only one patch, none on closed sphere
+};
+
+// CPU port of CalcTessFactor and ConstantHS of Shader.hlsli (Shadow.hlsli is same with its own parameters).
+// Float operations are done in the same order as HLSL, integer ones with the same types, and pow is
+// exp2(y * log2(x)) as the shader compiler emits it. Factors are exact powers of two, so results match
+// GPU except where a factor exponent is within rounding of an integer step. XMVectorLog2 and XMVectorExp2
+// are not exact either: against plain float math, factors differ by one step when exponent is within 1e-4
+// of an integer step (see TessFactorTests).
+namespace TessFactor
+{
+	// CalcTessFactor of four plane positions at once, as structure of arrays.
+	DirectX::XMVECTOR CalcTessFactorBatch(
+		IN const TessParameters& params, DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z);
+	float CalcTessFactor(IN const TessParameters& params, IN const DirectX::XMFLOAT3& planePos);
+
+	// Face axes, factor and estimated neighbour factors of group at quadPos, in one batch.
+	TessGroup PrepareGroup(IN const TessParameters& params, IN const DirectX::XMFLOAT3& quadPos);
+
+	// ConstantHS of one patch, corners in index buffer order. group must be prepared from its quad position.
+	PatchTessFactors EvaluatePatch(IN const TessParameters& params, IN const TessGroup& group, IN const VertexTess* const patch[4]);
+
+	// Integer partitioning rounds factors up into [1, TESS_MAX_FACTOR].
+	// Inside factors of 1 are raised to 2 unless patch is a quad, so split edges have a ring to be stitched to.
+	IntegerTessFactors PartitionInteger(IN const PatchTessFactors& factors);
+
+	// CalcLevel of DS, mip level of displacement map sampled for a factor. w is max tess exponent.
+	uint32_t CalcLevel(float w, float tess);
+
+	// Triangles emitted by tessellator with integer partitioning.
+	uint32_t CalcTriangleCount(IN const PatchTessFactors& factors);
+
+	// Sum of CalcTriangleCount for every patch of ranges.
+	uint64_t EstimateTriangleCount(
+		IN const TessParameters& params, IN const VertexTess* vertices, IN const uint32_t* indices,
+		IN const IndexRange* ranges, uint32_t rangeCount);
+
+	// Evaluate every patch of index buffer and compare factors each side gives to shared edges.
+	// Edges inside a group are stored only if they don't get group factor, so most are never hashed.
+	TessEdgeCheck CheckSharedEdges(
+		IN const TessParameters& params, IN const VertexTess* vertices, IN const uint32_t* indices, uint32_t indexCount);
+}
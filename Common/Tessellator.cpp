@@ -0,0 +1,429 @@
+#include "pch.h"
+#include "Tessellator.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+	// Points evaluated per height query.
+	constexpr uint32_t c_chunkSize = 256;
+
+	constexpr float c_weldScale = 1024.0f;
+
+	void AddTriangle(QuadDomain& domain, uint32_t a, uint32_t b, uint32_t c)
+	{
+		const XMFLOAT2& pa = domain.points[a];
+		const XMFLOAT2& pb = domain.points[b];
+		const XMFLOAT2& pc = domain.points[c];
+
+		const float area = (pb.x - pa.x) * (pc.y - pa.y) - (pb.y - pa.y) * (pc.x - pa.x);
+		if (area < 0.0f)
+			std::swap(b, c);
+
+		domain.indices.push_back(a);
+		domain.indices.push_back(b);
+		domain.indices.push_back(c);
+	}
+
+	// Point k of edge e, from its first corner to its second (see PatchTessFactors).
+	struct EdgePoints
+	{
+		uint32_t	corners[2];
+		uint32_t	base;		// Index of point 1
+		uint32_t	count;		// Segments
+
+		uint32_t operator[](uint32_t k) const { return k == 0 ? corners[0] : k == count ? corners[1] : base + k - 1; }
+	};
+
+	// Inner grid point (i, j), i in [1, insideU - 1] and j in [1, insideV - 1].
+	struct InnerPoints
+	{
+		uint32_t	base;
+		uint32_t	width;		// insideU - 1
+
+		uint32_t operator()(uint32_t i, uint32_t j) const { return base + (j - 1) * width + (i - 1); }
+	};
+
+	struct WeldKey
+	{
+		int32_t		position[3];
+
+		bool operator==(const WeldKey& other) const
+		{
+			return position[0] == other.position[0] && position[1] == other.position[1] && position[2] == other.position[2];
+		}
+	};
+
+	struct WeldKeyHash
+	{
+		size_t operator()(const WeldKey& key) const
+		{
+			// FNV-1a over grid coordinates.
+			uint64_t hash = 14695981039346656037ull;
+			for (int32_t word : key.position)
+			{
+				hash ^= static_cast<uint32_t>(word);
+				hash *= 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+}
+
+void Tessellator::BuildDomain(const IntegerTessFactors& factors, QuadDomain& domain)
+{
+	domain.factors = factors;
+	domain.points.clear();
+	domain.indices.clear();
+
+	// Same places as patch corners.
+	domain.points.emplace_back(0.0f, 0.0f);
+	domain.points.emplace_back(1.0f, 0.0f);
+	domain.points.emplace_back(0.0f, 1.0f);
+	domain.points.emplace_back(1.0f, 1.0f);
+
+	if (factors.IsQuad())
+	{
+		AddTriangle(domain, 0, 1, 2);
+		AddTriangle(domain, 2, 1, 3);
+		return;
+	}
+
+	// Edge points without corners. Edges 0 and 2 run along v, 1 and 3 along u.
+	constexpr uint32_t edgeCorners[4][2] = { { 0, 2 }, { 0, 1 }, { 1, 3 }, { 2, 3 } };
+	EdgePoints edges[4];
+	for (uint32_t e = 0; e < 4; e++)
+	{
+		const uint32_t count = factors.edgeTess[e];
+		edges[e] = { { edgeCorners[e][0], edgeCorners[e][1] }, static_cast<uint32_t>(domain.points.size()), count };
+
+		for (uint32_t k = 1; k < count; k++)
+		{
+			const float t = static_cast<float>(k) / static_cast<float>(count);
+			switch (e)
+			{
+			case 0: domain.points.emplace_back(0.0f, t); break;
+			case 1: domain.points.emplace_back(t, 0.0f); break;
+			case 2: domain.points.emplace_back(1.0f, t); break;
+			default: domain.points.emplace_back(t, 1.0f); break;
+			}
+		}
+	}
+
+	// Inner grid, one point if both inside factors are 2.
+	const uint32_t insideU = factors.insideTess[0];
+	const uint32_t insideV = factors.insideTess[1];
+	const InnerPoints inner = { static_cast<uint32_t>(domain.points.size()), insideU - 1 };
+	for (uint32_t j = 1; j < insideV; j++)
+	{
+		for (uint32_t i = 1; i < insideU; i++)
+			domain.points.emplace_back(static_cast<float>(i) / insideU, static_cast<float>(j) / insideV);
+	}
+
+	for (uint32_t j = 1; j + 1 < insideV; j++)
+	{
+		for (uint32_t i = 1; i + 1 < insideU; i++)
+		{
+			AddTriangle(domain, inner(i, j), inner(i + 1, j), inner(i, j + 1));
+			AddTriangle(domain, inner(i, j + 1), inner(i + 1, j), inner(i + 1, j + 1));
+		}
+	}
+
+	// Strip between each edge and the same side of inner ring, merged by parameter along edge.
+	for (uint32_t e = 0; e < 4; e++)
+	{
+		const bool alongV = e == 0 || e == 2;
+		const uint32_t ringCount = alongV ? insideV - 1 : insideU - 1;
+		const auto ring = [&](uint32_t l)
+		{
+			switch (e)
+			{
+			case 0: return inner(1, l + 1);
+			case 1: return inner(l + 1, 1);
+			case 2: return inner(insideU - 1, l + 1);
+			default: return inner(l + 1, insideV - 1);
+			}
+		};
+		const auto parameter = [&](uint32_t point)
+		{
+			return alongV ? domain.points[point].y : domain.points[point].x;
+		};
+
+		const EdgePoints& edge = edges[e];
+		uint32_t a = 0;
+		uint32_t b = 0;
+		while (a < edge.count || b + 1 < ringCount)
+		{
+			const bool advanceEdge = b + 1 == ringCount ||
+				(a < edge.count && parameter(edge[a + 1]) <= parameter(ring(b + 1)));
+			if (advanceEdge)
+			{
+				AddTriangle(domain, edge[a], edge[a + 1], ring(b));
+				a++;
+			}
+			else
+			{
+				AddTriangle(domain, edge[a], ring(b + 1), ring(b));
+				b++;
+			}
+		}
+	}
+}
+
+void Tessellator::EvaluatePatch(
+	const TessParameters& params, const VertexTess* const patch[4], const PatchTessFactors& factors,
+	const QuadDomain& domain, const HeightQuery* heights, XMFLOAT3* positions)
+{
+	const float w = params.parameters.w;
+
+	// Levels of DS, corners always sample level 0.
+	const uint32_t insideLevel = TessFactor::CalcLevel(w, factors.insideTess[0]);
+	uint32_t edgeLevels[4];
+	for (uint32_t i = 0; i < 4; i++)
+		edgeLevels[i] = TessFactor::CalcLevel(w, factors.edgeTess[i]);
+	const float cornerDistance = sqrtf(2.0f) / 2.0f;
+
+	XMVECTOR corners[4][3];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		corners[c][0] = XMVectorReplicate(patch[c]->position.x);
+		corners[c][1] = XMVectorReplicate(patch[c]->position.y);
+		corners[c][2] = XMVectorReplicate(patch[c]->position.z);
+	}
+
+	const auto count = static_cast<uint32_t>(domain.points.size());
+	for (uint32_t chunk = 0; chunk < count; chunk += c_chunkSize)
+	{
+		const uint32_t chunkCount = std::min(c_chunkSize, count - chunk);
+
+		// Bilinear position and its direction, four points at once. Last batch repeats its last point.
+		XMFLOAT3* directions = positions + chunk;
+		for (uint32_t i = 0; i < chunkCount; i += 4)
+		{
+			XMFLOAT2 uv[4];
+			for (uint32_t lane = 0; lane < 4; lane++)
+				uv[lane] = domain.points[chunk + std::min(i + lane, chunkCount - 1)];
+			const XMVECTOR u = XMVectorSet(uv[0].x, uv[1].x, uv[2].x, uv[3].x);
+			const XMVECTOR v = XMVectorSet(uv[0].y, uv[1].y, uv[2].y, uv[3].y);
+
+			// lerp(x, y, s) = x + s * (y - x), as HLSL.
+			XMVECTOR position[3];
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const XMVECTOR v1 = XMVectorMultiplyAdd(u, corners[1][axis] - corners[0][axis], corners[0][axis]);
+				const XMVECTOR v2 = XMVectorMultiplyAdd(u, corners[3][axis] - corners[2][axis], corners[2][axis]);
+				position[axis] = XMVectorMultiplyAdd(v, v2 - v1, v1);
+			}
+
+			const XMVECTOR invLength = XMVectorReciprocalSqrt(
+				position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+
+			XMFLOAT4 x, y, z;
+			XMStoreFloat4(&x, position[0] * invLength);
+			XMStoreFloat4(&y, position[1] * invLength);
+			XMStoreFloat4(&z, position[2] * invLength);
+
+			const float xs[4] = { x.x, x.y, x.z, x.w };
+			const float ys[4] = { y.x, y.y, y.z, y.w };
+			const float zs[4] = { z.x, z.y, z.z, z.w };
+			for (uint32_t lane = 0; lane < 4 && i + lane < chunkCount; lane++)
+				directions[i + lane] = XMFLOAT3(xs[lane], ys[lane], zs[lane]);
+		}
+
+		float chunkHeights[c_chunkSize] = {};
+		if (heights && *heights)
+		{
+			uint32_t levels[c_chunkSize];
+			for (uint32_t i = 0; i < chunkCount; i++)
+			{
+				const XMFLOAT2& uv = domain.points[chunk + i];
+
+				uint32_t level = insideLevel;
+				const float du = uv.x - 0.5f;
+				const float dv = uv.y - 0.5f;
+				if (sqrtf(du * du + dv * dv) >= cornerDistance)
+				{
+					level = 0;
+				}
+				else
+				{
+					level = uv.x == 0.0f ? edgeLevels[0] : uv.x == 1.0f ? edgeLevels[2] : level;
+					level = uv.y == 0.0f ? edgeLevels[1] : uv.y == 1.0f ? edgeLevels[3] : level;
+				}
+				levels[i] = level;
+			}
+
+			(*heights)(directions, levels, chunkCount, chunkHeights);
+		}
+
+		// catPos = normCatPos * (150 + height * 0.6), world matrix is identity.
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			const float radius = SPHERE_RADIUS + chunkHeights[i] * SPHERE_MAX_DISPLACEMENT;
+			directions[i] = XMFLOAT3(directions[i].x * radius, directions[i].y * radius, directions[i].z * radius);
+		}
+	}
+}
+
+void Tessellator::Expand(
+	const TessParameters& params, const VertexTess* vertices, const uint32_t* indices,
+	const IndexRange* ranges, uint32_t rangeCount, const HeightQuery* heights, TessMesh& mesh)
+{
+	// Neighbouring patches mostly have same factors, so domain is rebuilt only when they change.
+	QuadDomain domain;
+	bool hasDomain = false;
+
+	TessGroup group = {};
+	bool hasGroup = false;
+	for (uint32_t r = 0; r < rangeCount; r++)
+	{
+		const uint32_t end = ranges[r].start + ranges[r].count;
+		for (uint32_t index = ranges[r].start; index < end; index += 4)
+		{
+			const VertexTess* const patch[4] =
+			{
+				&vertices[indices[index]], &vertices[indices[index + 1]], &vertices[indices[index + 2]], &vertices[indices[index + 3]],
+			};
+
+			if (!hasGroup ||
+				group.quadPos.x != patch[3]->quadPos.x || group.quadPos.y != patch[3]->quadPos.y || group.quadPos.z != patch[3]->quadPos.z)
+			{
+				group = TessFactor::PrepareGroup(params, patch[3]->quadPos);
+				hasGroup = true;
+			}
+
+			const PatchTessFactors factors = TessFactor::EvaluatePatch(params, group, patch);
+			const IntegerTessFactors tess = TessFactor::PartitionInteger(factors);
+			if (!hasDomain || memcmp(&tess, &domain.factors, sizeof(IntegerTessFactors)) != 0)
+			{
+				BuildDomain(tess, domain);
+				hasDomain = true;
+			}
+
+			const auto base = static_cast<uint32_t>(mesh.positions.size());
+			mesh.positions.resize(base + domain.points.size());
+			EvaluatePatch(params, patch, factors, domain, heights, &mesh.positions[base]);
+
+			for (uint32_t domainIndex : domain.indices)
+				mesh.indices.push_back(base + domainIndex);
+			mesh.patchCount++;
+		}
+	}
+}
+
+TessMeshCheck Tessellator::CheckMesh(const TessMesh* meshes, uint32_t meshCount)
+{
+	TessMeshCheck result = {};
+
+	// Same point of neighbouring patches can differ in last bits, as DS interpolates it from other corners.
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> welded;
+	std::unordered_map<uint64_t, uint32_t> edges;
+	std::vector<uint32_t> remap;
+
+	for (uint32_t m = 0; m < meshCount; m++)
+	{
+		const TessMesh& mesh = meshes[m];
+
+		remap.resize(mesh.positions.size());
+		for (size_t v = 0; v < mesh.positions.size(); v++)
+		{
+			const XMFLOAT3& position = mesh.positions[v];
+			const WeldKey key =
+			{
+				{
+					static_cast<int32_t>(lroundf(position.x * c_weldScale)),
+					static_cast<int32_t>(lroundf(position.y * c_weldScale)),
+					static_cast<int32_t>(lroundf(position.z * c_weldScale)),
+				}
+			};
+			remap[v] = welded.emplace(key, static_cast<uint32_t>(welded.size())).first->second;
+		}
+
+		for (size_t t = 0; t + 3 <= mesh.indices.size(); t += 3)
+		{
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				const uint32_t a = remap[mesh.indices[t + e]];
+				const uint32_t b = remap[mesh.indices[t + (e + 1) % 3]];
+				if (a == b)
+					continue;
+
+				edges[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)]++;
+			}
+		}
+	}
+
+	result.weldedVertexCount = static_cast<uint32_t>(welded.size());
+	result.edgeCount = static_cast<uint32_t>(edges.size());
+	for (const auto& edge : edges)
+	{
+		if (edge.second == 1)
+			result.openEdgeCount++;
+		else if (edge.second > 2)
+			result.nonManifoldEdgeCount++;
+	}
+
+	return result;
+}
+
+bool Tessellator::WriteObj(const wchar_t* fileName, const TessMesh* meshes, uint32_t meshCount)
+{
+	const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Written in blocks, whole mesh as text can be a few GB.
+	constexpr size_t flushSize = 1 << 20;
+	std::string out;
+	out.reserve(flushSize + 256);
+
+	bool result = true;
+	const auto flush = [&](bool force)
+	{
+		if (!result || (!force && out.size() < flushSize))
+			return;
+
+		DWORD written = 0;
+		result = WriteFile(file, out.data(), static_cast<DWORD>(out.size()), &written, nullptr) && written == out.size();
+		out.clear();
+	};
+
+	char line[128];
+	for (uint32_t m = 0; m < meshCount; m++)
+	{
+		for (const XMFLOAT3& position : meshes[m].positions)
+		{
+			const int length = snprintf(line, sizeof(line), "v %.5f %.5f %.5f\n", position.x, position.y, position.z);
+			out.append(line, static_cast<size_t>(length));
+			flush(false);
+		}
+	}
+
+	// OBJ indices start from 1 and run over every mesh.
+	uint64_t base = 1;
+	for (uint32_t m = 0; m < meshCount; m++)
+	{
+		const std::vector<uint32_t>& indices = meshes[m].indices;
+		for (size_t t = 0; t + 3 <= indices.size(); t += 3)
+		{
+			const int length = snprintf(line, sizeof(line), "f %llu %llu %llu\n",
+				static_cast<unsigned long long>(base + indices[t]),
+				static_cast<unsigned long long>(base + indices[t + 1]),
+				static_cast<unsigned long long>(base + indices[t + 2]));
+			out.append(line, static_cast<size_t>(length));
+			flush(false);
+		}
+		base += meshes[m].positions.size();
+	}
+
+	flush(true);
+	CloseHandle(file);
+
+	if (!result)
+		DeleteFileW(fileName);
+
+	return result;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "TessFactor.h"
+
+// Heights in [0, 1] of displacement map for count unit directions, sampled at given mip levels as DS does.
+using HeightQuery = std::function<void(
+	const DirectX::XMFLOAT3* directions, const uint32_t* levels, uint32_t count, OUT float* heights)>;
+
+// Domain points and triangles of one patch for a set of integer factors.
+// Triangles have positive area in (u, v), same winding as corners 0, 1, 2 of patch.
+struct QuadDomain
+{
+	IntegerTessFactors				factors;
+	std::vector<DirectX::XMFLOAT2>	points;
+	std::vector<uint32_t>			indices;
+};
+
+// Displaced triangle mesh in world space. Every patch has its own vertices.
+struct TessMesh
+{
+	std::vector<DirectX::XMFLOAT3>	positions;
+	std::vector<uint32_t>			indices;
+	uint32_t						patchCount = 0;
+
+	void Clear() { positions.clear(); indices.clear(); patchCount = 0; }
+};
+
+struct TessMeshCheck
+{
+	uint32_t						weldedVertexCount;
+	uint32_t						edgeCount;
+	uint32_t						openEdgeCount;		// Used by one triangle, a crack on closed sphere
+	uint32_t						nonManifoldEdgeCount;
+};
+
+// CPU quad domain tessellator with integer partitioning, for factors of ConstantHS.
+// Domain points are the ones D3D11 tessellator generates: k / factor along each edge and an inner grid of
+// inside factors. Transition strips between edges and inner ring are stitched monotonically, and inner grid
+// cells are split along the same diagonal everywhere.
+//
+// D3D11 instead mirrors diagonals about the middle of each ring and orders transition stitches by its ruler
+// function table, so where a strip or cell can be split more than one way the diagonals differ.
+// Points, triangle count and covered area are the same, and so are the triangles of inside factor 2, which
+// has only one way to be split. Compare output with GPU mesh as vertex sets, not triangle lists.
+namespace Tessellator
+{
+	// Points and triangles of factors. domain keeps its capacity, so rebuilding it for a patch rarely allocates.
+	void BuildDomain(IN const IntegerTessFactors& factors, OUT QuadDomain& domain);
+
+	// DS of Shader.hlsli for every point of domain, written to positions.
+	// Without heights, points are put on undisplaced sphere.
+	void EvaluatePatch(
+		IN const TessParameters& params, IN const VertexTess* const patch[4], IN const PatchTessFactors& factors,
+		IN const QuadDomain& domain, IN const HeightQuery* heights, OUT DirectX::XMFLOAT3* positions);
+
+	// Tessellate and displace every patch of ranges and append them to mesh.
+	void Expand(
+		IN const TessParameters& params, IN const VertexTess* vertices, IN const uint32_t* indices,
+		IN const IndexRange* ranges, uint32_t rangeCount, IN const HeightQuery* heights, OUT TessMesh& mesh);
+
+	// Weld vertices on a 1/1024 grid and count triangles of every edge.
+	TessMeshCheck CheckMesh(IN const TessMesh* meshes, uint32_t meshCount);
+
+	// Wavefront OBJ of meshes, as one object.
+	bool WriteObj(const wchar_t* fileName, IN const TessMesh* meshes, uint32_t meshCount);
+}
@@ -0,0 +1,385 @@
+#include "pch.h"
+#include "TextureDecoder.h"
+
+#include "DdsFormat.h"
+
+namespace
+{
+	// Find DXGI format of legacy pixel format.
+	uint32_t GetLegacyFormat(const Dds::PixelFormat& pf)
+	{
+		if (pf.flags & Dds::c_pixelFourCC)
+		{
+			if (pf.fourCC == Dds::MakeFourCC('D', 'X', 'T', '1'))
+				return DXGI_FORMAT_BC1_UNORM;
+			if (pf.fourCC == Dds::MakeFourCC('A', 'T', 'I', '1') || pf.fourCC == Dds::MakeFourCC('B', 'C', '4', 'U'))
+				return DXGI_FORMAT_BC4_UNORM;
+			if (pf.fourCC == 114)	// D3DFMT_R32F
+				return DXGI_FORMAT_R32_FLOAT;
+			return DXGI_FORMAT_UNKNOWN;
+		}
+
+		if ((pf.flags & Dds::c_pixelRGB) && pf.rgbBitCount == 32)
+		{
+			if (pf.rBitMask == 0x000000ff && pf.gBitMask == 0x0000ff00 && pf.bBitMask == 0x00ff0000)
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+			if (pf.rBitMask == 0x00ff0000 && pf.gBitMask == 0x0000ff00 && pf.bBitMask == 0x000000ff)
+				return DXGI_FORMAT_B8G8R8A8_UNORM;
+			return DXGI_FORMAT_UNKNOWN;
+		}
+
+		if (pf.flags & Dds::c_pixelLuminance)
+		{
+			if (pf.rgbBitCount == 8 && pf.rBitMask == 0xff)
+				return DXGI_FORMAT_R8_UNORM;
+			if (pf.rgbBitCount == 16 && pf.rBitMask == 0xffff)
+				return DXGI_FORMAT_R16_UNORM;
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	// Expand RGB565 to [0, 1].
+	inline void Expand565(uint16_t color, float rgb[3])
+	{
+		rgb[0] = static_cast<float>((color >> 11) & 0x1F) / 31.0f;
+		rgb[1] = static_cast<float>((color >> 5) & 0x3F) / 63.0f;
+		rgb[2] = static_cast<float>(color & 0x1F) / 31.0f;
+	}
+
+	bool IsSrgbFormat(uint32_t dxgiFormat)
+	{
+		return dxgiFormat == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+			dxgiFormat == DXGI_FORMAT_BC1_UNORM_SRGB;
+	}
+}
+
+bool TextureDecoder::Load(const wchar_t* fileName)
+{
+	m_fileData.clear();
+	m_bits = m_firstMipBits = nullptr;
+	m_format = Format::Unknown;
+	m_srgb = false;
+	m_dxgiFormat = 0;
+	m_width = m_height = 0;
+	m_mipCount = 0;
+
+	const HANDLE file = CreateFileW(
+		fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart > UINT32_MAX)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_fileData.resize(static_cast<size_t>(fileSize.QuadPart));
+
+	DWORD read = 0;
+	const BOOL result = ReadFile(file, m_fileData.data(), static_cast<DWORD>(m_fileData.size()), &read, nullptr);
+	CloseHandle(file);
+
+	if (!result || read != m_fileData.size())
+		return false;
+
+	uint32_t dxgiFormat;
+	size_t offset;
+	if (!ParseHeader(m_fileData.data(), m_fileData.size(), dxgiFormat, m_firstMipWidth, m_firstMipHeight, m_mipCount, offset))
+		return false;
+
+	// First mip of first array slice comes right after headers.
+	m_format = GetFormat(dxgiFormat);
+	m_srgb = IsSrgbFormat(dxgiFormat);
+	m_dxgiFormat = dxgiFormat;
+	m_firstMipBits = m_fileData.data() + offset;
+
+	if (!SelectMip(0))
+	{
+		m_format = Format::Unknown;
+		return false;
+	}
+
+	return true;
+}
+
+bool TextureDecoder::ParseHeader(
+	const uint8_t* data, size_t size, uint32_t& dxgiFormat, uint32_t& width, uint32_t& height, uint32_t& mipCount, size_t& dataOffset)
+{
+	static_assert(c_maxHeaderSize == sizeof(uint32_t) + sizeof(Dds::Header) + sizeof(Dds::HeaderDXT10), "DDS header size");
+
+	size_t offset = sizeof(uint32_t) + sizeof(Dds::Header);
+	if (size < offset)
+		return false;
+
+	uint32_t magic;
+	memcpy(&magic, data, sizeof(uint32_t));
+
+	Dds::Header header;
+	memcpy(&header, data + sizeof(uint32_t), sizeof(Dds::Header));
+
+	if (magic != Dds::c_magic || header.size != sizeof(Dds::Header) || header.ddspf.size != sizeof(Dds::PixelFormat))
+		return false;
+
+	uint32_t format;
+	if ((header.ddspf.flags & Dds::c_pixelFourCC) && header.ddspf.fourCC == Dds::MakeFourCC('D', 'X', '1', '0'))
+	{
+		if (size < offset + sizeof(Dds::HeaderDXT10))
+			return false;
+
+		Dds::HeaderDXT10 header10;
+		memcpy(&header10, data + offset, sizeof(Dds::HeaderDXT10));
+		offset += sizeof(Dds::HeaderDXT10);
+
+		format = header10.dxgiFormat;
+	}
+	else
+	{
+		format = GetLegacyFormat(header.ddspf);
+	}
+
+	if (GetFormat(format) == Format::Unknown || header.width == 0 || header.height == 0)
+		return false;
+
+	dxgiFormat = format;
+	width = header.width;
+	height = header.height;
+	mipCount = std::max(header.mipMapCount, 1u);
+	dataOffset = offset;
+
+	return true;
+}
+
+bool TextureDecoder::SelectMip(uint32_t mip)
+{
+	if (m_format == Format::Unknown || mip >= m_mipCount)
+		return false;
+
+	// Mips of first array slice are stored one after another.
+	const uint8_t* bits = m_firstMipBits;
+	uint32_t width = m_firstMipWidth;
+	uint32_t height = m_firstMipHeight;
+	for (uint32_t m = 0; m < mip; m++)
+	{
+		size_t rowPitch, rowCount;
+		CalcPitch(width, height, rowPitch, rowCount);
+		bits += rowPitch * rowCount;
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	size_t rowPitch, rowCount;
+	CalcPitch(width, height, rowPitch, rowCount);
+	if (bits + rowPitch * rowCount > m_fileData.data() + m_fileData.size())
+		return false;
+
+	m_bits = bits;
+	m_rowPitch = rowPitch;
+	m_width = width;
+	m_height = height;
+
+	return true;
+}
+
+void TextureDecoder::CalcPitch(uint32_t width, uint32_t height, size_t& rowPitch, size_t& rowCount) const
+{
+	if (IsBlockCompressed(m_format))
+	{
+		rowPitch = static_cast<size_t>((width + 3) / 4) * 8;
+		rowCount = (height + 3) / 4;
+	}
+	else
+	{
+		rowPitch = static_cast<size_t>(width) * GetBitsPerPixel(m_format) / 8;
+		rowCount = height;
+	}
+}
+
+void TextureDecoder::DecodeStrip(uint32_t strip, float* out) const
+{
+	DecodeRows(strip, 1, out);
+}
+
+void TextureDecoder::DecodeStripRGBA(uint32_t strip, float* out) const
+{
+	DecodeRows(strip, 4, out);
+}
+
+void TextureDecoder::DecodeRows(uint32_t strip, uint32_t channelCount, float* out) const
+{
+	const uint32_t y0 = strip * c_stripHeight;
+	const uint32_t rowCount = std::min(c_stripHeight, m_height - y0);
+
+	// Single channel formats read as (r, 0, 0, 1), as GPU samples them.
+	if (IsBlockCompressed(m_format))
+	{
+		// Strip is exactly one block row.
+		const uint8_t* blockRow = m_bits + m_rowPitch * strip;
+
+		for (uint32_t bx = 0; bx < (m_width + 3) / 4; bx++)
+		{
+			float texels[16][4];
+			if (m_format == Format::BC1)
+				DecodeBC1Block(blockRow + bx * 8, texels);
+			else
+				DecodeBC4Block(blockRow + bx * 8, texels);
+
+			for (uint32_t y = 0; y < rowCount; y++)
+			{
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < m_width; x++)
+				{
+					float* dest = out + (static_cast<size_t>(y) * m_width + bx * 4 + x) * channelCount;
+					for (uint32_t c = 0; c < channelCount; c++)
+						dest[c] = texels[y * 4 + x][c];
+				}
+			}
+		}
+		return;
+	}
+
+	for (uint32_t y = 0; y < rowCount; y++)
+	{
+		const uint8_t* row = m_bits + m_rowPitch * (y0 + y);
+		float* dest = out + static_cast<size_t>(y) * m_width * channelCount;
+
+		for (uint32_t x = 0; x < m_width; x++)
+		{
+			float texel[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			switch (m_format)
+			{
+			case Format::R8:
+				texel[0] = row[x] / 255.0f;
+				break;
+
+			case Format::RGBA8:
+				for (uint32_t c = 0; c < 4; c++)
+					texel[c] = row[x * 4 + c] / 255.0f;
+				break;
+
+			case Format::BGRA8:
+				texel[0] = row[x * 4 + 2] / 255.0f;
+				texel[1] = row[x * 4 + 1] / 255.0f;
+				texel[2] = row[x * 4 + 0] / 255.0f;
+				texel[3] = row[x * 4 + 3] / 255.0f;
+				break;
+
+			case Format::R16:
+			{
+				uint16_t value;
+				memcpy(&value, row + x * 2, sizeof(uint16_t));
+				texel[0] = value / 65535.0f;
+				break;
+			}
+
+			case Format::R32F:
+				memcpy(&texel[0], row + x * 4, sizeof(float));
+				break;
+
+			default:
+				break;
+			}
+
+			for (uint32_t c = 0; c < channelCount; c++)
+				dest[x * channelCount + c] = texel[c];
+		}
+	}
+}
+
+TextureDecoder::Format TextureDecoder::GetFormat(uint32_t dxgiFormat)
+{
+	switch (dxgiFormat)
+	{
+	case DXGI_FORMAT_R8_UNORM:				return Format::R8;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:	return Format::RGBA8;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:	return Format::BGRA8;
+	case DXGI_FORMAT_R16_UNORM:				return Format::R16;
+	case DXGI_FORMAT_R32_FLOAT:				return Format::R32F;
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:		return Format::BC1;
+	case DXGI_FORMAT_BC4_UNORM:				return Format::BC4;
+	default:								return Format::Unknown;
+	}
+}
+
+uint32_t TextureDecoder::GetBitsPerPixel(Format format)
+{
+	switch (format)
+	{
+	case Format::R8:	return 8;
+	case Format::R16:	return 16;
+	case Format::RGBA8:
+	case Format::BGRA8:
+	case Format::R32F:	return 32;
+	default:			return 0;
+	}
+}
+
+void TextureDecoder::DecodeBC1Block(const uint8_t* block, float texels[16][4])
+{
+	uint16_t color0, color1;
+	uint32_t bits;
+	memcpy(&color0, block, sizeof(uint16_t));
+	memcpy(&color1, block + 2, sizeof(uint16_t));
+	memcpy(&bits, block + 4, sizeof(uint32_t));
+
+	float palette[4][4] = {};
+	Expand565(color0, palette[0]);
+	Expand565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = 1.0f;
+
+	// Four color mode if color0 > color1, otherwise three colors and transparent black.
+	for (int c = 0; c < 3; c++)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+		}
+	}
+	palette[3][3] = color0 > color1 ? 1.0f : 0.0f;
+
+	for (int i = 0; i < 16; i++)
+		memcpy(texels[i], palette[(bits >> (2 * i)) & 0x3], sizeof(palette[0]));
+}
+
+void TextureDecoder::DecodeBC4Block(const uint8_t* block, float texels[16][4])
+{
+	const float r0 = block[0] / 255.0f;
+	const float r1 = block[1] / 255.0f;
+
+	// Eight interpolated values if red0 > red1, otherwise six and both ends of range.
+	float palette[8] = { r0, r1 };
+	if (block[0] > block[1])
+	{
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * r0 + i * r1) / 7.0f;
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			palette[i + 1] = ((5 - i) * r0 + i * r1) / 5.0f;
+		palette[6] = 0.0f;
+		palette[7] = 1.0f;
+	}
+
+	// 3-bit indices packed into 48 bits.
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+
+	for (int i = 0; i < 16; i++)
+	{
+		texels[i][0] = palette[(bits >> (3 * i)) & 0x7];
+		texels[i][1] = texels[i][2] = 0.0f;
+		texels[i][3] = 1.0f;
+	}
+}
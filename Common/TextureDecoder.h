@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// CPU side reader of DDS texture mips of first array slice, for data which GPU textures are also built from.
+// Texels are decoded as float in [0, 1], red channel only or RGBA. sRGB values are not converted.
+// Supported formats are R8, R8G8B8A8, B8G8R8A8, R16, R32F, BC1 and BC4, with DX10 or legacy header.
+class TextureDecoder
+{
+public:
+	// Read whole file. Returns false if file is missing, corrupted or its format is not supported.
+	bool Load(const wchar_t* fileName);
+
+	// Format, size of mip 0, mip count and offset of mip 0 from headers at start of a DDS file, without reading the rest.
+	// Returns false if headers are corrupted or format is not supported.
+	static bool ParseHeader(
+		IN const uint8_t* data, size_t size, OUT uint32_t& dxgiFormat, OUT uint32_t& width, OUT uint32_t& height,
+		OUT uint32_t& mipCount, OUT size_t& dataOffset);
+
+	static constexpr size_t c_maxHeaderSize = 148;	// Magic, DDS_HEADER and DDS_HEADER_DXT10
+
+	// Size of selected mip, first one after Load.
+	uint32_t	GetWidth() const { return m_width; }
+	uint32_t	GetHeight() const { return m_height; }
+
+	// Mips stored in file, at least 1.
+	uint32_t	GetMipCount() const { return m_mipCount; }
+
+	// Make mip the one GetWidth, GetHeight and DecodeStrip read. Returns false if file doesn't hold it.
+	bool SelectMip(uint32_t mip);
+
+	// Decode rows [strip * c_stripHeight, strip * c_stripHeight + c_stripHeight) into out, width floats per row.
+	// Rows beyond height are not written.
+	void DecodeStrip(uint32_t strip, float* out) const;
+	uint32_t GetStripCount() const { return (m_height + c_stripHeight - 1) / c_stripHeight; }
+
+	// Same rows as RGBA, 4 * width floats per row. Single channel formats are (r, 0, 0, 1).
+	void DecodeStripRGBA(uint32_t strip, float* out) const;
+
+	static constexpr uint32_t c_stripHeight = 4;	// One block row of BC formats
+
+	enum class Format
+	{
+		Unknown, R8, RGBA8, BGRA8, R16, R32F, BC1, BC4,
+	};
+
+	Format		GetSourceFormat() const { return m_format; }
+	bool		IsSrgb() const { return m_srgb; }
+	uint32_t	GetDxgiFormat() const { return m_dxgiFormat; }
+
+	// Undecoded rows of selected mip as stored in file, block rows of BC formats.
+	const uint8_t*	GetRowData(uint32_t row) const { return m_bits + row * m_rowPitch; }
+	size_t			GetRowPitch() const { return m_rowPitch; }
+
+private:
+	static Format GetFormat(uint32_t dxgiFormat);
+	static uint32_t GetBitsPerPixel(Format format);
+	static bool IsBlockCompressed(Format format) { return format == Format::BC1 || format == Format::BC4; }
+
+	// Bytes per row (or block row) and row count of a mip.
+	void CalcPitch(uint32_t width, uint32_t height, OUT size_t& rowPitch, OUT size_t& rowCount) const;
+
+	void DecodeRows(uint32_t strip, uint32_t channelCount, OUT float* out) const;
+
+	static void DecodeBC1Block(const uint8_t* block, float texels[16][4]);
+	static void DecodeBC4Block(const uint8_t* block, float texels[16][4]);
+
+	std::vector<uint8_t>	m_fileData;
+	const uint8_t*			m_firstMipBits = nullptr;
+	uint32_t				m_firstMipWidth = 0;
+	uint32_t				m_firstMipHeight = 0;
+	uint32_t				m_mipCount = 0;
+
+	const uint8_t*			m_bits = nullptr;	// Selected mip
+	size_t					m_rowPitch = 0;		// Bytes per row, or per block row
+
+	Format					m_format = Format::Unknown;
+	bool					m_srgb = false;
+	uint32_t				m_dxgiFormat = 0;
+	uint32_t				m_width = 0;
+	uint32_t				m_height = 0;
+};
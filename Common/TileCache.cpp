@@ -0,0 +1,452 @@
+#include "pch.h"
+#include "TileCache.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+using namespace DirectX;
+
+TileCache::TileCache(uint32_t slotCount)
+	: m_slots(slotCount, Slot{ TILE_CACHE_NO_SLOT, 0, TILE_CACHE_NO_SLOT, TILE_CACHE_NO_SLOT }),
+	m_buffers(static_cast<size_t>(c_maxLoadsInFlight) * TILE_SIZE_BYTES)
+{
+	// Lowest slots and buffers are taken first.
+	for (uint32_t slot = slotCount; slot > 0; slot--)
+		m_freeSlots.push_back(slot - 1);
+	for (uint32_t buffer = c_maxLoadsInFlight; buffer > 0; buffer--)
+		m_freeBuffers.push_back(buffer - 1);
+
+	// Every load holds a buffer, so none of these grow past it.
+	m_uploadedBuffers.reserve(c_maxLoadsInFlight);
+	m_readyLoads.reserve(c_maxLoadsInFlight);
+	m_queuedLoads.reserve(c_maxLoadsInFlight);
+	m_completedLoads.reserve(c_maxLoadsInFlight);
+
+	m_stats.slotCount = slotCount;
+}
+
+TileCache::~TileCache()
+{
+	Stop();
+}
+
+uint32_t TileCache::AddTexture(std::unique_ptr<TileStore> store, uint32_t half)
+{
+	const TileLayout& layout = store->GetLayout();
+
+	Texture texture = {};
+	texture.half = half;
+	texture.slots.assign(layout.tileCount, TILE_CACHE_NO_SLOT);
+	texture.wantedFrames.assign(layout.tileCount, 0);
+	texture.states.assign(layout.tileCount, TILE_ABSENT);
+	texture.minMips.assign(static_cast<size_t>(layout.GetTilesX(0)) * layout.GetTilesY(0), static_cast<float>(layout.packedMipStart));
+	texture.minMipsDirty = true;
+	texture.store = std::move(store);
+
+	m_textures.push_back(std::move(texture));
+
+	return static_cast<uint32_t>(m_textures.size()) - 1;
+}
+
+void TileCache::Start()
+{
+	if (m_thread.joinable())
+		return;
+
+	m_stop = false;
+	m_thread = std::thread(&TileCache::LoaderMain, this);
+}
+
+void TileCache::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+
+		// Queued tiles are requested again by next Update after a restart.
+		for (const Load& load : m_queuedLoads)
+		{
+			m_textures[load.texture].states[load.tile] = TILE_ABSENT;
+			m_freeBuffers.push_back(load.buffer);
+		}
+		m_queuedLoads.clear();
+	}
+
+	m_wakeCondition.notify_all();
+	m_thread.join();
+}
+
+void TileCache::LoaderMain()
+{
+	PROFILE_THREAD_NAME("Tile loader");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wakeCondition.wait(lock, [this]() { return m_stop || !m_queuedLoads.empty(); });
+		if (m_stop)
+			return;
+
+		Load load = m_queuedLoads.front();
+		m_queuedLoads.erase(m_queuedLoads.begin());
+		lock.unlock();
+
+		{
+			PROFILE_SCOPE("Read tile");
+
+			const auto readStart = std::chrono::high_resolution_clock::now();
+			load.succeeded = m_textures[load.texture].store->ReadTile(
+				load.tile, &m_buffers[static_cast<size_t>(load.buffer) * TILE_SIZE_BYTES]);
+			load.readTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - readStart).count();
+		}
+
+		lock.lock();
+		m_completedLoads.push_back(load);
+	}
+}
+
+uint32_t TileCache::Update(
+	uint64_t frame, const TileRequest* requests, uint32_t requestCount, uint32_t maxUploads, std::vector<TileUpdate>& updates)
+{
+	PROFILE_SCOPE("Tile cache update");
+
+	m_frame = frame;
+	updates.clear();
+
+	// Renderer copied tiles handed out last time.
+	m_freeBuffers.insert(m_freeBuffers.end(), m_uploadedBuffers.begin(), m_uploadedBuffers.end());
+	m_uploadedBuffers.clear();
+
+	m_missingTiles.clear();
+	m_wantedResidentCount = 0;
+	m_stats.wantedTileCount = 0;
+	for (uint32_t r = 0; r < requestCount; r++)
+	{
+		const TileRequest& request = requests[r];
+
+		// Part up to x = 1, then part wrapped around to x = 0.
+		const float pieces[2][2] =
+		{
+			{ request.x0, std::min(request.x1, 1.0f) },
+			{ 0.0f, std::min(request.x1 - 1.0f, 1.0f) },
+		};
+		for (const auto& piece : pieces)
+		{
+			if (piece[1] < piece[0])
+				continue;
+
+			// Left half covers x in [0, 0.5], right half [0.5, 1].
+			for (uint32_t t = 0; t < m_textures.size(); t++)
+			{
+				if (m_textures[t].half == 0 && piece[0] < 0.5f)
+					MarkRequest(t, request, piece[0] * 2.0f, std::min(piece[1], 0.5f) * 2.0f);
+				if (m_textures[t].half == 1 && piece[1] > 0.5f)
+					MarkRequest(t, request, std::max(piece[0], 0.5f) * 2.0f - 1.0f, piece[1] * 2.0f - 1.0f);
+			}
+		}
+	}
+
+	MapLoads(maxUploads, updates);
+	QueueLoads();
+
+	uint32_t dirtyMask = 0;
+	for (uint32_t t = 0; t < m_textures.size(); t++)
+	{
+		if (m_textures[t].minMipsDirty || m_firstUpdate)
+		{
+			UpdateMinMips(m_textures[t]);
+			dirtyMask |= 1u << t;
+		}
+	}
+	m_firstUpdate = false;
+
+	return dirtyMask;
+}
+
+void TileCache::MarkRequest(uint32_t texture, const TileRequest& request, float u0, float u1)
+{
+	const TileLayout& layout = GetLayout(texture);
+
+	// Width of a half spans pi of longitude at mip 0.
+	const float texelCount = request.texelAngle * layout.width / XM_PI;
+	const uint32_t mip = texelCount > 1.0f ? static_cast<uint32_t>(log2f(texelCount)) : 0;
+	if (mip >= layout.packedMipStart)
+		return;
+
+	// Two texels of margin for filter footprints.
+	const float mipWidth = static_cast<float>(layout.GetMipWidth(mip));
+	const float mipHeight = static_cast<float>(layout.GetMipHeight(mip));
+	const auto toTile = [](float texel, float tileSize, uint32_t tileCount)
+	{
+		return static_cast<uint32_t>(std::min(std::max(texel / tileSize, 0.0f), static_cast<float>(tileCount - 1)));
+	};
+
+	const uint32_t tilesX = layout.GetTilesX(mip);
+	const uint32_t tilesY = layout.GetTilesY(mip);
+	const uint32_t x0 = toTile(u0 * mipWidth - 2.0f, static_cast<float>(layout.tileWidth), tilesX);
+	const uint32_t x1 = toTile(u1 * mipWidth + 2.0f, static_cast<float>(layout.tileWidth), tilesX);
+	const uint32_t y0 = toTile(request.y0 * mipHeight - 2.0f, static_cast<float>(layout.tileHeight), tilesY);
+	const uint32_t y1 = toTile(request.y1 * mipHeight + 2.0f, static_cast<float>(layout.tileHeight), tilesY);
+
+	for (uint32_t y = y0; y <= y1; y++)
+	{
+		for (uint32_t x = x0; x <= x1; x++)
+			MarkTile(texture, layout.GetTileIndex(mip, x, y));
+	}
+}
+
+void TileCache::MarkTile(uint32_t texture, uint32_t tile)
+{
+	Texture& target = m_textures[texture];
+	const TileLayout& layout = target.store->GetLayout();
+
+	// Tiles over a marked one are marked already. Parents are touched after children, so they are more recent in LRU.
+	while (tile < layout.tileCount && target.wantedFrames[tile] != m_frame + 1)
+	{
+		target.wantedFrames[tile] = m_frame + 1;
+		m_stats.wantedTileCount++;
+
+		if (target.states[tile] == TILE_RESIDENT)
+		{
+			m_wantedResidentCount++;
+			Unlink(target.slots[tile]);
+			PushFront(target.slots[tile]);
+		}
+		else if (target.states[tile] == TILE_ABSENT)
+		{
+			uint32_t mip, x, y;
+			layout.GetTileCoord(tile, mip, x, y);
+			m_missingTiles.push_back((static_cast<uint64_t>(mip) << 40) | (static_cast<uint64_t>(texture) << 32) | tile);
+		}
+
+		tile = layout.GetParentTile(tile);
+	}
+}
+
+void TileCache::MapLoads(uint32_t maxUploads, std::vector<TileUpdate>& updates)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_readyLoads.insert(m_readyLoads.end(), m_completedLoads.begin(), m_completedLoads.end());
+		m_completedLoads.clear();
+	}
+
+	m_stats.uploadCount = 0;
+	uint32_t readyCount = 0;
+	for (; readyCount < m_readyLoads.size() && m_stats.uploadCount < maxUploads; readyCount++)
+	{
+		const Load& load = m_readyLoads[readyCount];
+
+		Texture& texture = m_textures[load.texture];
+		m_totalReadTime += load.readTime;
+		if (!load.succeeded)
+		{
+			texture.states[load.tile] = TILE_FAILED;
+			m_stats.failedTileCount++;
+			m_freeBuffers.push_back(load.buffer);
+			continue;
+		}
+
+		m_stats.loadedTileCount++;
+		const uint32_t slot = AllocateSlot(updates);
+		if (slot == TILE_CACHE_NO_SLOT)
+		{
+			texture.states[load.tile] = TILE_ABSENT;
+			m_stats.overflowCount++;
+			m_freeBuffers.push_back(load.buffer);
+			continue;
+		}
+
+		m_slots[slot].texture = load.texture;
+		m_slots[slot].tile = load.tile;
+		PushFront(slot);
+
+		// Tiles over it stay more recent, as MarkTile leaves them, so they aren't evicted before it.
+		const TileLayout& layout = texture.store->GetLayout();
+		for (uint32_t parent = layout.GetParentTile(load.tile);
+			parent < layout.tileCount && texture.slots[parent] != TILE_CACHE_NO_SLOT; parent = layout.GetParentTile(parent))
+		{
+			Unlink(texture.slots[parent]);
+			PushFront(texture.slots[parent]);
+		}
+		texture.slots[load.tile] = slot;
+		texture.states[load.tile] = TILE_RESIDENT;
+		texture.minMipsDirty = true;
+
+		// Holds its slot in this frame like tiles marked resident, which QueueLoads budgets for.
+		if (texture.wantedFrames[load.tile] == m_frame + 1)
+			m_wantedResidentCount++;
+
+		TileUpdate update = {};
+		update.texture = load.texture;
+		layout.GetTileCoord(load.tile, update.mip, update.x, update.y);
+		update.slot = slot;
+		update.data = &m_buffers[static_cast<size_t>(load.buffer) * TILE_SIZE_BYTES];
+		updates.push_back(update);
+
+		m_uploadedBuffers.push_back(load.buffer);
+		m_stats.uploadCount++;
+	}
+	m_readyLoads.erase(m_readyLoads.begin(), m_readyLoads.begin() + readyCount);
+}
+
+uint32_t TileCache::AllocateSlot(std::vector<TileUpdate>& updates)
+{
+	if (!m_freeSlots.empty())
+	{
+		const uint32_t slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+		return slot;
+	}
+
+	// Least recent tile is wanted in this frame too, so every one is.
+	const uint32_t slot = m_lruTail;
+	if (slot == TILE_CACHE_NO_SLOT)
+		return TILE_CACHE_NO_SLOT;
+
+	const Slot victim = m_slots[slot];
+	Texture& owner = m_textures[victim.texture];
+	if (owner.wantedFrames[victim.tile] == m_frame + 1)
+		return TILE_CACHE_NO_SLOT;
+
+	Unlink(slot);
+	owner.slots[victim.tile] = TILE_CACHE_NO_SLOT;
+	owner.states[victim.tile] = TILE_ABSENT;
+	owner.minMipsDirty = true;
+	m_stats.evictedTileCount++;
+
+	TileUpdate update = {};
+	update.texture = victim.texture;
+	owner.store->GetLayout().GetTileCoord(victim.tile, update.mip, update.x, update.y);
+	update.slot = TILE_CACHE_NO_SLOT;
+	update.data = nullptr;
+	updates.push_back(update);
+
+	return slot;
+}
+
+void TileCache::QueueLoads()
+{
+	// Coarse tiles first, finer ones are of no use until tiles over them are resident.
+	std::sort(m_missingTiles.begin(), m_missingTiles.end(), std::greater<uint64_t>());
+
+	// Loads beyond slots not held by wanted tiles would only be dropped.
+	const uint32_t loadingCount = c_maxLoadsInFlight - static_cast<uint32_t>(m_freeBuffers.size() + m_uploadedBuffers.size());
+	const uint32_t usedCount = m_wantedResidentCount + loadingCount;
+	uint32_t budget = GetSlotCount() > usedCount ? GetSlotCount() - usedCount : 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const uint64_t key : m_missingTiles)
+		{
+			if (m_freeBuffers.empty() || budget == 0)
+				break;
+
+			Load load = {};
+			load.texture = static_cast<uint32_t>(key >> 32) & 0xFF;
+			load.tile = static_cast<uint32_t>(key);
+			load.buffer = m_freeBuffers.back();
+			m_freeBuffers.pop_back();
+			m_queuedLoads.push_back(load);
+
+			m_textures[load.texture].states[load.tile] = TILE_LOADING;
+			budget--;
+		}
+	}
+
+	m_wakeCondition.notify_one();
+}
+
+void TileCache::UpdateMinMips(Texture& texture)
+{
+	const TileLayout& layout = texture.store->GetLayout();
+	const uint32_t regionsX = layout.GetTilesX(0);
+	const uint32_t regionsY = layout.GetTilesY(0);
+
+	// Finest mip resident down from tail, walking from coarse to fine.
+	std::vector<uint8_t>& finest = m_finestMips;
+	finest.assign(static_cast<size_t>(regionsX) * regionsY, static_cast<uint8_t>(layout.packedMipStart));
+	for (uint32_t m = layout.packedMipStart; m > 0; m--)
+	{
+		const uint32_t mip = m - 1;
+		const uint32_t tilesX = layout.GetTilesX(mip);
+		const uint32_t tilesY = layout.GetTilesY(mip);
+		for (uint32_t y = 0; y < regionsY; y++)
+		{
+			for (uint32_t x = 0; x < regionsX; x++)
+			{
+				uint8_t& region = finest[static_cast<size_t>(y) * regionsX + x];
+				if (region != m)
+					continue;
+
+				const uint32_t tile = layout.GetTileIndex(mip, std::min(x >> mip, tilesX - 1), std::min(y >> mip, tilesY - 1));
+				if (texture.slots[tile] != TILE_CACHE_NO_SLOT)
+					region = static_cast<uint8_t>(mip);
+			}
+		}
+	}
+
+	// Coarsest of 3x3 neighbours.
+	for (uint32_t y = 0; y < regionsY; y++)
+	{
+		for (uint32_t x = 0; x < regionsX; x++)
+		{
+			uint8_t mip = 0;
+			for (uint32_t ny = (y > 0 ? y - 1 : 0); ny <= std::min(y + 1, regionsY - 1); ny++)
+			{
+				for (uint32_t nx = (x > 0 ? x - 1 : 0); nx <= std::min(x + 1, regionsX - 1); nx++)
+					mip = std::max(mip, finest[static_cast<size_t>(ny) * regionsX + nx]);
+			}
+			texture.minMips[static_cast<size_t>(y) * regionsX + x] = mip;
+		}
+	}
+
+	texture.minMipsDirty = false;
+}
+
+void TileCache::Unlink(uint32_t slot)
+{
+	Slot& s = m_slots[slot];
+	if (s.prev != TILE_CACHE_NO_SLOT)
+		m_slots[s.prev].next = s.next;
+	else
+		m_lruHead = s.next;
+
+	if (s.next != TILE_CACHE_NO_SLOT)
+		m_slots[s.next].prev = s.prev;
+	else
+		m_lruTail = s.prev;
+
+	s.prev = s.next = TILE_CACHE_NO_SLOT;
+}
+
+void TileCache::PushFront(uint32_t slot)
+{
+	Slot& s = m_slots[slot];
+	s.prev = TILE_CACHE_NO_SLOT;
+	s.next = m_lruHead;
+	if (m_lruHead != TILE_CACHE_NO_SLOT)
+		m_slots[m_lruHead].prev = slot;
+	m_lruHead = slot;
+
+	if (m_lruTail == TILE_CACHE_NO_SLOT)
+		m_lruTail = slot;
+}
+
+TileCacheStats TileCache::GetStats() const
+{
+	TileCacheStats stats = m_stats;
+	stats.residentTileCount = GetSlotCount() - static_cast<uint32_t>(m_freeSlots.size());
+	stats.loadingTileCount = c_maxLoadsInFlight - static_cast<uint32_t>(m_freeBuffers.size() + m_uploadedBuffers.size());
+
+	const uint64_t readCount = stats.loadedTileCount + stats.failedTileCount;
+	stats.readTime = readCount > 0 ? static_cast<float>(m_totalReadTime / readCount) : 0.0f;
+
+	return stats;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TileStore.h"
+
+#define TILE_CACHE_MAX_TEXTURES 4u
+#define TILE_CACHE_NO_SLOT UINT32_MAX
+
+// Part of sphere one visible node wants, in coordinates of Displace: x = theta / 2pi, y = phi / pi.
+// x0 is in [0, 1), and x1 goes past 1 for nodes across x = 0.
+struct TileRequest
+{
+	float					x0;
+	float					y0;
+	float					x1;
+	float					y1;
+	float					texelAngle;		// Widest arc of sphere one texel may cover, radians
+};
+
+// Mapping change of one tile, applied by renderer in order.
+// Unmap of an evicted tile comes right before the map reusing its slot.
+struct TileUpdate
+{
+	uint32_t				texture;
+	uint32_t				mip;
+	uint32_t				x;
+	uint32_t				y;
+	uint32_t				slot;			// TILE_CACHE_NO_SLOT to unmap
+	const uint8_t*			data;			// TILE_SIZE_BYTES to copy into tile, valid until next Update
+};
+
+struct TileCacheStats
+{
+	uint32_t				slotCount;
+	uint32_t				residentTileCount;
+	uint32_t				wantedTileCount;		// Tiles of last requests, resident or not
+	uint32_t				loadingTileCount;		// Queued, being read or waiting for upload
+	uint32_t				uploadCount;			// Maps of last Update
+	uint64_t				loadedTileCount;		// Since Start
+	uint64_t				evictedTileCount;
+	uint64_t				failedTileCount;
+	uint64_t				overflowCount;			// Loads dropped as every slot held a wanted tile
+	float					readTime;				// Average milliseconds of one tile read
+};
+
+// CPU side of virtual texture streaming, with no device object.
+// Textures are cut into tiles (see TileLayout). Their mip tails are always resident, other tiles live in
+// a fixed number of physical slots shared by every texture, and page table of each texture maps tiles to slots.
+//
+// Each Update takes requests of visible nodes, marks tiles at mip of wanted texel size and every coarser
+// tile over them, and touches resident ones in LRU order. Wanted tiles which are missing are read by the
+// loader thread, coarsest first. Read tiles are mapped to free slots, or to least recently used ones
+// not wanted in this frame, at most maxUploads per Update.
+//
+// Nothing is allocated per Update once buffers grew to the largest request set.
+//
+// Residency is fed back to shaders as a min mip map per texture: one texel per tile of mip 0 holding
+// finest mip whose tiles are resident all the way to tail there, raised to its neighbours' so filter
+// footprints crossing into next tile stay resident too.
+class TileCache
+{
+public:
+	static constexpr uint32_t c_maxLoadsInFlight = 32;
+
+	explicit TileCache(uint32_t slotCount);
+	~TileCache();
+
+	TileCache(const TileCache&) = delete;
+	TileCache& operator=(const TileCache&) = delete;
+
+	// Add texture before Start. half is 0 for left and 1 for right texture of map, requests go to textures of their half.
+	// Returns texture index.
+	uint32_t AddTexture(std::unique_ptr<TileStore> store, uint32_t half);
+
+	// Start and stop loader thread. Stop drops queued loads and waits for current one.
+	void Start();
+	void Stop();
+
+	// Returns mask of textures whose min mip map changed, including every texture on first call.
+	uint32_t Update(
+		uint64_t frame, IN const TileRequest* requests, uint32_t requestCount, uint32_t maxUploads,
+		OUT std::vector<TileUpdate>& updates);
+
+	uint32_t				GetTextureCount() const { return static_cast<uint32_t>(m_textures.size()); }
+	const TileLayout&		GetLayout(uint32_t texture) const { return m_textures[texture].store->GetLayout(); }
+	TileStore&				GetStore(uint32_t texture) const { return *m_textures[texture].store; }
+
+	// GetTilesX(0) x GetTilesY(0) mips, rows top to bottom.
+	const std::vector<float>& GetMinMipMap(uint32_t texture) const { return m_textures[texture].minMips; }
+
+	// Slot of tile, or TILE_CACHE_NO_SLOT if it isn't resident.
+	uint32_t GetSlot(uint32_t texture, uint32_t tile) const { return m_textures[texture].slots[tile]; }
+
+	uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+	TileCacheStats GetStats() const;
+
+private:
+	enum TileState : uint8_t
+	{
+		TILE_ABSENT,
+		TILE_LOADING,		// Queued, being read or read and waiting for a slot
+		TILE_RESIDENT,
+		TILE_FAILED,		// Never requested again
+	};
+
+	struct Texture
+	{
+		std::unique_ptr<TileStore>	store;
+		uint32_t					half;
+		std::vector<uint32_t>		slots;			// Page table
+		std::vector<uint64_t>		wantedFrames;	// Last frame tile was wanted in, plus one
+		std::vector<uint8_t>		states;
+		std::vector<float>			minMips;
+		bool						minMipsDirty;
+	};
+
+	struct Slot
+	{
+		uint32_t					texture;		// TILE_CACHE_NO_SLOT if free
+		uint32_t					tile;
+		uint32_t					prev;			// LRU list, head is most recent
+		uint32_t					next;
+	};
+
+	struct Load
+	{
+		uint32_t					texture;
+		uint32_t					tile;
+		uint32_t					buffer;
+		bool						succeeded;
+		float						readTime;
+	};
+
+	void LoaderMain();
+
+	void MarkRequest(uint32_t texture, IN const TileRequest& request, float u0, float u1);
+	void MarkTile(uint32_t texture, uint32_t tile);
+	void QueueLoads();
+	void MapLoads(uint32_t maxUploads, OUT std::vector<TileUpdate>& updates);
+	uint32_t AllocateSlot(OUT std::vector<TileUpdate>& updates);
+	void UpdateMinMips(Texture& texture);
+
+	void Unlink(uint32_t slot);
+	void PushFront(uint32_t slot);
+
+	std::vector<Texture>			m_textures;
+
+	std::vector<Slot>				m_slots;
+	std::vector<uint32_t>			m_freeSlots;
+	uint32_t						m_lruHead = TILE_CACHE_NO_SLOT;
+	uint32_t						m_lruTail = TILE_CACHE_NO_SLOT;
+
+	uint64_t						m_frame = 0;
+	bool							m_firstUpdate = true;
+	std::vector<uint64_t>			m_missingTiles;		// Wanted and absent tiles of frame, mip << 40 | texture << 32 | tile
+	uint32_t						m_wantedResidentCount = 0;
+
+	// Staging buffers of loads, c_maxLoadsInFlight tiles.
+	std::vector<uint8_t>			m_buffers;
+	std::vector<uint32_t>			m_freeBuffers;
+	std::vector<uint32_t>			m_uploadedBuffers;	// Handed out by last Update
+	std::vector<Load>				m_readyLoads;		// Read, waiting for upload budget
+	std::vector<uint8_t>			m_finestMips;		// Scratch of UpdateMinMips
+
+	std::thread						m_thread;
+	mutable std::mutex				m_mutex;
+	std::condition_variable			m_wakeCondition;
+	std::vector<Load>				m_queuedLoads;
+	std::vector<Load>				m_completedLoads;
+	bool							m_stop = false;
+
+	TileCacheStats					m_stats = {};
+	double							m_totalReadTime = 0.0;
+};
@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "TileFile.h"
+
+#include "TextureDecoder.h"
+
+namespace
+{
+	bool WriteData(HANDLE file, const void* data, size_t size)
+	{
+		DWORD written = 0;
+		return WriteFile(file, data, static_cast<DWORD>(size), &written, nullptr) && written == size;
+	}
+}
+
+TileFile::~TileFile()
+{
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+}
+
+bool TileFile::Build(const wchar_t* ddsFileName, const wchar_t* tileFileName)
+{
+	TextureDecoder decoder;
+	TileLayout layout;
+	if (!decoder.Load(ddsFileName) ||
+		!layout.Create(decoder.GetDxgiFormat(), decoder.GetWidth(), decoder.GetHeight(), decoder.GetMipCount()))
+		return false;
+
+	const HANDLE file = CreateFileW(tileFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	Header header = {};
+	header.magic = c_magic;
+	header.version = c_version;
+	header.format = layout.format;
+	header.width = layout.width;
+	header.height = layout.height;
+	header.mipCount = layout.mipCount;
+	header.tileCount = layout.tileCount;
+	header.packedMipStart = layout.packedMipStart;
+	header.tailSize = layout.GetTailSize();
+
+	bool written = WriteData(file, &header, sizeof(Header));
+
+	for (uint32_t mip = layout.packedMipStart; mip < layout.mipCount && written; mip++)
+	{
+		written = decoder.SelectMip(mip) && decoder.GetRowPitch() == layout.GetRowPitch(mip);
+		for (uint32_t row = 0; row < layout.GetRowCount(mip) && written; row++)
+			written = WriteData(file, decoder.GetRowData(row), layout.GetRowPitch(mip));
+	}
+
+	const uint32_t tileRowSize = layout.tileWidth / layout.blockSize * layout.elementSize;
+	const uint32_t tileRowCount = layout.tileHeight / layout.blockSize;
+	std::vector<uint8_t> tile(TILE_SIZE_BYTES);
+	for (uint32_t mip = 0; mip < layout.packedMipStart && written; mip++)
+	{
+		written = decoder.SelectMip(mip) && decoder.GetRowPitch() == layout.GetRowPitch(mip);
+
+		const uint32_t rowPitch = layout.GetRowPitch(mip);
+		const uint32_t rowCount = layout.GetRowCount(mip);
+		for (uint32_t y = 0; y < layout.GetTilesY(mip) && written; y++)
+		{
+			for (uint32_t x = 0; x < layout.GetTilesX(mip) && written; x++)
+			{
+				std::fill(tile.begin(), tile.end(), static_cast<uint8_t>(0));
+
+				const uint32_t firstByte = x * tileRowSize;
+				const uint32_t copySize = std::min(tileRowSize, rowPitch - firstByte);
+				for (uint32_t r = 0; r < tileRowCount && y * tileRowCount + r < rowCount; r++)
+					memcpy(&tile[r * tileRowSize], decoder.GetRowData(y * tileRowCount + r) + firstByte, copySize);
+
+				written = WriteData(file, tile.data(), tile.size());
+			}
+		}
+	}
+
+	CloseHandle(file);
+	if (!written)
+	{
+		DeleteFileW(tileFileName);
+		return false;
+	}
+
+	return true;
+}
+
+bool TileFile::BuildTextures()
+{
+	static const wchar_t* const names[] =
+	{
+		L"Textures\\colormap_l", L"Textures\\colormap_r", L"Textures\\displacement_l", L"Textures\\displacement_r",
+	};
+
+	bool succeeded = true;
+	for (const wchar_t* name : names)
+	{
+		const std::wstring baseName = name;
+		const bool built = Build((baseName + L".dds").c_str(), (baseName + L".tiles").c_str());
+		succeeded = succeeded && built;
+
+		char line[128];
+		snprintf(line, sizeof(line), "TileFile: %ls %s\n", name, built ? "built" : "failed");
+		OutputDebugStringA(line);
+	}
+
+	return succeeded;
+}
+
+bool TileFile::Open(const wchar_t* fileName)
+{
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+
+	m_file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	Header header = {};
+	LARGE_INTEGER fileSize = {};
+	bool valid = GetFileSizeEx(m_file, &fileSize) && Read(0, &header, sizeof(Header)) &&
+		header.magic == c_magic && header.version == c_version &&
+		m_layout.Create(header.format, header.width, header.height, header.mipCount) &&
+		m_layout.tileCount == header.tileCount && m_layout.packedMipStart == header.packedMipStart &&
+		m_layout.GetTailSize() == header.tailSize;
+
+	m_tileOffset = sizeof(Header) + header.tailSize;
+	valid = valid && static_cast<uint64_t>(fileSize.QuadPart) == m_tileOffset + static_cast<uint64_t>(TILE_SIZE_BYTES) * m_layout.tileCount;
+	if (!valid)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		m_layout = {};
+		return false;
+	}
+
+	return true;
+}
+
+bool TileFile::ReadTail(std::vector<uint8_t>& data) const
+{
+	data.resize(static_cast<size_t>(m_layout.GetTailSize()));
+
+	return data.empty() || Read(sizeof(Header), data.data(), static_cast<uint32_t>(data.size()));
+}
+
+bool TileFile::ReadTile(uint32_t tile, uint8_t* data)
+{
+	return tile < m_layout.tileCount && Read(m_tileOffset + static_cast<uint64_t>(tile) * TILE_SIZE_BYTES, data, TILE_SIZE_BYTES);
+}
+
+bool TileFile::Read(uint64_t offset, void* data, uint32_t size) const
+{
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER position = {};
+	position.QuadPart = static_cast<LONGLONG>(offset);
+
+	DWORD read = 0;
+	return SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) &&
+		ReadFile(m_file, data, size, &read, nullptr) && read == size;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "TileStore.h"
+
+// Texture cut into tiles offline, so one tile is one read while streaming.
+// File is a header, rows of every tail mip tightly packed, then tiles in layout order.
+// A tile holds tile height rows of tile width texels (or blocks), the linear buffer layout CopyTiles reads.
+// Parts of edge tiles beyond their mip are zero.
+class TileFile : public TileStore
+{
+public:
+	TileFile() = default;
+	~TileFile() override;
+
+	TileFile(const TileFile&) = delete;
+	TileFile& operator=(const TileFile&) = delete;
+
+	// Tile first array slice of a DDS file. Returns false if it can't be decoded or output can't be written.
+	static bool Build(const wchar_t* ddsFileName, const wchar_t* tileFileName);
+
+	// Color and displacement maps of Textures directory, each next to its DDS file as .tiles.
+	static bool BuildTextures();
+
+	// Returns false if file is missing, of another version, or its layout doesn't add up to its size.
+	bool Open(const wchar_t* fileName);
+
+	// Rows of tail mips, GetTailSize bytes.
+	bool ReadTail(OUT std::vector<uint8_t>& data) const;
+
+	const TileLayout& GetLayout() const override { return m_layout; }
+	bool ReadTile(uint32_t tile, OUT uint8_t* data) override;
+
+private:
+	static constexpr uint32_t c_magic = 0x454C4954;	// "TILE"
+	static constexpr uint32_t c_version = 1;
+
+	struct Header
+	{
+		uint32_t				magic;
+		uint32_t				version;
+		uint32_t				format;			// DXGI_FORMAT
+		uint32_t				width;
+		uint32_t				height;
+		uint32_t				mipCount;
+		uint32_t				tileCount;
+		uint32_t				packedMipStart;
+		uint64_t				tailSize;
+	};
+
+	bool Read(uint64_t offset, OUT void* data, uint32_t size) const;
+
+	HANDLE						m_file = INVALID_HANDLE_VALUE;
+	TileLayout					m_layout = {};
+	uint64_t					m_tileOffset = 0;
+};
@@ -0,0 +1,105 @@
+#include "pch.h"
+#include "TileStore.h"
+
+bool TileLayout::Create(uint32_t dxgiFormat, uint32_t mipWidth, uint32_t mipHeight, uint32_t mips)
+{
+	*this = {};
+
+	switch (dxgiFormat)
+	{
+	case DXGI_FORMAT_R8_UNORM:
+		elementSize = 1;
+		blockSize = 1;
+		break;
+	case DXGI_FORMAT_R16_UNORM:
+		elementSize = 2;
+		blockSize = 1;
+		break;
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		elementSize = 4;
+		blockSize = 1;
+		break;
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+		elementSize = 8;
+		blockSize = 4;
+		break;
+	default:
+		return false;
+	}
+
+	if (mipWidth == 0 || mipHeight == 0 || mips == 0 || mips > TILE_LAYOUT_MAX_MIPS)
+		return false;
+
+	format = dxgiFormat;
+	width = mipWidth;
+	height = mipHeight;
+	mipCount = mips;
+
+	// Standard 64KB tile shapes, in elements: 256x256, 256x128, 128x128 and 128x64.
+	switch (elementSize)
+	{
+	case 1:		tileWidth = 256;	tileHeight = 256;	break;
+	case 2:		tileWidth = 256;	tileHeight = 128;	break;
+	case 4:		tileWidth = 128;	tileHeight = 128;	break;
+	default:	tileWidth = 128;	tileHeight = 64;	break;
+	}
+	tileWidth *= blockSize;
+	tileHeight *= blockSize;
+
+	packedMipStart = mipCount;
+	for (uint32_t mip = 0; mip < mipCount; mip++)
+	{
+		if (GetMipWidth(mip) < tileWidth || GetMipHeight(mip) < tileHeight)
+		{
+			packedMipStart = mip;
+			break;
+		}
+
+		mipFirstTile[mip] = tileCount;
+		tileCount += GetTilesX(mip) * GetTilesY(mip);
+	}
+	for (uint32_t mip = packedMipStart; mip < mipCount; mip++)
+		mipFirstTile[mip] = tileCount;
+
+	return true;
+}
+
+void TileLayout::GetTileCoord(uint32_t tile, uint32_t& mip, uint32_t& x, uint32_t& y) const
+{
+	mip = 0;
+	while (mip + 1 < packedMipStart && tile >= mipFirstTile[mip + 1])
+		mip++;
+
+	const uint32_t index = tile - mipFirstTile[mip];
+	x = index % GetTilesX(mip);
+	y = index / GetTilesX(mip);
+}
+
+uint32_t TileLayout::GetParentTile(uint32_t tile) const
+{
+	uint32_t mip, x, y;
+	GetTileCoord(tile, mip, x, y);
+	if (mip + 1 >= packedMipStart)
+		return tileCount;
+
+	// Odd sizes round down, so last tile of a row may have no own parent.
+	const uint32_t parentX = std::min(x / 2, GetTilesX(mip + 1) - 1);
+	const uint32_t parentY = std::min(y / 2, GetTilesY(mip + 1) - 1);
+
+	return GetTileIndex(mip + 1, parentX, parentY);
+}
+
+uint64_t TileLayout::GetTailSize() const
+{
+	uint64_t size = 0;
+	for (uint32_t mip = packedMipStart; mip < mipCount; mip++)
+		size += static_cast<uint64_t>(GetRowPitch(mip)) * GetRowCount(mip);
+
+	return size;
+}
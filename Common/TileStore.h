@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#define TILE_SIZE_BYTES 65536u			// D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES
+#define TILE_LAYOUT_MAX_MIPS 16u
+
+// Tiles of a 2D texture with full mip chain, as D3D12 reserved resource lays them out.
+// Every tile is 64KB with the standard shape of format, the same in texels for every mip, so tile (x, y)
+// of mip m + 1 covers tiles (2x ~ 2x + 1, 2y ~ 2y + 1) of mip m. Mips with either side under one tile
+// are the mip tail, which is packed and kept resident. Tiles of other mips are indexed mip by mip, row by row.
+struct TileLayout
+{
+	uint32_t				format;				// DXGI_FORMAT
+	uint32_t				width;				// Mip 0
+	uint32_t				height;
+	uint32_t				mipCount;
+	uint32_t				elementSize;		// Bytes of one texel, or of one 4x4 block
+	uint32_t				blockSize;			// 4 for BC formats, 1 otherwise
+	uint32_t				tileWidth;			// Texels of one tile
+	uint32_t				tileHeight;
+	uint32_t				packedMipStart;		// First mip of tail, mipCount if there is none
+	uint32_t				tileCount;			// Tiles of mips before tail
+	uint32_t				mipFirstTile[TILE_LAYOUT_MAX_MIPS];
+
+	// Returns false if format is not one TextureDecoder reads, or there are too many mips.
+	bool Create(uint32_t dxgiFormat, uint32_t mipWidth, uint32_t mipHeight, uint32_t mips);
+
+	uint32_t GetMipWidth(uint32_t mip) const { return width >> mip > 0 ? width >> mip : 1; }
+	uint32_t GetMipHeight(uint32_t mip) const { return height >> mip > 0 ? height >> mip : 1; }
+	uint32_t GetTilesX(uint32_t mip) const { return (GetMipWidth(mip) + tileWidth - 1) / tileWidth; }
+	uint32_t GetTilesY(uint32_t mip) const { return (GetMipHeight(mip) + tileHeight - 1) / tileHeight; }
+
+	uint32_t GetTileIndex(uint32_t mip, uint32_t x, uint32_t y) const { return mipFirstTile[mip] + y * GetTilesX(mip) + x; }
+	void GetTileCoord(uint32_t tile, OUT uint32_t& mip, OUT uint32_t& x, OUT uint32_t& y) const;
+
+	// Tile covering tile at next coarser mip, or tileCount if that mip is in tail.
+	uint32_t GetParentTile(uint32_t tile) const;
+
+	// Bytes of one row of texels (or blocks), and rows of a mip as stored in DDS.
+	uint32_t GetRowPitch(uint32_t mip) const { return (GetMipWidth(mip) + blockSize - 1) / blockSize * elementSize; }
+	uint32_t GetRowCount(uint32_t mip) const { return (GetMipHeight(mip) + blockSize - 1) / blockSize; }
+
+	// Rows of every tail mip, tightly packed.
+	uint64_t GetTailSize() const;
+};
+
+// Source of tile data for TileCache. ReadTile is only called from loader thread.
+class TileStore
+{
+public:
+	virtual ~TileStore() = default;
+
+	virtual const TileLayout& GetLayout() const = 0;
+
+	// Write TILE_SIZE_BYTES of tile into data. Returns false if tile can't be read.
+	virtual bool ReadTile(uint32_t tile, OUT uint8_t* data) = 0;
+};
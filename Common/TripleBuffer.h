@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-off of the latest value from one producer thread to one consumer thread.
+// Producer fills GetWriteBuffer() and publishes it, consumer takes the latest published value with Acquire.
+// Neither side waits. A value published twice before an Acquire replaces the first one.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Every buffer, to set up before threads start.
+	T& GetBuffer(uint32_t index) { return m_buffers[index]; }
+
+	// Producer side.
+	T& GetWriteBuffer() { return m_buffers[m_writeIndex]; }
+	void Publish()
+	{
+		const uint8_t previous = m_shared.exchange(m_writeIndex | c_newFlag, std::memory_order_acq_rel);
+		m_writeIndex = previous & c_indexMask;
+	}
+
+	// Consumer side. Returns false if nothing was published since last acquire, read buffer is kept then.
+	bool Acquire()
+	{
+		if ((m_shared.load(std::memory_order_relaxed) & c_newFlag) == 0)
+			return false;
+
+		const uint8_t previous = m_shared.exchange(m_readIndex, std::memory_order_acq_rel);
+		m_readIndex = previous & c_indexMask;
+		return true;
+	}
+	const T& GetReadBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+	static constexpr uint8_t c_indexMask = 0x3;
+	static constexpr uint8_t c_newFlag = 0x4;
+
+	T							m_buffers[3];
+
+	// Index of buffer between the two sides, with flag set if it was published after last acquire.
+	// Each side owns one more index, on its own cache line.
+	alignas(64) std::atomic<uint8_t>	m_shared = 1;
+	alignas(64) uint8_t					m_writeIndex = 0;
+	alignas(64) uint8_t					m_readIndex = 2;
+};
@@ -0,0 +1,71 @@
+#include "pch.h"
+#include "UploadRing.h"
+
+RingAllocator::RingAllocator(uint64_t size)
+{
+	m_size = size;
+}
+
+void RingAllocator::Retire(uint64_t completedFenceValue)
+{
+	size_t retired = 0;
+	while (retired < m_frames.size() && m_frames[retired].fenceValue <= completedFenceValue)
+	{
+		m_tail = m_frames[retired].end;
+		retired++;
+	}
+
+	m_frames.erase(m_frames.begin(), m_frames.begin() + retired);
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0 || size > m_size)
+		return c_invalidOffset;
+
+	// Align offset in ring. Ring size is a multiple of alignment, so aligning position is the same.
+	uint64_t start = (m_head + alignment - 1) / alignment * alignment;
+
+	// Skip rest of ring if allocation doesn't fit before its end.
+	if (start % m_size + size > m_size)
+		start += m_size - start % m_size;
+
+	if (start + size - m_tail > m_size)
+		return c_invalidOffset;
+
+	m_head = start + size;
+	return start % m_size;
+}
+
+void RingAllocator::FinishFrame(uint64_t fenceValue)
+{
+	m_frames.push_back({ fenceValue, m_head });
+}
+
+UploadRing::UploadRing(RenderBackend& backend, uint64_t size) : m_allocator(size), m_backend(backend)
+{
+	m_buffer = m_backend.CreateBuffer(size, BufferHeap::UPLOAD);
+	if (m_buffer == INVALID_BUFFER_HANDLE)
+		throw std::exception();
+
+	m_mappedData = m_backend.GetMappedData(m_buffer);
+}
+
+UploadRing::~UploadRing()
+{
+	m_backend.DestroyBuffer(m_buffer);
+}
+
+UploadRing::Allocation UploadRing::Allocate(uint64_t size, uint64_t alignment)
+{
+	const uint64_t offset = m_allocator.Allocate(size, alignment);
+	if (offset == RingAllocator::c_invalidOffset)
+		throw std::exception();
+
+	Allocation allocation = {};
+	allocation.cpuAddress = m_mappedData + offset;
+	allocation.buffer = m_buffer;
+	allocation.offset = offset;
+
+	return allocation;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RenderBackend.h"
+
+// Allocation logic of UploadRing, without any device object.
+// Frames are closed with the fence value GPU signals after them, and their space is reused
+// once that value is completed. Fence values only come in as plain numbers, so any fence works.
+class RingAllocator
+{
+public:
+	static constexpr uint64_t c_invalidOffset = UINT64_MAX;
+
+	explicit RingAllocator(uint64_t size);
+
+	// Free space of every closed frame whose fence value is completed.
+	void Retire(uint64_t completedFenceValue);
+
+	// Returns offset in ring, or c_invalidOffset if there is not enough free space.
+	// An allocation never wraps, end of ring is skipped instead.
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+	// Close current frame, which GPU finishes when fence reaches fenceValue.
+	void FinishFrame(uint64_t fenceValue);
+
+	uint64_t GetSize() const { return m_size; }
+	uint64_t GetUsedSize() const { return m_head - m_tail; }
+
+private:
+	struct FrameMark
+	{
+		uint64_t		fenceValue;
+		uint64_t		end;		// Head at end of frame
+	};
+
+	uint64_t				m_size;
+
+	// Ever growing positions, offset in ring is position % size.
+	uint64_t				m_head = 0;
+	uint64_t				m_tail = 0;
+
+	// Few frames are in flight, so a vector erased from front is cheap and never reallocates once grown.
+	std::vector<FrameMark>	m_frames;
+};
+
+// Persistently mapped upload buffer shared by frames in flight.
+// Data written in a frame stays untouched until GPU passes that frame's fence value.
+class UploadRing
+{
+public:
+	struct Allocation
+	{
+		void*						cpuAddress;
+		BufferHandle				buffer;
+		uint64_t					offset;
+	};
+
+	UploadRing(RenderBackend& backend, uint64_t size);
+	~UploadRing();
+
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	void BeginFrame(uint64_t completedFenceValue) { m_allocator.Retire(completedFenceValue); }
+	void EndFrame(uint64_t fenceValue) { m_allocator.FinishFrame(fenceValue); }
+
+	// Throws if ring is full, so it must be sized for worst case of every frame in flight.
+	Allocation Allocate(uint64_t size, uint64_t alignment);
+
+private:
+	RingAllocator								m_allocator;
+	RenderBackend&								m_backend;
+	BufferHandle								m_buffer;
+	uint8_t*									m_mappedData;
+};
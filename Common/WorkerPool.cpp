@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "WorkerPool.h"
+
+#include "Profiler.h"
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+	m_activeThreadCount = threadCount;
+	m_nextTask = 0;
+
+	for (uint32_t w = 0; w + 1 < threadCount; w++)
+		m_threads.emplace_back(&WorkerPool::WorkerMain, this, w);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+void WorkerPool::Dispatch(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+	if (taskCount == 0)
+		return;
+
+	// Run inline when there is no other thread to share.
+	if (m_activeThreadCount == 1)
+	{
+		for (uint32_t t = 0; t < taskCount; t++)
+			task(t);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_taskCount = taskCount;
+		m_nextTask = 0;
+		m_pendingWorkers = m_activeThreadCount - 1;
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+
+	RunTasks();
+
+	// Wait for workers, task must outlive every access to it.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_pendingWorkers == 0; });
+	m_task = nullptr;
+}
+
+void WorkerPool::SetActiveThreadCount(uint32_t count)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_activeThreadCount = std::min(std::max(count, 1u), GetThreadCount());
+}
+
+void WorkerPool::WorkerMain(uint32_t workerIndex)
+{
+	PROFILE_THREAD_NAME("Worker");
+
+	uint64_t generation = 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wakeCondition.wait(lock, [&]() { return m_exit || m_generation != generation; });
+		if (m_exit)
+			return;
+
+		generation = m_generation;
+
+		// Workers beyond active thread count sit out this dispatch.
+		if (workerIndex + 1 >= m_activeThreadCount)
+			continue;
+
+		lock.unlock();
+		RunTasks();
+		lock.lock();
+
+		if (--m_pendingWorkers == 0)
+			m_doneCondition.notify_one();
+	}
+}
+
+void WorkerPool::RunTasks()
+{
+	for (;;)
+	{
+		const uint32_t t = m_nextTask.fetch_add(1, std::memory_order_relaxed);
+		if (t >= m_taskCount)
+			return;
+
+		(*m_task)(t);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads running indexed tasks.
+// Tasks of one dispatch are pulled from a shared atomic counter, so idle threads take
+// remaining tasks from busy ones. The calling thread runs tasks too.
+class WorkerPool
+{
+public:
+	// threadCount includes the calling thread.
+	explicit WorkerPool(uint32_t threadCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Run task(0) ~ task(taskCount - 1) and wait until every task is done.
+	void Dispatch(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+	// Limit threads used by next dispatches, in [1, GetThreadCount()].
+	void		SetActiveThreadCount(uint32_t count);
+	uint32_t	GetActiveThreadCount() const { return m_activeThreadCount; }
+	uint32_t	GetThreadCount() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+
+private:
+	void WorkerMain(uint32_t workerIndex);
+	void RunTasks();
+
+	std::vector<std::thread>					m_threads;
+
+	std::mutex									m_mutex;
+	std::condition_variable						m_wakeCondition;
+	std::condition_variable						m_doneCondition;
+
+	uint64_t									m_generation = 0;
+	uint32_t									m_pendingWorkers = 0;
+	bool										m_exit = false;
+
+	const std::function<void(uint32_t)>*		m_task = nullptr;
+	uint32_t									m_taskCount = 0;
+	std::atomic<uint32_t>						m_nextTask;
+
+	uint32_t									m_activeThreadCount = 1;
+};
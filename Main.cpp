@@ -2,6 +2,11 @@
 #include "Apollo.h"
 
 #include "ApolloArgument.h"
+#include "CubeFaceBaker.h"
+#include "CullBenchmark.h"
+#include "HeadlessReplay.h"
+#include "RecordingBackend.h"
+#include "TileFile.h"
 #include "imgui_impl_win32.h"
 
 #ifndef HID_USAGE_PAGE_GENERIC
@@ -165,6 +170,71 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hWnd, message, wParam, lParam);
 }
 
+// Same sphere as Apollo renders, from mesh cache.
+std::vector<FaceTree*> LoadFaceTrees(MeshCache& meshCache, UINT subDivideCount)
+{
+    wchar_t cacheFileName[64] = {};
+    swprintf_s(cacheFileName, L"Cache\\quadsphere_%u.bin", subDivideCount);
+    CreateDirectoryW(L"Cache", nullptr);
+
+    meshCache.LoadOrGenerate(
+        cacheFileName, 300.0f, subDivideCount, L"Textures\\displacement_l.dds", L"Textures\\displacement_r.dds");
+    return meshCache.CreateFaceTrees();
+}
+
+// Replay camera path through culling and draw argument upload into a recording backend, no window or device.
+// Stats go next to path (fileName + ".json"). Fails if path can't be read or frame loop still allocates after warm-up.
+int RunHeadlessReplay(const wchar_t* fileName, UINT subDivideCount)
+{
+    CameraPath path;
+    if (!path.Load(fileName) || path.GetFrameCount() == 0)
+        return 1;
+
+    MeshCache meshCache;
+    const std::vector<FaceTree*> faceTrees = LoadFaceTrees(meshCache, subDivideCount);
+
+    int exitCode = 1;
+    {
+        // Same worker count and scene bounds as Apollo. Path has no window size, so aspect ratio is fixed.
+        WorkerPool workerPool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+        RecordingBackend backend(false);
+        HeadlessReplay replay(
+            faceTrees, workerPool, backend, 16.0f / 9.0f, BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 160.0f));
+
+        const SceneCullOptions options = { true, true, true, true, workerPool.GetThreadCount() };
+        ReplayReport report;
+        replay.Run(path, options, report);
+
+        if (report.Save((std::wstring(fileName) + L".json").c_str()))
+            exitCode = report.GetSteadyStateAllocationCount() > 0 ? 1 : 0;
+    }
+
+    for (const auto faceTree : faceTrees)
+        delete faceTree;
+
+    return exitCode;
+}
+
+// Time every culling mode on CullBenchmark's fixed camera path, and write table of cull times to fileName.
+int RunCullBenchmark(const wchar_t* fileName, UINT subDivideCount)
+{
+    MeshCache meshCache;
+    const std::vector<FaceTree*> faceTrees = LoadFaceTrees(meshCache, subDivideCount);
+
+    bool saved = false;
+    {
+        WorkerPool workerPool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+        CullBenchmark benchmark(faceTrees, workerPool, BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 160.0f));
+        benchmark.RunAll();
+        saved = benchmark.Save(fileName);
+    }
+
+    for (const auto faceTree : faceTrees)
+        delete faceTree;
+
+    return saved ? 0 : 1;
+}
+
 // Entry point
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
@@ -178,6 +248,19 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     if (FAILED(initialize))
         return 1;
 
+    // Offline bake of cube face textures, tiling of maps for streaming, headless replay or cull benchmark, no window or device.
+    {
+        const ApolloArgument arguments = CollectApolloArgument();
+        if (arguments.BakeFaces)
+            return CubeFaceBaker::BakeTextures(arguments.BakeFaceSize) ? 0 : 1;
+        if (arguments.TileTextures)
+            return TileFile::BuildTextures() ? 0 : 1;
+        if (!arguments.HeadlessReplayFileName.empty())
+            return RunHeadlessReplay(arguments.HeadlessReplayFileName.c_str(), arguments.SubDivideCount);
+        if (!arguments.CullBenchmarkFileName.empty())
+            return RunCullBenchmark(arguments.CullBenchmarkFileName.c_str(), arguments.SubDivideCount);
+    }
+
     g_apollo = std::make_unique<Apollo>();
 
     // Register class and create window
@@ -233,6 +316,9 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
             arguments.SubDivideCount, 
             arguments.ShadowMapSize, 
             arguments.FullScreenMode);
+
+        if (!arguments.ReplayFileName.empty())
+            g_apollo->StartReplay(arguments.ReplayFileName.c_str(), true);
     }
 
     // Main message loop
@@ -256,7 +342,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 }
 
 // Exit helper
-void ExitGame() noexcept
+void ExitGame(int exitCode) noexcept
 {
-    PostQuitMessage(0);
+    PostQuitMessage(exitCode);
 }
\ No newline at end of file
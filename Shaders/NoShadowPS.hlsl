@@ -37,6 +37,7 @@ struct PS_OUTPUT
 // Texture & Sampler Variables
 //--------------------------------------------------------------------------------------
 Texture2D texMap[5] : register(t0);
+Texture2D<float> minMipMap[4] : register(t8);
 SamplerState samAnisotropic : register(s0);
 SamplerState anisotropicClampMip1 : register(s2);
 
@@ -44,17 +45,27 @@ SamplerState anisotropicClampMip1 : register(s2);
 //--------------------------------------------------------------------------------------
 // Pixel Shader
 //--------------------------------------------------------------------------------------
-float3 GetNormalFromHeight(Texture2D tex, float2 texSize, float2 sTexCoord, float multiplier)
+// Finest resident mip of map at sTexCoord, per tile if streamed (see TileCache) or whole map if loaded progressively (see MipLoader).
+float GetMinMip(int texIndex, float2 sTexCoord)
+{
+    uint width, height;
+    minMipMap[texIndex].GetDimensions(width, height);
+    int2 region = min(int2(saturate(sTexCoord) * float2(width, height)), int2(width - 1, height - 1));
+
+    return minMipMap[texIndex].Load(int3(region, 0));
+}
+
+float3 GetNormalFromHeight(Texture2D tex, float2 texSize, float2 sTexCoord, float multiplier, float minMip)
 {
     float2 xmOffset = { -3.f / texSize.x, 0 };
     float2 xpOffset = { +3.f / texSize.y, 0 };
     float2 ymOffset = { 0, -1.0f / texSize.x };
     float2 ypOffset = { 0, +1.0f / texSize.y };
 
-    float xm = tex.Sample(samAnisotropic, sTexCoord + xmOffset * multiplier).r;
-    float xp = tex.Sample(samAnisotropic, sTexCoord + xpOffset * multiplier).r;
-    float ym = tex.Sample(samAnisotropic, sTexCoord + ymOffset * multiplier).r;
-    float yp = tex.Sample(samAnisotropic, sTexCoord + ypOffset * multiplier).r;
+    float xm = tex.Sample(samAnisotropic, sTexCoord + xmOffset * multiplier, int2(0, 0), minMip).r;
+    float xp = tex.Sample(samAnisotropic, sTexCoord + xpOffset * multiplier, int2(0, 0), minMip).r;
+    float ym = tex.Sample(samAnisotropic, sTexCoord + ymOffset * multiplier, int2(0, 0), minMip).r;
+    float yp = tex.Sample(samAnisotropic, sTexCoord + ypOffset * multiplier, int2(0, 0), minMip).r;
 
     float3 va = normalize(float3(1.0f, 0, (xp - xm) * 0.1f));
     float3 vb = normalize(float3(0, 1.0f, (yp - ym) * 0.1f));
@@ -62,14 +73,14 @@ float3 GetNormalFromHeight(Texture2D tex, float2 texSize, float2 sTexCoord, floa
     return normalize(cross(va, vb));
 }
 
-float3 GetTBNNormal(Texture2D tex, float2 sTexCoord, float3x3 TBN)
+float3 GetTBNNormal(Texture2D tex, float2 sTexCoord, float minMip, float3x3 TBN)
 {
     uint width, height, numMips;
     tex.GetDimensions(0, width, height, numMips);
     float2 texSize = float2(width, height);
 
     // Calculate local normal from height map.
-    float3 localNormal = GetNormalFromHeight(tex, texSize, sTexCoord, 1.0f);
+    float3 localNormal = GetNormalFromHeight(tex, texSize, sTexCoord, 1.0f, minMip);
     localNormal = normalize(localNormal);
 
     return normalize(mul(localNormal, TBN));
@@ -120,8 +131,9 @@ PS_OUTPUT PS(DS_OUT input)
     float3x3 TBN = float3x3(normalize(T), normalize(B), normalize(N));
 
     // Merge Results.
-    float4 texColor = texMap[texIndex].Sample(samAnisotropic, sTexCoord);
-    float3 normal = GetTBNNormal(texMap[texIndex + 2], sTexCoord, TBN);
+    // Clamped to resident mips of streamed maps.
+    float4 texColor = texMap[texIndex].Sample(samAnisotropic, sTexCoord, int2(0, 0), GetMinMip(texIndex, sTexCoord));
+    float3 normal = GetTBNNormal(texMap[texIndex + 2], sTexCoord, GetMinMip(texIndex + 2, sTexCoord), TBN);
 
     float3 diffuse = saturate(dot(normal, -cb.lightDirection.xyz)) * cb.lightColor.xyz;
     float3 ambient = float3(0.008f, 0.008f, 0.008f) * cb.lightColor.xyz;
@@ -0,0 +1 @@
+#include "Shader.hlsli"
\ No newline at end of file
@@ -51,6 +51,7 @@ struct DS_OUT
 // Texture & Sampler Variables
 //--------------------------------------------------------------------------------------
 Texture2D texMap[5] : register(t0);
+Texture2D<float> minMipMap[4] : register(t8);
 SamplerState samAnisotropic : register(s0);
 
 
@@ -215,27 +216,20 @@ float CalcLevel(float tess)
     return max(0, (cb.parameters.w - 2) - (int) log2(tess));
 }
 
-[domain("quad")]
-DS_OUT DS(const OutputPatch<HS_OUT, 4> input, float2 uv : SV_DomainLocation, PatchTess patch)
+// Finest resident mip of map at sTexCoord, per tile if streamed (see TileCache) or whole map if loaded progressively (see MipLoader).
+float GetMinMip(int texIndex, float2 sTexCoord)
 {
-    DS_OUT output;
-	
-	// Bilinear interpolation (position).
-    float3 v1 = lerp(input[0].position, input[1].position, uv.x);
-    float3 v2 = lerp(input[2].position, input[3].position, uv.x);
-    float3 position = lerp(v1, v2, uv.y);
+    uint width, height;
+    minMipMap[texIndex].GetDimensions(width, height);
+    int2 region = min(int2(saturate(sTexCoord) * float2(width, height)), int2(width - 1, height - 1));
 
-    uint level = CalcLevel(patch.insideTess[0]);
-    if (distance(uv, float2(0.5f, 0.5f)) >= sqrt(2) / 2.0f) // patch on corner.
-    {
-        level = 0;
-    }
-    else // patch on border.
-    {
-        level = uv.x == 0 ? CalcLevel(patch.edgeTess[0]) : uv.x == 1 ? CalcLevel(patch.edgeTess[2]) : level;
-        level = uv.y == 0 ? CalcLevel(patch.edgeTess[1]) : uv.y == 1 ? CalcLevel(patch.edgeTess[3]) : level;
-    }
-    // both not, just use calculated level.
+    return minMipMap[texIndex].Load(int3(region, 0));
+}
+
+// Displace position on patch with height sampled at level, and project it to light.
+DS_OUT Displace(float3 position, uint level)
+{
+    DS_OUT output;
 
     // Get normalized cartesian position.
     float3 normCatPos = normalize(position);
@@ -253,7 +247,7 @@ DS_OUT DS(const OutputPatch<HS_OUT, 4> input, float2 uv : SV_DomainLocation, Pat
     float2 sTexCoord = float2(round(gTexCoord.x) == 0 ? saturate(gTexCoord.x * 2) : saturate((gTexCoord.x - 0.5f) * 2.0f), gTexCoord.y);
 
     // Get height from texture.
-    float height = texMap[texIndex].SampleLevel(samAnisotropic, sTexCoord, level).r;
+    float height = texMap[texIndex].SampleLevel(samAnisotropic, sTexCoord, max(level, GetMinMip(texIndex, sTexCoord))).r;
     float3 catPos = normCatPos * (150.0f + height * 0.6f);
 
     // Multiply MVP matrices.
@@ -263,6 +257,75 @@ DS_OUT DS(const OutputPatch<HS_OUT, 4> input, float2 uv : SV_DomainLocation, Pat
     return output;
 }
 
+[domain("quad")]
+DS_OUT DS(const OutputPatch<HS_OUT, 4> input, float2 uv : SV_DomainLocation, PatchTess patch)
+{
+	// Bilinear interpolation (position).
+    float3 v1 = lerp(input[0].position, input[1].position, uv.x);
+    float3 v2 = lerp(input[2].position, input[3].position, uv.x);
+    float3 position = lerp(v1, v2, uv.y);
+
+    uint level = CalcLevel(patch.insideTess[0]);
+    if (distance(uv, float2(0.5f, 0.5f)) >= sqrt(2) / 2.0f) // patch on corner.
+    {
+        level = 0;
+    }
+    else // patch on border.
+    {
+        level = uv.x == 0 ? CalcLevel(patch.edgeTess[0]) : uv.x == 1 ? CalcLevel(patch.edgeTess[2]) : level;
+        level = uv.y == 0 ? CalcLevel(patch.edgeTess[1]) : uv.y == 1 ? CalcLevel(patch.edgeTess[3]) : level;
+    }
+    // both not, just use calculated level.
+
+    return Displace(position, level);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Pattern Vertex Shader (pre-tessellated patches, see PatternCache)
+//--------------------------------------------------------------------------------------
+struct PATTERN_INPUT
+{
+    float2 uv : DOMAIN;
+    uint instance : PATCH;  // Patch index (22 bits), inside level (3 bits), edge level (3 bits).
+};
+
+struct SphereVertex
+{
+    float3 position;
+    float3 quadPos;
+};
+
+// Static VB and IB of quad sphere, as root SRVs.
+StructuredBuffer<SphereVertex> sphereVertices : register(t6);
+StructuredBuffer<uint> sphereIndices : register(t7);
+
+DS_OUT PatternVS(PATTERN_INPUT input)
+{
+    uint index = (input.instance & 0x3FFFFF) * 4;
+    float3 p0 = sphereVertices[sphereIndices[index]].position;
+    float3 p1 = sphereVertices[sphereIndices[index + 1]].position;
+    float3 p2 = sphereVertices[sphereIndices[index + 2]].position;
+    float3 p3 = sphereVertices[sphereIndices[index + 3]].position;
+
+    // Same interpolation as DS.
+    float2 uv = input.uv;
+    float3 position = lerp(lerp(p0, p1, uv.x), lerp(p2, p3, uv.x), uv.y);
+
+    // Levels were calculated by CPU from the same factors as ConstantHS.
+    uint level = (input.instance >> 22) & 0x7;
+    if (distance(uv, float2(0.5f, 0.5f)) >= sqrt(2) / 2.0f) // patch on corner.
+    {
+        level = 0;
+    }
+    else if (uv.x == 0 || uv.x == 1 || uv.y == 0 || uv.y == 1) // patch on border.
+    {
+        level = (input.instance >> 25) & 0x7;
+    }
+
+    return Displace(position, level);
+}
+
 void PS(DS_OUT input)
 {
     // Nothing to do.
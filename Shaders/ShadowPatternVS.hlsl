@@ -0,0 +1 @@
+#include "Shadow.hlsli"
\ No newline at end of file
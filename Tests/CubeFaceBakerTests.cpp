@@ -0,0 +1,254 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "CubeFaceBaker.h"
+#include "DdsFormat.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr uint32_t c_sourceSize = 128;	// Width and height of each half
+	constexpr uint32_t c_headerSize = sizeof(Dds::c_magic) + sizeof(Dds::Header) + sizeof(Dds::HeaderDXT10);
+
+	// Smooth over whole sphere, poles and theta wrap included.
+	float GetValue(float x, float y, float z)
+	{
+		return 0.5f + 0.3f * x + 0.15f * y - 0.05f * z;
+	}
+
+	// R32F half of equirectangular map, as Displace and PS read it: left half is theta in [0, pi].
+	bool WriteSource(const wchar_t* fileName, uint32_t half)
+	{
+		std::vector<float> texels(static_cast<size_t>(c_sourceSize) * c_sourceSize);
+		for (uint32_t y = 0; y < c_sourceSize; y++)
+		{
+			for (uint32_t x = 0; x < c_sourceSize; x++)
+			{
+				const float theta = XM_PI * (half + (x + 0.5f) / c_sourceSize);
+				const float phi = XM_PI * (y + 0.5f) / c_sourceSize;
+				texels[static_cast<size_t>(y) * c_sourceSize + x] =
+					GetValue(sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta));
+			}
+		}
+
+		Dds::Header header = {};
+		header.size = sizeof(Dds::Header);
+		header.flags = Dds::c_headerCaps | Dds::c_headerHeight | Dds::c_headerWidth | Dds::c_headerPixelFormat | Dds::c_headerPitch;
+		header.height = c_sourceSize;
+		header.width = c_sourceSize;
+		header.pitchOrLinearSize = c_sourceSize * sizeof(float);
+		header.depth = 1;
+		header.mipMapCount = 1;
+		header.ddspf.size = sizeof(Dds::PixelFormat);
+		header.ddspf.flags = Dds::c_pixelFourCC;
+		header.ddspf.fourCC = Dds::MakeFourCC('D', 'X', '1', '0');
+		header.caps = Dds::c_capsTexture;
+
+		Dds::HeaderDXT10 header10 = {};
+		header10.dxgiFormat = DXGI_FORMAT_R32_FLOAT;
+		header10.resourceDimension = Dds::c_dimensionTexture2D;
+		header10.arraySize = 1;
+
+		const HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		DWORD written = 0;
+		bool result = WriteFile(file, &Dds::c_magic, sizeof(Dds::c_magic), &written, nullptr) &&
+			WriteFile(file, &header, sizeof(header), &written, nullptr) &&
+			WriteFile(file, &header10, sizeof(header10), &written, nullptr) &&
+			WriteFile(file, texels.data(), static_cast<DWORD>(texels.size() * sizeof(float)), &written, nullptr);
+		CloseHandle(file);
+
+		return result;
+	}
+
+	bool ReadOutput(const wchar_t* fileName, OUT std::vector<uint8_t>& data)
+	{
+		const HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size = {};
+		DWORD read = 0;
+		const bool result = GetFileSizeEx(file, &size) &&
+			(data.resize(static_cast<size_t>(size.QuadPart)), ReadFile(file, data.data(), static_cast<DWORD>(data.size()), &read, nullptr)) &&
+			read == data.size();
+		CloseHandle(file);
+
+		return result;
+	}
+
+	// R16 texels of baked array, every mip of every face.
+	class BakedFaces
+	{
+	public:
+		BakedFaces(const std::vector<uint8_t>& data, uint32_t faceSize, uint32_t mipCount)
+			: m_data(data), m_faceSize(faceSize), m_mipCount(mipCount)
+		{
+		}
+
+		static uint64_t CalcSize(uint32_t faceSize, uint32_t mipCount)
+		{
+			uint64_t faceBytes = 0;
+			for (uint32_t mip = 0; mip < mipCount; mip++)
+				faceBytes += sizeof(uint16_t) * static_cast<uint64_t>(faceSize >> mip) * (faceSize >> mip);
+
+			return c_headerSize + CUBE_FACE_COUNT * faceBytes;
+		}
+
+		float Get(uint32_t face, uint32_t mip, uint32_t x, uint32_t y) const
+		{
+			size_t offset = c_headerSize;
+			for (uint32_t f = 0; f <= face; f++)
+			{
+				for (uint32_t m = 0; m < m_mipCount && (f < face || m < mip); m++)
+					offset += sizeof(uint16_t) * static_cast<size_t>(m_faceSize >> m) * (m_faceSize >> m);
+			}
+			offset += sizeof(uint16_t) * (static_cast<size_t>(y) * (m_faceSize >> mip) + x);
+
+			uint16_t value;
+			memcpy(&value, &m_data[offset], sizeof(uint16_t));
+			return value / 65535.0f;
+		}
+
+	private:
+		const std::vector<uint8_t>&	m_data;
+		uint32_t					m_faceSize;
+		uint32_t					m_mipCount;
+	};
+
+	struct BakeFiles
+	{
+		const wchar_t*	left = L"CubeFaceBakerTest_l.dds";
+		const wchar_t*	right = L"CubeFaceBakerTest_r.dds";
+		const wchar_t*	out = L"CubeFaceBakerTest_faces.dds";
+
+		~BakeFiles()
+		{
+			DeleteFileW(left);
+			DeleteFileW(right);
+			DeleteFileW(out);
+		}
+	};
+}
+
+// Face-local coordinates of a face direction are found on same face, away from edges where faces tie.
+TEST_CASE(CubeFaceBakerFindsFaceOfDirection)
+{
+	uint32_t mismatchCount = 0;
+	for (uint32_t face = 0; face < CUBE_FACE_COUNT; face++)
+	{
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			const float s = i / 16.0f;
+			const float t = (16 - i) / 16.0f * 0.9f + 0.05f;
+
+			uint32_t foundFace;
+			float foundS, foundT;
+			CubeFaceBaker::FindFace(CubeFaceBaker::GetDirection(face, s, t), foundFace, foundS, foundT);
+			mismatchCount += foundFace == face && fabsf(foundS - s) < 1e-5f && fabsf(foundT - t) < 1e-5f ? 0 : 1;
+		}
+	}
+
+	CHECK(mismatchCount == 0);
+}
+
+// Baked faces hold source values at their directions, meet without a step at face seams, and each
+// mip is box filtered from the one above it.
+TEST_CASE(CubeFaceBakerBakesContinuousFacesAndMips)
+{
+	const BakeFiles files;
+	CHECK(WriteSource(files.left, 0) && WriteSource(files.right, 1));
+
+	WorkerPool pool(4);
+	CubeFaceBakeStats stats;
+	CHECK(CubeFaceBaker::Bake(files.left, files.right, files.out, 0, pool, stats));
+	CHECK(stats.faceSize == CubeFaceBaker::CalcFaceSize(c_sourceSize) && stats.faceSize == 64);
+	CHECK(stats.mipCount == 7);
+	CHECK(stats.format == DXGI_FORMAT_R16_UNORM);
+
+	std::vector<uint8_t> data;
+	CHECK(ReadOutput(files.out, data));
+	CHECK(data.size() == BakedFaces::CalcSize(stats.faceSize, stats.mipCount));
+	if (data.size() != BakedFaces::CalcSize(stats.faceSize, stats.mipCount))
+		return;
+
+	const BakedFaces faces(data, stats.faceSize, stats.mipCount);
+	const uint32_t size = stats.faceSize;
+
+	// First mip against value at texel center direction, and largest step between neighbours inside a face.
+	float maxError = 0.0f;
+	float maxStep = 0.0f;
+	for (uint32_t face = 0; face < CUBE_FACE_COUNT; face++)
+	{
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				const XMFLOAT3 direction = CubeFaceBaker::GetDirection(face, (x + 0.5f) / size, (y + 0.5f) / size);
+				const float value = faces.Get(face, 0, x, y);
+				maxError = std::max(maxError, fabsf(value - GetValue(direction.x, direction.y, direction.z)));
+				if (x + 1 < size)
+					maxStep = std::max(maxStep, fabsf(faces.Get(face, 0, x + 1, y) - value));
+				if (y + 1 < size)
+					maxStep = std::max(maxStep, fabsf(faces.Get(face, 0, x, y + 1) - value));
+			}
+		}
+	}
+	CHECK(maxError < 0.01f);
+	CHECK(maxStep > 0.0f);
+
+	// Edge texel against texel of face across seam, one texel beyond edge.
+	float maxSeamStep = 0.0f;
+	for (uint32_t face = 0; face < CUBE_FACE_COUNT; face++)
+	{
+		for (uint32_t i = 0; i < size; i++)
+		{
+			const uint32_t edgeTexels[4][2] = { { 0, i }, { size - 1, i }, { i, 0 }, { i, size - 1 } };
+			for (const auto& texel : edgeTexels)
+			{
+				const float s = (texel[0] + 0.5f) / size;
+				const float t = (texel[1] + 0.5f) / size;
+				const float beyondS = texel[0] == 0 ? -0.5f / size : texel[0] == size - 1 ? 1.0f + 0.5f / size : s;
+				const float beyondT = texel[0] != 0 && texel[0] != size - 1 ? (texel[1] == 0 ? -0.5f / size : 1.0f + 0.5f / size) : t;
+
+				uint32_t otherFace;
+				float otherS, otherT;
+				CubeFaceBaker::FindFace(CubeFaceBaker::GetDirection(face, beyondS, beyondT), otherFace, otherS, otherT);
+				CHECK(otherFace != face);
+
+				const uint32_t otherX = std::min(static_cast<uint32_t>(otherS * size), size - 1);
+				const uint32_t otherY = std::min(static_cast<uint32_t>(otherT * size), size - 1);
+				maxSeamStep = std::max(maxSeamStep,
+					fabsf(faces.Get(face, 0, texel[0], texel[1]) - faces.Get(otherFace, 0, otherX, otherY)));
+			}
+		}
+	}
+	CHECK(maxSeamStep <= 2.0f * maxStep);
+
+	// Every mip is 2x2 average of finer one, within R16 rounding.
+	float maxMipError = 0.0f;
+	for (uint32_t face = 0; face < CUBE_FACE_COUNT; face++)
+	{
+		for (uint32_t mip = 1; mip < stats.mipCount; mip++)
+		{
+			const uint32_t mipSize = size >> mip;
+			for (uint32_t y = 0; y < mipSize; y++)
+			{
+				for (uint32_t x = 0; x < mipSize; x++)
+				{
+					const float average = 0.25f * (
+						faces.Get(face, mip - 1, 2 * x, 2 * y) + faces.Get(face, mip - 1, 2 * x + 1, 2 * y) +
+						faces.Get(face, mip - 1, 2 * x, 2 * y + 1) + faces.Get(face, mip - 1, 2 * x + 1, 2 * y + 1));
+					maxMipError = std::max(maxMipError, fabsf(faces.Get(face, mip, x, y) - average));
+				}
+			}
+		}
+	}
+	CHECK(maxMipError < 2.0f / 65535.0f);
+}
@@ -0,0 +1,298 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "QuadSphereGenerator.h"
+#include "SceneView.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Same as FaceTree's cache epsilon, per plane or horizon component.
+	constexpr float c_cacheEpsilon = 1e-5f;
+
+	struct TestSphere
+	{
+		QuadSphereGenerator::QuadSphereInfo*	info;
+
+		explicit TestSphere(uint32_t subdivideCount)
+			: info(QuadSphereGenerator::CreateQuadSphere(300.0f, 300.0f, 300.0f, subdivideCount, nullptr))
+		{
+		}
+
+		~TestSphere()
+		{
+			for (const FaceTree* faceTree : info->faceTrees)
+				delete faceTree;
+			delete info;
+		}
+	};
+
+	SceneView CreateView(float x)
+	{
+		CameraFrame frame = {};
+		frame.position = XMFLOAT3(x, 80.0f, -300.0f);
+		frame.yaw = 0.1f;
+		frame.pitch = 0.2f;
+		frame.lightDirection = XMFLOAT3(cosf(3.0f), 0.0f, -sinf(3.0f));
+		return SceneView::Create(frame, 16.0f / 9.0f, BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 160.0f));
+	}
+
+	// Normals only, distances are hundreds of units and have no float precision left for a sub-epsilon step.
+	void MoveNormals(OUT CullPlanes planes[CULL_VIEW_COUNT], float delta)
+	{
+		for (uint32_t v = 0; v < CULL_VIEW_COUNT; v++)
+		{
+			for (XMFLOAT4& plane : planes[v].planes)
+			{
+				plane.x += delta;
+				plane.y -= delta;
+				plane.z += delta;
+			}
+		}
+	}
+
+	struct CullResult
+	{
+		std::vector<IndexRange>		ranges[CULL_VIEW_COUNT];
+		uint32_t					culledQuadCount[CULL_VIEW_COUNT];
+		uint32_t					cachedSubtreeCount;
+	};
+
+	CullResult Cull(
+		IN const std::vector<FaceTree*>& faceTrees, IN const CullPlanes planes[CULL_VIEW_COUNT],
+		IN const CullHorizon horizons[CULL_VIEW_COUNT])
+	{
+		CullResult result = {};
+		for (FaceTree* faceTree : faceTrees)
+		{
+			for (uint32_t subtree = 0; subtree < FACE_TREE_SUBTREE_COUNT; subtree++)
+			{
+				for (uint32_t v = 0; v < CULL_VIEW_COUNT; v++)
+				{
+					const auto view = static_cast<CullView>(v);
+					const CullStats stats = faceTree->UpdateIndexData(planes[v], horizons[v], subtree, view);
+					result.culledQuadCount[v] += stats.culledQuadCount;
+					result.cachedSubtreeCount += stats.cachedSubtreeCount;
+
+					const std::vector<IndexRange>& ranges = faceTree->GetRenderRanges(view, subtree);
+					result.ranges[v].insert(result.ranges[v].end(), ranges.begin(), ranges.end());
+				}
+			}
+		}
+
+		return result;
+	}
+
+	bool SameRanges(const CullResult& a, const CullResult& b)
+	{
+		for (uint32_t v = 0; v < CULL_VIEW_COUNT; v++)
+		{
+			if (a.culledQuadCount[v] != b.culledQuadCount[v] || a.ranges[v].size() != b.ranges[v].size())
+				return false;
+			for (size_t r = 0; r < a.ranges[v].size(); r++)
+			{
+				if (a.ranges[v][r].start != b.ranges[v][r].start || a.ranges[v][r].count != b.ranges[v][r].count)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Orthographic light volume smaller than sphere and off its center, as world space box and as cull
+	// planes. It takes sphere rim in front of and behind center, but not front or back cap.
+	struct LightBox
+	{
+		BoundingOrientedBox		volume;
+		CullPlanes				planes;
+		CullHorizon				horizon;
+	};
+
+	LightBox CreateLightBox()
+	{
+		const XMVECTOR lightDirection = XMVector3Normalize(XMVectorSet(0.6f, -0.3f, 0.75f, 0.0f));
+		const XMMATRIX lightView = XMMatrixLookAtLH(
+			XMVectorScale(lightDirection, -320.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+		// Sphere center is at depth 320, radius 150.
+		const float l = -40.0f, r = 160.0f, b = -60.0f, t = 80.0f, n = 230.0f, f = 380.0f;
+
+		LightBox lightBox = {};
+		lightBox.planes = CullPlanes::FromViewProjection(lightView * XMMatrixOrthographicOffCenterLH(l, r, b, t, n, f));
+		lightBox.horizon = CullHorizon::FromDirection(XMVectorNegate(lightDirection));
+
+		XMVECTOR det;
+		const BoundingOrientedBox box(
+			XMFLOAT3(0.5f * (l + r), 0.5f * (b + t), 0.5f * (n + f)),
+			XMFLOAT3(0.5f * (r - l), 0.5f * (t - b), 0.5f * (f - n)), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+		box.Transform(lightBox.volume, XMMatrixInverse(&det, lightView));
+
+		return lightBox;
+	}
+
+	// Box is wholly behind one of planes, which is all plane culling can tell.
+	bool OutsidePlane(IN const CullPlanes& planes, IN const BoundingOrientedBox& box)
+	{
+		const XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&box.Orientation));
+		const XMVECTOR center = XMLoadFloat3(&box.Center);
+		const float extents[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+
+		for (const XMFLOAT4& plane : planes.planes)
+		{
+			const XMVECTOR normal = XMLoadFloat4(&plane);
+			float radius = 0.0f;
+			for (uint32_t a = 0; a < 3; a++)
+				radius += extents[a] * fabsf(XMVectorGetX(XMVector3Dot(normal, rotation.r[a])));
+
+			if (XMVectorGetX(XMVector3Dot(normal, center)) + plane.w < -radius)
+				return true;
+		}
+
+		return false;
+	}
+
+	bool InRanges(IN const std::vector<IndexRange>& ranges, uint32_t start, uint32_t count)
+	{
+		for (const IndexRange& range : ranges)
+		{
+			if (range.start <= start && start + count <= range.start + range.count)
+				return true;
+		}
+
+		return false;
+	}
+}
+
+// Same view, or one within epsilon, reuses every subtree's ranges as they are.
+TEST_CASE(FaceTreeReusesResultOfUnchangedView)
+{
+	const TestSphere sphere(7);
+	const std::vector<FaceTree*>& faceTrees = sphere.info->faceTrees;
+	constexpr uint32_t subtreeCount = 6 * FACE_TREE_SUBTREE_COUNT * CULL_VIEW_COUNT;
+
+	const SceneView view = CreateView(0.0f);
+	CullPlanes planes[CULL_VIEW_COUNT];
+	CullHorizon horizons[CULL_VIEW_COUNT];
+	view.GetCullPlanes(planes);
+	view.GetCullHorizons(true, horizons);
+
+	const CullResult first = Cull(faceTrees, planes, horizons);
+	CHECK(first.cachedSubtreeCount == 0);
+	CHECK(first.culledQuadCount[CULL_VIEW_CAMERA] > 0 && !first.ranges[CULL_VIEW_CAMERA].empty());
+
+	const CullResult same = Cull(faceTrees, planes, horizons);
+	CHECK(same.cachedSubtreeCount == subtreeCount);
+	CHECK(SameRanges(first, same));
+
+	MoveNormals(planes, 0.5f * c_cacheEpsilon);
+	const CullResult near = Cull(faceTrees, planes, horizons);
+	CHECK(near.cachedSubtreeCount == subtreeCount);
+	CHECK(SameRanges(first, near));
+
+	// Invalidated cache culls again, to the same result.
+	for (FaceTree* faceTree : faceTrees)
+		faceTree->InvalidateCache();
+	const CullResult invalidated = Cull(faceTrees, planes, horizons);
+	CHECK(invalidated.cachedSubtreeCount == 0);
+	CHECK(SameRanges(first, invalidated));
+}
+
+// View past epsilon culls again, and result is that of the new view, not of the cached one.
+TEST_CASE(FaceTreeRecullsAfterViewMoves)
+{
+	const TestSphere sphere(7);
+	const std::vector<FaceTree*>& faceTrees = sphere.info->faceTrees;
+
+	CullPlanes planes[CULL_VIEW_COUNT];
+	CullHorizon horizons[CULL_VIEW_COUNT];
+	CreateView(0.0f).GetCullPlanes(planes);
+	CreateView(0.0f).GetCullHorizons(true, horizons);
+	Cull(faceTrees, planes, horizons);
+
+	// Key stays at culled view on hits, so steps under epsilon can't add up to drift past it.
+	MoveNormals(planes, 0.6f * c_cacheEpsilon);
+	CHECK(Cull(faceTrees, planes, horizons).cachedSubtreeCount > 0);
+	MoveNormals(planes, 0.6f * c_cacheEpsilon);
+	CHECK(Cull(faceTrees, planes, horizons).cachedSubtreeCount == 0);
+
+	// Horizon alone moving past epsilon misses too, in camera view only.
+	const CullResult key = Cull(faceTrees, planes, horizons);
+	horizons[CULL_VIEW_CAMERA].cosHorizon += 2.0f * c_cacheEpsilon;
+	CHECK(Cull(faceTrees, planes, horizons).cachedSubtreeCount == 6 * FACE_TREE_SUBTREE_COUNT);
+	CHECK(key.cachedSubtreeCount == 2 * 6 * FACE_TREE_SUBTREE_COUNT);
+
+	// Camera moved sideways: what is culled changes, and matches a cull of the moved view from scratch.
+	// Light planes are back at those of view too, past epsilon from their moved key.
+	const SceneView moved = CreateView(40.0f);
+	moved.GetCullPlanes(planes);
+	moved.GetCullHorizons(true, horizons);
+	const CullResult culled = Cull(faceTrees, planes, horizons);
+	CHECK(culled.cachedSubtreeCount == 0);
+	CHECK(!SameRanges(key, culled));
+
+	for (FaceTree* faceTree : faceTrees)
+		faceTree->InvalidateCache();
+	CHECK(SameRanges(culled, Cull(faceTrees, planes, horizons)));
+}
+
+// Light view keeps every leaf its box intersects, checked one leaf at a time, and drops every leaf wholly
+// behind one of its planes. Horizon culling only drops more.
+TEST_CASE(FaceTreeLightViewMatchesBoxTest)
+{
+	const TestSphere sphere(7);
+	const LightBox lightBox = CreateLightBox();
+	CullHorizon noHorizon = {};
+
+	uint32_t leafCount = 0;
+	uint32_t intersectingCount = 0;
+	uint32_t missedCount = 0;
+	uint32_t extraCount = 0;
+	uint32_t horizonCount = 0;
+	uint32_t horizonExtraCount = 0;
+
+	for (FaceTree* faceTree : sphere.info->faceTrees)
+	{
+		std::vector<IndexRange> ranges;
+		std::vector<IndexRange> horizonRanges;
+		for (uint32_t subtree = 0; subtree < FACE_TREE_SUBTREE_COUNT; subtree++)
+		{
+			faceTree->UpdateIndexData(lightBox.planes, noHorizon, subtree, CULL_VIEW_LIGHT);
+			const std::vector<IndexRange>& subtreeRanges = faceTree->GetRenderRanges(CULL_VIEW_LIGHT, subtree);
+			ranges.insert(ranges.end(), subtreeRanges.begin(), subtreeRanges.end());
+
+			faceTree->UpdateIndexData(lightBox.planes, lightBox.horizon, subtree, CULL_VIEW_LIGHT);
+			const std::vector<IndexRange>& subtreeHorizonRanges = faceTree->GetRenderRanges(CULL_VIEW_LIGHT, subtree);
+			horizonRanges.insert(horizonRanges.end(), subtreeHorizonRanges.begin(), subtreeHorizonRanges.end());
+		}
+
+		std::vector<QuadNodeRecord> records;
+		faceTree->GetQuadTree().GetRecords(records);
+		const uint32_t firstLeaf = QuadTree::CalcNodeCount(faceTree->GetQuadTree().GetLevelCount() - 1);
+
+		for (uint32_t node = firstLeaf; node < records.size(); node++)
+		{
+			const QuadNodeRecord& record = records[node];
+			const BoundingOrientedBox leafBox(record.obbCenter, record.obbExtents, record.obbOrientation);
+			const bool intersecting = lightBox.volume.Intersects(leafBox);
+			const bool drawn = InRanges(ranges, record.baseAddress, record.indexCount);
+			const bool horizonDrawn = InRanges(horizonRanges, record.baseAddress, record.indexCount);
+
+			leafCount++;
+			intersectingCount += intersecting ? 1 : 0;
+			missedCount += intersecting && !drawn ? 1 : 0;
+			extraCount += drawn && OutsidePlane(lightBox.planes, leafBox) ? 1 : 0;
+			horizonCount += horizonDrawn ? 1 : 0;
+			horizonExtraCount += horizonDrawn && !drawn ? 1 : 0;
+		}
+	}
+
+	// Box cuts sphere, so some leaves are in it and some are not.
+	CHECK(intersectingCount > 0 && intersectingCount < leafCount);
+	CHECK(missedCount == 0);
+	CHECK(extraCount == 0);
+
+	// Far side of box is behind sphere from light.
+	CHECK(horizonCount > 0 && horizonCount < intersectingCount);
+	CHECK(horizonExtraCount == 0);
+}
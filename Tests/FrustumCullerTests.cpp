@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "FrustumCuller.h"
+
+#include <DirectXCollision.h>
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Random perspective view somewhere around origin, as DirectXCollision frustum and as cull planes.
+	struct TestFrustum
+	{
+		BoundingFrustum		frustum;
+		CullPlanes			planes;
+		XMFLOAT3			position;
+		XMFLOAT3			direction;
+		float				farZ;
+	};
+
+	TestFrustum CreateFrustum(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> fov(0.3f, 2.0f);
+		std::uniform_real_distribution<float> aspect(0.5f, 2.5f);
+		std::uniform_real_distribution<float> nearZ(0.1f, 5.0f);
+		std::uniform_real_distribution<float> depth(20.0f, 400.0f);
+
+		TestFrustum result = {};
+		const XMVECTOR position = XMVectorSet(100.0f * unit(random), 100.0f * unit(random), 100.0f * unit(random), 1.0f);
+		const XMVECTOR direction = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f));
+		const XMVECTOR up = XMVectorSet(unit(random), 1.0f, unit(random), 0.0f);
+
+		const float n = nearZ(random);
+		result.farZ = n + depth(random);
+		const XMMATRIX view = XMMatrixLookToLH(position, direction, up);
+		const XMMATRIX projection = XMMatrixPerspectiveFovLH(fov(random), aspect(random), n, result.farZ);
+
+		XMVECTOR det;
+		BoundingFrustum(projection).Transform(result.frustum, XMMatrixInverse(&det, view));
+		result.planes = CullPlanes::FromViewProjection(view * projection);
+		XMStoreFloat3(&result.position, position);
+		XMStoreFloat3(&result.direction, direction);
+
+		return result;
+	}
+
+	// CULL_BATCH_SIZE random boxes inside and around frustum, and their structure-of-arrays view.
+	struct TestBoxes
+	{
+		BoundingOrientedBox		boxes[CULL_BATCH_SIZE];
+		float					centers[3][CULL_BATCH_SIZE];
+		float					axes[3][3][CULL_BATCH_SIZE];	// Axis, component, lane
+
+		CullBoxes GetCullBoxes() const
+		{
+			CullBoxes result = {};
+			result.centerX = centers[0];
+			result.centerY = centers[1];
+			result.centerZ = centers[2];
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				result.axisX[a] = axes[a][0];
+				result.axisY[a] = axes[a][1];
+				result.axisZ[a] = axes[a][2];
+			}
+			return result;
+		}
+	};
+
+	TestBoxes CreateBoxes(std::mt19937& random, IN const TestFrustum& frustum)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> along(-0.2f, 1.2f);
+		std::uniform_real_distribution<float> extent(0.05f, 40.0f);
+
+		TestBoxes result = {};
+		for (uint32_t lane = 0; lane < CULL_BATCH_SIZE; lane++)
+		{
+			// Along view direction, spread sideways as far as frustum is deep so boxes land on every side.
+			const float t = along(random) * frustum.farZ;
+			const XMVECTOR center = XMLoadFloat3(&frustum.position) + XMLoadFloat3(&frustum.direction) * t +
+				XMVectorSet(unit(random), unit(random), unit(random), 0.0f) * (0.2f * frustum.farZ + 10.0f);
+			const XMVECTOR orientation = XMQuaternionNormalize(XMVectorSet(unit(random), unit(random), unit(random), unit(random) + 1.5f));
+
+			BoundingOrientedBox& box = result.boxes[lane];
+			XMStoreFloat3(&box.Center, center);
+			box.Extents = XMFLOAT3(extent(random), extent(random), extent(random));
+			XMStoreFloat4(&box.Orientation, orientation);
+
+			result.centers[0][lane] = box.Center.x;
+			result.centers[1][lane] = box.Center.y;
+			result.centers[2][lane] = box.Center.z;
+
+			const XMMATRIX rotation = XMMatrixRotationQuaternion(orientation);
+			const float extents[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				XMFLOAT3 axis;
+				XMStoreFloat3(&axis, rotation.r[a] * extents[a]);
+				result.axes[a][0][lane] = axis.x;
+				result.axes[a][1][lane] = axis.y;
+				result.axes[a][2][lane] = axis.z;
+			}
+		}
+
+		return result;
+	}
+}
+
+// Batch is conservative against BoundingFrustum::Contains: a box it rejects is one DirectXCollision
+// finds disjoint, with or without plane hint. Build with _XM_NO_INTRINSICS_ to cover scalar path.
+TEST_CASE(FrustumCullerNeverRejectsVisibleBox)
+{
+	std::mt19937 random(5);
+
+	uint32_t laneCount = 0;
+	uint32_t outsideCount = 0;
+	uint32_t disjointCount = 0;
+	uint32_t containedCount = 0;
+	uint32_t wrongOutsideCount = 0;
+	uint32_t wrongInsideCount = 0;
+	for (uint32_t f = 0; f < 64; f++)
+	{
+		const TestFrustum frustum = CreateFrustum(random);
+		uint8_t planeHint = 0;
+		for (uint32_t batch = 0; batch < 256; batch++)
+		{
+			const TestBoxes boxes = CreateBoxes(random, frustum);
+
+			CullBatchResult result;
+			FrustumCuller::CullBatch(frustum.planes, boxes.GetCullBoxes(), 0, CULL_PLANE_MASK_ALL, batch % 2 ? &planeHint : nullptr, result);
+
+			for (uint32_t lane = 0; lane < CULL_BATCH_SIZE; lane++)
+			{
+				const ContainmentType containment = frustum.frustum.Contains(boxes.boxes[lane]);
+				const bool outside = (result.outsideMask >> lane) & 1;
+
+				laneCount++;
+				outsideCount += outside ? 1 : 0;
+				disjointCount += containment == DISJOINT ? 1 : 0;
+				containedCount += containment == CONTAINS ? 1 : 0;
+				wrongOutsideCount += outside && containment != DISJOINT ? 1 : 0;
+
+				// No plane left to intersect means box is inside every plane.
+				wrongInsideCount += !outside && result.planeMasks[lane] == 0 && containment != CONTAINS ? 1 : 0;
+			}
+		}
+	}
+
+	CHECK(wrongOutsideCount == 0);
+	CHECK(wrongInsideCount == 0);
+
+	// Boxes fall on every side, so neither answer is vacuous.
+	CHECK(outsideCount > laneCount / 10 && disjointCount >= outsideCount);
+	CHECK(containedCount > laneCount / 20);
+	CHECK(laneCount - disjointCount > laneCount / 10);
+}
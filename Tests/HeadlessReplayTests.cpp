@@ -0,0 +1,263 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "AllocationCounter.h"
+#include "DrawArgumentBuffer.h"
+#include "HeadlessReplay.h"
+#include "QuadSphereGenerator.h"
+#include "RecordingBackend.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr float c_aspectRatio = 16.0f / 9.0f;
+
+	// Sphere as Apollo generates it without height map, at low subdivision to keep tests quick.
+	struct TestSphere
+	{
+		QuadSphereGenerator::QuadSphereInfo*	info;
+
+		explicit TestSphere(uint32_t subdivideCount)
+			: info(QuadSphereGenerator::CreateQuadSphere(300.0f, 300.0f, 300.0f, subdivideCount, nullptr))
+		{
+		}
+
+		~TestSphere()
+		{
+			for (const FaceTree* faceTree : info->faceTrees)
+				delete faceTree;
+			delete info;
+		}
+	};
+
+	BoundingSphere GetSceneBounds()
+	{
+		return BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 160.0f);
+	}
+
+	// Camera circling sphere while coming closer, looking at its center, under a turning light.
+	CameraPath CreateOrbitPath(uint32_t frameCount)
+	{
+		CameraPath path;
+		for (uint32_t f = 0; f < frameCount; f++)
+		{
+			const float t = static_cast<float>(f) / static_cast<float>(frameCount);
+			const float angle = 1.5f * t;
+			const float distance = 500.0f - 300.0f * t;
+
+			CameraFrame frame = {};
+			frame.position = XMFLOAT3(-distance * sinf(angle), 0.2f * distance, -distance * cosf(angle));
+			frame.yaw = angle;
+			frame.pitch = 0.2f;
+			frame.lightDirection = XMFLOAT3(cosf(3.0f + t), 0.0f, -sinf(3.0f + t));
+			path.Add(frame);
+		}
+
+		return path;
+	}
+}
+
+// Culled ranges reach the backend as they are: every slot of argument buffer matches culling, and the
+// backend draws exactly the index count culling reports, with only changed slots copied.
+TEST_CASE(HeadlessReplaySubmitsCulledRanges)
+{
+	const TestSphere sphere(7);
+	WorkerPool workerPool(4);
+	RecordingBackend backend(true);
+	HeadlessReplay replay(sphere.info->faceTrees, workerPool, backend, c_aspectRatio, GetSceneBounds());
+
+	const uint32_t slotCount = replay.GetCuller().GetSlotCount();
+	const uint64_t passSize = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * slotCount;
+	CHECK(slotCount > 0);
+
+	const CameraPath path = CreateOrbitPath(60);
+	std::vector<D3D12_DRAW_INDEXED_ARGUMENTS> expected(slotCount);
+	uint64_t copyBytes = 0;
+	uint32_t mismatchCount = 0;
+
+	for (uint32_t simd = 0; simd < 2; simd++)
+	{
+		const SceneCullOptions options = { simd == 1, true, true, true, 4 };
+		for (uint32_t f = 0; f < path.GetFrameCount(); f++)
+		{
+			backend.Clear();
+			const uint64_t uploadedBytes = replay.GetUploadedBytes();
+			const ReplayFrameStats stats = replay.RunFrame(path.GetFrame(f), options);
+
+			// Camera sees part of sphere. Light volume encloses it, so only horizon culling leaves its far side.
+			const uint64_t totalIndexCount = sphere.info->indices.size();
+			CHECK(stats.indexCount > 0 && stats.indexCount < totalIndexCount);
+			CHECK(stats.shadowIndexCount > 0 && stats.shadowIndexCount <= totalIndexCount);
+			CHECK(!options.simd || stats.shadowIndexCount < totalIndexCount);
+
+			// Backend drew what culling found, and copied what replay uploaded.
+			const RecordingStats& recorded = backend.GetStats();
+			CHECK(recorded.indexCount == stats.indexCount + stats.shadowIndexCount);
+			CHECK(recorded.drawCount == stats.drawCount + replay.GetCuller().GetDrawCount(CULL_VIEW_LIGHT));
+			CHECK(recorded.copyBytes == replay.GetUploadedBytes() - uploadedBytes);
+			CHECK(recorded.copyBytes <= CULL_VIEW_COUNT * passSize);
+			CHECK(recorded.indirectCallCount == CULL_VIEW_COUNT);
+			CHECK(recorded.presentCount == 1);
+			copyBytes += recorded.copyBytes;
+
+			// Per view: copies inside one barrier pair if anything changed, then draw of whole buffer.
+			const std::vector<RecordedCommand>& commands = backend.GetCommands();
+			uint32_t view = 0;
+			size_t c = 0;
+			while (c < commands.size() && view < CULL_VIEW_COUNT)
+			{
+				if (commands[c].type == RecordedCommandType::BARRIER)
+				{
+					CHECK(commands[c].after == BufferState::COPY_DEST);
+					for (c++; c < commands.size() && commands[c].type == RecordedCommandType::COPY; c++)
+						;
+					CHECK(c < commands.size() && commands[c].type == RecordedCommandType::BARRIER);
+					CHECK(c < commands.size() && commands[c].after == BufferState::INDIRECT_ARGUMENT);
+					c++;
+				}
+
+				CHECK(c < commands.size() && commands[c].type == RecordedCommandType::DRAW_INDEXED_INDIRECT);
+				if (c == commands.size())
+					break;
+				CHECK(commands[c].drawCount == slotCount);
+
+				std::fill(expected.begin(), expected.end(), D3D12_DRAW_INDEXED_ARGUMENTS{});
+				replay.GetCuller().WriteDrawSlots(static_cast<CullView>(view), expected.data());
+				mismatchCount += memcmp(backend.GetData(commands[c].buffer), expected.data(), passSize) == 0 ? 0 : 1;
+
+				view++;
+				c++;
+			}
+			CHECK(view == CULL_VIEW_COUNT);
+			CHECK(c + 1 == commands.size() && commands.back().type == RecordedCommandType::PRESENT);
+		}
+	}
+
+	CHECK(mismatchCount == 0);
+
+	// Moving camera changes some slots each frame, far fewer than whole buffers.
+	CHECK(copyBytes > 0);
+	CHECK(copyBytes < 2 * path.GetFrameCount() * CULL_VIEW_COUNT * passSize / 4);
+}
+
+// Without shadow pass, light view is neither culled nor drawn.
+TEST_CASE(HeadlessReplaySkipsShadowPass)
+{
+	const TestSphere sphere(7);
+	WorkerPool workerPool(2);
+	RecordingBackend backend(false);
+	HeadlessReplay replay(sphere.info->faceTrees, workerPool, backend, c_aspectRatio, GetSceneBounds());
+
+	const SceneCullOptions options = { true, true, true, false, 2 };
+	const ReplayFrameStats stats = replay.RunFrame(CreateOrbitPath(1).GetFrame(0), options);
+
+	CHECK(stats.shadowIndexCount == 0 && stats.shadowCulledQuadCount == 0);
+	CHECK(backend.GetStats().indirectCallCount == 1);
+	CHECK(backend.GetStats().indexCount == stats.indexCount);
+}
+
+// Frame loop of every culling mode allocates nothing once warmed up, which is what replay runner fails on.
+TEST_CASE(HeadlessReplayDoesNotAllocateAfterWarmUp)
+{
+	// Counter sees allocations of this process, so zero below means none happened.
+	const AllocationCount before = AllocationCounter::GetCount();
+	std::vector<uint8_t> probe(64);
+	CHECK((AllocationCounter::GetCount() - before).count == 1);
+
+	const TestSphere sphere(7);
+	WorkerPool workerPool(4);
+	RecordingBackend backend(false);
+	HeadlessReplay replay(sphere.info->faceTrees, workerPool, backend, c_aspectRatio, GetSceneBounds());
+
+	const CameraPath path = CreateOrbitPath(ReplayReport::c_warmUpFrameCount + 90);
+	const SceneCullOptions optionSets[] =
+	{
+		{ true, true, true, true, 4 },
+		{ true, false, false, true, 4 },
+		{ true, true, true, true, 1 },
+		{ false, false, false, true, 1 },
+	};
+
+	ReplayReport report;
+	for (const SceneCullOptions& options : optionSets)
+	{
+		replay.Run(path, options, report);
+		CHECK(report.GetFrameCount() == path.GetFrameCount());
+		CHECK(report.GetSteadyStateAllocationCount() == 0);
+	}
+}
+
+// Dirty runs of a recorded path, applied to last frame's slots, rebuild this frame's slots exactly.
+// Merged runs upload more than the changed slots alone, but far less than whole slot arrays.
+TEST_CASE(DrawArgumentRunsRebuildSlotsOfRecordedPath)
+{
+	const wchar_t* pathFileName = L"DrawArgumentRunsTest.path";
+	CHECK(CreateOrbitPath(120).Save(pathFileName));
+	CameraPath path;
+	CHECK(path.Load(pathFileName));
+	DeleteFileW(pathFileName);
+	CHECK(path.GetFrameCount() == 120);
+
+	const TestSphere sphere(7);
+	WorkerPool workerPool(4);
+	SceneCuller culler(sphere.info->faceTrees, workerPool);
+
+	const uint32_t slotCount = culler.GetSlotCount();
+	const uint32_t mergeGap = 4;
+	std::vector<D3D12_DRAW_INDEXED_ARGUMENTS> uploaded[CULL_VIEW_COUNT];
+	for (auto& slots : uploaded)
+		slots.assign(slotCount, {});
+	std::vector<D3D12_DRAW_INDEXED_ARGUMENTS> next(slotCount);
+	std::vector<SlotRun> runs;
+
+	uint64_t runBytes = 0;
+	uint64_t dirtyBytes = 0;
+	uint32_t mismatchCount = 0;
+	uint32_t badRunCount = 0;
+	for (uint32_t f = 0; f < path.GetFrameCount(); f++)
+	{
+		const SceneView view = SceneView::Create(path.GetFrame(f), c_aspectRatio, GetSceneBounds());
+		culler.Cull(view, { true, true, true, true, 4 });
+
+		for (uint32_t v = 0; v < CULL_VIEW_COUNT; v++)
+		{
+			std::fill(next.begin(), next.end(), D3D12_DRAW_INDEXED_ARGUMENTS{});
+			for (const FaceTree* faceTree : sphere.info->faceTrees)
+				faceTree->WriteDrawSlots(static_cast<CullView>(v), next.data());
+
+			std::vector<D3D12_DRAW_INDEXED_ARGUMENTS>& slots = uploaded[v];
+			for (uint32_t s = 0; s < slotCount; s++)
+				dirtyBytes += memcmp(&slots[s], &next[s], sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)) == 0 ? 0 : sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+
+			// Runs are in order, apart by more than merge gap, and start and end on changed slots.
+			DrawArgumentBuffer::FindDirtyRuns(slots.data(), next.data(), slotCount, mergeGap, runs);
+			for (size_t r = 0; r < runs.size(); r++)
+			{
+				const SlotRun& run = runs[r];
+				const uint32_t last = run.first + run.count - 1;
+				badRunCount += run.count > 0 && last < slotCount &&
+					(r == 0 || runs[r - 1].first + runs[r - 1].count + mergeGap < run.first) &&
+					memcmp(&slots[run.first], &next[run.first], sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)) != 0 &&
+					memcmp(&slots[last], &next[last], sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)) != 0 ? 0 : 1;
+			}
+
+			for (const SlotRun& run : runs)
+			{
+				memcpy(&slots[run.first], &next[run.first], sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * run.count);
+				runBytes += sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * run.count;
+			}
+			mismatchCount += memcmp(slots.data(), next.data(), sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * slotCount) == 0 ? 0 : 1;
+		}
+	}
+
+	CHECK(mismatchCount == 0);
+	CHECK(badRunCount == 0);
+
+	const uint64_t passSize = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) * slotCount;
+	const uint64_t frameCount = path.GetFrameCount();
+	printf("  %llu bytes per frame in runs, %llu in changed slots, %llu in whole slot arrays\n",
+		runBytes / frameCount, dirtyBytes / frameCount, CULL_VIEW_COUNT * passSize);
+	CHECK(dirtyBytes > 0 && dirtyBytes <= runBytes);
+	CHECK(runBytes < frameCount * CULL_VIEW_COUNT * passSize / 4);
+}
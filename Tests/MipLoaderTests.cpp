@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MipLoader.h"
+#include "SimulatedMipSource.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	// Four maps as Apollo loads them: 1024x1024 RGBA, drawn first at 128x128.
+	constexpr uint32_t c_textureCount = 4;
+	constexpr uint32_t c_mipCount = 11;
+	constexpr uint32_t c_initialSize = 128;
+	constexpr uint32_t c_initialMip = 3;
+
+	TileLayout CreateLayout()
+	{
+		TileLayout layout;
+		layout.Create(DXGI_FORMAT_R8G8B8A8_UNORM, 1024, 1024, c_mipCount);
+		return layout;
+	}
+}
+
+TEST_CASE(MipLoaderMakesCoarseMipsResidentFirst)
+{
+	const TileLayout layout = CreateLayout();
+
+	MipLoader loader(64 * 1024, 4);
+	for (uint32_t t = 0; t < c_textureCount; t++)
+		CHECK(loader.AddTexture(std::make_unique<SimulatedMipSource>(layout, t, std::chrono::microseconds(50)), c_initialSize) == t);
+	for (uint32_t t = 0; t < c_textureCount; t++)
+		CHECK(loader.GetInitialMip(t) == c_initialMip && loader.GetResidentMip(t) == c_initialMip);
+
+	loader.Start();
+
+	std::vector<MipUpload> updates;
+	uint32_t lastMip = c_initialMip;
+	uint32_t orderErrorCount = 0;
+	uint32_t dataErrorCount = 0;
+	uint32_t residentMips[c_textureCount] = { c_initialMip, c_initialMip, c_initialMip, c_initialMip };
+	for (uint32_t frame = 0; frame < 20000 && !loader.IsComplete(); frame++)
+	{
+		const uint32_t dirtyMask = loader.Update(2, updates);
+		CHECK(frame > 0 || dirtyMask == (1u << c_textureCount) - 1);
+
+		// Chunks come coarsest mip of any texture first, so no texture gets finer than others by more than a mip.
+		for (const MipUpload& upload : updates)
+		{
+			orderErrorCount += upload.mip <= lastMip ? 0 : 1;
+			lastMip = upload.mip;
+			dataErrorCount += SimulatedMipSource::CheckRows(layout, upload.texture, upload.mip, upload.firstRow, upload.rowCount, upload.data) ? 0 : 1;
+		}
+
+		for (uint32_t t = 0; t < c_textureCount; t++)
+		{
+			const uint32_t residentMip = loader.GetResidentMip(t);
+			orderErrorCount += residentMip <= residentMips[t] ? 0 : 1;
+			orderErrorCount += ((dirtyMask >> t) & 1) == (residentMip != residentMips[t] || frame == 0) ? 0 : 1;
+			residentMips[t] = residentMip;
+		}
+		for (uint32_t t = 0; t < c_textureCount; t++)
+		{
+			for (uint32_t u = 0; u < c_textureCount; u++)
+				orderErrorCount += residentMips[t] + 1 >= residentMips[u] ? 0 : 1;
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	loader.Stop();
+
+	CHECK(orderErrorCount == 0);
+	CHECK(dataErrorCount == 0);
+	CHECK(loader.IsComplete());
+	CHECK(lastMip == 0);
+
+	const MipLoaderStats stats = loader.GetStats();
+	CHECK(stats.loadedSize == stats.totalSize);
+	CHECK(stats.failedTextureCount == 0);
+	for (uint32_t t = 0; t < c_textureCount; t++)
+		CHECK(loader.GetResidentMip(t) == 0);
+}
+
+TEST_CASE(MipLoaderFirstFrameIsBounded)
+{
+	const TileLayout layout = CreateLayout();
+	const uint32_t chunkSize = 64 * 1024;
+	const uint32_t maxUploads = 2;
+
+	MipLoader loader(chunkSize, 4);
+	std::vector<SimulatedMipSource*> sources;
+	for (uint32_t t = 0; t < c_textureCount; t++)
+	{
+		auto source = std::make_unique<SimulatedMipSource>(layout, t);
+		sources.push_back(source.get());
+		loader.AddTexture(std::move(source), c_initialSize);
+	}
+
+	// What CreateProgressiveTextures waits for: initial mips, one read each, finest first.
+	std::vector<uint8_t> data;
+	for (uint32_t t = 0; t < c_textureCount; t++)
+	{
+		CHECK(loader.ReadInitialMips(t, data));
+
+		const uint8_t* mipData = data.data();
+		for (uint32_t mip = c_initialMip; mip < c_mipCount; mip++)
+		{
+			CHECK(SimulatedMipSource::CheckRows(layout, t, mip, 0, layout.GetRowCount(mip), mipData));
+			mipData += MipLoader::GetMipSize(layout, mip);
+		}
+		CHECK(mipData == data.data() + data.size());
+		CHECK(sources[t]->GetReadCount() == c_mipCount - c_initialMip);
+	}
+
+	// Chunk reads of finer mips loader thread makes after Start, rows aligned as MipLoader aligns them.
+	uint64_t chunkCount = 0;
+	for (uint32_t mip = 0; mip < c_initialMip; mip++)
+	{
+		const uint32_t alignedPitch =
+			(layout.GetRowPitch(mip) + MIP_LOADER_PITCH_ALIGNMENT - 1) / MIP_LOADER_PITCH_ALIGNMENT * MIP_LOADER_PITCH_ALIGNMENT;
+		const uint32_t chunkRows = std::max(chunkSize / alignedPitch, 1u);
+		chunkCount += (layout.GetRowCount(mip) + chunkRows - 1) / chunkRows;
+	}
+	chunkCount *= c_textureCount;
+
+	// First frame needs only initial reads, a small part of whole maps, and gets no finer mip yet.
+	const uint64_t initialReadCount = c_textureCount * (c_mipCount - c_initialMip);
+	CHECK(initialReadCount * 4 < initialReadCount + chunkCount);
+
+	loader.Start();
+	std::vector<MipUpload> updates;
+	CHECK(loader.Update(maxUploads, updates) == (1u << c_textureCount) - 1);
+	CHECK(updates.size() <= maxUploads);
+	for (uint32_t t = 0; t < c_textureCount; t++)
+		CHECK(loader.GetResidentMip(t) == c_initialMip);
+
+	// Every frame hands out at most its budget while finer mips stream in, each chunk read once.
+	uint64_t frameCount = 1;
+	uint64_t uploadCount = updates.size();
+	uint32_t overBudgetCount = 0;
+	while (!loader.IsComplete() && frameCount < 10000000)
+	{
+		loader.Update(maxUploads, updates);
+		overBudgetCount += updates.size() <= maxUploads ? 0 : 1;
+		uploadCount += updates.size();
+		frameCount++;
+
+		std::this_thread::yield();
+	}
+	loader.Stop();
+	CHECK(loader.IsComplete());
+	CHECK(overBudgetCount == 0);
+
+	uint64_t readCount = 0;
+	for (const SimulatedMipSource* source : sources)
+		readCount += source->GetReadCount();
+	CHECK(readCount == initialReadCount + chunkCount);
+	CHECK(uploadCount == chunkCount);
+	CHECK(loader.GetStats().uploadedChunkCount == chunkCount);
+	CHECK(frameCount * maxUploads >= chunkCount);
+}
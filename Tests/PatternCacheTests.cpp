@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "PatternCache.h"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+	using Triangle = std::array<uint32_t, 3>;
+
+	// Rotated so smallest point comes first, which keeps winding.
+	Triangle Canonical(uint32_t a, uint32_t b, uint32_t c)
+	{
+		if (b < a && b < c)
+			return { b, c, a };
+		if (c < a && c < b)
+			return { c, a, b };
+		return { a, b, c };
+	}
+
+	uint32_t ToGrid(const DirectX::XMFLOAT2& point)
+	{
+		const auto u = static_cast<uint32_t>(lroundf(point.x * TESS_MAX_FACTOR));
+		const auto v = static_cast<uint32_t>(lroundf(point.y * TESS_MAX_FACTOR));
+		return v * PATTERN_GRID_SIZE + u;
+	}
+}
+
+// Every power of two factor set ConstantHS can give, drawn from patterns, against BuildDomain of the same factors.
+TEST_CASE(PatternCacheMatchesBuildDomain)
+{
+	const PatternCache cache;
+	CHECK(cache.GetStats().patternCount == PatternCache::c_patternCount);
+	CHECK(cache.GetPoints().size() == PATTERN_GRID_SIZE * PATTERN_GRID_SIZE);
+
+	QuadDomain domain;
+	PatchPatterns patterns;
+	std::vector<Triangle> expected;
+	std::vector<Triangle> actual;
+	uint32_t factorSetCount = 0;
+	uint32_t mismatchCount = 0;
+	uint32_t offGridCount = 0;
+
+	constexpr uint32_t n = PATTERN_EXPONENT_COUNT;
+	for (uint32_t set = 0; set < n * n * n * n * n; set++)
+	{
+		PatchTessFactors factors;
+		uint32_t digits = set;
+		for (float& edge : factors.edgeTess)
+		{
+			edge = static_cast<float>(1u << (digits % n));
+			digits /= n;
+		}
+		factors.insideTess[0] = factors.insideTess[1] = static_cast<float>(1u << digits);
+
+		Tessellator::BuildDomain(TessFactor::PartitionInteger(factors), domain);
+		expected.clear();
+		for (size_t i = 0; i < domain.indices.size(); i += 3)
+		{
+			const uint32_t a = ToGrid(domain.points[domain.indices[i]]);
+			const uint32_t b = ToGrid(domain.points[domain.indices[i + 1]]);
+			const uint32_t c = ToGrid(domain.points[domain.indices[i + 2]]);
+			expected.push_back(Canonical(a, b, c));
+		}
+		for (const DirectX::XMFLOAT2& point : domain.points)
+		{
+			const DirectX::XMFLOAT2& gridPoint = cache.GetPoints()[ToGrid(point)];
+			offGridCount += gridPoint.x == point.x && gridPoint.y == point.y ? 0 : 1;
+		}
+
+		PatternCache::SelectPatterns(static_cast<float>(n - 1), factors, 0, patterns);
+		CHECK(patterns.count > 0 && patterns.count <= PATTERN_MAX_PER_PATCH);
+		actual.clear();
+		for (uint32_t p = 0; p < patterns.count; p++)
+		{
+			const PatternRange& range = cache.GetPattern(patterns.patterns[p]);
+			const std::vector<uint16_t>& indices = cache.GetIndices();
+			for (uint32_t i = range.startIndex; i < range.startIndex + range.indexCount; i += 3)
+				actual.push_back(Canonical(indices[i], indices[i + 1], indices[i + 2]));
+		}
+
+		std::sort(expected.begin(), expected.end());
+		std::sort(actual.begin(), actual.end());
+		mismatchCount += expected == actual ? 0 : 1;
+		factorSetCount++;
+	}
+
+	CHECK(factorSetCount == 16807);
+	CHECK(mismatchCount == 0);
+	CHECK(offGridCount == 0);
+}
+
+TEST_CASE(PatternCacheSelectsUniformPattern)
+{
+	PatchPatterns patterns;
+
+	// Edges matching inside factor, as inside a tess group.
+	const PatchTessFactors uniform = { { 16.0f, 16.0f, 16.0f, 16.0f }, { 16.0f, 16.0f } };
+	PatternCache::SelectPatterns(6.0f, uniform, 42, patterns);
+	CHECK(patterns.count == 1);
+	CHECK(patterns.patterns[0] == PatternCache::UniformPattern(4));
+	CHECK((patterns.instances[0] & (PATTERN_MAX_PATCH_COUNT - 1)) == 42);
+
+	const PatchTessFactors quad = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } };
+	PatternCache::SelectPatterns(6.0f, quad, 0, patterns);
+	CHECK(patterns.count == 1);
+	CHECK(patterns.patterns[0] == PatternCache::c_quadPattern);
+
+	// Inside factor 2 has no inner grid, only four strips.
+	const PatchTessFactors split = { { 1.0f, 2.0f, 4.0f, 1.0f }, { 2.0f, 2.0f } };
+	PatternCache::SelectPatterns(6.0f, split, 0, patterns);
+	CHECK(patterns.count == 4);
+	CHECK(patterns.patterns[2] == PatternCache::StripPattern(2, 2, 1));
+}
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RecordingBackend.h"
+#include "UploadRing.h"
+
+namespace
+{
+	// GPU side of ring, which completes submitted frames only when told to.
+	struct FakeFence
+	{
+		uint64_t	submittedValue = 0;
+		uint64_t	completedValue = 0;
+
+		uint64_t Submit() { return ++submittedValue; }
+		void Complete(uint64_t value) { completedValue = value; }
+	};
+}
+
+TEST_CASE(RingAllocatorWrapsAroundEnd)
+{
+	RingAllocator allocator(1024);
+	FakeFence fence;
+
+	// Frame 1 and 2 fill ring up to 768.
+	CHECK(allocator.Allocate(256, 256) == 0);
+	CHECK(allocator.Allocate(256, 256) == 256);
+	allocator.FinishFrame(fence.Submit());
+	CHECK(allocator.Allocate(256, 256) == 512);
+	allocator.FinishFrame(fence.Submit());
+
+	// Frame 3 doesn't fit in the 256 bytes left before end, so end is skipped and it needs frame 1 back.
+	CHECK(allocator.Allocate(300, 4) == RingAllocator::c_invalidOffset);
+
+	fence.Complete(1);
+	allocator.Retire(fence.completedValue);
+	CHECK(allocator.GetUsedSize() == 256);
+	CHECK(allocator.Allocate(300, 4) == 0);
+	CHECK(allocator.GetUsedSize() == 256 + 256 + 300);
+	allocator.FinishFrame(fence.Submit());
+
+	// Aligned start after wrapped allocation.
+	fence.Complete(2);
+	allocator.Retire(fence.completedValue);
+	CHECK(allocator.Allocate(16, 256) == 512);
+}
+
+TEST_CASE(RingAllocatorBlocksUntilFenceCompletes)
+{
+	RingAllocator allocator(1024);
+	FakeFence fence;
+
+	// Four frames in flight fill whole ring.
+	for (uint32_t frame = 0; frame < 4; frame++)
+	{
+		CHECK(allocator.Allocate(256, 256) == frame * 256);
+		allocator.FinishFrame(fence.Submit());
+	}
+	CHECK(allocator.GetUsedSize() == 1024);
+
+	// Nothing fits, however often it is retried, until GPU passes a frame.
+	for (int retry = 0; retry < 3; retry++)
+	{
+		allocator.Retire(fence.completedValue);
+		CHECK(allocator.Allocate(1, 1) == RingAllocator::c_invalidOffset);
+	}
+
+	// Frames complete in order, and each one frees exactly its own space.
+	fence.Complete(2);
+	allocator.Retire(fence.completedValue);
+	CHECK(allocator.GetUsedSize() == 512);
+	CHECK(allocator.Allocate(512, 256) == 0);
+	CHECK(allocator.Allocate(1, 1) == RingAllocator::c_invalidOffset);
+
+	// Larger than ring never fits, empty allocation is rejected too.
+	CHECK(allocator.Allocate(2048, 256) == RingAllocator::c_invalidOffset);
+	CHECK(allocator.Allocate(0, 256) == RingAllocator::c_invalidOffset);
+}
+
+TEST_CASE(RingAllocatorReusesRetiredSpace)
+{
+	RingAllocator allocator(4096);
+	FakeFence fence;
+
+	// Steady state of three frames in flight, each allocating the same sizes.
+	// Once warmed up, frame n reuses exactly the space of frame n - 3.
+	constexpr uint32_t framesInFlight = 3;
+	std::vector<uint64_t> offsets;
+	for (uint32_t frame = 0; frame < 64; frame++)
+	{
+		if (fence.submittedValue >= framesInFlight)
+			fence.Complete(fence.submittedValue - framesInFlight + 1);
+		allocator.Retire(fence.completedValue);
+
+		const uint64_t first = allocator.Allocate(200, 256);
+		const uint64_t second = allocator.Allocate(600, 256);
+		CHECK(first != RingAllocator::c_invalidOffset);
+		CHECK(second != RingAllocator::c_invalidOffset);
+		CHECK(first % 256 == 0 && second % 256 == 0);
+		CHECK(first + 200 <= 4096 && second + 600 <= 4096);
+
+		offsets.push_back(first);
+		allocator.FinishFrame(fence.Submit());
+
+		CHECK(allocator.GetUsedSize() <= allocator.GetSize());
+	}
+
+	// Everything comes back once GPU is idle.
+	fence.Complete(fence.submittedValue);
+	allocator.Retire(fence.completedValue);
+	CHECK(allocator.GetUsedSize() == 0);
+
+	// Space of retired frames is handed out again rather than always growing into fresh space.
+	CHECK(std::count(offsets.begin(), offsets.end(), offsets[0]) > 1);
+}
+
+TEST_CASE(UploadRingThrowsWhenFull)
+{
+	RecordingBackend backend(false);
+	FakeFence fence;
+
+	{
+		UploadRing ring(backend, 512);
+
+		ring.BeginFrame(fence.completedValue);
+		const auto allocation = ring.Allocate(512, 256);
+		CHECK(allocation.offset == 0);
+		CHECK(allocation.cpuAddress == backend.GetMappedData(allocation.buffer));
+		ring.EndFrame(fence.Submit());
+
+		bool thrown = false;
+		ring.BeginFrame(fence.completedValue);
+		try
+		{
+			ring.Allocate(256, 256);
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		CHECK(thrown);
+
+		fence.Complete(1);
+		ring.BeginFrame(fence.completedValue);
+		CHECK(ring.Allocate(256, 256).offset == 0);
+	}
+
+	// Ring buffer is released with ring.
+	CHECK(backend.GetStats().bufferBytes == 0);
+}
@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "QuadSphereGenerator.h"
+#include "TessFactor.h"
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Largest distance of factor exponent from an integer step at which batch and scalar port may truncate
+	// to different steps. XMVectorLog2 and XMVectorExp2 are polynomial fits a few ulps off log2f and exp2f,
+	// and an ulp of exponent (at most max tess exponent 8) is about 1e-6.
+	constexpr float c_exponentTolerance = 1e-4f;
+
+	struct TestSphere
+	{
+		QuadSphereGenerator::QuadSphereInfo*	info;
+
+		explicit TestSphere(uint32_t subdivideCount)
+			: info(QuadSphereGenerator::CreateQuadSphere(300.0f, 300.0f, 300.0f, subdivideCount, nullptr))
+		{
+		}
+
+		~TestSphere()
+		{
+			for (const FaceTree* faceTree : info->faceTrees)
+				delete faceTree;
+			delete info;
+		}
+	};
+
+	// Same values as Apollo's GetTessParameters for a sphere of subdivideCount.
+	TessParameters CreateParameters(uint32_t subdivideCount, float tessMax, IN const XMFLOAT3& cameraPosition)
+	{
+		TessParameters params = {};
+		params.cameraPosition = cameraPosition;
+		params.parameters = XMFLOAT4(
+			300.0f / powf(2.0f, TESS_GROUP_QUAD_LEVEL), powf(2.0f, static_cast<float>(subdivideCount - TESS_GROUP_QUAD_LEVEL)),
+			0.0f, tessMax);
+		return params;
+	}
+
+	// Cameras from far away down to just above surface, spread over sphere (golden angle spiral).
+	std::vector<XMFLOAT3> CreateCameraPositions(uint32_t count)
+	{
+		std::vector<XMFLOAT3> positions;
+		for (uint32_t c = 0; c < count; c++)
+		{
+			const float y = 1.0f - 2.0f * (c + 0.5f) / count;
+			const float ring = sqrtf(1.0f - y * y);
+			const float angle = c * XM_PI * (3.0f - sqrtf(5.0f));
+			const float distance = SPHERE_RADIUS + 1.0f + 300.0f * c / count;
+			positions.emplace_back(cosf(angle) * ring * distance, y * distance, sinf(angle) * ring * distance);
+		}
+
+		return positions;
+	}
+
+	// CalcTessFactor of Shader.hlsli in plain float operations, and exponent before (int) cast.
+	float CalcScalarTessFactor(IN const TessParameters& params, IN const XMFLOAT3& planePos, OUT float& exponent)
+	{
+		const float length = sqrtf(planePos.x * planePos.x + planePos.y * planePos.y + planePos.z * planePos.z);
+		const float dx = planePos.x / length * SPHERE_RADIUS - params.cameraPosition.x;
+		const float dy = planePos.y / length * SPHERE_RADIUS - params.cameraPosition.y;
+		const float dz = planePos.z / length * SPHERE_RADIUS - params.cameraPosition.z;
+
+		const float d = sqrtf(dx * dx + dy * dy + dz * dz);
+		const float s = std::min(std::max((d - TESS_NEAR_DISTANCE) / (TESS_FAR_DISTANCE - TESS_NEAR_DISTANCE), 0.0f), 1.0f);
+
+		const float w = params.parameters.w;
+		exponent = -w * powf(s, 0.8f) + w;
+		return ldexpf(1.0f, static_cast<int>(exponent));
+	}
+
+	float GetStepDistance(float exponent)
+	{
+		return fabsf(exponent - roundf(exponent));
+	}
+}
+
+// Batch factors are the scalar port's, except where exponent is within tolerance of an integer step,
+// and then only one step apart.
+TEST_CASE(TessFactorBatchMatchesScalarPort)
+{
+	std::mt19937 random(19);
+	std::uniform_real_distribution<float> coordinate(-150.0f, 150.0f);
+	std::uniform_int_distribution<uint32_t> axis(0, 5);
+
+	uint32_t sampleCount = 0;
+	uint32_t mismatchCount = 0;
+	uint32_t badMismatchCount = 0;
+	for (const XMFLOAT3& cameraPosition : CreateCameraPositions(16))
+	{
+		for (float tessMax = 4.0f; tessMax <= 8.0f; tessMax += 2.0f)
+		{
+			const TessParameters params = CreateParameters(7, tessMax, cameraPosition);
+			for (uint32_t batch = 0; batch < 256; batch++)
+			{
+				// Four points on cube faces, one lane each.
+				XMFLOAT3 points[4];
+				for (XMFLOAT3& point : points)
+				{
+					const uint32_t face = axis(random);
+					const float side = face & 1 ? 150.0f : -150.0f;
+					const float a = coordinate(random);
+					const float b = coordinate(random);
+					point = face < 2 ? XMFLOAT3(side, a, b) : face < 4 ? XMFLOAT3(a, side, b) : XMFLOAT3(a, b, side);
+				}
+
+				XMFLOAT4 factors;
+				XMStoreFloat4(&factors, TessFactor::CalcTessFactorBatch(
+					params,
+					XMVectorSet(points[0].x, points[1].x, points[2].x, points[3].x),
+					XMVectorSet(points[0].y, points[1].y, points[2].y, points[3].y),
+					XMVectorSet(points[0].z, points[1].z, points[2].z, points[3].z)));
+				const float lanes[4] = { factors.x, factors.y, factors.z, factors.w };
+
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					float exponent;
+					const float expected = CalcScalarTessFactor(params, points[lane], exponent);
+					sampleCount++;
+					if (lanes[lane] == expected)
+						continue;
+
+					mismatchCount++;
+					if (GetStepDistance(exponent) > c_exponentTolerance || (lanes[lane] != 2.0f * expected && 2.0f * lanes[lane] != expected))
+						badMismatchCount++;
+				}
+			}
+		}
+	}
+
+	CHECK(sampleCount == 16 * 3 * 256 * 4);
+	CHECK(badMismatchCount == 0);
+	CHECK(mismatchCount * 1000 < sampleCount);
+
+	// Scalar entry point goes through batch.
+	const TessParameters params = CreateParameters(7, 8.0f, XMFLOAT3(0.0f, 0.0f, -200.0f));
+	const XMFLOAT3 point(20.0f, -40.0f, -150.0f);
+	CHECK(TessFactor::CalcTessFactor(params, point) ==
+		XMVectorGetX(TessFactor::CalcTessFactorBatch(params, XMVectorReplicate(point.x), XMVectorReplicate(point.y), XMVectorReplicate(point.z))));
+}
+
+// Both patches of every edge of generated sphere give it the same factor, so tessellated surface has no
+// cracks, for camera and light parameters and from far away down to surface.
+TEST_CASE(TessFactorSharedEdgesMatch)
+{
+	for (uint32_t subdivideCount = 6; subdivideCount <= 7; subdivideCount++)
+	{
+		const TestSphere sphere(subdivideCount);
+		const VertexTess* vertices = sphere.info->vertices.data();
+		const uint32_t* indices = sphere.info->indices.data();
+		const auto indexCount = static_cast<uint32_t>(sphere.info->indices.size());
+		const uint32_t edgeCount = 2 * indexCount / 4;
+
+		for (const XMFLOAT3& cameraPosition : CreateCameraPositions(8))
+		{
+			for (float tessMax = 6.0f; tessMax <= 8.0f; tessMax += 2.0f)
+			{
+				const TessParameters params = CreateParameters(subdivideCount, tessMax, cameraPosition);
+				const TessEdgeCheck check = TessFactor::CheckSharedEdges(params, vertices, indices, indexCount);
+
+				CHECK(check.sharedEdgeCount == edgeCount);
+				CHECK(check.mismatchCount == 0);
+				CHECK(check.unmatchedCount == 0);
+			}
+		}
+	}
+}
@@ -0,0 +1,170 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "Tessellator.h"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+	using Point = std::pair<float, float>;
+	using Triangle = std::array<Point, 3>;
+
+	std::vector<Point> GetPoints(IN const QuadDomain& domain)
+	{
+		std::vector<Point> points;
+		for (const DirectX::XMFLOAT2& point : domain.points)
+			points.emplace_back(point.x, point.y);
+		std::sort(points.begin(), points.end());
+		return points;
+	}
+
+	// Domain points D3D11 emits for integer partitioning: corners, k / factor along each edge
+	// and (i / insideU, j / insideV) inside, with no point twice.
+	std::vector<Point> GetD3D11Points(IN const IntegerTessFactors& factors)
+	{
+		std::vector<Point> points = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+		if (!factors.IsQuad())
+		{
+			for (uint32_t e = 0; e < 4; e++)
+			{
+				const uint32_t count = factors.edgeTess[e];
+				for (uint32_t k = 1; k < count; k++)
+				{
+					const float t = static_cast<float>(k) / static_cast<float>(count);
+					const float fixed = e == 0 || e == 1 ? 0.0f : 1.0f;
+					points.push_back(e == 0 || e == 2 ? Point(fixed, t) : Point(t, fixed));
+				}
+			}
+			for (uint32_t j = 1; j < factors.insideTess[1]; j++)
+			{
+				for (uint32_t i = 1; i < factors.insideTess[0]; i++)
+					points.emplace_back(static_cast<float>(i) / factors.insideTess[0], static_cast<float>(j) / factors.insideTess[1]);
+			}
+		}
+		std::sort(points.begin(), points.end());
+		return points;
+	}
+
+	float GetArea(const Point& a, const Point& b, const Point& c)
+	{
+		return 0.5f * ((b.first - a.first) * (c.second - a.second) - (b.second - a.second) * (c.first - a.first));
+	}
+
+	// Triangles as point triples, rotated so smallest point comes first, which keeps winding.
+	std::vector<Triangle> GetTriangles(IN const QuadDomain& domain)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i < domain.indices.size(); i += 3)
+		{
+			Triangle triangle;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const DirectX::XMFLOAT2& point = domain.points[domain.indices[i + k]];
+				triangle[k] = Point(point.x, point.y);
+			}
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	struct KnownOutput
+	{
+		IntegerTessFactors	factors;
+		uint32_t			pointCount;		// DS invocations of one patch
+		uint32_t			triangleCount;	// Primitives out of tessellator
+	};
+
+	// Counts of D3D11 quad domain with integer partitioning. Edge factors are in order of PatchTessFactors.
+	// Triangles of n points with h on patch border are 2n - h - 2 however they are split.
+	const KnownOutput c_knownOutputs[] =
+	{
+		{ { { 1, 1, 1, 1 }, { 1, 1 } }, 4, 2 },
+		{ { { 1, 1, 1, 1 }, { 2, 2 } }, 5, 4 },
+		{ { { 2, 2, 2, 2 }, { 2, 2 } }, 9, 8 },
+		{ { { 4, 4, 4, 4 }, { 4, 4 } }, 25, 32 },
+		{ { { 64, 64, 64, 64 }, { 64, 64 } }, 4225, 8192 },
+		{ { { 1, 2, 4, 8 }, { 8, 8 } }, 64, 111 },
+		{ { { 64, 1, 1, 1 }, { 2, 2 } }, 68, 67 },
+		{ { { 3, 5, 7, 2 }, { 4, 6 } }, 32, 45 },
+		{ { { 16, 8, 16, 8 }, { 32, 4 } }, 141, 232 },
+	};
+}
+
+TEST_CASE(TessellatorMatchesD3D11Points)
+{
+	QuadDomain domain;
+	for (const KnownOutput& known : c_knownOutputs)
+	{
+		Tessellator::BuildDomain(known.factors, domain);
+
+		// Same point set as D3D11, so vertices on patch edges meet those of neighbours.
+		const std::vector<Point> points = GetPoints(domain);
+		CHECK(points == GetD3D11Points(known.factors));
+		CHECK(points.size() == known.pointCount);
+		CHECK(std::adjacent_find(points.begin(), points.end()) == points.end());
+
+		// Same count, and triangles tile the whole patch with its winding.
+		CHECK(domain.indices.size() == 3 * known.triangleCount);
+
+		PatchTessFactors factors;
+		for (uint32_t e = 0; e < 4; e++)
+			factors.edgeTess[e] = static_cast<float>(known.factors.edgeTess[e]);
+		factors.insideTess[0] = static_cast<float>(known.factors.insideTess[0]);
+		factors.insideTess[1] = static_cast<float>(known.factors.insideTess[1]);
+		CHECK(TessFactor::CalcTriangleCount(factors) == known.triangleCount);
+
+		float area = 0.0f;
+		uint32_t flippedCount = 0;
+		for (const Triangle& triangle : GetTriangles(domain))
+		{
+			const float triangleArea = GetArea(triangle[0], triangle[1], triangle[2]);
+			flippedCount += triangleArea > 0.0f ? 0 : 1;
+			area += triangleArea;
+		}
+		CHECK(flippedCount == 0);
+		CHECK(fabsf(area - 1.0f) < 1e-4f);
+	}
+}
+
+// Inside factor 2 leaves one inner point, which every edge point is joined to, so D3D11 has no choice of diagonal.
+TEST_CASE(TessellatorMatchesD3D11TrianglesOfInsideTwo)
+{
+	const Point center = { 0.5f, 0.5f };
+
+	// Edges 0 to 3 as PatchTessFactors orders them, corners of patch at (0, 0), (1, 0), (0, 1), (1, 1).
+	QuadDomain domain;
+	Tessellator::BuildDomain({ { 1, 2, 3, 1 }, { 2, 2 } }, domain);
+
+	std::vector<Triangle> expected =
+	{
+		{ Point(0.0f, 0.0f), center, Point(0.0f, 1.0f) },
+		{ Point(0.0f, 0.0f), Point(0.5f, 0.0f), center },
+		{ Point(0.5f, 0.0f), Point(1.0f, 0.0f), center },
+		{ Point(1.0f, 0.0f), Point(1.0f, 1.0f / 3.0f), center },
+		{ Point(1.0f, 1.0f / 3.0f), Point(1.0f, 2.0f / 3.0f), center },
+		{ Point(1.0f, 2.0f / 3.0f), Point(1.0f, 1.0f), center },
+		{ Point(0.0f, 1.0f), center, Point(1.0f, 1.0f) },
+	};
+	for (Triangle& triangle : expected)
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+	std::sort(expected.begin(), expected.end());
+
+	CHECK(GetTriangles(domain) == expected);
+
+	// Every edge split joins the same fan.
+	for (uint32_t edge = 1; edge <= 8; edge *= 2)
+	{
+		const IntegerTessFactors factors = { { edge, 1, edge, 1 }, { 2, 2 } };
+		Tessellator::BuildDomain(factors, domain);
+		CHECK(domain.indices.size() == 3 * (2 * edge + 2));
+
+		uint32_t fanCount = 0;
+		for (const Triangle& triangle : GetTriangles(domain))
+			fanCount += std::find(triangle.begin(), triangle.end(), center) != triangle.end() ? 1 : 0;
+		CHECK(fanCount == 2 * edge + 2);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Device-free tests of Common, run by apollo_tests.
+// Every TEST_CASE registers itself, and CHECK reports a failure with its location without stopping the test.
+namespace Test
+{
+	using Function = void (*)();
+
+	bool Register(const char* name, Function function);
+	void Fail(const char* file, int line, const char* expression);
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static const bool name##Registered = Test::Register(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) Test::Fail(__FILE__, __LINE__, #expression); } while (false)
@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "Test.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	struct TestEntry
+	{
+		const char*		name;
+		Test::Function	function;
+	};
+
+	// Filled during static initialization, so it must be constructed on first use.
+	std::vector<TestEntry>& GetTests()
+	{
+		static std::vector<TestEntry> tests;
+		return tests;
+	}
+
+	uint32_t g_failureCount = 0;
+}
+
+bool Test::Register(const char* name, Function function)
+{
+	GetTests().push_back({ name, function });
+	return true;
+}
+
+void Test::Fail(const char* file, int line, const char* expression)
+{
+	printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	g_failureCount++;
+}
+
+// apollo_tests [filter]
+// Runs every test whose name contains filter, and returns the number of failed tests.
+int main(int argc, char* argv[])
+{
+	const char* filter = argc >= 2 ? argv[1] : nullptr;
+
+	int failedTestCount = 0;
+	uint32_t testCount = 0;
+	for (const TestEntry& test : GetTests())
+	{
+		if (filter != nullptr && strstr(test.name, filter) == nullptr)
+			continue;
+
+		const uint32_t failureCount = g_failureCount;
+		try
+		{
+			test.function();
+		}
+		catch (const std::exception&)
+		{
+			Test::Fail(__FILE__, __LINE__, "no exception");
+		}
+
+		const bool passed = g_failureCount == failureCount;
+		printf("[%s] %s\n", passed ? " OK " : "FAIL", test.name);
+
+		failedTestCount += passed ? 0 : 1;
+		testCount++;
+	}
+
+	printf("%u tests, %d failed\n", testCount, failedTestCount);
+	return failedTestCount;
+}
@@ -0,0 +1,251 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SimulatedTileStore.h"
+#include "TileCache.h"
+
+#include <thread>
+
+namespace
+{
+	// 1024x1024 R8: mip 0 is 4x4 tiles, mip 1 2x2, mip 2 one tile, and mip 3 starts tail. 21 tiles.
+	TileLayout CreateLayout()
+	{
+		TileLayout layout;
+		layout.Create(DXGI_FORMAT_R8_UNORM, 1024, 1024, 11);
+		return layout;
+	}
+
+	// Request of left half texture covering its tile (x, y) at mip 0.
+	TileRequest CreateRequest(uint32_t x, uint32_t y)
+	{
+		TileRequest request = {};
+		request.x0 = (x * 256.0f + 64.0f) / 2048.0f;
+		request.x1 = (x * 256.0f + 192.0f) / 2048.0f;
+		request.y0 = (y * 256.0f + 64.0f) / 1024.0f;
+		request.y1 = (y * 256.0f + 192.0f) / 1024.0f;
+		request.texelAngle = 0.001f;
+		return request;
+	}
+
+	// Renderer side, applying updates to its own page table and checking them as it goes.
+	struct PageTable
+	{
+		std::vector<uint32_t>	tiles;			// Of slot, TILE_CACHE_NO_SLOT if free
+		std::vector<uint32_t>	mappedMips;		// In order of maps
+		uint32_t				errorCount = 0;
+
+		explicit PageTable(uint32_t slotCount)
+			: tiles(slotCount, TILE_CACHE_NO_SLOT)
+		{
+		}
+
+		void Apply(const TileLayout& layout, IN const std::vector<TileUpdate>& updates)
+		{
+			uint32_t unmappedSlot = TILE_CACHE_NO_SLOT;
+			for (const TileUpdate& update : updates)
+			{
+				const uint32_t tile = layout.GetTileIndex(update.mip, update.x, update.y);
+				if (update.slot == TILE_CACHE_NO_SLOT)
+				{
+					const auto it = std::find(tiles.begin(), tiles.end(), tile);
+					errorCount += it != tiles.end() && unmappedSlot == TILE_CACHE_NO_SLOT ? 0 : 1;
+					if (it != tiles.end())
+					{
+						unmappedSlot = static_cast<uint32_t>(it - tiles.begin());
+						*it = TILE_CACHE_NO_SLOT;
+					}
+					continue;
+				}
+
+				// Slot is free, or was unmapped right before, and holds data of tile.
+				errorCount += tiles[update.slot] == TILE_CACHE_NO_SLOT ? 0 : 1;
+				errorCount += unmappedSlot == TILE_CACHE_NO_SLOT || unmappedSlot == update.slot ? 0 : 1;
+				errorCount += SimulatedTileStore::CheckTile(update.data, update.texture, tile) ? 0 : 1;
+				tiles[update.slot] = tile;
+				mappedMips.push_back(update.mip);
+				unmappedSlot = TILE_CACHE_NO_SLOT;
+			}
+			errorCount += unmappedSlot == TILE_CACHE_NO_SLOT ? 0 : 1;
+		}
+
+		bool IsMapped(uint32_t tile) const { return std::find(tiles.begin(), tiles.end(), tile) != tiles.end(); }
+	};
+
+	// Update with the same requests until no load is left, or a few seconds passed.
+	void Settle(
+		TileCache& cache, PageTable& pageTable, IN const std::vector<TileRequest>& requests, uint32_t maxUploads, uint64_t& frame)
+	{
+		std::vector<TileUpdate> updates;
+		for (uint32_t i = 0; i < 5000; i++)
+		{
+			cache.Update(frame++, requests.data(), static_cast<uint32_t>(requests.size()), maxUploads, updates);
+			pageTable.Apply(cache.GetLayout(0), updates);
+			if (cache.GetStats().loadingTileCount == 0)
+				return;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+TEST_CASE(TileCacheLoadsCoarseTilesFirst)
+{
+	const TileLayout layout = CreateLayout();
+	CHECK(layout.packedMipStart == 3);
+	CHECK(layout.tileCount == 21);
+
+	auto store = std::make_unique<SimulatedTileStore>(layout, 0, std::chrono::microseconds(200));
+	SimulatedTileStore& storeRef = *store;
+
+	TileCache cache(32);
+	cache.AddTexture(std::move(store), 0);
+	cache.Start();
+
+	// Whole left half of sphere at mip 0, one upload per frame.
+	const std::vector<TileRequest> requests = { { 0.0f, 0.0f, 0.5f, 1.0f, 0.001f } };
+	PageTable pageTable(cache.GetSlotCount());
+	uint64_t frame = 0;
+	Settle(cache, pageTable, requests, 1, frame);
+	cache.Stop();
+
+	CHECK(pageTable.errorCount == 0);
+
+	// Every tile read once, and mapped from coarsest mip to finest.
+	const TileCacheStats stats = cache.GetStats();
+	CHECK(stats.loadedTileCount == 21);
+	CHECK(stats.residentTileCount == 21);
+	CHECK(stats.wantedTileCount == 21);
+	CHECK(stats.evictedTileCount == 0);
+	CHECK(storeRef.GetReadCount() == 21);
+	CHECK(pageTable.mappedMips.size() == 21);
+	CHECK(std::is_sorted(pageTable.mappedMips.rbegin(), pageTable.mappedMips.rend()));
+
+	for (uint32_t tile = 0; tile < layout.tileCount; tile++)
+		CHECK(cache.GetSlot(0, tile) != TILE_CACHE_NO_SLOT && pageTable.tiles[cache.GetSlot(0, tile)] == tile);
+
+	// Min mip map shows mip 0 everywhere.
+	for (const float mip : cache.GetMinMipMap(0))
+		CHECK(mip == 0.0f);
+}
+
+TEST_CASE(TileCacheKeepsCoarseTilesWhenSlotsRunOut)
+{
+	const TileLayout layout = CreateLayout();
+
+	TileCache cache(8);
+	cache.AddTexture(std::make_unique<SimulatedTileStore>(layout, 0), 0);
+	cache.Start();
+
+	// 21 tiles wanted, 8 slots: coarse ones go first, and no fine tile is resident without tiles over it.
+	const std::vector<TileRequest> requests = { { 0.0f, 0.0f, 0.5f, 1.0f, 0.001f } };
+	PageTable pageTable(cache.GetSlotCount());
+	uint64_t frame = 0;
+	Settle(cache, pageTable, requests, 4, frame);
+	cache.Stop();
+
+	CHECK(pageTable.errorCount == 0);
+
+	const TileCacheStats stats = cache.GetStats();
+	CHECK(stats.residentTileCount == 8);
+	CHECK(stats.overflowCount == 0);
+	CHECK(stats.evictedTileCount == 0);
+
+	for (uint32_t tile = 0; tile < layout.tileCount; tile++)
+	{
+		const uint32_t parent = layout.GetParentTile(tile);
+		if (cache.GetSlot(0, tile) != TILE_CACHE_NO_SLOT && parent < layout.tileCount)
+			CHECK(cache.GetSlot(0, parent) != TILE_CACHE_NO_SLOT);
+	}
+	for (uint32_t tile = layout.mipFirstTile[1]; tile < layout.tileCount; tile++)
+		CHECK(cache.GetSlot(0, tile) != TILE_CACHE_NO_SLOT);
+}
+
+TEST_CASE(TileCacheEvictsLeastRecentlyUsed)
+{
+	const TileLayout layout = CreateLayout();
+
+	TileCache cache(8);
+	cache.AddTexture(std::make_unique<SimulatedTileStore>(layout, 0), 0);
+	cache.Start();
+
+	// Each corner wants its mip 0 and mip 1 tile, and mip 2 tile they share.
+	const std::vector<TileRequest> a = { CreateRequest(0, 0) };
+	const std::vector<TileRequest> b = { CreateRequest(3, 3) };
+	const std::vector<TileRequest> c = { CreateRequest(0, 3) };
+	const std::vector<TileRequest> d = { CreateRequest(3, 0) };
+
+	PageTable pageTable(cache.GetSlotCount());
+	uint64_t frame = 0;
+	Settle(cache, pageTable, a, 4, frame);
+	Settle(cache, pageTable, b, 4, frame);
+	Settle(cache, pageTable, c, 4, frame);
+	CHECK(cache.GetStats().residentTileCount == 7);
+
+	// Touching a again leaves b least recent, so d takes the last free slot and the slot of b mip 0 tile.
+	// Its mip 1 tile stays, being more recent than tile under it.
+	Settle(cache, pageTable, a, 4, frame);
+	Settle(cache, pageTable, d, 4, frame);
+	cache.Stop();
+
+	CHECK(pageTable.errorCount == 0);
+
+	const TileCacheStats stats = cache.GetStats();
+	CHECK(stats.residentTileCount == 8);
+	CHECK(stats.evictedTileCount == 1);
+	CHECK(stats.loadedTileCount == 9);
+
+	CHECK(cache.GetSlot(0, layout.GetTileIndex(0, 3, 3)) == TILE_CACHE_NO_SLOT);
+	CHECK(!pageTable.IsMapped(layout.GetTileIndex(0, 3, 3)));
+
+	const uint32_t residentTiles[] =
+	{
+		layout.GetTileIndex(0, 0, 0), layout.GetTileIndex(1, 0, 0),
+		layout.GetTileIndex(1, 1, 1),
+		layout.GetTileIndex(0, 0, 3), layout.GetTileIndex(1, 0, 1),
+		layout.GetTileIndex(0, 3, 0), layout.GetTileIndex(1, 1, 0),
+		layout.GetTileIndex(2, 0, 0),
+	};
+	for (const uint32_t tile : residentTiles)
+		CHECK(cache.GetSlot(0, tile) != TILE_CACHE_NO_SLOT && pageTable.IsMapped(tile));
+
+	// Evicted tile is coarser in min mip map now, around it too.
+	const std::vector<float>& minMips = cache.GetMinMipMap(0);
+	CHECK(minMips[3 * 4 + 3] == 1.0f);
+	CHECK(minMips[2 * 4 + 2] == 1.0f);
+}
+
+TEST_CASE(TileCacheDoesNotRetryFailedTiles)
+{
+	const TileLayout layout = CreateLayout();
+
+	auto store = std::make_unique<SimulatedTileStore>(layout, 0);
+	SimulatedTileStore& storeRef = *store;
+	store->SetFailing(layout.GetTileIndex(0, 0, 0));
+
+	TileCache cache(32);
+	cache.AddTexture(std::move(store), 0);
+	cache.Start();
+
+	const std::vector<TileRequest> requests = { { 0.0f, 0.0f, 0.5f, 1.0f, 0.001f } };
+	PageTable pageTable(cache.GetSlotCount());
+	uint64_t frame = 0;
+	Settle(cache, pageTable, requests, 8, frame);
+	Settle(cache, pageTable, requests, 8, frame);
+	cache.Stop();
+
+	CHECK(pageTable.errorCount == 0);
+
+	const TileCacheStats stats = cache.GetStats();
+	CHECK(stats.failedTileCount == 1);
+	CHECK(stats.residentTileCount == 20);
+	CHECK(storeRef.GetReadCount() == 21);
+
+	// Corner falls back to mip 1, and so do its neighbours.
+	const std::vector<float>& minMips = cache.GetMinMipMap(0);
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		for (uint32_t x = 0; x < 4; x++)
+			CHECK(minMips[y * 4 + x] == (x <= 1 && y <= 1 ? 1.0f : 0.0f));
+	}
+}
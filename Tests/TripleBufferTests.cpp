@@ -0,0 +1,141 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Large enough that a slot written while being read shows up as mixed values.
+	struct Packet
+	{
+		uint64_t								sequence;
+		std::chrono::steady_clock::time_point	sampleTime;		// As inputSampleTime of Apollo's frame packet
+		uint64_t								values[1024];
+	};
+
+	void WritePacket(Packet& packet, uint64_t sequence)
+	{
+		packet.sequence = sequence;
+		for (uint64_t& value : packet.values)
+			value = sequence;
+	}
+
+	bool IsWhole(const Packet& packet)
+	{
+		for (const uint64_t value : packet.values)
+		{
+			if (value != packet.sequence)
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE(TripleBufferKeepsLatestValue)
+{
+	TripleBuffer<uint32_t> buffer;
+	for (uint32_t i = 0; i < 3; i++)
+		buffer.GetBuffer(i) = 0;
+
+	// Nothing published yet.
+	CHECK(!buffer.Acquire());
+
+	buffer.GetWriteBuffer() = 1;
+	buffer.Publish();
+	buffer.GetWriteBuffer() = 2;
+	buffer.Publish();
+
+	// Second value replaced first one, and is acquired once.
+	CHECK(buffer.Acquire());
+	CHECK(buffer.GetReadBuffer() == 2);
+	CHECK(!buffer.Acquire());
+	CHECK(buffer.GetReadBuffer() == 2);
+
+	// Producer never writes into buffer consumer holds.
+	for (uint32_t value = 3; value < 10; value++)
+	{
+		CHECK(&buffer.GetWriteBuffer() != &buffer.GetReadBuffer());
+		buffer.GetWriteBuffer() = value;
+		buffer.Publish();
+		CHECK(&buffer.GetWriteBuffer() != &buffer.GetReadBuffer());
+	}
+	CHECK(buffer.Acquire());
+	CHECK(buffer.GetReadBuffer() == 9);
+}
+
+TEST_CASE(TripleBufferConcurrentHandOff)
+{
+	constexpr uint64_t packetCount = 20000;
+
+	auto buffer = std::make_unique<TripleBuffer<Packet>>();
+	for (uint32_t i = 0; i < 3; i++)
+		WritePacket(buffer->GetBuffer(i), 0);
+
+	// Sample time of every sequence, and last published sequence, for consumer to bound latency with.
+	std::vector<std::chrono::steady_clock::time_point> sampleTimes(packetCount + 1, std::chrono::steady_clock::now());
+	std::atomic<uint64_t> publishedSequence = 0;
+
+	// Producer samples and publishes every sequence number once, as simulation thread does.
+	std::thread producer([&]()
+	{
+		for (uint64_t sequence = 1; sequence <= packetCount; sequence++)
+		{
+			sampleTimes[sequence] = std::chrono::steady_clock::now();
+			Packet& packet = buffer->GetWriteBuffer();
+			WritePacket(packet, sequence);
+			packet.sampleTime = sampleTimes[sequence];
+			buffer->Publish();
+			publishedSequence.store(sequence, std::memory_order_release);
+		}
+	});
+
+	// Consumer must see whole packets only, each newer than the last one, and finally the last one.
+	uint64_t lastSequence = 0;
+	uint64_t acquiredCount = 0;
+	uint64_t tornCount = 0;
+	uint64_t staleCount = 0;
+	uint64_t lateCount = 0;
+	uint64_t latencyCount = 0;
+	while (lastSequence < packetCount)
+	{
+		const uint64_t newestSequence = publishedSequence.load(std::memory_order_acquire);
+		if (!buffer->Acquire())
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		const Packet& packet = buffer->GetReadBuffer();
+		tornCount += IsWhole(packet) ? 0 : 1;
+		staleCount += packet.sequence > lastSequence ? 0 : 1;
+
+		// Hold it a little while producer keeps going, as render thread does.
+		if (acquiredCount % 7 == 0)
+			std::this_thread::yield();
+		tornCount += IsWhole(packet) ? 0 : 1;
+
+		// Submitted packet is never older than newest one published before acquire, so latency from its
+		// input sample to submission is at most time since that sample, with no frame queued in between.
+		const auto submitTime = std::chrono::steady_clock::now();
+		lateCount += packet.sequence >= newestSequence ? 0 : 1;
+		latencyCount += packet.sampleTime <= submitTime && submitTime - packet.sampleTime <= submitTime - sampleTimes[newestSequence] ? 0 : 1;
+
+		lastSequence = packet.sequence;
+		acquiredCount++;
+	}
+
+	producer.join();
+
+	CHECK(tornCount == 0);
+	CHECK(staleCount == 0);
+	CHECK(lateCount == 0);
+	CHECK(latencyCount == 0);
+	CHECK(acquiredCount > 0);
+	CHECK(lastSequence == packetCount);
+	CHECK(!buffer->Acquire());
+}
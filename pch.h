@@ -30,6 +30,7 @@
 #include <DirectXColors.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>